@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""Measure what weaving costs at build time: compile time and object size.
+
+Usage: build_cost.py --tool=PATH --prelude=PATH --corpus=DIR --work=DIR
+                     [--compiler=c++] [--size=size] [--output=FILE]
+                     [--top=N] [-- extra tool arguments]
+
+The corpus comes from optiweave_bench_corpus. A copy is woven by the tool
+(its headers too), then every TU is compiled at -O2 as written and as
+woven, one at a time. Per TU, this reports the compile time and the .text
+and object file sizes of both builds.
+
+With Clang, both builds also pass -ftime-trace. The woven traces are
+split by prelude entity (__primop_add, __maybe_primop_subscript,
+has_subscript_overload, ...): each frontend event whose detail names
+something in namespace optiweave is charged its self time, meaning its
+duration minus the events nested in it. The cost of including
+prelude.hpp, with the standard headers it pulls in, is reported
+separately. GCC has no -ftime-trace, so there the attribution is skipped.
+"""
+
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+DEFAULT_TOOL_ARGS = ["--arithmetic-ops"]
+
+PRELUDE_ENTITY = re.compile(r"optiweave::(\w+)")
+# Frontend events whose detail names a template or declaration
+ATTRIBUTED_EVENTS = {
+    "InstantiateClass", "InstantiateFunction", "ParseClass",
+    "ParseTemplate", "CodeGen Function", "DebugType",
+}
+
+
+def run(command):
+    result = subprocess.run(command, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.stderr.write(" ".join(command) + "\n" + result.stdout +
+                         result.stderr)
+        raise SystemExit(2)
+    return result.stdout
+
+
+def is_clang(compiler):
+    return "clang" in run([compiler, "--version"]).lower()
+
+
+def text_size(size_tool, obj):
+    """Bytes in .text sections, from `size -A`."""
+    total = 0
+    for line in run([size_tool, "-A", obj]).splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0].startswith(".text"):
+            total += int(fields[1])
+    return total
+
+
+def compile_tu(options, source, obj, extra):
+    command = [options["compiler"], "-std=c++20", "-O2", "-c", source,
+               "-o", obj] + extra
+    start = time.perf_counter()
+    run(command)
+    return time.perf_counter() - start
+
+
+def self_times(events):
+    """(event, self microseconds) for the complete events of one trace."""
+    result = []
+    by_thread = {}
+    for event in events:
+        # "Total ..." events are per-category sums, not spans
+        if event.get("ph") == "X" and "dur" in event and \
+                not event.get("name", "").startswith("Total "):
+            by_thread.setdefault(event.get("tid"), []).append(event)
+    for thread_events in by_thread.values():
+        # Parents start first; at the same start the longer one is outer
+        thread_events.sort(key=lambda e: (e["ts"], -e["dur"]))
+        stack = []  # [event, self time]
+        for event in thread_events:
+            while stack and event["ts"] >= stack[-1][0]["ts"] + \
+                    stack[-1][0]["dur"]:
+                result.append(tuple(stack.pop()))
+            if stack:
+                stack[-1][1] -= event["dur"]
+            stack.append([event, event["dur"]])
+        result.extend(tuple(entry) for entry in stack)
+    return result
+
+
+def attribute(trace_path, prelude_name):
+    """Self time per prelude entity, and the prelude include time (µs)."""
+    with open(trace_path) as f:
+        events = json.load(f)["traceEvents"]
+    entities = {}
+    include = 0
+    for event in events:
+        detail = event.get("args", {}).get("detail", "")
+        # Outermost Source event of the prelude, so nested headers count
+        if event.get("name") == "Source" and \
+                os.path.basename(detail) == prelude_name:
+            include = max(include, event.get("dur", 0))
+    for event, micros in self_times(events):
+        if event["name"] not in ATTRIBUTED_EVENTS:
+            continue
+        match = PRELUDE_ENTITY.search(event.get("args", {}).get("detail", ""))
+        if match:
+            entry = entities.setdefault(match.group(1), [0, 0])
+            entry[0] += micros
+            entry[1] += 1
+    return entities, include
+
+
+def main(argv):
+    options = {"compiler": "c++", "size": "size", "output": None, "top": "15"}
+    tool_args = DEFAULT_TOOL_ARGS
+    args = argv[1:]
+    if "--" in args:
+        at = args.index("--")
+        tool_args = args[at + 1:]
+        args = args[:at]
+    for arg in args:
+        if arg in ("-h", "--help"):
+            print(__doc__.strip())
+            return 0
+        key, _, value = arg.lstrip("-").partition("=")
+        options[key] = value
+    if any(not options.get(key)
+           for key in ("tool", "prelude", "corpus", "work")):
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    corpus = options["corpus"]
+    work = options["work"]
+    woven_dir = os.path.join(work, "woven")
+    objects = os.path.join(work, "objects")
+    shutil.rmtree(work, ignore_errors=True)
+    # The tool rewrites only the files it changes, so weave a copy in place
+    shutil.copytree(corpus, woven_dir)
+    os.makedirs(objects)
+
+    sources = sorted(name for name in os.listdir(corpus)
+                     if name.endswith(".cpp"))
+    run([options["tool"], f"--prelude={options['prelude']}"] + tool_args +
+        [os.path.join(woven_dir, name) for name in sources] +
+        ["--", "-I", woven_dir])
+
+    trace = is_clang(options["compiler"])
+    if not trace:
+        print("note: the compiler has no -ftime-trace; reporting compile "
+              "time and sizes only", file=sys.stderr)
+    prelude_name = os.path.basename(options["prelude"])
+
+    units = []
+    entities = {}
+    include_micros = 0
+    for name in sources:
+        stem = os.path.splitext(name)[0]
+        unit = {"tu": stem}
+        for variant, directory, extra in (
+                ("raw", corpus, []),
+                ("woven", woven_dir, ["-include", options["prelude"]])):
+            obj = os.path.join(objects, f"{stem}.{variant}.o")
+            flags = ["-I", directory] + extra
+            if trace:
+                flags.append("-ftime-trace")
+            seconds = compile_tu(options, os.path.join(directory, name), obj,
+                                 flags)
+            unit[variant] = {
+                "seconds": seconds,
+                "object_bytes": os.path.getsize(obj),
+                "text_bytes": text_size(options["size"], obj),
+            }
+            if trace and variant == "woven":
+                # Clang writes the trace next to the object
+                tu_entities, include = attribute(
+                    os.path.splitext(obj)[0] + ".json", prelude_name)
+                include_micros += include
+                for entity, (micros, count) in tu_entities.items():
+                    entry = entities.setdefault(entity, [0, 0])
+                    entry[0] += micros
+                    entry[1] += count
+        units.append(unit)
+
+    print(f"{'tu':<12}{'raw s':>8}{'woven s':>9}{'ratio':>7}"
+          f"{'raw .text':>11}{'woven .text':>13}{'delta':>8}"
+          f"{'raw obj':>10}{'woven obj':>11}")
+    totals = {"raw": [0.0, 0, 0], "woven": [0.0, 0, 0]}
+    for unit in units:
+        raw, woven = unit["raw"], unit["woven"]
+        for variant in totals:
+            totals[variant][0] += unit[variant]["seconds"]
+            totals[variant][1] += unit[variant]["text_bytes"]
+            totals[variant][2] += unit[variant]["object_bytes"]
+        delta = (woven["text_bytes"] - raw["text_bytes"]) / \
+            raw["text_bytes"] if raw["text_bytes"] else 0.0
+        print(f"{unit['tu']:<12}{raw['seconds']:>8.2f}"
+              f"{woven['seconds']:>9.2f}"
+              f"{woven['seconds'] / raw['seconds']:>6.2f}x"
+              f"{raw['text_bytes']:>11}{woven['text_bytes']:>13}"
+              f"{delta:>+8.0%}{raw['object_bytes']:>10}"
+              f"{woven['object_bytes']:>11}")
+    raw, woven = totals["raw"], totals["woven"]
+    print(f"{'total':<12}{raw[0]:>8.2f}{woven[0]:>9.2f}"
+          f"{woven[0] / raw[0]:>6.2f}x{raw[1]:>11}{woven[1]:>13}"
+          f"{(woven[1] - raw[1]) / raw[1] if raw[1] else 0.0:>+8.0%}"
+          f"{raw[2]:>10}{woven[2]:>11}")
+
+    ranked = sorted(entities.items(), key=lambda item: -item[1][0])
+    if trace:
+        print(f"\nprelude.hpp include: {include_micros / 1e6:.2f} s over "
+              f"{len(units)} TUs")
+        print(f"{'prelude entity':<36}{'self s':>9}{'events':>9}")
+        for entity, (micros, count) in ranked[:int(options["top"])]:
+            print(f"{entity:<36}{micros / 1e6:>9.3f}{count:>9}")
+
+    if options["output"]:
+        report = {
+            "units": units,
+            "prelude_include_seconds": include_micros / 1e6 if trace else None,
+            "prelude_entities": {
+                entity: {"self_seconds": micros / 1e6, "events": count}
+                for entity, (micros, count) in ranked
+            },
+        }
+        with open(options["output"], "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,110 @@
+// Strided gather used to check --insert-prefetch advice.
+//
+// Visits every 8th double of a 256 MiB array column by column, so each
+// access lands on a new cache line that the hardware prefetcher does not
+// follow. The prefetched variant is the code the tool emits for the
+// subscript `in[i]` with advice stride_bytes = stride * 8, distance = d:
+//
+//   (__builtin_prefetch(&(in)[(i) + (d * stride)]), in[i])
+//
+// Usage: optiweave_prefetch_gather [distance] [stride-elements]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kElements = (std::size_t{256} << 20) / sizeof(double);
+constexpr int kRepetitions = 5;
+
+// Enough dependent work per element that the loop is not purely
+// load-bound; otherwise out-of-order execution already overlaps the misses
+inline double work(double x) {
+  for (int k = 0; k < 12; ++k) {
+    x = x * 1.0000001 + 0.5;
+  }
+  return x;
+}
+
+__attribute__((noinline)) double gather(const double *in, std::size_t n,
+                                        std::size_t stride) {
+  double sum = 0;
+  for (std::size_t start = 0; start < stride; start += 8) {
+    for (std::size_t i = start; i < n; i += stride) {
+      sum += work(in[i]);
+    }
+  }
+  return sum;
+}
+
+__attribute__((noinline)) double gatherPrefetched(const double *in,
+                                                  std::size_t n,
+                                                  std::size_t stride,
+                                                  std::size_t distance) {
+  double sum = 0;
+  for (std::size_t start = 0; start < stride; start += 8) {
+    for (std::size_t i = start; i < n; i += stride) {
+      sum += work((__builtin_prefetch(&(in)[(i) + (distance * stride)]), in[i]));
+    }
+  }
+  return sum;
+}
+
+template <typename Kernel> double bestMillis(Kernel &&kernel, double &result) {
+  double best = 1e300;
+  for (int rep = 0; rep < kRepetitions; ++rep) {
+    auto start = std::chrono::steady_clock::now();
+    result = kernel();
+    auto stop = std::chrono::steady_clock::now();
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(stop - start).count());
+  }
+  return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::size_t distance = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8;
+  std::size_t stride = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 520;
+  if (distance == 0 || stride < 8) {
+    std::fprintf(stderr, "usage: %s [distance>0] [stride-elements>=8]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  // Padding so the prefetch past the end stays inside the allocation;
+  // __builtin_prefetch does not fault, but the address must be computable
+  std::vector<double> data(kElements + distance * stride, 1.0);
+  std::size_t accesses = 0;
+  for (std::size_t start = 0; start < stride; start += 8) {
+    accesses += (kElements - start + stride - 1) / stride;
+  }
+
+  double plain_sum = 0, prefetched_sum = 0;
+  double plain =
+      bestMillis([&] { return gather(data.data(), kElements, stride); },
+                 plain_sum);
+  double prefetched = bestMillis(
+      [&] {
+        return gatherPrefetched(data.data(), kElements, stride, distance);
+      },
+      prefetched_sum);
+  if (plain_sum != prefetched_sum) {
+    std::fprintf(stderr, "results differ: %f vs %f\n", plain_sum,
+                 prefetched_sum);
+    return 1;
+  }
+
+  std::printf("stride %zu bytes, distance %zu, %zu accesses\n",
+              stride * sizeof(double), distance, accesses);
+  std::printf("baseline    %8.1f ms  %6.2f ns/access\n", plain,
+              plain * 1e6 / accesses);
+  std::printf("prefetched  %8.1f ms  %6.2f ns/access\n", prefetched,
+              prefetched * 1e6 / accesses);
+  std::printf("speedup     %8.2fx\n", plain / prefetched);
+  return 0;
+}
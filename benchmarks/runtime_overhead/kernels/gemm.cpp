@@ -0,0 +1,16 @@
+#include "kernels.hpp"
+
+namespace OPTIWEAVE_KERNELS {
+
+void gemm(const double *a, const double *b, double *c, int n) {
+  for (int i = 0; i < n; ++i) {
+    for (int k = 0; k < n; ++k) {
+      double scale = a[i * n + k];
+      for (int j = 0; j < n; ++j) {
+        c[i * n + j] += scale * b[k * n + j];
+      }
+    }
+  }
+}
+
+} // namespace OPTIWEAVE_KERNELS
@@ -0,0 +1,22 @@
+#include "kernels.hpp"
+
+namespace OPTIWEAVE_KERNELS {
+
+std::size_t hashProbe(const std::uint64_t *table, std::uint64_t mask,
+                      const std::uint64_t *keys, std::size_t count) {
+  std::size_t found = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint64_t key = keys[i];
+    std::uint64_t slot = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+    while (table[slot] != 0) {
+      if (table[slot] == key) {
+        ++found;
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+  return found;
+}
+
+} // namespace OPTIWEAVE_KERNELS
@@ -0,0 +1,37 @@
+// Kernels of the runtime overhead suite.
+//
+// Every kernel is compiled twice: as written (namespace raw) and after
+// `optiweave --arithmetic-ops` (namespace woven). OPTIWEAVE_KERNELS names
+// the namespace, so this header has no include guard and the benchmark
+// includes it once per variant.
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef OPTIWEAVE_KERNELS
+#error "define OPTIWEAVE_KERNELS to the variant's namespace"
+#endif
+
+namespace OPTIWEAVE_KERNELS {
+
+/// c += a * b for n x n row-major matrices, i-k-j order
+void gemm(const double *a, const double *b, double *c, int n);
+
+/// 5-point Jacobi sweep over the interior of a rows x cols grid
+void stencil5(const double *in, double *out, int rows, int cols);
+
+/// Linear-probing lookups in an open-addressing table; 0 marks empty slots
+std::size_t hashProbe(const std::uint64_t *table, std::uint64_t mask,
+                      const std::uint64_t *keys, std::size_t count);
+
+/// y = A x for A in compressed sparse row form
+void spmv(const int *row_ptr, const int *col_idx, const double *values,
+          const double *x, double *y, int rows);
+
+/// In-place quicksort with insertion sort for short ranges
+void quicksort(int *data, int count);
+
+/// Sum of the comma-separated, possibly negative integers in text
+std::int64_t parseIntegers(const char *text, std::size_t length);
+
+} // namespace OPTIWEAVE_KERNELS
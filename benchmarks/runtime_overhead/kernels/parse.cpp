@@ -0,0 +1,24 @@
+#include "kernels.hpp"
+
+namespace OPTIWEAVE_KERNELS {
+
+std::int64_t parseIntegers(const char *text, std::size_t length) {
+  std::int64_t total = 0;
+  std::size_t i = 0;
+  while (i < length) {
+    bool negative = text[i] == '-';
+    if (negative) {
+      ++i;
+    }
+    std::int64_t value = 0;
+    while (i < length && text[i] >= '0' && text[i] <= '9') {
+      value = value * 10 + (text[i] - '0');
+      ++i;
+    }
+    total += negative ? -value : value;
+    ++i; // the comma
+  }
+  return total;
+}
+
+} // namespace OPTIWEAVE_KERNELS
@@ -0,0 +1,54 @@
+#include "kernels.hpp"
+
+namespace OPTIWEAVE_KERNELS {
+
+namespace {
+
+void insertionSort(int *data, int count) {
+  for (int i = 1; i < count; ++i) {
+    int value = data[i];
+    int j = i - 1;
+    while (j >= 0 && data[j] > value) {
+      data[j + 1] = data[j];
+      --j;
+    }
+    data[j + 1] = value;
+  }
+}
+
+} // namespace
+
+void quicksort(int *data, int count) {
+  while (count > 16) {
+    // Hoare partition around the middle element
+    int pivot = data[count / 2];
+    int i = -1;
+    int j = count;
+    for (;;) {
+      do {
+        ++i;
+      } while (data[i] < pivot);
+      do {
+        --j;
+      } while (data[j] > pivot);
+      if (i >= j) {
+        break;
+      }
+      int swapped = data[i];
+      data[i] = data[j];
+      data[j] = swapped;
+    }
+    // Recurse into the smaller half, loop on the larger
+    if (j + 1 < count - j - 1) {
+      quicksort(data, j + 1);
+      data += j + 1;
+      count -= j + 1;
+    } else {
+      quicksort(data + j + 1, count - j - 1);
+      count = j + 1;
+    }
+  }
+  insertionSort(data, count);
+}
+
+} // namespace OPTIWEAVE_KERNELS
@@ -0,0 +1,16 @@
+#include "kernels.hpp"
+
+namespace OPTIWEAVE_KERNELS {
+
+void spmv(const int *row_ptr, const int *col_idx, const double *values,
+          const double *x, double *y, int rows) {
+  for (int i = 0; i < rows; ++i) {
+    double sum = 0;
+    for (int k = row_ptr[i]; k < row_ptr[i + 1]; ++k) {
+      sum += values[k] * x[col_idx[k]];
+    }
+    y[i] = sum;
+  }
+}
+
+} // namespace OPTIWEAVE_KERNELS
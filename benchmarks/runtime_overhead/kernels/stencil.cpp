@@ -0,0 +1,16 @@
+#include "kernels.hpp"
+
+namespace OPTIWEAVE_KERNELS {
+
+void stencil5(const double *in, double *out, int rows, int cols) {
+  for (int i = 1; i < rows - 1; ++i) {
+    for (int j = 1; j < cols - 1; ++j) {
+      out[i * cols + j] =
+          0.2 * (in[i * cols + j] + in[(i - 1) * cols + j] +
+                 in[(i + 1) * cols + j] + in[i * cols + j - 1] +
+                 in[i * cols + j + 1]);
+    }
+  }
+}
+
+} // namespace OPTIWEAVE_KERNELS
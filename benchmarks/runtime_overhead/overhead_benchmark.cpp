@@ -0,0 +1,309 @@
+// optiweave_overhead: cost of the prelude wrappers and runtime policies on
+// realistic kernels.
+//
+// Each kernel runs as written (raw/<kernel>) and as transformed by
+// `optiweave --arithmetic-ops` (woven/<kernel>) in the same process, so the
+// ratio of the two is the slowdown under the policy selected with
+// --policy. The runtime reads its configuration once per process;
+// run_overhead.py runs the binary once per policy and tabulates the
+// ratios.
+//
+//   disabled  wrappers call nothing; what remains is the flag checks
+//   counters  per-site event counters (OPTIWEAVE_TELEMETRY)
+//   sampled   SHARDS reuse-distance sampling (OPTIWEAVE_MRC)
+//   trace     every event to the binary trace (OPTIWEAVE_TRACE)
+//
+// Usage: optiweave_overhead --policy=NAME [benchmark options]
+
+#include "prelude.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#define OPTIWEAVE_KERNELS raw
+#include "kernels/kernels.hpp"
+#undef OPTIWEAVE_KERNELS
+#define OPTIWEAVE_KERNELS woven
+#include "kernels/kernels.hpp"
+#undef OPTIWEAVE_KERNELS
+
+namespace {
+
+constexpr int kMatrixSize = 128;
+constexpr int kGridSize = 512;
+constexpr int kTableBits = 16;
+constexpr std::size_t kLookups = 100000;
+constexpr int kSparseRows = 20000;
+constexpr int kNonZerosPerRow = 10;
+constexpr int kSortCount = 50000;
+constexpr int kParseCount = 100000;
+
+/**
+ * @brief Select a runtime policy before the first instrumented call
+ * @return false for an unknown policy, or if there is no scratch directory
+ */
+bool applyPolicy(const std::string &policy) {
+  if (policy != "disabled" && policy != "counters" && policy != "sampled" &&
+      policy != "trace") {
+    return false;
+  }
+  optiweave::g_config.log_array_accesses = policy != "disabled";
+  optiweave::g_config.log_arithmetic_ops = policy != "disabled";
+  optiweave::g_config.log_to_stderr = false;
+  if (policy == "disabled") {
+    return true;
+  }
+
+  // Reports and traces go to a scratch directory
+  char scratch[] = "/tmp/optiweave-overhead.XXXXXX";
+  if (!mkdtemp(scratch)) {
+    std::perror("optiweave_overhead: mkdtemp");
+    return false;
+  }
+  std::string dir = scratch;
+  if (policy == "counters") {
+    setenv("OPTIWEAVE_TELEMETRY", "1", 1);
+  } else if (policy == "sampled") {
+    setenv("OPTIWEAVE_MRC", "1", 1);
+    setenv("OPTIWEAVE_MRC_REPORT", (dir + "/mrc.tsv").c_str(), 1);
+  } else {
+    setenv("OPTIWEAVE_TRACE", "1", 1);
+    setenv("OPTIWEAVE_TRACE_DIR", dir.c_str(), 1);
+    setenv("OPTIWEAVE_TRACE_BUDGET_MB", "512", 1);
+  }
+  setenv("OPTIWEAVE_HEAP_REPORT", (dir + "/heap.tsv").c_str(), 1);
+  std::fprintf(stderr, "optiweave_overhead: policy %s, output in %s\n",
+               policy.c_str(), dir.c_str());
+  return true;
+}
+
+std::vector<double> randomDoubles(std::size_t count, unsigned seed) {
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<double> value(-1.0, 1.0);
+  std::vector<double> out(count);
+  for (double &x : out) {
+    x = value(random);
+  }
+  return out;
+}
+
+struct GemmData {
+  std::vector<double> a = randomDoubles(kMatrixSize * kMatrixSize, 1);
+  std::vector<double> b = randomDoubles(kMatrixSize * kMatrixSize, 2);
+  std::vector<double> c = std::vector<double>(kMatrixSize * kMatrixSize);
+};
+
+struct StencilData {
+  std::vector<double> in = randomDoubles(kGridSize * kGridSize, 3);
+  std::vector<double> out = std::vector<double>(kGridSize * kGridSize);
+};
+
+struct HashData {
+  std::vector<std::uint64_t> table;
+  std::vector<std::uint64_t> keys;
+
+  /// Half full; half of the lookups hit
+  HashData() : table(std::size_t{1} << kTableBits) {
+    std::mt19937_64 random(4);
+    std::uint64_t mask = table.size() - 1;
+    while (keys.size() < table.size() / 2) {
+      std::uint64_t key = random() | 1;
+      std::uint64_t slot = (key * 0x9E3779B97F4A7C15ull) >> 32 & mask;
+      while (table[slot] != 0) {
+        slot = (slot + 1) & mask;
+      }
+      table[slot] = key;
+      keys.push_back(key);
+    }
+    keys.resize(kLookups / 2);
+    while (keys.size() < kLookups) {
+      keys.push_back(random() | 1);
+    }
+    std::shuffle(keys.begin(), keys.end(), random);
+  }
+};
+
+struct SparseData {
+  std::vector<int> row_ptr;
+  std::vector<int> col_idx;
+  std::vector<double> values;
+  std::vector<double> x = randomDoubles(kSparseRows, 5);
+  std::vector<double> y = std::vector<double>(kSparseRows);
+
+  SparseData() {
+    std::mt19937 random(6);
+    std::uniform_int_distribution<int> column(0, kSparseRows - 1);
+    row_ptr.push_back(0);
+    for (int i = 0; i < kSparseRows; ++i) {
+      for (int k = 0; k < kNonZerosPerRow; ++k) {
+        col_idx.push_back(column(random));
+      }
+      std::sort(col_idx.end() - kNonZerosPerRow, col_idx.end());
+      row_ptr.push_back(static_cast<int>(col_idx.size()));
+    }
+    values = randomDoubles(col_idx.size(), 7);
+  }
+};
+
+std::vector<int> unsortedInts() {
+  std::mt19937 random(8);
+  std::vector<int> out(kSortCount);
+  for (int &x : out) {
+    x = static_cast<int>(random());
+  }
+  return out;
+}
+
+std::string integerText() {
+  std::mt19937 random(9);
+  std::uniform_int_distribution<int> value(-1000000, 1000000);
+  std::string out;
+  for (int i = 0; i < kParseCount; ++i) {
+    out += std::to_string(value(random));
+    out += ',';
+  }
+  return out;
+}
+
+/// One benchmark per kernel, for the raw or the woven variant
+template <bool Woven> struct Suite {
+  static void gemm(benchmark::State &state) {
+    static GemmData data;
+    for (auto _ : state) {
+      if constexpr (Woven) {
+        woven::gemm(data.a.data(), data.b.data(), data.c.data(), kMatrixSize);
+      } else {
+        raw::gemm(data.a.data(), data.b.data(), data.c.data(), kMatrixSize);
+      }
+      benchmark::DoNotOptimize(data.c.data());
+      benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kMatrixSize * kMatrixSize *
+                            kMatrixSize);
+  }
+
+  static void stencil(benchmark::State &state) {
+    static StencilData data;
+    for (auto _ : state) {
+      if constexpr (Woven) {
+        woven::stencil5(data.in.data(), data.out.data(), kGridSize, kGridSize);
+      } else {
+        raw::stencil5(data.in.data(), data.out.data(), kGridSize, kGridSize);
+      }
+      benchmark::DoNotOptimize(data.out.data());
+      benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * (kGridSize - 2) *
+                            (kGridSize - 2));
+  }
+
+  static void hashProbe(benchmark::State &state) {
+    static HashData data;
+    std::uint64_t mask = data.table.size() - 1;
+    for (auto _ : state) {
+      std::size_t found =
+          Woven ? woven::hashProbe(data.table.data(), mask, data.keys.data(),
+                                   data.keys.size())
+                : raw::hashProbe(data.table.data(), mask, data.keys.data(),
+                                 data.keys.size());
+      benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * data.keys.size());
+  }
+
+  static void spmv(benchmark::State &state) {
+    static SparseData data;
+    for (auto _ : state) {
+      if constexpr (Woven) {
+        woven::spmv(data.row_ptr.data(), data.col_idx.data(),
+                    data.values.data(), data.x.data(), data.y.data(),
+                    kSparseRows);
+      } else {
+        raw::spmv(data.row_ptr.data(), data.col_idx.data(), data.values.data(),
+                  data.x.data(), data.y.data(), kSparseRows);
+      }
+      benchmark::DoNotOptimize(data.y.data());
+      benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * data.values.size());
+  }
+
+  static void sort(benchmark::State &state) {
+    static const std::vector<int> input = unsortedInts();
+    std::vector<int> data(input.size());
+    for (auto _ : state) {
+      // The copy is a memcpy, small next to the sort
+      std::copy(input.begin(), input.end(), data.begin());
+      if constexpr (Woven) {
+        woven::quicksort(data.data(), static_cast<int>(data.size()));
+      } else {
+        raw::quicksort(data.data(), static_cast<int>(data.size()));
+      }
+      benchmark::DoNotOptimize(data.data());
+      benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * input.size());
+  }
+
+  static void parse(benchmark::State &state) {
+    static const std::string text = integerText();
+    for (auto _ : state) {
+      std::int64_t total =
+          Woven ? woven::parseIntegers(text.data(), text.size())
+                : raw::parseIntegers(text.data(), text.size());
+      benchmark::DoNotOptimize(total);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+  }
+
+  static void registerAll() {
+    const std::string prefix = Woven ? "woven/" : "raw/";
+    benchmark::RegisterBenchmark((prefix + "gemm").c_str(), gemm);
+    benchmark::RegisterBenchmark((prefix + "stencil").c_str(), stencil);
+    benchmark::RegisterBenchmark((prefix + "hash_probe").c_str(), hashProbe);
+    benchmark::RegisterBenchmark((prefix + "spmv").c_str(), spmv);
+    benchmark::RegisterBenchmark((prefix + "sort").c_str(), sort);
+    benchmark::RegisterBenchmark((prefix + "parse").c_str(), parse);
+  }
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string policy = "disabled";
+  std::vector<char *> args;
+  for (int i = 0; i < argc; ++i) {
+    if (std::strncmp(argv[i], "--policy=", 9) == 0) {
+      policy = argv[i] + 9;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (!applyPolicy(policy)) {
+    std::fprintf(stderr,
+                 "optiweave_overhead: cannot use policy '%s'; use disabled, "
+                 "counters, sampled or trace\n",
+                 policy.c_str());
+    return 1;
+  }
+
+  Suite<false>::registerAll();
+  Suite<true>::registerAll();
+  benchmark::AddCustomContext("optiweave_policy", policy);
+
+  int count = static_cast<int>(args.size());
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Run optiweave_overhead under every policy and tabulate the slowdowns.
+
+Usage: run_overhead.py BINARY [--remarks=DIR] [--output=FILE]
+                       [--policies=disabled,counters,sampled,trace]
+                       [-- benchmark options]
+
+The runtime reads its configuration once per process, so the binary runs
+once per policy. The slowdown of a kernel is its woven real time over its
+raw real time in the same run. With --remarks, the vectorization column
+comes from the optimization remarks the build wrote for each kernel
+source: GCC's -fopt-info-vec-optimized files (<variant>_<kernel>.vec) or
+Clang's optimization records (<variant>_<kernel>.opt.yaml).
+"""
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+POLICIES = ["disabled", "counters", "sampled", "trace"]
+
+# Benchmark names, which are also the kernel source names
+KERNELS = ["gemm", "stencil", "hash_probe", "spmv", "sort", "parse"]
+
+
+def vectorized(remarks, variant, kernel):
+    """True or False from the kernel's remarks, None if there are none."""
+    if not remarks:
+        return None
+    base = os.path.join(remarks, f"{variant}_{kernel}")
+    if os.path.exists(base + ".vec"):
+        with open(base + ".vec") as f:
+            return "loop vectorized" in f.read()
+    if os.path.exists(base + ".opt.yaml"):
+        with open(base + ".opt.yaml") as f:
+            for record in f.read().split("--- ")[1:]:
+                if record.startswith("!Passed") and \
+                        "Pass:            loop-vectorize" in record:
+                    return True
+        return False
+    return None
+
+
+def run_policy(binary, policy, extra):
+    """Real times in ns per benchmark name for one policy."""
+    with tempfile.NamedTemporaryFile(suffix=".json") as out:
+        subprocess.run([binary, f"--policy={policy}",
+                        "--benchmark_format=console",
+                        "--benchmark_out_format=json",
+                        f"--benchmark_out={out.name}"] + extra,
+                       check=True, stdout=subprocess.DEVNULL)
+        results = json.load(out)
+    times = {}
+    for benchmark in results["benchmarks"]:
+        if benchmark.get("run_type", "iteration") != "iteration":
+            continue
+        times[benchmark["name"]] = benchmark["real_time"]
+    return times
+
+
+def vector_label(state):
+    return {True: "yes", False: "no", None: "?"}[state]
+
+
+def main(argv):
+    remarks = None
+    output = None
+    policies = POLICIES
+    extra = []
+    args = argv[1:]
+    if "--" in args:
+        at = args.index("--")
+        extra = args[at + 1:]
+        args = args[:at]
+    paths = []
+    for arg in args:
+        if arg.startswith("--remarks="):
+            remarks = arg[len("--remarks="):]
+        elif arg.startswith("--output="):
+            output = arg[len("--output="):]
+        elif arg.startswith("--policies="):
+            policies = arg[len("--policies="):].split(",")
+        elif arg in ("-h", "--help"):
+            print(__doc__.strip())
+            return 0
+        else:
+            paths.append(arg)
+    if len(paths) != 1:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    binary = paths[0]
+
+    slowdowns = {}
+    for policy in policies:
+        print(f"running policy {policy}...", file=sys.stderr)
+        times = run_policy(binary, policy, extra)
+        for kernel in KERNELS:
+            raw = times.get(f"raw/{kernel}")
+            woven = times.get(f"woven/{kernel}")
+            if raw and woven:
+                slowdowns.setdefault(kernel, {})[policy] = woven / raw
+
+    header = f"{'kernel':<12}" + "".join(f"{p:>10}" for p in policies)
+    print(header + f"{'vec raw':>9}{'vec woven':>11}")
+    report = {"policies": policies, "kernels": {}}
+    for kernel, by_policy in slowdowns.items():
+        raw_vec = vectorized(remarks, "raw", kernel)
+        woven_vec = vectorized(remarks, "woven", kernel)
+        cells = "".join(
+            f"{by_policy[p]:>9.2f}x" if p in by_policy else f"{'-':>10}"
+            for p in policies)
+        print(f"{kernel:<12}{cells}{vector_label(raw_vec):>9}"
+              f"{vector_label(woven_vec):>11}")
+        report["kernels"][kernel] = {
+            "slowdown": by_policy,
+            "vectorized": {"raw": raw_vec, "woven": woven_vec},
+        }
+
+    if output:
+        with open(output, "w") as f:
+            json.dump(report, f, indent=2)
+            f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""Compare optiweave_bench_driver results against a stored baseline.
+
+Usage: compare_throughput.py BASELINE CURRENT [--tolerance=0.10]
+
+Prints each metric with its change and exits with 1 if any metric is
+worse than the baseline by more than the tolerance (a fraction). Exits
+with 2 if the two results come from different corpora, since their
+numbers are not comparable.
+"""
+
+import json
+import sys
+
+# (key path, label, True if larger is better)
+METRICS = [
+    (("tus_per_second",), "TUs/s", True),
+    (("rewrites_per_second",), "rewrites/s", True),
+    (("phases", "parse"), "parse s", False),
+    (("phases", "transform"), "transform s", False),
+    (("phases", "write"), "write s", False),
+    (("peak_rss_kb",), "peak RSS KiB", False),
+]
+
+# Phases this short are dominated by noise
+MIN_SECONDS = 0.05
+
+
+def lookup(results, path):
+    value = results
+    for key in path:
+        value = value[key]
+    return value
+
+
+def main(argv):
+    tolerance = 0.10
+    paths = []
+    for arg in argv[1:]:
+        if arg.startswith("--tolerance="):
+            tolerance = float(arg[len("--tolerance="):])
+        elif arg in ("-h", "--help"):
+            print(__doc__.strip())
+            return 0
+        else:
+            paths.append(arg)
+    if len(paths) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    with open(paths[0]) as f:
+        baseline = json.load(f)
+    with open(paths[1]) as f:
+        current = json.load(f)
+
+    if baseline.get("corpus") != current.get("corpus"):
+        print("corpus differs from the baseline's; regenerate one of them",
+              file=sys.stderr)
+        return 2
+
+    regressions = []
+    print(f"{'metric':<14} {'baseline':>14} {'current':>14} {'change':>8}")
+    for path, label, higher_is_better in METRICS:
+        old = lookup(baseline, path)
+        new = lookup(current, path)
+        change = (new - old) / old if old else 0.0
+        worse = -change if higher_is_better else change
+        noisy = path[0] == "phases" and max(old, new) < MIN_SECONDS
+        flag = ""
+        if worse > tolerance and not noisy:
+            flag = "  REGRESSION"
+            regressions.append(label)
+        print(f"{label:<14} {old:>14.3f} {new:>14.3f} {change:>+7.1%}{flag}")
+
+    # The same corpus should get the same rewrites; a difference is a
+    # behaviour change in the tool, not a performance one
+    if baseline["rewrites"] != current["rewrites"]:
+        print(f"note: rewrites changed from {baseline['rewrites']} to "
+              f"{current['rewrites']}")
+    if current["errors"] > baseline["errors"]:
+        print(f"note: errors rose from {baseline['errors']} to "
+              f"{current['errors']}")
+
+    if regressions:
+        print(f"{len(regressions)} regression(s) beyond {tolerance:.0%}: "
+              + ", ".join(regressions))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,273 @@
+// optiweave_bench_corpus: synthetic translation units for measuring the
+// throughput of the optiweave tool itself.
+//
+// Every knob maps to work the tool does per TU: subscripts and arithmetic
+// chains are rewrite sites, nesting depth stresses the post-order
+// traversal and getOperandText on nested rewrites, template-dependent
+// kernels exercise the dependency checks, and header fan-out adds parse
+// time and rewrites outside the main file. The same options and seed
+// always produce the same corpus, so results stay comparable.
+//
+// Writes <out>/tu_<n>.cpp, <out>/header_<n>.hpp and <out>/corpus.json,
+// which records the options for optiweave_bench_driver.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+struct Options {
+  std::string out = "corpus";
+  unsigned tus = 50;
+  unsigned functions = 8;   // kernels per TU
+  unsigned subscripts = 16; // a[i] sites per kernel
+  unsigned chain = 6;       // binary operators per arithmetic chain
+  unsigned depth = 3;       // loop nesting per kernel
+  unsigned templates = 2;   // of the kernels, how many are templates
+  unsigned headers = 4;     // headers each TU includes
+  unsigned header_pool = 16;
+  unsigned seed = 1;
+};
+
+void printHelp() {
+  std::printf(R"(Usage: optiweave_bench_corpus [options]
+
+Options:
+  --out=DIR          Output directory (default: corpus)
+  --tus=N            Translation units (default: 50)
+  --functions=N      Kernels per translation unit (default: 8)
+  --subscripts=N     Subscripts per kernel (default: 16)
+  --chain=N          Binary operators per arithmetic chain (default: 6)
+  --depth=N          Loop nesting depth of each kernel (default: 3)
+  --templates=N      Kernels per TU that are function templates (default: 2)
+  --headers=N        Headers included by each TU (default: 4)
+  --header-pool=N    Distinct headers to include from (default: 16)
+  --seed=N           Seed for expression shapes (default: 1)
+  -h, --help         Show this help
+)");
+}
+
+bool parseUnsigned(const std::string &arg, const char *prefix,
+                   unsigned &value) {
+  std::size_t length = std::strlen(prefix);
+  if (arg.compare(0, length, prefix) != 0) {
+    return false;
+  }
+  value = static_cast<unsigned>(std::strtoul(arg.c_str() + length, nullptr, 10));
+  return true;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      printHelp();
+      std::exit(0);
+    } else if (arg.rfind("--out=", 0) == 0) {
+      options.out = arg.substr(6);
+    } else if (!parseUnsigned(arg, "--tus=", options.tus) &&
+               !parseUnsigned(arg, "--functions=", options.functions) &&
+               !parseUnsigned(arg, "--subscripts=", options.subscripts) &&
+               !parseUnsigned(arg, "--chain=", options.chain) &&
+               !parseUnsigned(arg, "--depth=", options.depth) &&
+               !parseUnsigned(arg, "--templates=", options.templates) &&
+               !parseUnsigned(arg, "--headers=", options.headers) &&
+               !parseUnsigned(arg, "--header-pool=", options.header_pool) &&
+               !parseUnsigned(arg, "--seed=", options.seed)) {
+      std::fprintf(stderr, "optiweave_bench_corpus: unknown argument '%s'\n",
+                   arg.c_str());
+      return false;
+    }
+  }
+  if (options.depth == 0 || options.tus == 0 || options.header_pool == 0) {
+    std::fprintf(stderr,
+                 "optiweave_bench_corpus: --tus, --depth and --header-pool "
+                 "must be positive\n");
+    return false;
+  }
+  if (options.headers > options.header_pool) {
+    options.headers = options.header_pool;
+  }
+  return true;
+}
+
+/// Emits kernels whose expression shapes come from one seeded generator
+class KernelWriter {
+public:
+  KernelWriter(const Options &options, unsigned seed)
+      : options_(options), random_(seed) {}
+
+  /**
+   * @brief One kernel over arrays a (written) and b (read)
+   * @param scalar "double", or "T" inside a template
+   */
+  std::string kernel(const std::string &name, const std::string &scalar) {
+    std::ostringstream out;
+    out << scalar << " " << name << "(" << scalar << " *a, const " << scalar
+        << " *b, int n) {\n";
+    out << "  " << scalar << " acc = 0;\n";
+
+    std::string indent = "  ";
+    for (unsigned level = 0; level < options_.depth; ++level) {
+      out << indent << "for (int i" << level << " = 1; i" << level
+          << " < n - 1; ++i" << level << ") {\n";
+      indent += "  ";
+    }
+
+    // Spread the subscripts over statements of up to four each; every
+    // statement also carries one arithmetic chain
+    std::string index = "i" + std::to_string(options_.depth - 1);
+    unsigned remaining = options_.subscripts;
+    do {
+      unsigned here = remaining < 4 ? remaining : 4;
+      remaining -= here;
+      out << indent << "a[" << index << "] = " << chain(scalar, here, index)
+          << ";\n";
+      out << indent << "acc += a[" << index << "];\n";
+    } while (remaining > 0);
+
+    for (unsigned level = options_.depth; level-- > 0;) {
+      indent.resize(indent.size() - 2);
+      out << indent << "}\n";
+    }
+    out << "  return acc;\n}\n";
+    return out.str();
+  }
+
+private:
+  /// Operands are b[...] subscripts while they last, then constants
+  std::string chain(const std::string &scalar, unsigned subscripts,
+                    const std::string &index) {
+    static const char *const kOperators[] = {" + ", " - ", " * "};
+    std::string text = operand(scalar, subscripts, index);
+    for (unsigned i = 0; i < options_.chain; ++i) {
+      text += kOperators[random_() % 3];
+      text += operand(scalar, subscripts, index);
+    }
+    while (subscripts > 0) {
+      text += " + " + operand(scalar, subscripts, index);
+    }
+    return text;
+  }
+
+  std::string operand(const std::string &scalar, unsigned &subscripts,
+                      const std::string &index) {
+    if (subscripts == 0) {
+      return scalar + "(" + std::to_string(random_() % 7 + 1) + ")";
+    }
+    --subscripts;
+    static const char *const kOffsets[] = {"", " - 1", " + 1"};
+    return "b[" + index + kOffsets[random_() % 3] + "]";
+  }
+
+  const Options &options_;
+  std::mt19937 random_;
+};
+
+bool writeFile(const std::filesystem::path &path, const std::string &text) {
+  std::ofstream out(path);
+  out << text;
+  if (!out) {
+    std::fprintf(stderr, "optiweave_bench_corpus: cannot write %s\n",
+                 path.c_str());
+    return false;
+  }
+  return true;
+}
+
+std::string header(const Options &options, unsigned id) {
+  KernelWriter writer(options, options.seed * 7919u + id);
+  std::ostringstream out;
+  out << "// Generated by optiweave_bench_corpus; do not edit\n";
+  out << "#pragma once\n\n";
+  // Standard headers for realistic parse cost; the tool skips them
+  out << "#include <cmath>\n#include <vector>\n\n";
+  out << "namespace header_" << id << " {\n\n";
+  out << "inline " << writer.kernel("helper", "double") << "\n";
+  out << "} // namespace header_" << id << "\n";
+  return out.str();
+}
+
+std::string translationUnit(const Options &options, unsigned id) {
+  KernelWriter writer(options, options.seed * 104729u + id);
+  std::ostringstream out;
+  out << "// Generated by optiweave_bench_corpus; do not edit\n";
+  for (unsigned i = 0; i < options.headers; ++i) {
+    out << "#include \"header_" << (id + i) % options.header_pool
+        << ".hpp\"\n";
+  }
+  out << "\nnamespace tu_" << id << " {\n\n";
+  for (unsigned f = 0; f < options.functions; ++f) {
+    std::string name = "kernel_" + std::to_string(f);
+    if (f < options.templates) {
+      out << "template <typename T>\n" << writer.kernel(name, "T");
+      out << "template double " << name
+          << "<double>(double *, const double *, int);\n\n";
+    } else {
+      out << writer.kernel(name, "double") << "\n";
+    }
+  }
+  out << "} // namespace tu_" << id << "\n";
+  return out.str();
+}
+
+std::string manifest(const Options &options) {
+  std::ostringstream out;
+  out << "{\n"
+      << "  \"tus\": " << options.tus << ",\n"
+      << "  \"functions\": " << options.functions << ",\n"
+      << "  \"subscripts\": " << options.subscripts << ",\n"
+      << "  \"chain\": " << options.chain << ",\n"
+      << "  \"depth\": " << options.depth << ",\n"
+      << "  \"templates\": " << options.templates << ",\n"
+      << "  \"headers\": " << options.headers << ",\n"
+      << "  \"header_pool\": " << options.header_pool << ",\n"
+      << "  \"seed\": " << options.seed << "\n"
+      << "}\n";
+  return out.str();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printHelp();
+    return 1;
+  }
+
+  std::filesystem::path out(options.out);
+  std::error_code error;
+  std::filesystem::create_directories(out, error);
+  if (error) {
+    std::fprintf(stderr, "optiweave_bench_corpus: cannot create %s: %s\n",
+                 out.c_str(), error.message().c_str());
+    return 1;
+  }
+
+  for (unsigned id = 0; id < options.header_pool; ++id) {
+    if (!writeFile(out / ("header_" + std::to_string(id) + ".hpp"),
+                   header(options, id))) {
+      return 1;
+    }
+  }
+  for (unsigned id = 0; id < options.tus; ++id) {
+    if (!writeFile(out / ("tu_" + std::to_string(id) + ".cpp"),
+                   translationUnit(options, id))) {
+      return 1;
+    }
+  }
+  if (!writeFile(out / "corpus.json", manifest(options))) {
+    return 1;
+  }
+
+  std::printf("%u translation units, %u headers in %s\n", options.tus,
+              options.header_pool, out.c_str());
+  return 0;
+}
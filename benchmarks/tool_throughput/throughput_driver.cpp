@@ -0,0 +1,310 @@
+// optiweave_bench_driver: runs the optiweave tool over a corpus from
+// optiweave_bench_corpus and records its throughput as JSON.
+//
+// Each run transforms every TU of the corpus in one tool invocation, the
+// way a project build does, writing into a scratch directory so the corpus
+// stays pristine. Reported per run are wall time, the rewrite counts from
+// the tool's statistics, parse/transform/write time from --time-phases and
+// the tool's peak RSS. The median run by wall time is kept.
+//
+// Usage: optiweave_bench_driver --tool=PATH --corpus=DIR [--runs=N]
+//            [--output=FILE] [-- extra tool arguments]
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+  std::string tool;
+  std::string corpus;
+  std::string output = "tool_throughput.json";
+  unsigned runs = 3;
+  std::vector<std::string> tool_args;
+};
+
+/// What one invocation of the tool did and cost
+struct RunResult {
+  double wall_seconds = 0;
+  double parse_seconds = 0;
+  double transform_seconds = 0;
+  double write_seconds = 0;
+  unsigned long long rewrites = 0;
+  unsigned long long errors = 0;
+  unsigned translation_units = 0; ///< Statistics blocks seen
+  long peak_rss_kb = 0;
+};
+
+void printHelp() {
+  std::printf(R"(Usage: optiweave_bench_driver [options] [-- tool arguments]
+
+Options:
+  --tool=PATH     The optiweave executable
+  --corpus=DIR    Corpus written by optiweave_bench_corpus
+  --runs=N        Runs; the median by wall time is reported (default: 3)
+  --output=FILE   JSON results (default: tool_throughput.json)
+  -h, --help      Show this help
+
+Arguments after -- go to optiweave before the file list.
+)");
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      printHelp();
+      std::exit(0);
+    } else if (arg == "--") {
+      options.tool_args.assign(argv + i + 1, argv + argc);
+      break;
+    } else if (arg.rfind("--tool=", 0) == 0) {
+      options.tool = arg.substr(7);
+    } else if (arg.rfind("--corpus=", 0) == 0) {
+      options.corpus = arg.substr(9);
+    } else if (arg.rfind("--output=", 0) == 0) {
+      options.output = arg.substr(9);
+    } else if (arg.rfind("--runs=", 0) == 0) {
+      options.runs =
+          static_cast<unsigned>(std::strtoul(arg.c_str() + 7, nullptr, 10));
+    } else {
+      std::fprintf(stderr, "optiweave_bench_driver: unknown argument '%s'\n",
+                   arg.c_str());
+      return false;
+    }
+  }
+  if (options.runs == 0) {
+    options.runs = 1;
+  }
+  return !options.tool.empty() && !options.corpus.empty();
+}
+
+std::string readFile(const std::filesystem::path &path) {
+  std::ifstream in(path);
+  std::stringstream text;
+  text << in.rdbuf();
+  return text.str();
+}
+
+/**
+ * @brief Fold the tool's stderr into a run: statistics blocks from
+ * TransformationStats::print and blocks from --time-phases
+ */
+void parseToolOutput(const std::string &output, RunResult &run) {
+  std::istringstream lines(output);
+  std::string line;
+  enum class Block { None, Stats, Phases } block = Block::None;
+  while (std::getline(lines, line)) {
+    if (line.rfind("Transformation Statistics:", 0) == 0) {
+      block = Block::Stats;
+      ++run.translation_units;
+      continue;
+    }
+    if (line.rfind("=== Phase Times", 0) == 0) {
+      block = Block::Phases;
+      continue;
+    }
+    std::size_t colon = line.find(": ");
+    if (line.rfind("  ", 0) != 0 || colon == std::string::npos) {
+      block = Block::None;
+      continue;
+    }
+    std::string label = line.substr(2, colon - 2);
+    const char *value = line.c_str() + colon + 2;
+    if (block == Block::Stats) {
+      // Skipped instantiations are not rewrites
+      if (label == "Errors encountered") {
+        run.errors += std::strtoull(value, nullptr, 10);
+      } else if (label != "Template instantiations skipped") {
+        run.rewrites += std::strtoull(value, nullptr, 10);
+      }
+    } else if (block == Block::Phases) {
+      double seconds = std::strtod(value, nullptr);
+      if (label == "Parse") {
+        run.parse_seconds += seconds;
+      } else if (label == "Transform") {
+        run.transform_seconds += seconds;
+      } else if (label == "Write") {
+        run.write_seconds += seconds;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Run the tool once, capturing stderr and its resource usage
+ * @return false if it could not be started or did not exit with 0
+ */
+bool runTool(const std::vector<std::string> &command, RunResult &run) {
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) {
+    std::perror("optiweave_bench_driver: pipe");
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  pid_t child = fork();
+  if (child < 0) {
+    std::perror("optiweave_bench_driver: fork");
+    return false;
+  }
+  if (child == 0) {
+    dup2(pipe_fds[1], STDERR_FILENO);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    std::vector<char *> argv;
+    for (const std::string &arg : command) {
+      argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    std::perror("optiweave_bench_driver: exec");
+    _exit(127);
+  }
+
+  close(pipe_fds[1]);
+  std::string output;
+  char buffer[4096];
+  ssize_t count;
+  while ((count = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) {
+    output.append(buffer, static_cast<std::size_t>(count));
+  }
+  close(pipe_fds[0]);
+
+  int status = 0;
+  struct rusage usage {};
+  if (wait4(child, &status, 0, &usage) < 0) {
+    std::perror("optiweave_bench_driver: wait4");
+    return false;
+  }
+  run.wall_seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  run.peak_rss_kb = usage.ru_maxrss; // kilobytes on Linux
+  parseToolOutput(output, run);
+
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    std::fprintf(stderr, "optiweave_bench_driver: tool failed:\n%s",
+                 output.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printHelp();
+    return 1;
+  }
+
+  std::filesystem::path corpus(options.corpus);
+  std::string manifest = readFile(corpus / "corpus.json");
+  if (manifest.empty()) {
+    std::fprintf(stderr,
+                 "optiweave_bench_driver: %s has no corpus.json; generate it "
+                 "with optiweave_bench_corpus\n",
+                 corpus.c_str());
+    return 1;
+  }
+  std::vector<std::string> sources;
+  for (const auto &entry : std::filesystem::directory_iterator(corpus)) {
+    if (entry.path().extension() == ".cpp") {
+      sources.push_back(entry.path().string());
+    }
+  }
+  std::sort(sources.begin(), sources.end());
+
+  std::filesystem::path scratch = corpus / "transformed";
+  std::filesystem::create_directories(scratch);
+
+  std::vector<std::string> command = {options.tool, "--time-phases",
+                                      "--output-dir=" + scratch.string()};
+  command.insert(command.end(), options.tool_args.begin(),
+                 options.tool_args.end());
+  command.insert(command.end(), sources.begin(), sources.end());
+  command.push_back("--");
+  command.push_back("-I" + corpus.string());
+
+  std::vector<RunResult> runs;
+  for (unsigned i = 0; i < options.runs; ++i) {
+    RunResult run;
+    if (!runTool(command, run)) {
+      return 1;
+    }
+    std::fprintf(stderr, "run %u: %.3f s, %llu rewrites, %ld KiB peak RSS\n",
+                 i + 1, run.wall_seconds, run.rewrites, run.peak_rss_kb);
+    if (run.translation_units != sources.size()) {
+      std::fprintf(stderr,
+                   "optiweave_bench_driver: statistics for %u of %zu TUs; "
+                   "rewrite counts are incomplete\n",
+                   run.translation_units, sources.size());
+    }
+    runs.push_back(run);
+  }
+  std::sort(runs.begin(), runs.end(), [](const auto &a, const auto &b) {
+    return a.wall_seconds < b.wall_seconds;
+  });
+  const RunResult &median = runs[runs.size() / 2];
+  long peak_rss_kb = 0;
+  for (const RunResult &run : runs) {
+    peak_rss_kb = std::max(peak_rss_kb, run.peak_rss_kb);
+  }
+
+  std::FILE *out = std::fopen(options.output.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "optiweave_bench_driver: cannot write %s\n",
+                 options.output.c_str());
+    return 1;
+  }
+  // Nested one level deeper than in corpus.json
+  while (!manifest.empty() && manifest.back() == '\n') {
+    manifest.pop_back();
+  }
+  for (std::size_t at = manifest.find('\n'); at != std::string::npos;
+       at = manifest.find('\n', at + 3)) {
+    manifest.insert(at + 1, "  ");
+  }
+  std::fprintf(out,
+               "{\n"
+               "  \"corpus\": %s,\n"
+               "  \"runs\": %u,\n"
+               "  \"translation_units\": %zu,\n"
+               "  \"wall_seconds\": %.6f,\n"
+               "  \"tus_per_second\": %.3f,\n"
+               "  \"rewrites\": %llu,\n"
+               "  \"rewrites_per_second\": %.1f,\n"
+               "  \"errors\": %llu,\n"
+               "  \"phases\": {\"parse\": %.6f, \"transform\": %.6f, "
+               "\"write\": %.6f},\n"
+               "  \"peak_rss_kb\": %ld\n"
+               "}\n",
+               manifest.c_str(), options.runs, sources.size(),
+               median.wall_seconds, sources.size() / median.wall_seconds,
+               median.rewrites, median.rewrites / median.wall_seconds,
+               median.errors, median.parse_seconds, median.transform_seconds,
+               median.write_seconds, peak_rss_kb);
+  std::fclose(out);
+
+  std::printf("%zu TUs in %.3f s: %.2f TUs/s, %.0f rewrites/s, peak RSS "
+              "%ld KiB; results in %s\n",
+              sources.size(), median.wall_seconds,
+              sources.size() / median.wall_seconds,
+              median.rewrites / median.wall_seconds, peak_rss_kb,
+              options.output.c_str());
+  return 0;
+}
@@ -1,5 +1,11 @@
 #pragma once
 
+#include "optiweave/core/branch_profile.hpp"
+#include "optiweave/core/memory_accounting.hpp"
+#include "optiweave/core/prefetch_advice.hpp"
+#include "optiweave/core/receiver_profile.hpp"
+#include "optiweave/core/reserve_advice.hpp"
+
 #include <clang/AST/AST.h>
 #include <clang/AST/ASTConsumer.h>
 #include <clang/AST/ASTContext.h>
@@ -7,9 +13,11 @@
 #include <clang/Rewrite/Core/Rewriter.h>
 #include <cmath>
 #include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Regex.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include <functional>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -24,11 +32,29 @@ struct TransformationConfig {
   bool transform_array_subscripts = true;
   bool transform_arithmetic_operators = false;
   bool transform_assignment_operators = false;
-  bool transform_comparisons_operators = false; // Fixed typo
+  bool transform_comparison_operators = false;
+  bool profile_loop_trips = false; // count iterations of for loops
+  bool probe_functions = false;    // entry/exit probe in function bodies
+  std::string probe_filter;        // regex on qualified names, empty = all
+  bool track_allocations = false;  // new/delete, malloc/free, containers
+  bool profile_container_growth = false; // vector/string reallocations
+  bool track_copies = false;       // copies of large or heap-owning types
+  size_t copy_threshold = 64;      // bytes that make a copy expensive
+  bool profile_virtual_calls = false; // receiver types of virtual calls
+  bool profile_hash_lookups = false; // unordered_map/set chains and rehashes
+  bool fuse_subscripts = true;      // a[i][j] on arrays as one event
+  bool fuse_pointer_chains = false; // ...and on pointer-to-pointer chains
   bool preserve_templates = true;
   bool skip_system_headers = true;
+  bool account_memory = false; // measure the parent map for --memory-stats
   std::string prelude_path;
   std::vector<std::string> include_paths;
+  std::shared_ptr<const PrefetchAdviceTable> prefetch_advice; // --insert-prefetch
+  std::shared_ptr<const BranchProfileTable> branch_profile; // --annotate-branches
+  double branch_threshold = 0.9; // share of outcomes that makes a branch likely
+  std::shared_ptr<const ReserveAdviceTable> reserve_advice; // --insert-reserve
+  std::shared_ptr<const ReceiverProfileTable> receiver_profile; // --devirtualize
+  double guard_threshold = 0.9; // share of calls on the type a guard tests
 };
 
 /**
@@ -36,8 +62,21 @@ struct TransformationConfig {
 */
 struct TransformationStats {
   size_t array_subscripts_transformed = 0;
+  size_t subscript_chains_fused = 0;
+  size_t container_subscripts_transformed = 0;
   size_t arithmetic_ops_transformed = 0;
   size_t template_instantiations_skipped = 0;
+  size_t prefetches_inserted = 0;
+  size_t branches_annotated = 0;
+  size_t loops_instrumented = 0;
+  size_t functions_probed = 0;
+  size_t allocations_instrumented = 0;
+  size_t growth_calls_instrumented = 0;
+  size_t reserves_inserted = 0;
+  size_t copies_instrumented = 0;
+  size_t virtual_calls_instrumented = 0;
+  size_t virtual_calls_guarded = 0;
+  size_t hash_lookups_instrumented = 0;
   size_t errors_encountered = 0;
 
   void reset() { *this = TransformationStats{}; }
@@ -87,7 +126,8 @@ public:
   bool VisitBinaryOperator(clang::BinaryOperator *expr);
 
   /**
-      @brief Visit unary operators
+      @brief Visit unary operators; ++ and -- in the increment of a for
+      loop get the loop's trip counter
       @param expr The unary operator expression
       @return true to continue traversal
   */
@@ -101,6 +141,64 @@ public:
 
   bool VisitCXXOperatorCallExpr(clang::CXXOperatorCallExpr *expr);
 
+  /**
+      @brief Visit if statements to annotate profiled branches
+      @param stmt The if statement
+      @return true to continue traversal
+  */
+
+  bool VisitIfStmt(clang::IfStmt *stmt);
+
+  /**
+      @brief Visit function definitions to insert entry/exit probes
+      @param decl The function declaration
+      @return true to continue traversal
+  */
+
+  bool VisitFunctionDecl(clang::FunctionDecl *decl);
+
+  /**
+      @brief Visit new expressions to record allocations
+      @param expr The new expression
+      @return true to continue traversal
+  */
+
+  bool VisitCXXNewExpr(clang::CXXNewExpr *expr);
+
+  /**
+      @brief Visit delete expressions to record deallocations
+      @param expr The delete expression
+      @return true to continue traversal
+  */
+
+  bool VisitCXXDeleteExpr(clang::CXXDeleteExpr *expr);
+
+  /**
+      @brief Visit calls to redirect malloc, calloc, realloc, aligned_alloc
+      and free to the prelude's traced versions
+      @param expr The call expression
+      @return true to continue traversal
+  */
+
+  bool VisitCallExpr(clang::CallExpr *expr);
+
+  /**
+      @brief Visit constructions of standard containers
+      @param expr The construct expression
+      @return true to continue traversal
+  */
+
+  bool VisitCXXConstructExpr(clang::CXXConstructExpr *expr);
+
+  /**
+      @brief Visit push_back, emplace_back and append on local vectors and
+      strings to profile their growth or reserve their capacity
+      @param expr The member call expression
+      @return true to continue traversal
+  */
+
+  bool VisitCXXMemberCallExpr(clang::CXXMemberCallExpr *expr);
+
   /**
       @brief Get transformation Statistics
       @return const reference to stats
@@ -114,14 +212,44 @@ public:
 
   void resetStats() { stats_.reset(); }
 
+  /**
+      @brief Add the visitor's own containers to a memory report
+      @param report Report of the current translation unit
+  */
+
+  void reportMemory(MemoryReport &report) const;
+
 private:
+  template <typename T>
+  using AccountedSet = std::set<T, std::less<T>, AccountingAllocator<T>>;
+  using SourceRangeKey = std::pair<unsigned, unsigned>;
+  using ClassIndex =
+      std::map<std::string, const clang::CXXRecordDecl *,
+               std::less<std::string>,
+               AccountingAllocator<std::pair<const std::string,
+                                             const clang::CXXRecordDecl *>>>;
+
   clang::Rewriter &rewriter_;
   clang::ASTContext &context_;
   TransformationConfig config_;
   TransformationStats stats_;
+  std::unique_ptr<llvm::Regex> probe_filter_; // compiled config_.probe_filter
+
+  // Heap bytes of the containers below, for --memory-stats
+  MemoryAccount processed_ranges_memory_;
+  MemoryAccount class_index_memory_;
+  MemoryAccount tracked_containers_memory_;
 
   // Track processed source ranges to avoid double-processing
-  std::set<std::pair<unsigned, unsigned>> processed_ranges_;
+  AccountedSet<SourceRangeKey> processed_ranges_;
+
+  // Polymorphic classes by their printed name, for --devirtualize
+  ClassIndex polymorphic_classes_;
+  bool polymorphic_classes_indexed_ = false;
+
+  // Containers that already have a GrowthTracker or a reserve() call
+  AccountedSet<const clang::VarDecl *> growth_tracked_;
+  AccountedSet<const clang::VarDecl *> reserved_;
 
   /**
       @brief Check if we should skip this expression based on context
@@ -162,6 +290,359 @@ private:
 
   bool transformArraySubscript(clang::ArraySubscriptExpr *expr);
 
+  /**
+      @brief Check if a subscript can be an inner link of a fused chain
+      @param expr The array subscript expression
+      @return true if it yields a row of a constant-size array, or a row
+      pointer when pointer chains are fused
+  */
+
+  bool isFusableLink(const clang::ArraySubscriptExpr *expr) const;
+
+  /**
+      @brief Check if a subscript is instrumented as part of its parent
+      @param expr The array subscript expression
+      @return true if expr is a fusable link used as the base of another
+      subscript
+  */
+
+  bool isFusedIntoParent(const clang::ArraySubscriptExpr *expr) const;
+
+  /**
+      @brief Collect the fusable chain ending at a subscript
+      @param expr The outermost array subscript expression
+      @param indices Set to the index expressions, outermost dimension first
+      @return The root the chain subscripts, or nullptr if expr is not the
+      end of a chain of at least two subscripts
+  */
+
+  const clang::Expr *
+  collectSubscriptChain(const clang::ArraySubscriptExpr *expr,
+                        std::vector<const clang::Expr *> &indices) const;
+
+  /**
+      @brief Replace a chain of subscripts with one __primop_subscript_nd
+      call that records every index
+      @param expr The outermost array subscript expression
+      @param root The subscripted array or pointer
+      @param indices The index expressions, outermost dimension first
+      @return true on success
+  */
+
+  bool transformSubscriptChain(clang::ArraySubscriptExpr *expr,
+                               const clang::Expr *root,
+                               const std::vector<const clang::Expr *> &indices);
+
+  /**
+      @brief Transform operator[] of a std::vector, std::array or std::span
+      @param expr The operator call expression
+      @return true on success
+  */
+
+  bool transformContainerSubscript(clang::CXXOperatorCallExpr *expr);
+
+  /**
+      @brief Check if subscripts of a type go to a contiguous standard
+      container that the prelude records as data() + index
+      @param type The type of the subscripted object
+      @return true for std::vector (except vector<bool>), std::array and
+      std::span
+  */
+
+  bool isContiguousContainer(clang::QualType type) const;
+
+  /**
+      @brief Check if a type is one of the standard unordered containers
+      @param type The type of the object a lookup is made on
+      @return true for std::unordered_map and std::unordered_set; the multi
+      variants chain equal keys on purpose and are left alone
+  */
+
+  bool isHashContainer(clang::QualType type) const;
+
+  /**
+      @brief Source text of the key a hash container call looks up, for the
+      probe to sample its bucket
+      @param expr The member call expression
+      @return The key's original text, or empty if the call takes no key or
+      the key cannot be evaluated a second time
+  */
+
+  std::string hashKeyText(const clang::CXXMemberCallExpr *expr) const;
+
+  /**
+      @brief Find the prefetch advice for a subscript, if any
+      @param expr The array subscript expression
+      @return The advice, or nullptr if none applies
+  */
+
+  const PrefetchAdvice *
+  findPrefetchAdvice(const clang::ArraySubscriptExpr *expr) const;
+
+  /**
+      @brief Prepend a __builtin_prefetch of the element `advice` iterations
+      ahead to the replacement text of a subscript
+      @param expr The array subscript expression
+      @param advice Stride and distance for this site
+      @param lhs_text The text of the base
+      @param rhs_text The text of the index
+      @param access_text Replacement for the access itself
+      @return "(__builtin_prefetch(...), access_text)", or an empty string if
+      the operands cannot safely be evaluated twice
+  */
+
+  std::string generatePrefetch(const clang::ArraySubscriptExpr *expr,
+                               const PrefetchAdvice &advice,
+                               llvm::StringRef lhs_text,
+                               llvm::StringRef rhs_text,
+                               llvm::StringRef access_text) const;
+
+  /**
+      @brief Check if a function definition gets an entry/exit probe
+      @param decl The function declaration
+      @return true for selected non-constexpr definitions with a plain body
+  */
+
+  bool shouldProbeFunction(const clang::FunctionDecl *decl) const;
+
+  /**
+      @brief Record the construction of a local or temporary container
+      @param expr The construct expression
+      @return true if it was instrumented
+  */
+
+  bool transformContainerConstruction(const clang::CXXConstructExpr *expr);
+
+  /**
+      @brief Find the callee of a call that dispatches through the vtable
+      @param expr The member call expression
+      @return The member expression naming the method, or nullptr for
+      non-virtual, final and qualified calls
+  */
+
+  const clang::MemberExpr *
+  findVirtualCallee(const clang::CXXMemberCallExpr *expr) const;
+
+  /**
+      @brief Wrap the receiver of a virtual call so the runtime counts its
+      dynamic type
+      @param expr The member call expression
+      @param member Its callee
+      @return true if successful
+  */
+
+  bool transformVirtualCall(const clang::CXXMemberCallExpr *expr,
+                            const clang::MemberExpr *member);
+
+  /**
+      @brief Route find/insert and similar calls on an unordered container
+      through a probe that counts them and samples the key's bucket
+      @param expr The member call expression
+      @return true if successful
+  */
+
+  bool transformHashCall(const clang::CXXMemberCallExpr *expr);
+
+  /**
+      @brief Route operator[] on an unordered map through the same probe
+      @param expr The operator call expression
+      @return true if successful
+  */
+
+  bool transformHashSubscript(const clang::CXXOperatorCallExpr *expr);
+
+  /**
+      @brief Put a direct call to the overrider of the profile's dominant
+      receiver type behind a typeid guard
+      @param expr The member call expression
+      @param member Its callee
+      @return true if the call was guarded
+  */
+
+  bool guardVirtualCall(const clang::CXXMemberCallExpr *expr,
+                        const clang::MemberExpr *member);
+
+  /**
+      @brief Find a polymorphic class by the name the runtime reports
+      @param name Demangled name, e.g. "shapes::Circle"
+      @return The class definition, or nullptr
+  */
+
+  const clang::CXXRecordDecl *findPolymorphicClass(const std::string &name);
+
+  /**
+      @brief Record a copy construction of an expensive type
+      @param expr The construct expression
+  */
+
+  void instrumentCopyConstruction(const clang::CXXConstructExpr *expr);
+
+  /**
+      @brief Record a copy assignment of an expensive type
+      @param expr The operator= call
+  */
+
+  void instrumentCopyAssignment(const clang::CXXOperatorCallExpr *expr);
+
+  /**
+      @brief Wrap the source of a copy so the runtime counts it
+      @param source The copied expression
+      @param wrapper optiweave::track_copy or optiweave::track_copy_assignment
+  */
+
+  void instrumentCopySource(const clang::Expr *source, llvm::StringRef wrapper);
+
+  /**
+      @brief Check if copying a type is worth recording
+      @param type The copied type
+      @return true for classes of at least config_.copy_threshold bytes or
+      owning heap memory
+  */
+
+  bool isExpensiveCopy(clang::QualType type) const;
+
+  /**
+      @brief Check if a class holds a standard container, directly, in a
+      base or in a member
+      @param record The class
+      @param depth Nesting already searched
+      @return true if copying it copies heap memory
+  */
+
+  bool ownsHeapMemory(const clang::CXXRecordDecl *record,
+                      unsigned depth = 0) const;
+
+  /**
+      @brief Check if a copy reads a local variable for the last time
+      @param source The copied expression
+      @return true if source names a non-const local that is not referenced
+      after it and is not read again by a later iteration of a loop
+  */
+
+  bool isLastUse(const clang::Expr *source) const;
+
+  /**
+      @brief Find the local vector or string a growing call is made on
+      @param expr The member call expression
+      @return The container's declaration, or nullptr if the call is not
+      push_back/emplace_back (vector) or push_back/append (string) on a
+      local variable named directly
+  */
+
+  const clang::VarDecl *
+  findGrowingContainer(const clang::CXXMemberCallExpr *expr) const;
+
+  /**
+      @brief Find the declaration statement of a local variable
+      @param var The variable
+      @return The statement, or nullptr unless it sits directly in a block
+      where another statement can follow it
+  */
+
+  const clang::DeclStmt *findDeclaringStatement(const clang::VarDecl *var) const;
+
+  /**
+      @brief Route a growing call through the container's GrowthTracker,
+      declaring the tracker after the container on first use
+      @param expr The member call expression
+      @param var The container
+      @param decl_stmt The container's declaration statement
+      @return true if successful
+  */
+
+  bool transformGrowthCall(const clang::CXXMemberCallExpr *expr,
+                           const clang::VarDecl *var,
+                           const clang::DeclStmt *decl_stmt);
+
+  /**
+      @brief Reserve the profiled capacity right after a stable container's
+      declaration
+      @param var The container
+      @param decl_stmt The container's declaration statement
+      @return true if a reserve() call was inserted
+  */
+
+  bool insertReserve(const clang::VarDecl *var,
+                     const clang::DeclStmt *decl_stmt);
+
+  /**
+      @brief Check if a type is a standard container that allocates
+      @param type The constructed type
+      @return true for std::vector, std::basic_string, std::deque, lists,
+      and ordered and unordered maps and sets
+  */
+
+  bool isAllocatingContainer(clang::QualType type) const;
+
+  /**
+      @brief Count the loops a statement is repeated by within its function
+      @param stmt The statement
+      @return Number of enclosing loop bodies, conditions and increments;
+      init statements run once and do not count
+  */
+
+  unsigned loopDepth(const clang::Stmt *stmt) const;
+
+  /**
+      @brief Generate the site argument of an allocation wrapper
+      @param stmt The instrumented statement
+      @return "__optiweave_site_loop(column, depth)" inside loops, otherwise
+      "__optiweave_site(column)"
+  */
+
+  std::string generateAllocationSite(const clang::Stmt *stmt) const;
+
+  /**
+      @brief Count the iterations of the for loop whose increment is expr
+      @param expr A ++ or -- expression, built-in or overloaded
+  */
+
+  void instrumentLoopIncrement(const clang::Expr *expr);
+
+  /**
+      @brief Find the for loop whose increment an expression is
+      @param expr The expression to check
+      @return The loop, or nullptr if expr is not a whole increment
+  */
+
+  const clang::ForStmt *findIncrementedLoop(const clang::Expr *expr) const;
+
+  /**
+      @brief Wrap a for loop in a block declaring its trip counter and count
+      each entry into its body
+      @param loop The for loop, found through its increment
+      @return true on success
+  */
+
+  bool transformLoopIncrement(const clang::ForStmt *loop);
+
+  /**
+      @brief Check if a statement is in a constexpr or consteval function,
+      where the non-literal trip counter cannot be declared
+      @param stmt The statement to check
+      @return true if the enclosing function is explicitly constexpr
+  */
+
+  bool isInConstexprFunction(const clang::Stmt *stmt) const;
+
+  /**
+      @brief Check if an expression must be constant-evaluated: a
+      static_assert, template argument, array bound, if constexpr
+      condition, case label, enumerator or constexpr variable initializer
+      @param expr The expression to check
+      @return true if the expression is never evaluated at run time
+  */
+
+  bool isInConstantContext(const clang::Expr *expr) const;
+
+  /**
+      @brief Find the branch profile of a comparison, if any
+      @param expr The comparison
+      @return The profile, or nullptr if none was recorded
+  */
+
+  const BranchProfile *findBranchProfile(const clang::BinaryOperator *expr) const;
+
   /**
       @brief Transform binary operator expression
       @param expr The binary operator expression
@@ -175,12 +656,14 @@ private:
       @param lhs_type The type of the left-hand side
       @param lhs_text The text of the left-hand side
       @param rhs_text The text of the right-hand side
+      @param site_text The site argument for the wrapper call
       @return Generated instrumentation code
   */
   std::string
   generateArraySubscriptInstrumentation(clang::QualType lhs_type,
                                         llvm::StringRef lhs_text,
-                                        llvm::StringRef rhs_text) const;
+                                        llvm::StringRef rhs_text,
+                                        llvm::StringRef site_text) const;
 
   /**
       @brief Generate instrumentation code for binary operator
@@ -189,13 +672,30 @@ private:
       @param rhs_type The type of the right-hand side
       @param lhs_text The text of the left-hand side
       @param rhs_text The text of the right-hand side
+      @param site_text The site argument for the wrapper call
       @return Generated instrumentation code
    */
 
   std::string generateBinaryOperatorInstrumentation(
       clang::BinaryOperatorKind op, clang::QualType lhs_type,
       clang::QualType rhs_type, llvm::StringRef lhs_text,
-      llvm::StringRef rhs_text) const;
+      llvm::StringRef rhs_text, llvm::StringRef site_text) const;
+
+  /**
+    @brief Generate the site argument passed to every wrapper call
+    @param expr The expression being instrumented
+    @return Text such as "__optiweave_site(12)" carrying the original column,
+    or "__optiweave_site_write(12)" for stores
+   */
+  std::string generateSiteArgument(const clang::Expr *expr) const;
+
+  /**
+    @brief Check if the value of an expression is stored to
+    @param expr The expression to check
+    @return true if it is the target of an assignment or increment,
+    directly or through member access
+   */
+  bool isStoreTarget(const clang::Expr *expr) const;
 
   /**
     @brief Check if type is template-dependent
@@ -211,6 +711,14 @@ private:
     @return Text content
    */
   std::string getSourceText(clang::SourceRange range) const;
+
+  /**
+    @brief Get the current text of an operand, including the rewrites
+    already applied inside it
+    @param expr The operand
+    @return Text content
+   */
+  std::string getOperandText(const clang::Expr *expr) const;
 };
 
 /**
@@ -226,9 +734,21 @@ public:
 
   const TransformationStats &getStats() const;
 
+  /**
+      @brief Memory of the translation unit by subsystem: Clang's AST and
+      source manager, the parent map, rewrite buffers and the visitor
+      @return The report; the parent map is included only with
+      config.account_memory set and a C library that reports heap use
+  */
+
+  MemoryReport getMemoryReport() const;
+
 private:
   std::unique_ptr<ModernASTVisitor> visitor_;
+  clang::Rewriter &rewriter_;
   clang::ASTContext &context_;
+  bool account_memory_;
+  std::size_t parent_map_bytes_ = 0;
 };
 
 } // namespace optiweave::core
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "optiweave/core/profile_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace optiweave::core {
+
+/**
+    @brief Outcomes of one instrumented comparison
+*/
+struct BranchProfile {
+  /// Fewer evaluations than this say nothing about the bias
+  static constexpr std::uint64_t kMinEvaluations = 100;
+
+  std::uint64_t true_count = 0;
+  std::uint64_t false_count = 0;
+
+  /**
+      @brief Decide how the comparison's branch should be annotated
+      @param threshold Share of the evaluations one outcome needs
+      @return 1 if mostly true, -1 if mostly false, 0 if unbiased or rarely
+      evaluated
+  */
+  int bias(double threshold) const;
+};
+
+/**
+    @brief Branch profile written by the runtime (OPTIWEAVE_BRANCHES=1)
+    Sites are keyed by ProfileSite: file name, line and original column of
+    the comparison.
+*/
+class BranchProfileTable {
+public:
+  /**
+      @brief Read a tab-separated profile with a header line
+      @param path File to read
+      @param error Set to a description of the problem on failure
+      @return true if the file was read; malformed rows are an error
+  */
+  bool load(const std::string &path, std::string &error);
+
+  /**
+      @brief Look up the profile of a comparison
+      @return The profile, or nullptr if the site was not profiled
+  */
+  const BranchProfile *find(std::string_view file, unsigned line,
+                            unsigned column) const;
+
+  std::size_t size() const { return entries_.size(); }
+
+private:
+  std::map<ProfileSite, BranchProfile> entries_;
+};
+
+} // namespace optiweave::core
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace optiweave::core {
+
+/**
+    @brief Live and peak heap bytes charged to one OptiWeave-owned structure
+*/
+struct MemoryAccount {
+  std::size_t bytes = 0;
+  std::size_t allocations = 0;
+  std::size_t peak_bytes = 0;
+
+  void charge(std::size_t size) {
+    bytes += size;
+    ++allocations;
+    if (bytes > peak_bytes) {
+      peak_bytes = bytes;
+    }
+  }
+
+  void release(std::size_t size) {
+    bytes -= size;
+    --allocations;
+  }
+};
+
+/**
+    @brief Standard allocator that charges every allocation to an account
+    Containers of the tool use it so --memory-stats can report them; the
+    account must outlive the container.
+*/
+template <typename T> class AccountingAllocator {
+public:
+  using value_type = T;
+
+  explicit AccountingAllocator(MemoryAccount &account) noexcept
+      : account_(&account) {}
+
+  template <typename U>
+  AccountingAllocator(const AccountingAllocator<U> &other) noexcept
+      : account_(other.account()) {}
+
+  T *allocate(std::size_t count) {
+    T *memory = std::allocator<T>().allocate(count);
+    account_->charge(count * sizeof(T));
+    return memory;
+  }
+
+  void deallocate(T *memory, std::size_t count) noexcept {
+    account_->release(count * sizeof(T));
+    std::allocator<T>().deallocate(memory, count);
+  }
+
+  MemoryAccount *account() const noexcept { return account_; }
+
+  template <typename U>
+  bool operator==(const AccountingAllocator<U> &other) const noexcept {
+    return account_ == other.account();
+  }
+
+  template <typename U>
+  bool operator!=(const AccountingAllocator<U> &other) const noexcept {
+    return account_ != other.account();
+  }
+
+private:
+  MemoryAccount *account_;
+};
+
+/**
+    @brief Bytes used by one subsystem of the tool
+*/
+struct MemoryEntry {
+  std::string subsystem;
+  std::size_t bytes = 0;
+  std::size_t count = 0; ///< Objects of `unit`, when meaningful
+  std::string unit;      ///< Empty when the count is not reported
+};
+
+/**
+    @brief Memory of one translation unit, by subsystem
+*/
+class MemoryReport {
+public:
+  void add(std::string subsystem, std::size_t bytes, std::size_t count = 0,
+           std::string unit = "");
+
+  /**
+      @brief Add a subsystem whose bytes come from an account
+  */
+  void add(std::string subsystem, const MemoryAccount &account,
+           std::size_t count, std::string unit);
+
+  std::size_t totalBytes() const;
+
+  const std::vector<MemoryEntry> &entries() const { return entries_; }
+
+  /**
+      @brief One indented "  Subsystem: bytes (count unit)" line per entry,
+      then the total
+  */
+  std::string format() const;
+
+private:
+  std::vector<MemoryEntry> entries_;
+};
+
+/**
+    @brief Largest use of each subsystem over the translation units of a run
+*/
+class MemoryPeak {
+public:
+  void record(const std::string &file, const MemoryReport &report);
+
+  /**
+      @brief Per subsystem the peak and the file it was reached in, then
+      the largest translation unit
+  */
+  std::string format() const;
+
+private:
+  struct Peak {
+    std::string subsystem;
+    std::size_t bytes = 0;
+    std::string file;
+  };
+
+  std::vector<Peak> peaks_; // in order of first appearance
+  std::size_t largest_bytes_ = 0;
+  std::string largest_file_;
+};
+
+/**
+    @brief Format a byte count as B, KiB, MiB or GiB
+*/
+std::string formatBytes(std::size_t bytes);
+
+/**
+    @brief Heap bytes in use according to the C library
+    @return 0 where the C library cannot tell (not glibc 2.33 or later)
+*/
+std::size_t heapBytesInUse();
+
+} // namespace optiweave::core
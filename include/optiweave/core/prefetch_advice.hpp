@@ -0,0 +1,49 @@
+#pragma once
+
+#include "optiweave/core/profile_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace optiweave::core {
+
+/**
+    @brief Prefetch recommendation for one subscript site
+*/
+struct PrefetchAdvice {
+  std::int64_t stride_bytes = 0; ///< Address step between iterations
+  std::uint32_t distance = 0;    ///< Iterations to prefetch ahead
+};
+
+/**
+    @brief Advice file written by the runtime (OPTIWEAVE_PREFETCH=1)
+    Sites are keyed by ProfileSite: file name, line and original column of
+    the subscript.
+*/
+class PrefetchAdviceTable {
+public:
+  /**
+      @brief Read a tab-separated advice file with a header line
+      @param path File to read
+      @param error Set to a description of the problem on failure
+      @return true if the file was read; malformed rows are an error
+  */
+  bool load(const std::string &path, std::string &error);
+
+  /**
+      @brief Look up the advice for a site
+      @return The advice, or nullptr if the site has none
+  */
+  const PrefetchAdvice *find(std::string_view file, unsigned line,
+                             unsigned column) const;
+
+  std::size_t size() const { return entries_.size(); }
+
+private:
+  std::map<ProfileSite, PrefetchAdvice> entries_;
+};
+
+} // namespace optiweave::core
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace optiweave::core {
+
+/**
+    @brief Site of a profile row: file name, line and original column
+    Only the last path component of the file is kept, because the runtime
+    sees the path of the transformed copy rather than the original source.
+*/
+using ProfileSite = std::tuple<std::string, unsigned, unsigned>;
+
+ProfileSite makeProfileSite(std::string_view file, unsigned line,
+                            unsigned column);
+
+/**
+    @brief One data row of a profile
+*/
+struct ProfileRow {
+  ProfileSite site;
+  std::vector<std::string> fields; ///< All fields, file/line/column included
+};
+
+/**
+    @brief Read a tab-separated profile written by the runtime
+    The first line is a header and empty lines are skipped. Every row
+    starts with file, line and column.
+    @param path File to read
+    @param min_fields Fields a row needs; fewer is an error
+    @param handle_row Maps a row into the caller's table; throws
+    std::exception (std::stoul and friends included) to reject it
+    @param error Set to "cannot open <path>" or "<path>:<line>: <reason>"
+    @return true if the file was read; malformed rows are an error
+*/
+bool readProfile(const std::string &path, std::size_t min_fields,
+                 const std::function<void(const ProfileRow &)> &handle_row,
+                 std::string &error);
+
+} // namespace optiweave::core
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "optiweave/core/profile_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace optiweave::core {
+
+/**
+    @brief Receiver types seen at one virtual call site
+*/
+struct ReceiverProfile {
+  /// Fewer calls than this are not worth a guard
+  static constexpr std::uint64_t kMinCalls = 100;
+
+  std::string dominant; ///< Demangled type; empty if instantiations disagree
+  std::uint64_t calls = 0;
+  std::uint64_t dominant_calls = 0;
+
+  /**
+      @brief Decide whether a guarded direct call pays off
+      @param threshold Share of the calls the dominant type needs
+  */
+  bool guardable(double threshold) const;
+};
+
+/**
+    @brief Dispatch report written by the runtime (OPTIWEAVE_DISPATCH=1)
+    Sites are keyed by ProfileSite: file name, line and original column of
+    the call.
+*/
+class ReceiverProfileTable {
+public:
+  /**
+      @brief Read a tab-separated report with a header line
+      @param path File to read
+      @param error Set to a description of the problem on failure
+      @return true if the file was read; malformed rows are an error
+  */
+  bool load(const std::string &path, std::string &error);
+
+  /**
+      @brief Look up the profile of a virtual call
+      @return The profile, or nullptr if the site was not profiled
+  */
+  const ReceiverProfile *find(std::string_view file, unsigned line,
+                              unsigned column) const;
+
+  std::size_t size() const { return entries_.size(); }
+
+private:
+  std::map<ProfileSite, ReceiverProfile> entries_;
+};
+
+} // namespace optiweave::core
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "optiweave/core/profile_reader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace optiweave::core {
+
+/**
+    @brief Capacity to reserve for the containers of one declaration
+*/
+struct ReserveAdvice {
+  std::uint64_t reserve = 0; ///< 0 when the instances never reallocated
+  bool stable = false;       ///< every instance peaked at the same size
+};
+
+/**
+    @brief Growth report written by the runtime (OPTIWEAVE_GROWTH=1)
+    Sites are keyed by ProfileSite: file name, line and original column of
+    the declared variable.
+*/
+class ReserveAdviceTable {
+public:
+  /**
+      @brief Read a tab-separated report with a header line
+      @param path File to read
+      @param error Set to a description of the problem on failure
+      @return true if the file was read; malformed rows are an error
+  */
+  bool load(const std::string &path, std::string &error);
+
+  /**
+      @brief Look up the advice for a container declaration
+      @return The advice, or nullptr if the declaration was not tracked
+  */
+  const ReserveAdvice *find(std::string_view file, unsigned line,
+                            unsigned column) const;
+
+  std::size_t size() const { return entries_.size(); }
+
+private:
+  std::map<ProfileSite, ReserveAdvice> entries_;
+};
+
+} // namespace optiweave::core
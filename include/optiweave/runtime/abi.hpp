@@ -0,0 +1,124 @@
+#pragma once
+
+// C ABI between code generated by the OptiWeave tool and the runtime
+// library. The declarations here must stay in sync with the copies in
+// templates/prelude.hpp, which is the only header transformed code sees.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Site flag: the instrumented access stores to memory
+#define __OPTIWEAVE_SITE_WRITE 0x1u
+/// Site flag: a copied local is not used after the copy (std::move candidate)
+#define __OPTIWEAVE_SITE_LAST_USE 0x2u
+/// Site flags: loop nesting depth of the expression, from the tool
+#define __OPTIWEAVE_SITE_LOOP_SHIFT 8u
+#define __OPTIWEAVE_SITE_LOOP_MASK 0xff00u
+
+/// Denormal report bits: which of the operands and result were subnormal
+#define __OPTIWEAVE_DENORMAL_LHS 0x1u
+#define __OPTIWEAVE_DENORMAL_RHS 0x2u
+#define __OPTIWEAVE_DENORMAL_RESULT 0x4u
+
+/// Site id returned when a site is not profiled (profiling off, registry full)
+#define __OPTIWEAVE_NO_SITE 0xffffffffu
+
+/// Per-thread site state (branch, receiver and hash counters) comes in
+/// blocks of 1 << shift sites, allocated as the thread first reaches a
+/// block; the blocks cover every site id
+#define __OPTIWEAVE_SITE_BLOCK_SHIFT 8u
+#define __OPTIWEAVE_SITE_BLOCKS 64u
+
+/// Receiver types one thread's cache of a virtual call site holds
+#define __OPTIWEAVE_RECEIVER_ENTRIES 4u
+
+extern "C" {
+
+/**
+ * @brief Static description of an instrumented expression
+ *
+ * Built at the call site from std::source_location plus the original
+ * column and flags emitted by the transformation tool; the wrapper fills
+ * in the accessed type. The runtime never retains the pointer itself, only
+ * the (static storage) strings and numbers inside.
+ */
+struct __optiweave_site_info {
+  const char *file;
+  const char *function;
+  std::uint32_t line;
+  std::uint32_t column;
+  std::uint32_t flags; ///< __OPTIWEAVE_SITE_* bits
+  const char *type;    ///< Mangled name of the accessed type, or null
+};
+
+void __optiweave_log_access(const char *operation, const void *ptr,
+                            std::size_t index, std::size_t element_size,
+                            const __optiweave_site_info *site);
+void __optiweave_log_access_nd(const char *operation, const void *element,
+                               std::size_t element_size, std::uint32_t rank,
+                               const std::size_t *indices,
+                               const std::size_t *extents,
+                               const __optiweave_site_info *site);
+void __optiweave_log_operation(const char *operation,
+                               const __optiweave_site_info *site);
+void __optiweave_check_bounds(const void *ptr, std::size_t index,
+                              std::size_t element_size,
+                              const __optiweave_site_info *site);
+void __optiweave_profile_value(const char *operation, std::int64_t value,
+                              const __optiweave_site_info *site);
+void __optiweave_report_denormal(const char *operation, std::uint32_t operands,
+                                 const __optiweave_site_info *site);
+std::uint32_t __optiweave_branch_site(const char *operation,
+                                     const __optiweave_site_info *site);
+std::atomic<std::uint64_t> (*__optiweave_branch_counters(std::uint32_t id))[2];
+
+/**
+ * @brief One thread's receiver types of a virtual call site
+ *
+ * The prelude claims the type slots first come, first served, like a
+ * polymorphic inline cache, and counts calls on further types as overflow.
+ * Only the owning thread writes; the runtime merges the threads' caches at
+ * shutdown.
+ */
+struct __optiweave_receiver_cache {
+  std::atomic<const void *> types[__OPTIWEAVE_RECEIVER_ENTRIES];
+  std::atomic<std::uint64_t> counts[__OPTIWEAVE_RECEIVER_ENTRIES];
+  std::atomic<std::uint64_t> overflow;
+};
+
+void __optiweave_record_trips(std::uint64_t trips,
+                              const __optiweave_site_info *site);
+void __optiweave_enter_function(const __optiweave_site_info *function);
+void __optiweave_exit_function(void);
+void __optiweave_record_allocation(const char *operation, std::size_t bytes,
+                                   const __optiweave_site_info *site);
+void __optiweave_record_deallocation(const char *operation,
+                                     const __optiweave_site_info *site);
+void __optiweave_record_growth(std::uint64_t peak_size,
+                               std::uint64_t reallocations,
+                               const __optiweave_site_info *site);
+void __optiweave_record_copy(const char *operation, std::size_t bytes,
+                             const __optiweave_site_info *site);
+std::uint32_t __optiweave_dispatch_site(const __optiweave_site_info *site);
+__optiweave_receiver_cache *__optiweave_receiver_caches(std::uint32_t id);
+
+/**
+ * @brief One thread's calls on an unordered container at one site
+ *
+ * Fields mirror HashSiteProfile; only the owning thread writes, and the
+ * runtime merges the threads' counts at shutdown.
+ */
+struct __optiweave_hash_counts {
+  std::atomic<std::uint64_t> lookups;
+  std::atomic<std::uint64_t> rehashes;
+  std::atomic<std::uint64_t> size_sum;
+  std::atomic<std::uint64_t> max_size;
+  std::atomic<std::uint64_t> bucket_sum;
+  std::atomic<std::uint64_t> sampled_lookups;
+  std::atomic<std::uint64_t> sampled_chain;
+};
+
+std::uint32_t __optiweave_hash_site(const __optiweave_site_info *site);
+__optiweave_hash_counts *__optiweave_hash_counters(std::uint32_t id);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "optiweave/runtime/abi.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+class ThreadRegistry;
+
+/**
+ * @brief One call path in a thread's calling-context tree
+ */
+struct CallNode {
+  static constexpr std::uint32_t kNone = 0xffffffffu;
+
+  const __optiweave_site_info *function = nullptr; ///< Null for the root
+  std::uint32_t parent = kNone;
+  std::uint32_t first_child = kNone;
+  std::uint32_t next_sibling = kNone;
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> cycles{0}; ///< Inclusive
+};
+
+/**
+ * @brief Shadow call stack and calling-context tree of one thread
+ *
+ * Probed functions push a frame on entry and add the elapsed cycles to
+ * their call path on exit. Paths are found by scanning the children of the
+ * current node, keyed by the identity of the function's static site, so
+ * nothing is hashed or formatted on the hot path. Nodes live in a fixed
+ * array that is never reallocated; only the owning thread writes, and the
+ * node count is published after a node is linked in, so the report can
+ * read a tree whose thread is still running.
+ */
+class CallTree {
+public:
+  static constexpr std::uint32_t kMaxNodes = 1u << 14;
+  static constexpr std::uint32_t kMaxDepth = 1024;
+
+  CallTree();
+
+  CallTree(const CallTree &) = delete;
+  CallTree &operator=(const CallTree &) = delete;
+
+  void enter(const __optiweave_site_info *function,
+             std::uint64_t now) noexcept;
+  void exit(std::uint64_t now) noexcept;
+
+  /**
+   * @brief Forget the frames of a thread that ended inside probed scopes,
+   * before the tree is handed to the next thread of the slot
+   */
+  void unwind() noexcept;
+
+  std::uint32_t size() const noexcept {
+    return size_.load(std::memory_order_acquire);
+  }
+  const CallNode &node(std::uint32_t index) const noexcept {
+    return nodes_[index];
+  }
+
+  /// Calls not recorded because the tree or the stack was full
+  std::uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Frame {
+    std::uint32_t node;
+    std::uint64_t start;
+  };
+
+  std::unique_ptr<CallNode[]> nodes_;
+  std::atomic<std::uint32_t> size_{1};
+  std::atomic<std::uint64_t> dropped_{0};
+  std::uint32_t current_ = 0;
+  std::uint32_t depth_ = 0;
+  std::uint32_t overflow_ = 0; ///< Frames entered beyond kMaxDepth
+  Frame frames_[kMaxDepth];
+};
+
+/**
+ * @brief Totals of one call path over all threads
+ */
+struct CallPathTotals {
+  std::uint64_t calls = 0;
+  std::uint64_t inclusive_cycles = 0;
+  std::uint64_t exclusive_cycles = 0;
+};
+
+/**
+ * @brief Add a thread's tree to per-path totals
+ * @param paths Keyed by "outer;...;inner" function names, the folded-stack
+ *        format of flamegraph.pl
+ */
+void foldCallTree(const CallTree &tree,
+                  std::map<std::string, CallPathTotals> &paths);
+
+/**
+ * @brief Time per call path of probed functions: folded stacks of
+ * exclusive nanoseconds for flamegraph.pl, and a table with inclusive time
+ */
+void writeProfileReport(const ThreadRegistry &threads, double ns_per_cycle,
+                        const std::string &folded_path,
+                        const std::string &report_path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Monotonic timestamp in nanoseconds
+ *
+ * CLOCK_MONOTONIC is served from the vDSO on Linux, so this does not enter
+ * the kernel on the instrumented hot path.
+ */
+inline std::uint64_t monotonicNanoseconds() noexcept {
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL +
+         static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+/**
+ * @brief Cycle counter for timing short scopes
+ *
+ * The invariant TSC on x86 and the virtual counter on AArch64 are read
+ * without a fence; elsewhere this falls back to monotonicNanoseconds().
+ * Convert differences with a rate measured against the monotonic clock.
+ */
+inline std::uint64_t readCycleCounter() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return monotonicNanoseconds();
+#endif
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "optiweave/runtime/thread_registry.hpp"
+
+namespace optiweave::runtime {
+
+class TraceWriter;
+
+/**
+ * @brief Flush buffered trace events when the process crashes
+ *
+ * Installs SIGSEGV, SIGBUS and SIGABRT handlers that call
+ * TraceWriter::flushForCrash() and then hand the signal to whatever handler
+ * was installed before, so debuggers, sanitizers and core dumps behave as
+ * they would without the runtime. Only one thread flushes; a second
+ * crashing thread waits for it to finish before chaining.
+ *
+ * @return false if a handler could not be installed
+ */
+bool installCrashHandlers(TraceWriter &writer) noexcept;
+
+/**
+ * @brief Restore the previous handlers; the writer is no longer referenced
+ */
+void uninstallCrashHandlers() noexcept;
+
+/**
+ * @brief Give the calling thread an alternate signal stack
+ *
+ * Without one a stack overflow cannot run any handler. The stack belongs
+ * to the thread slot and is reused by later threads in the same slot.
+ */
+void enableAltStack(ThreadRecord &record) noexcept;
+
+/**
+ * @brief Detach the stack set by enableAltStack() before the calling
+ * thread exits; a stack the application installed itself is left alone
+ */
+void disableAltStack(ThreadRecord &record) noexcept;
+
+} // namespace optiweave::runtime
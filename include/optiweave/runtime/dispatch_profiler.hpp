@@ -0,0 +1,101 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Calls a site made on receivers of one dynamic type
+ */
+struct ReceiverCount {
+  const std::type_info *type = nullptr;
+  std::uint64_t count = 0;
+};
+
+/**
+ * @brief How many receiver types a virtual call site dispatches to
+ */
+enum class DispatchShape {
+  Monomorphic, ///< One type: a guarded direct call always hits
+  Bimorphic,   ///< Two types: two guards cover every call
+  Polymorphic, ///< Up to the cache size
+  Megamorphic, ///< More types than the cache holds
+};
+
+/**
+ * @brief Receiver types of one virtual call site
+ */
+struct DispatchProfile {
+  std::uint64_t calls = 0;
+  std::uint64_t overflow = 0;         ///< Calls on types the cache missed
+  std::vector<ReceiverCount> receivers; ///< Descending by count
+
+  DispatchShape shape() const noexcept;
+
+  /**
+   * @brief Share of the calls made on the most frequent type
+   */
+  double dominantShare() const noexcept;
+};
+
+const char *dispatchShapeName(DispatchShape shape) noexcept;
+
+/**
+ * @brief Per-site inline caches of virtual call receiver types
+ *
+ * Each site has kEntries (type, count) slots claimed first come, first
+ * served, like a polymorphic inline cache; calls on further types are only
+ * counted. Types are identified by their std::type_info, which the prelude
+ * reads from the receiver's vtable. The prelude keeps the same cache per
+ * thread; the runtime merges those into this one at shutdown.
+ */
+class DispatchProfiler {
+public:
+  static constexpr std::size_t kEntries = 4;
+
+  explicit DispatchProfiler(std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~DispatchProfiler();
+
+  DispatchProfiler(const DispatchProfiler &) = delete;
+  DispatchProfiler &operator=(const DispatchProfiler &) = delete;
+
+  /**
+   * @brief Account calls on a receiver of dynamic type `type`
+   */
+  void record(SiteId site, const std::type_info *type,
+              std::uint64_t calls = 1) noexcept;
+
+  /**
+   * @brief Account calls on types a thread's own cache had no room for
+   */
+  void recordOverflow(SiteId site, std::uint64_t calls) noexcept;
+
+  /**
+   * @brief Profile of one call site
+   * @return false if the site made no calls
+   */
+  bool siteProfile(SiteId site, DispatchProfile &out) const;
+
+private:
+  struct SiteCache;
+
+  const std::size_t capacity_;
+  std::unique_ptr<SiteCache[]> sites_;
+};
+
+/**
+ * @brief Receiver types of each virtual call site, busiest first, with the
+ * type a guarded direct call would test for
+ */
+void writeDispatchReport(const DispatchProfiler &dispatch,
+                         const SiteRegistry &sites, const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief False sharing detector tuning
+ */
+struct FalseSharingConfig {
+  std::size_t table_lines = 1u << 16;  ///< Cache lines followed at once
+  std::uint64_t window_ns = 1000000;   ///< Accesses this close count as concurrent
+};
+
+/**
+ * @brief What one thread did to a cache line within a window
+ */
+struct LineAccessSummary {
+  std::uint32_t thread = 0;
+  std::uint64_t read_mask = 0;  ///< Bit n: byte n of the line was read
+  std::uint64_t write_mask = 0; ///< Bit n: byte n of the line was written
+  SiteId site = kInvalidSite;   ///< Site of the latest access
+};
+
+/**
+ * @brief A cache line that threads used without sharing any bytes
+ */
+struct FalseSharingFinding {
+  std::uintptr_t line = 0; ///< Address of the first byte of the line
+  std::uint64_t conflicts = 0;
+  std::uint64_t true_sharing = 0; ///< Accesses that did overlap another thread
+  LineAccessSummary first;        ///< The two threads of the first conflict
+  LineAccessSummary second;
+};
+
+/**
+ * @brief Per cache line record of which threads touch which bytes
+ *
+ * Accesses are grouped in fixed time windows. Within a window every line
+ * keeps a byte mask of reads and writes for up to kThreadsPerLine threads.
+ * An access conflicts when another thread used the line in the same window,
+ * none of the bytes overlap and at least one of the two wrote: the line
+ * bounces between cores although the threads share no data. Overlapping
+ * accesses are real sharing and are only counted.
+ *
+ * Lines live in a fixed open-addressed table; lines that have never
+ * conflicted are recycled once their window is over, and accesses to lines
+ * that find no room are counted as dropped. Each line is updated under its
+ * own spin flag.
+ */
+class FalseSharingDetector {
+public:
+  static constexpr std::size_t kLineBytes = 64;
+  static constexpr std::size_t kThreadsPerLine = 4;
+
+  explicit FalseSharingDetector(const FalseSharingConfig &config = {});
+  ~FalseSharingDetector();
+
+  FalseSharingDetector(const FalseSharingDetector &) = delete;
+  FalseSharingDetector &operator=(const FalseSharingDetector &) = delete;
+
+  /**
+   * @brief Record bytes [address, address + bytes) used by thread
+   * @param now_ns Monotonic time of the access
+   */
+  void access(std::uintptr_t address, std::size_t bytes, bool write,
+              std::uint32_t thread, SiteId site, std::uint64_t now_ns) noexcept;
+
+  /**
+   * @brief Lines with at least one conflict, most conflicts first
+   */
+  std::vector<FalseSharingFinding> findings() const;
+
+  std::uint64_t droppedAccesses() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Entry;
+
+  Entry *claim(std::uintptr_t line, std::uint64_t window) noexcept;
+  void accessLine(std::uintptr_t line, std::uint64_t mask, bool write,
+                  std::uint32_t thread, SiteId site,
+                  std::uint64_t window) noexcept;
+
+  const std::uint64_t window_ns_;
+  const std::size_t mask_;
+  std::unique_ptr<Entry[]> entries_;
+  std::atomic<std::uint64_t> dropped_{0};
+};
+
+/**
+ * @brief Lines with conflicting threads, the two sites of the first
+ * conflict and the types they accessed
+ */
+void writeFalseSharingReport(const FalseSharingDetector &detector,
+                             const SiteRegistry &sites,
+                             const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "optiweave/runtime/trip_profiler.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Growth of the containers constructed at one declaration
+ *
+ * Peak sizes share the trip profiler's log2 histogram: one "execution" is
+ * one container instance, its "trips" are the most elements it held.
+ */
+struct GrowthProfile {
+  LoopTripProfile sizes;
+  std::uint64_t reallocations = 0;
+
+  /**
+   * @brief Whether every instance peaked at the same size
+   */
+  bool stable() const noexcept;
+
+  /**
+   * @brief Capacity to reserve right after construction
+   * @return The peak size of stable sites, otherwise the 90th percentile at
+   * bucket resolution; 0 when the instances did not reallocate
+   */
+  std::uint64_t recommendedReserve() const noexcept;
+};
+
+/**
+ * @brief Per-declaration container growth
+ *
+ * The prelude's GrowthTracker watches one container instance and reports
+ * its peak size and the number of times its capacity grew when the
+ * instance goes out of scope.
+ */
+class GrowthProfiler {
+public:
+  explicit GrowthProfiler(std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~GrowthProfiler();
+
+  GrowthProfiler(const GrowthProfiler &) = delete;
+  GrowthProfiler &operator=(const GrowthProfiler &) = delete;
+
+  /**
+   * @brief Account one container instance
+   */
+  void record(SiteId site, std::uint64_t peak_size,
+              std::uint64_t reallocations) noexcept;
+
+  /**
+   * @brief Profile of one declaration
+   * @return false if no instance was recorded
+   */
+  bool siteProfile(SiteId site, GrowthProfile &out) const noexcept;
+
+private:
+  const std::size_t capacity_;
+  TripProfiler sizes_;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> reallocations_;
+};
+
+/**
+ * @brief Peak sizes and reallocations of each tracked container
+ * declaration, with the capacity to reserve up front
+ */
+void writeGrowthReport(const GrowthProfiler &growth, const SiteRegistry &sites,
+                       const std::string &path);
+
+} // namespace optiweave::runtime
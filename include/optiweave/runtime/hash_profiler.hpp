@@ -0,0 +1,104 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Lookups at one unordered container call site
+ */
+struct HashSiteProfile {
+  /// Fewer sampled lookups than this say nothing about the hash
+  static constexpr std::uint64_t kMinSampledLookups = 64;
+
+  std::uint64_t lookups = 0;
+  std::uint64_t rehashes = 0;   ///< Calls during which bucket_count changed
+  std::uint64_t size_sum = 0;   ///< Elements, summed over lookups
+  std::uint64_t max_size = 0;
+  std::uint64_t bucket_sum = 0; ///< bucket_count(), summed over lookups
+  std::uint64_t sampled_lookups = 0; ///< Lookups whose key's bucket was read
+  std::uint64_t sampled_chain = 0;   ///< Their key's bucket sizes, summed
+
+  double meanSize() const noexcept;
+  double meanLoadFactor() const noexcept;
+
+  /**
+   * @brief Mean size of the bucket a sampled lookup's key hashed to, which
+   * is the chain that lookup walked
+   */
+  double chainLength() const noexcept;
+
+  /**
+   * @brief Chain length a uniform hash would give a stored key at the mean
+   * load factor; lookups of absent keys walk one element less
+   */
+  double expectedChainLength() const noexcept;
+};
+
+/**
+ * @brief What a site's lookups suggest changing
+ */
+enum class HashAdvice {
+  Fine,       ///< Chains as short as the load factor allows
+  BetterHash, ///< Chains far longer than a uniform hash would make
+  Reserve,    ///< The table rehashed while the site used it
+  FlatMap,    ///< Small table: a flat or sorted vector beats node chasing
+};
+
+/**
+ * @brief Classify a site; a bad hash takes precedence over growth
+ */
+HashAdvice adviseHashSite(const HashSiteProfile &profile) noexcept;
+
+const char *hashAdviceName(HashAdvice advice) noexcept;
+
+/**
+ * @brief Per-site lookup, load-factor and rehash counters for
+ * std::unordered_map and std::unordered_set
+ *
+ * The prelude's HashProbe counts each call in the calling thread's
+ * __optiweave_hash_counts for the site, and on every 64th call of a site
+ * per thread also reads the size of the bucket the looked-up key hashes to.
+ * The runtime merges the threads' counts here at shutdown.
+ */
+class HashProfiler {
+public:
+  explicit HashProfiler(std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~HashProfiler();
+
+  HashProfiler(const HashProfiler &) = delete;
+  HashProfiler &operator=(const HashProfiler &) = delete;
+
+  /**
+   * @brief Add one thread's counts for a site; max_size is kept as the
+   * largest of the threads'
+   */
+  void record(SiteId site, const HashSiteProfile &counts) noexcept;
+
+  /**
+   * @brief Profile of one call site
+   * @return false if the site made no calls
+   */
+  bool siteProfile(SiteId site, HashSiteProfile &out) const noexcept;
+
+private:
+  struct SiteCounters;
+
+  const std::size_t capacity_;
+  std::unique_ptr<SiteCounters[]> sites_;
+};
+
+/**
+ * @brief Load factor, chain length and rehashes of each unordered container
+ * call site, busiest first, with what to change about the table
+ */
+void writeHashReport(const HashProfiler &hash, const SiteRegistry &sites,
+                     const std::string &path);
+
+} // namespace optiweave::runtime
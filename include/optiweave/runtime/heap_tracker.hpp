@@ -0,0 +1,201 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+class ThreadRegistry;
+
+/**
+ * @brief Snapshot of one tracked heap allocation
+ */
+struct HeapAllocation {
+  std::uint32_t id = 0;         ///< Record slot, reused after free
+  std::uint32_t generation = 0; ///< Bumped on every reuse of the slot
+  std::uintptr_t base = 0;
+  std::size_t size = 0;
+  std::uintptr_t site = 0; ///< Return address of the allocating call
+};
+
+/**
+ * @brief Outcome of HeapTracker::checkBounds()
+ */
+enum class BoundsStatus {
+  InBounds,
+  OutOfBounds,
+  Untracked ///< The pointer is not inside a live tracked allocation
+};
+
+/**
+ * @brief Per allocating call-site totals for the hotness report
+ */
+struct HeapSiteStats {
+  std::uintptr_t site = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes = 0;
+  std::uint64_t live_allocations = 0;
+  std::uint64_t live_bytes = 0;
+  std::uint64_t accesses = 0;
+};
+
+/**
+ * @brief Live heap ranges indexed by page for address attribution
+ *
+ * Allocations are kept in records from a fixed mmap'd pool and indexed by
+ * a three-level radix tree over 4 KiB page numbers. Allocations of at most
+ * one page are chained from the page they start on, so a lookup checks the
+ * page of the address and the one before it. Larger allocations are
+ * stored directly in every page they cover; since they cannot overlap,
+ * two slots per page are enough.
+ *
+ * Lookups never block: each leaf carries a sequence counter and readers
+ * retry if a writer changed the leaf under them. Writers on the same
+ * 16 MiB leaf serialize on a spin flag; the tree itself only grows, by CAS.
+ * Nothing here calls malloc, so the tracker can sit underneath an
+ * interposed allocator.
+ */
+class HeapTracker {
+public:
+  static constexpr std::size_t kMaxAllocations = 1u << 20;
+  static constexpr std::size_t kMaxSites = 1u << 14;
+  static constexpr unsigned kPageShift = 12;
+
+  constexpr HeapTracker() = default;
+  HeapTracker(const HeapTracker &) = delete;
+  HeapTracker &operator=(const HeapTracker &) = delete;
+
+  /**
+   * @brief Process-wide tracker fed by the malloc interposer
+   *
+   * Constant-initialized, so it is usable from the very first allocation
+   * and never destroyed.
+   */
+  static HeapTracker &global() noexcept;
+
+  /**
+   * @brief Turn on attribution of accesses; set by the interposer
+   */
+  void enable() noexcept { enabled_.store(true, std::memory_order_release); }
+  bool enabled() const noexcept {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Start tracking [ptr, ptr + size)
+   * @param site Return address of the allocation call
+   * @return false if the allocation could not be tracked
+   */
+  bool onAllocate(const void *ptr, std::size_t size, const void *site) noexcept;
+
+  /**
+   * @brief Stop tracking the allocation starting at ptr; folds its access
+   * count into its allocating site
+   */
+  void onFree(const void *ptr) noexcept;
+
+  /**
+   * @brief Find the live allocation containing address
+   */
+  bool find(std::uintptr_t address, HeapAllocation &out) const noexcept;
+
+  /**
+   * @brief Whether a snapshot from find() still describes a live allocation
+   */
+  bool isCurrent(const HeapAllocation &allocation) const noexcept;
+
+  /**
+   * @brief Check that [address, address + bytes) stays inside the
+   * allocation that pointer points into
+   *
+   * cache holds the allocation of the previous check (typically one per
+   * thread). While pointer stays inside it and it is still current, the
+   * check costs two compares and one generation load; otherwise the
+   * allocation is looked up again and cache updated.
+   */
+  BoundsStatus checkBounds(std::uintptr_t pointer, std::uintptr_t address,
+                           std::size_t bytes,
+                           HeapAllocation &cache) const noexcept;
+
+  /**
+   * @brief Attribute one access to the allocation containing address
+   * @return false if no tracked allocation contains it
+   */
+  bool recordAccess(std::uintptr_t address) noexcept;
+
+  /**
+   * @brief Charge one access to an allocation found earlier
+   */
+  void countAccess(const HeapAllocation &allocation) noexcept;
+
+  /**
+   * @brief Accesses charged to a live allocation so far
+   */
+  std::uint64_t accessCount(const HeapAllocation &allocation) const noexcept;
+
+  /**
+   * @brief Totals per allocating site, live allocations included
+   */
+  std::vector<HeapSiteStats> siteStats() const;
+
+  /**
+   * @brief Live allocations with the most accesses, hottest first
+   */
+  std::vector<std::pair<HeapAllocation, std::uint64_t>>
+  hottestAllocations(std::size_t limit) const;
+
+  std::uint64_t untrackedAllocations() const noexcept {
+    return untracked_.load(std::memory_order_relaxed);
+  }
+  std::uint64_t liveAllocations() const noexcept {
+    return live_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Record;
+  struct Leaf;
+  struct Mid;
+  struct SiteSlot;
+
+  static constexpr unsigned kLevelBits = 12;
+  static constexpr std::size_t kLevelSize = std::size_t{1} << kLevelBits;
+
+  Record *records() const noexcept;
+  SiteSlot *sites() const noexcept;
+  Leaf *leafFor(std::uintptr_t page, bool create) const noexcept;
+
+  std::uint32_t allocateRecord() noexcept;
+  void releaseRecord(std::uint32_t id) noexcept;
+  SiteSlot *siteSlot(std::uintptr_t site, bool create) const noexcept;
+
+  bool findInPage(std::uintptr_t page, std::uintptr_t address,
+                  bool small_only, HeapAllocation &out) const noexcept;
+  bool linkSmall(std::uint32_t id, std::uintptr_t page) noexcept;
+  bool linkLarge(std::uint32_t id, std::uintptr_t first_page,
+                 std::uintptr_t last_page) noexcept;
+  std::uint32_t unlinkSmall(std::uintptr_t base) noexcept;
+  std::uint32_t unlinkLarge(std::uintptr_t base) noexcept;
+
+  std::atomic<bool> enabled_{false};
+  mutable std::atomic<Mid *> root_[kLevelSize]{};
+  mutable std::atomic<Record *> records_{nullptr};
+  mutable std::atomic<SiteSlot *> sites_{nullptr};
+
+  std::atomic<std::uint32_t> next_unused_{0};
+  std::atomic<std::uint64_t> free_head_{0}; // tag << 32 | (id + 1)
+
+  std::atomic<std::uint64_t> untracked_{0};
+  std::atomic<std::uint64_t> live_{0};
+};
+
+/**
+ * @brief Per allocating site access totals, hottest first
+ */
+void writeHeapReport(const HeapTracker &heap, const ThreadRegistry &threads,
+                     const std::string &path);
+
+} // namespace optiweave::runtime
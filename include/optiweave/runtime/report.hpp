@@ -0,0 +1,25 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief "symbol+0x1c (module)" or "module+0x4f2c" for a code address
+ */
+std::string describeCodeAddress(std::uintptr_t address);
+
+/**
+ * @brief "file:line:column in function" for a site id
+ */
+std::string describeSite(const SiteRegistry &sites, SiteId id);
+
+/**
+ * @brief Readable name of a mangled type, "?" when unknown
+ */
+std::string demangleType(const char *mangled);
+
+} // namespace optiweave::runtime
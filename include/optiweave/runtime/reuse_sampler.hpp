@@ -0,0 +1,155 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Reuse sampler tuning
+ */
+struct ReuseSamplerConfig {
+  std::uint32_t sample_one_in = 100; ///< Initial spatial sampling rate
+  std::size_t max_lines = 8192;      ///< Sampled lines kept at once
+  unsigned line_shift = 6;           ///< log2 of the cache line size
+};
+
+/**
+ * @brief Estimated reuse-distance distribution of a set of accesses
+ *
+ * Distances are in cache lines. Bucket 0 holds reuses with no other line
+ * in between, bucket b > 0 distances in [2^(b-1), 2^b). Counts are
+ * estimates of the unsampled totals, so they are fractional.
+ */
+struct ReuseHistogram {
+  static constexpr std::size_t kBuckets = 40;
+
+  double accesses = 0;
+  double cold = 0; ///< First touches, i.e. distinct lines
+  double buckets[kBuckets] = {};
+
+  void merge(const ReuseHistogram &other) noexcept;
+
+  /**
+   * @brief Miss ratio of a fully associative LRU cache of cache_lines
+   * lines; exact at powers of two
+   */
+  double missRatio(std::uint64_t cache_lines) const noexcept;
+
+  /**
+   * @brief Smallest power-of-two cache, in lines, at which capacity misses
+   * drop below `tolerance` of the accesses
+   */
+  std::uint64_t linesNeeded(double tolerance) const noexcept;
+};
+
+/**
+ * @brief Reuse distances and miss-ratio curves from spatially hashed
+ * sampling (SHARDS)
+ *
+ * A cache line is sampled when a hash of its address falls below a
+ * threshold, so every access to a sampled line is seen and reuse distances
+ * among sampled lines, divided by the sampling rate, estimate the distances
+ * in the full stream. The filter is one hash and one compare and needs no
+ * lock; only sampled accesses reach record().
+ *
+ * Memory is bounded by max_lines: when more lines are sampled, the one
+ * with the largest hash is dropped and the threshold lowered to its hash,
+ * which lowers the rate for everything after. Accesses are weighted by the
+ * rate in effect when they were seen, so earlier and later estimates stay
+ * comparable. Distances are counted with a Fenwick tree over last-access
+ * times, compacted when the clock runs out. A sample whose bookkeeping
+ * cannot be allocated is dropped.
+ */
+class ReuseSampler {
+public:
+  explicit ReuseSampler(const ReuseSamplerConfig &config = {},
+                        std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~ReuseSampler();
+
+  ReuseSampler(const ReuseSampler &) = delete;
+  ReuseSampler &operator=(const ReuseSampler &) = delete;
+
+  /**
+   * @brief Account one access by `site`; cheap unless the line is sampled
+   */
+  void access(std::uintptr_t address, SiteId site) noexcept {
+    std::uintptr_t line = address >> line_shift_;
+    std::uint64_t hash = hashLine(line);
+    if (hash < threshold_.load(std::memory_order_relaxed)) {
+      record(line, hash, site);
+    }
+  }
+
+  /**
+   * @brief Histogram over all sampled accesses
+   */
+  ReuseHistogram total() const;
+
+  /**
+   * @brief Histogram of the accesses made by one site
+   * @return false if the site has no sampled access
+   */
+  bool siteHistogram(SiteId site, ReuseHistogram &out) const;
+
+  /**
+   * @brief Fraction of lines currently sampled
+   */
+  double samplingRate() const noexcept;
+
+  std::size_t lineBytes() const noexcept {
+    return std::size_t{1} << line_shift_;
+  }
+
+  static std::uint64_t hashLine(std::uintptr_t line) noexcept {
+    std::uint64_t x = line + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  }
+
+private:
+  struct Line {
+    std::uint64_t hash = 0;
+    std::uint32_t time = 0;
+  };
+
+  void record(std::uintptr_t line, std::uint64_t hash, SiteId site) noexcept;
+  void evictLargest();
+  void compactClock();
+  void mark(std::uint32_t time, int delta);
+  std::uint32_t markedAfter(std::uint32_t time) const;
+  ReuseHistogram &histogramFor(SiteId site);
+
+  const unsigned line_shift_;
+  const std::size_t max_lines_;
+  std::atomic<std::uint64_t> threshold_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::uintptr_t, Line> lines_;
+  std::set<std::pair<std::uint64_t, std::uintptr_t>> by_hash_;
+  std::vector<std::int32_t> fenwick_; // 1-based over clock ticks
+  std::uint32_t clock_ = 0;
+  std::uint32_t marked_ = 0;
+  ReuseHistogram total_;
+  std::vector<std::unique_ptr<ReuseHistogram>> sites_;
+};
+
+/**
+ * @brief Miss-ratio curves for the whole program, each function and each
+ * site, plus a stderr summary of the busiest functions
+ */
+void writeReuseReport(const ReuseSampler &reuse, const SiteRegistry &sites,
+                      const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,377 @@
+#pragma once
+
+#include "optiweave/runtime/abi.hpp"
+#include "optiweave/runtime/call_profiler.hpp"
+#include "optiweave/runtime/false_sharing.hpp"
+#include "optiweave/runtime/heap_tracker.hpp"
+#include "optiweave/runtime/reuse_sampler.hpp"
+#include "optiweave/runtime/site_counters.hpp"
+#include "optiweave/runtime/site_registry.hpp"
+#include "optiweave/runtime/stride_profiler.hpp"
+#include "optiweave/runtime/telemetry.hpp"
+#include "optiweave/runtime/thread_registry.hpp"
+#include "optiweave/runtime/trace_writer.hpp"
+#include "optiweave/runtime/traversal_profiler.hpp"
+#include "optiweave/runtime/dispatch_profiler.hpp"
+#include "optiweave/runtime/hash_profiler.hpp"
+#include "optiweave/runtime/growth_profiler.hpp"
+#include "optiweave/runtime/trip_profiler.hpp"
+#include "optiweave/runtime/value_profiler.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Runtime configuration, read once from the environment
+ *
+ *   OPTIWEAVE_TELEMETRY=1          publish live counters to /dev/shm
+ *   OPTIWEAVE_TELEMETRY_NAME=/x    override the shm segment name
+ *   OPTIWEAVE_TELEMETRY_KEEP=1     leave the segment behind at exit
+ *   OPTIWEAVE_TRACE=1              write every event to binary trace files
+ *   OPTIWEAVE_TRACE_DIR=path       trace directory (default ".")
+ *   OPTIWEAVE_TRACE_BLOCK_KB=n     write size (default 4096)
+ *   OPTIWEAVE_TRACE_RING=n         per-thread ring capacity in events
+ *   OPTIWEAVE_TRACE_SEGMENT_MB=n   rotate segments at this size (default 256)
+ *   OPTIWEAVE_TRACE_BUDGET_MB=n    delete old segments above this (default 2048)
+ *   OPTIWEAVE_TRACE_BACKPRESSURE=  drop | sample | block (default drop)
+ *   OPTIWEAVE_TRACE_SAMPLE=n       keep 1 in n events under sample pressure
+ *   OPTIWEAVE_TRACE_DIRECT=1       open segments with O_DIRECT
+ *   OPTIWEAVE_TRACE_IO=            uring | pwrite (default uring if built in)
+ *   OPTIWEAVE_TRACE_CRASH=0        do not flush buffered events on
+ *                                  SIGSEGV/SIGBUS/SIGABRT (default on)
+ *   OPTIWEAVE_HEAP=0               disable heap tracking when the program
+ *                                  links optiweave_heap
+ *   OPTIWEAVE_HEAP_REPORT=path     heap hotness report
+ *                                  (default optiweave-heap.<pid>.tsv)
+ *   OPTIWEAVE_BOUNDS=1|abort       check pointer subscripts against heap
+ *                                  allocations; report, or report and abort
+ *   OPTIWEAVE_MRC=1                estimate miss-ratio curves and working
+ *                                  sets of subscript accesses (SHARDS)
+ *   OPTIWEAVE_MRC_SAMPLE=n         start by sampling 1 in n cache lines
+ *                                  (default 100)
+ *   OPTIWEAVE_MRC_LINES=n          most sampled lines kept (default 8192)
+ *   OPTIWEAVE_MRC_REPORT=path      curves per site and function
+ *                                  (default optiweave-mrc.<pid>.tsv)
+ *   OPTIWEAVE_FALSE_SHARING=1      flag cache lines that threads use at
+ *                                  disjoint offsets with at least one writer
+ *   OPTIWEAVE_FALSE_SHARING_WINDOW_US=n
+ *                                  accesses this close are concurrent
+ *                                  (default 1000)
+ *   OPTIWEAVE_FALSE_SHARING_REPORT=path
+ *                                  (default optiweave-sharing.<pid>.tsv)
+ *   OPTIWEAVE_PREFETCH=1           detect strided subscript streams and
+ *                                  write prefetch advice for
+ *                                  `optiweave --insert-prefetch`
+ *   OPTIWEAVE_PREFETCH_ADVICE=path (default optiweave-prefetch.<pid>.tsv)
+ *   OPTIWEAVE_PREFETCH_LATENCY_NS=n
+ *                                  latency to cover (default 300)
+ *   OPTIWEAVE_DIVISORS=1           profile integer divisors of `/` and `%`
+ *                                  sites and flag constant or power-of-two
+ *                                  ones
+ *   OPTIWEAVE_DIVISORS_REPORT=path (default optiweave-divisors.<pid>.tsv)
+ *   OPTIWEAVE_DENORMALS=1          count subnormal operands and results of
+ *                                  floating-point arithmetic per site
+ *   OPTIWEAVE_DENORMALS_REPORT=path
+ *                                  (default optiweave-denormals.<pid>.tsv)
+ *   OPTIWEAVE_TRAVERSAL=1          report which dimension fused
+ *                                  multi-dimensional subscripts walk along
+ *   OPTIWEAVE_TRAVERSAL_REPORT=path
+ *                                  (default optiweave-traversal.<pid>.tsv)
+ *   OPTIWEAVE_BRANCHES=1           count true/false outcomes of instrumented
+ *                                  comparisons for
+ *                                  `optiweave --annotate-branches`
+ *   OPTIWEAVE_BRANCHES_REPORT=path (default optiweave-branches.<pid>.tsv)
+ *   OPTIWEAVE_LOOPS=1              histogram the trip counts of loops
+ *                                  instrumented with `--loop-trips`
+ *   OPTIWEAVE_LOOPS_REPORT=path    (default optiweave-loops.<pid>.tsv)
+ *   OPTIWEAVE_PROFILE=1            time functions probed with
+ *                                  `--probe-functions` per call path
+ *   OPTIWEAVE_PROFILE_FOLDED=path  exclusive time per path for
+ *                                  flamegraph.pl
+ *                                  (default optiweave-profile.<pid>.folded)
+ *   OPTIWEAVE_PROFILE_REPORT=path  calls, inclusive and exclusive time
+ *                                  (default optiweave-profile.<pid>.tsv)
+ *   OPTIWEAVE_ALLOCATIONS=1        count allocations and deallocations at
+ *                                  sites instrumented with `--allocations`
+ *   OPTIWEAVE_ALLOCATIONS_REPORT=path
+ *                                  (default optiweave-allocations.<pid>.tsv)
+ *   OPTIWEAVE_GROWTH=1             peak sizes and reallocations of vectors
+ *                                  and strings instrumented with
+ *                                  `--container-growth`, with reserve()
+ *                                  suggestions for `--insert-reserve`
+ *   OPTIWEAVE_GROWTH_REPORT=path   (default optiweave-growth.<pid>.tsv)
+ *   OPTIWEAVE_COPIES=1             count copies of large or heap-owning
+ *                                  types instrumented with `--copies`
+ *   OPTIWEAVE_COPIES_REPORT=path   (default optiweave-copies.<pid>.tsv)
+ *   OPTIWEAVE_DISPATCH=1           receiver types of virtual calls
+ *                                  instrumented with `--virtual-calls`,
+ *                                  for `optiweave --devirtualize`
+ *   OPTIWEAVE_DISPATCH_REPORT=path (default optiweave-dispatch.<pid>.tsv)
+ *   OPTIWEAVE_HASH=1               load factors, chain lengths and rehashes
+ *                                  at unordered container lookups
+ *                                  instrumented with `--hash-lookups`
+ *   OPTIWEAVE_HASH_REPORT=path     (default optiweave-hash.<pid>.tsv)
+ */
+struct RuntimeConfig {
+  bool telemetry = false;
+  std::string telemetry_name;
+  bool keep_telemetry = false;
+  bool trace = false;
+  bool crash_handlers = true;
+  std::string heap_report;
+  bool bounds = false;
+  bool bounds_abort = false;
+  bool reuse = false;
+  std::string reuse_report;
+  ReuseSamplerConfig reuse_config;
+  bool false_sharing = false;
+  std::string false_sharing_report;
+  FalseSharingConfig false_sharing_config;
+  bool prefetch = false;
+  std::string prefetch_advice;
+  PrefetchAdviceConfig prefetch_config;
+  bool divisors = false;
+  std::string divisors_report;
+  bool denormals = false;
+  std::string denormals_report;
+  bool traversal = false;
+  std::string traversal_report;
+  bool branches = false;
+  std::string branches_report;
+  bool loops = false;
+  std::string loops_report;
+  bool profile = false;
+  std::string profile_folded;
+  std::string profile_report;
+  bool allocations = false;
+  std::string allocations_report;
+  bool growth = false;
+  std::string growth_report;
+  bool copies = false;
+  std::string copies_report;
+  bool dispatch = false;
+  std::string dispatch_report;
+  bool hash = false;
+  std::string hash_report;
+  TraceWriterConfig trace_config;
+
+  static RuntimeConfig fromEnvironment();
+};
+
+static_assert(BranchCounters::kBlockSites * __OPTIWEAVE_SITE_BLOCKS ==
+                  SiteRegistry::kCapacity,
+              "per-thread site blocks must cover every site id");
+
+/**
+ * @brief Process-wide state behind the C hooks called by transformed code
+ *
+ * The instance is created on the first event and intentionally never
+ * destroyed, so threads still running during static destruction cannot
+ * touch a dead object; exit-time work happens in shutdown().
+ */
+class Runtime {
+public:
+  static Runtime &instance();
+
+  Runtime(const Runtime &) = delete;
+  Runtime &operator=(const Runtime &) = delete;
+
+  const RuntimeConfig &config() const { return config_; }
+  SiteRegistry &sites() { return sites_; }
+  ThreadRegistry &threads() { return threads_; }
+
+  /**
+   * @brief Record a subscript access
+   */
+  void recordAccess(const char *operation, const void *ptr, std::size_t index,
+                    std::size_t element_size,
+                    const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Record a fused chain of subscripts as one access
+   * @param element Address of the element the chain reaches
+   * @param extents Extent per dimension, 0 where unknown
+   */
+  void recordAccessNd(const char *operation, const void *element,
+                      std::size_t element_size, std::uint32_t rank,
+                      const std::size_t *indices, const std::size_t *extents,
+                      const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Record an arithmetic/assignment/comparison operation
+   */
+  void recordOperation(const char *operation,
+                       const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Validate a pointer subscript against the heap allocation the
+   * pointer points into; violations are reported once per site
+   */
+  void checkBounds(const void *ptr, std::size_t index,
+                   std::size_t element_size,
+                   const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Record an operand value, such as the divisor of a division
+   */
+  void recordValue(const char *operation, std::int64_t value,
+                   const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Count an arithmetic evaluation with subnormal operands or result
+   * @param operands __OPTIWEAVE_DENORMAL_* bits
+   */
+  void recordDenormal(const char *operation, std::uint32_t operands,
+                      const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Site id of a comparison, resolved once per call site by the
+   * prelude
+   * @return __OPTIWEAVE_NO_SITE when branches are not profiled or the
+   * registry is full
+   */
+  std::uint32_t branchSite(const char *operation,
+                           const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief The calling thread's block of comparison outcomes holding a
+   * site, [site within the block][false, true]
+   * @return nullptr when branches are not profiled, the thread has no
+   * record or the block cannot be allocated
+   */
+  std::atomic<std::uint64_t> (*branchCounters(std::uint32_t id) noexcept)[2];
+
+  /**
+   * @brief Account one execution of an instrumented loop
+   */
+  void recordTrips(std::uint64_t trips,
+                   const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Push a probed function on the calling thread's shadow stack
+   * @param function Static site of the function; its address identifies it
+   */
+  void enterFunction(const __optiweave_site_info *function) noexcept;
+
+  /**
+   * @brief Pop the innermost probed function and account its time
+   */
+  void exitFunction() noexcept;
+
+  /**
+   * @brief Count an allocation or a container construction that allocated
+   * @param bytes Requested size, 0 where not known at the site
+   */
+  void recordAllocation(const char *operation, std::size_t bytes,
+                        const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Count a delete or free
+   */
+  void recordDeallocation(const char *operation,
+                          const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Account one container instance when it goes out of scope
+   */
+  void recordGrowth(std::uint64_t peak_size, std::uint64_t reallocations,
+                    const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Count a copy construction or copy assignment
+   * @param bytes The copied object plus the elements it holds
+   */
+  void recordCopy(const char *operation, std::size_t bytes,
+                  const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief Site id of a virtual call, resolved once per call site by the
+   * prelude
+   * @return __OPTIWEAVE_NO_SITE when dispatch is not profiled or the
+   * registry is full
+   */
+  std::uint32_t dispatchSite(const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief The calling thread's block of receiver caches holding a site
+   * @return nullptr when dispatch is not profiled, the thread has no
+   * record or the block cannot be allocated
+   */
+  __optiweave_receiver_cache *receiverCaches(std::uint32_t id) noexcept;
+
+  /**
+   * @brief Site id of an unordered container call, resolved once per call
+   * site by the prelude
+   * @return __OPTIWEAVE_NO_SITE when hashing is not profiled or the
+   * registry is full
+   */
+  std::uint32_t hashSite(const __optiweave_site_info &site) noexcept;
+
+  /**
+   * @brief The calling thread's block of hash counts holding a site
+   * @return nullptr when hashing is not profiled, the thread has no record
+   * or the block cannot be allocated
+   */
+  __optiweave_hash_counts *hashCounters(std::uint32_t id) noexcept;
+
+  /**
+   * @brief Record of the calling thread, registering it on first use
+   * @return nullptr if the thread registry is full
+   */
+  ThreadRecord *currentThread() noexcept;
+
+  /**
+   * @brief Flush and release exit-time resources; idempotent
+   */
+  void shutdown();
+
+private:
+  Runtime();
+
+  friend struct ThreadHandle;
+  ThreadRecord *attachThread() noexcept;
+  void detachThread(ThreadRecord *record) noexcept;
+
+  SiteId resolveSite(const char *operation,
+                     const __optiweave_site_info &site) noexcept;
+  void recordAddress(SiteId id, ThreadRecord *thread, std::uintptr_t address,
+                     std::size_t index, std::size_t element_size,
+                     const __optiweave_site_info &site) noexcept;
+  void reportBoundsViolation(SiteId id, const __optiweave_site_info &site,
+                             std::uintptr_t address, std::size_t index,
+                             std::size_t element_size,
+                             const HeapAllocation &allocation) noexcept;
+
+  RuntimeConfig config_;
+  SiteRegistry sites_;
+  ThreadRegistry threads_;
+  std::unique_ptr<TelemetryPublisher> telemetry_;
+  std::unique_ptr<TraceWriter> trace_;
+  std::unique_ptr<ReuseSampler> reuse_;
+  std::unique_ptr<FalseSharingDetector> false_sharing_;
+  std::unique_ptr<StrideProfiler> strides_;
+  std::unique_ptr<ValueProfiler> values_;
+  std::unique_ptr<DenormalCounts[]> denormals_;
+  std::unique_ptr<TraversalProfiler> traversal_;
+  std::unique_ptr<BranchCounts[]> branches_;
+  std::unique_ptr<TripProfiler> trips_;
+  std::unique_ptr<AllocationCounts[]> allocations_;
+  std::unique_ptr<GrowthProfiler> growth_;
+  std::unique_ptr<CopyCounts[]> copies_;
+  std::unique_ptr<DispatchProfiler> dispatch_;
+  std::unique_ptr<HashProfiler> hash_;
+  std::uint64_t start_ns_ = 0;     ///< Clock at startup, for rates
+  std::uint64_t start_cycles_ = 0; ///< ...and the cycle counter with it
+  bool crash_handlers_installed_ = false;
+  std::unique_ptr<std::atomic<bool>[]> bounds_reported_;
+  std::atomic<std::uint64_t> bounds_violations_{0};
+  std::atomic<bool> bounds_warned_{false};
+  bool shut_down_ = false;
+};
+
+} // namespace optiweave::runtime
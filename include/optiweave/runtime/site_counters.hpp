@@ -0,0 +1,78 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Subnormal values seen at one arithmetic site
+ */
+struct DenormalCounts {
+  std::atomic<std::uint64_t> hits{0}; ///< Evaluations with any subnormal
+  std::atomic<std::uint64_t> lhs{0};
+  std::atomic<std::uint64_t> rhs{0};
+  std::atomic<std::uint64_t> result{0};
+};
+
+/**
+ * @brief Arithmetic sites that consumed or produced subnormal values
+ */
+void writeDenormalReport(const DenormalCounts *counts,
+                         const SiteRegistry &sites, const std::string &path);
+
+/**
+ * @brief Outcomes of one comparison site, indexed by the result
+ *
+ * Threads count into their own ThreadRecord::branch_counters; these are
+ * the totals merged from them at shutdown.
+ */
+struct BranchCounts {
+  std::uint64_t outcomes[2] = {}; ///< [false, true]
+};
+
+/**
+ * @brief True/false counts of each comparison site, for
+ * `optiweave --annotate-branches`
+ */
+void writeBranchReport(const BranchCounts *counts, const SiteRegistry &sites,
+                       const std::string &path);
+
+/**
+ * @brief Events and bytes of one allocation site
+ *
+ * Deallocations are counted apart so that delete and free sites never
+ * rank among the allocations.
+ */
+struct AllocationCounts {
+  std::atomic<std::uint64_t> events{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> deallocations{0};
+};
+
+/**
+ * @brief Allocation sites ranked by rate, with their loop depth
+ */
+void writeAllocationReport(const AllocationCounts *counts,
+                           const SiteRegistry &sites, double seconds,
+                           const std::string &path);
+
+/**
+ * @brief Copies and bytes copied at one copy construction or assignment
+ */
+struct CopyCounts {
+  std::atomic<std::uint64_t> events{0};
+  std::atomic<std::uint64_t> bytes{0};
+};
+
+/**
+ * @brief Copy sites ranked by bytes copied, flagging copies of locals that
+ * are not used afterwards
+ */
+void writeCopyReport(const CopyCounts *counts, const SiteRegistry &sites,
+                     const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "optiweave/runtime/abi.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Dense identifier of an instrumented expression
+ */
+using SiteId = std::uint32_t;
+
+inline constexpr SiteId kInvalidSite = 0xffffffffu;
+
+/**
+ * @brief Interned description of an instrumented expression
+ */
+struct SiteRecord {
+  const char *operation = nullptr;
+  const char *file = nullptr;
+  const char *function = nullptr;
+  const char *type = nullptr; ///< Mangled accessed type, if known
+  std::uint32_t line = 0;
+  std::uint32_t column = 0;
+  std::uint32_t flags = 0;
+};
+
+/**
+ * @brief Lock-free interning of call sites into dense identifiers
+ *
+ * Sites are keyed by the identity of their static strings plus line and
+ * column, so the hot path hashes a few words and compares pointers. Ids are
+ * handed out in first-seen order and never reused, which lets other
+ * subsystems index flat per-site arrays with them.
+ */
+class SiteRegistry {
+public:
+  static constexpr std::size_t kCapacity = 1u << 14;
+
+  SiteRegistry();
+  ~SiteRegistry() = default;
+
+  SiteRegistry(const SiteRegistry &) = delete;
+  SiteRegistry &operator=(const SiteRegistry &) = delete;
+
+  /**
+   * @brief Look up or create the id for a site
+   * @param operation Operation name (static storage)
+   * @param site Location of the instrumented expression
+   * @param inserted Set to true if this call created the entry
+   * @return Site id, or kInvalidSite if the registry is full
+   */
+  SiteId intern(const char *operation, const __optiweave_site_info &site,
+                bool *inserted = nullptr) noexcept;
+
+  /**
+   * @brief Get the record for an id
+   * @return Record, or nullptr if the id is not (yet) published
+   */
+  const SiteRecord *get(SiteId id) const noexcept;
+
+  /**
+   * @brief Number of ids handed out so far
+   */
+  std::size_t size() const noexcept {
+    return next_id_.load(std::memory_order_acquire);
+  }
+
+private:
+  enum SlotState : std::uint32_t { kEmpty = 0, kClaimed = 1, kReady = 2 };
+
+  struct Slot {
+    std::atomic<std::uint32_t> state{kEmpty};
+    SiteId id = kInvalidSite;
+    SiteRecord record;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  std::unique_ptr<std::atomic<const Slot *>[]> by_id_;
+  std::atomic<std::uint32_t> next_id_{0};
+};
+
+/**
+ * @brief Write id -> site metadata next to the trace segments
+ */
+void writeSiteTable(const SiteRegistry &sites, const std::string &directory);
+
+} // namespace optiweave::runtime
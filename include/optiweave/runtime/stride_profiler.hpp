@@ -0,0 +1,116 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+class ReuseSampler;
+
+/**
+ * @brief Last access of one site by one thread
+ */
+struct StrideCursor {
+  SiteId site = kInvalidSite;
+  std::int64_t last_stride = 0;
+  std::uintptr_t last_address = 0;
+  std::uint64_t last_ns = 0;
+};
+
+/**
+ * @brief Address-stream shape of one site, summed over threads
+ */
+struct SiteStrideProfile {
+  std::uint64_t accesses = 0;
+  std::uint64_t regular = 0;   ///< Same stride as the previous access
+  std::uint64_t new_lines = 0; ///< Left the previous access's cache line
+  std::int64_t stride = 0;     ///< Dominant stride in bytes
+  std::uint64_t gap_ns = 0;    ///< Time between consecutive accesses...
+  std::uint64_t gaps = 0;      ///< ...over this many loop-like pairs
+
+  double regularFraction() const noexcept {
+    return accesses ? static_cast<double>(regular) / accesses : 0.0;
+  }
+  double nsPerAccess() const noexcept {
+    return gaps ? static_cast<double>(gap_ns) / gaps : 0.0;
+  }
+};
+
+/**
+ * @brief When a site is worth a software prefetch, and how far ahead
+ */
+struct PrefetchAdviceConfig {
+  std::uint64_t latency_ns = 300; ///< Memory latency to hide
+  std::uint64_t min_accesses = 1000;
+  double min_regular = 0.75;
+  double min_miss_ratio = 0.1;
+  std::uint32_t max_distance = 64;
+};
+
+/**
+ * @brief Stride detection per instrumented site
+ *
+ * Each thread keeps a small direct-mapped table of cursors, indexed by
+ * site id, remembering the last address and stride it saw per site; the
+ * comparison with the previous access happens there without sharing. The
+ * per-site totals are relaxed atomics, and the dominant stride is tracked
+ * with a single majority-vote candidate, which is exact whenever one stride
+ * accounts for more than half of the accesses.
+ */
+class StrideProfiler {
+public:
+  static constexpr std::size_t kCursors = 64;
+  static constexpr std::uint64_t kMaxGapNs = 100000;
+
+  explicit StrideProfiler(std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~StrideProfiler();
+
+  StrideProfiler(const StrideProfiler &) = delete;
+  StrideProfiler &operator=(const StrideProfiler &) = delete;
+
+  /**
+   * @brief Account one access
+   * @param cursors The calling thread's kCursors cursors
+   */
+  void access(StrideCursor *cursors, SiteId site, std::uintptr_t address,
+              std::uint64_t now_ns) noexcept;
+
+  /**
+   * @brief Profile of one site
+   * @return false if the site was never seen
+   */
+  bool siteProfile(SiteId site, SiteStrideProfile &out) const noexcept;
+
+private:
+  struct SiteCounters;
+
+  const std::size_t capacity_;
+  std::unique_ptr<SiteCounters[]> sites_;
+};
+
+/**
+ * @brief Decide whether a site should be prefetched
+ * @param miss_ratio Estimated miss ratio of the site, negative if unknown
+ * @param distance Set to the prefetch distance in iterations
+ * @return true if the site is a regular stream that leaves its cache line
+ * on most accesses and misses often enough to be worth it
+ */
+bool recommendPrefetch(const SiteStrideProfile &profile,
+                       const PrefetchAdviceConfig &config, double miss_ratio,
+                       std::uint32_t &distance) noexcept;
+
+/**
+ * @brief Sites worth a software prefetch, in the format read by
+ * `optiweave --insert-prefetch`
+ */
+void writePrefetchAdvice(const StrideProfiler &strides,
+                         const ReuseSampler *reuse, const SiteRegistry &sites,
+                         const PrefetchAdviceConfig &config,
+                         const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Shared-memory layout for live telemetry
+ *
+ * The instrumented process owns a POSIX shared memory segment
+ * (/dev/shm/optiweave.<pid> by default) laid out as
+ *
+ *   [TelemetryHeader][TelemetrySite x site_capacity]
+ *   [TelemetryThread x thread_capacity]
+ *
+ * Counters are plain relaxed atomics. Metadata that a viewer must read as
+ * a unit (site names, thread ids) is guarded by a per-record seqlock: the
+ * writer makes the sequence odd, writes, then makes it even again, and a
+ * reader retries until it sees the same even value on both sides of its
+ * copy. Writers never wait for readers.
+ */
+inline constexpr std::uint64_t kTelemetryMagic = 0x314c45545754504fULL;
+inline constexpr std::uint32_t kTelemetryVersion = 1;
+
+struct alignas(64) TelemetryHeader {
+  std::atomic<std::uint64_t> magic;
+  std::uint32_t version;
+  std::uint32_t site_capacity;
+  std::uint32_t thread_capacity;
+  std::int32_t pid;
+  std::uint64_t start_time_ns;
+  std::uint64_t sites_offset;
+  std::uint64_t threads_offset;
+  std::atomic<std::uint32_t> site_count;
+  std::atomic<std::uint32_t> thread_count;
+  std::atomic<std::uint64_t> dropped_events;
+  char program[64];
+};
+
+struct alignas(64) TelemetrySite {
+  std::atomic<std::uint64_t> count;
+  std::atomic<std::uint32_t> sequence;
+  std::uint32_t line;
+  std::uint32_t column;
+  char operation[28];
+  char file[128];
+  char function[96];
+};
+
+struct alignas(64) TelemetryThread {
+  std::atomic<std::uint64_t> events;
+  std::atomic<std::uint32_t> sequence;
+  std::uint32_t active;
+  std::uint64_t os_tid;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "telemetry counters must be lock-free to live in shared memory");
+static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+              "telemetry sequences must be lock-free to live in shared memory");
+
+/**
+ * @brief Segment name used for a process id
+ */
+std::string telemetrySegmentName(int pid);
+
+/**
+ * @brief Writer side, owned by the instrumented process
+ */
+class TelemetryPublisher {
+public:
+  TelemetryPublisher() = default;
+  ~TelemetryPublisher();
+
+  TelemetryPublisher(const TelemetryPublisher &) = delete;
+  TelemetryPublisher &operator=(const TelemetryPublisher &) = delete;
+
+  /**
+   * @brief Create and map the segment
+   * @param name POSIX shm name, e.g. "/optiweave.1234"
+   * @param site_capacity Number of site records
+   * @param thread_capacity Number of thread records
+   * @param keep Leave the segment in /dev/shm after close()
+   * @return true on success
+   */
+  bool open(const std::string &name, std::uint32_t site_capacity,
+            std::uint32_t thread_capacity, bool keep = false);
+
+  /**
+   * @brief Unmap the segment, unlinking it unless asked to keep it
+   */
+  void close();
+
+  /**
+   * @brief Remove the segment name but keep the mapping
+   *
+   * Used at shutdown: threads and static destructors may still record
+   * events, so the memory must outlive the name. Attached viewers keep
+   * their own mapping and see the final counters.
+   */
+  void unlink() noexcept;
+
+  bool isOpen() const { return header_ != nullptr; }
+
+  /**
+   * @brief Publish metadata for a newly interned site
+   */
+  void publishSite(SiteId id, const SiteRecord &record) noexcept;
+
+  /**
+   * @brief Publish (or retire) a thread slot
+   */
+  void publishThread(std::uint32_t index, std::uint64_t os_tid,
+                     bool active) noexcept;
+
+  /**
+   * @brief Count one event; the only call on the hot path
+   */
+  void recordEvent(SiteId id, std::uint32_t thread) noexcept {
+    if (id < site_capacity_) {
+      sites_[id].count.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      header_->dropped_events.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (thread < thread_capacity_) {
+      // Single writer per slot: a load/store pair avoids a locked RMW
+      auto &events = threads_[thread].events;
+      events.store(events.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    }
+  }
+
+private:
+  std::string name_;
+  bool keep_ = false;
+  bool linked_ = false;
+  void *base_ = nullptr;
+  std::size_t size_ = 0;
+  TelemetryHeader *header_ = nullptr;
+  TelemetrySite *sites_ = nullptr;
+  TelemetryThread *threads_ = nullptr;
+  std::uint32_t site_capacity_ = 0;
+  std::uint32_t thread_capacity_ = 0;
+};
+
+/**
+ * @brief Consistent copy of one site record
+ */
+struct SiteSnapshot {
+  SiteId id = kInvalidSite;
+  std::uint64_t count = 0;
+  std::uint32_t line = 0;
+  std::uint32_t column = 0;
+  std::string operation;
+  std::string file;
+  std::string function;
+};
+
+/**
+ * @brief Consistent copy of one thread record
+ */
+struct ThreadSnapshot {
+  std::uint32_t index = 0;
+  std::uint64_t os_tid = 0;
+  std::uint64_t events = 0;
+  bool active = false;
+};
+
+/**
+ * @brief Consistent copy of a whole segment
+ */
+struct TelemetrySnapshot {
+  int pid = 0;
+  std::string program;
+  std::uint64_t start_time_ns = 0;
+  std::uint64_t taken_at_ns = 0;
+  std::uint64_t dropped_events = 0;
+  std::vector<SiteSnapshot> sites;
+  std::vector<ThreadSnapshot> threads;
+};
+
+/**
+ * @brief Read-only viewer side
+ */
+class TelemetryReader {
+public:
+  TelemetryReader() = default;
+  ~TelemetryReader();
+
+  TelemetryReader(const TelemetryReader &) = delete;
+  TelemetryReader &operator=(const TelemetryReader &) = delete;
+
+  /**
+   * @brief Map an existing segment read-only
+   * @param name POSIX shm name
+   * @param error Filled with a message on failure
+   * @return true on success
+   */
+  bool attach(const std::string &name, std::string &error);
+
+  void detach();
+
+  /**
+   * @brief Copy all published records
+   */
+  TelemetrySnapshot snapshot() const;
+
+private:
+  const void *base_ = nullptr;
+  std::size_t size_ = 0;
+  const TelemetryHeader *header_ = nullptr;
+};
+
+/**
+ * @brief Names of telemetry segments currently present in /dev/shm
+ */
+std::vector<std::string> listTelemetrySegments();
+
+} // namespace optiweave::runtime
@@ -0,0 +1,190 @@
+#pragma once
+
+#include "optiweave/runtime/abi.hpp"
+#include "optiweave/runtime/heap_tracker.hpp"
+#include "optiweave/runtime/stride_profiler.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace optiweave::runtime {
+
+class CallTree;
+class EventRing;
+struct TraversalCursor;
+struct ValueSketch;
+
+/**
+ * @brief Increment a counter that only its owning thread writes
+ *
+ * A relaxed load/store pair instead of fetch_add keeps the instruction
+ * unlocked while still letting other threads read a torn-free value.
+ */
+inline void bumpOwned(std::atomic<std::uint64_t> &counter,
+                      std::uint64_t amount = 1) noexcept {
+  counter.store(counter.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+/**
+ * @brief One thread's state for every site, in blocks allocated as the
+ * thread first reaches them
+ *
+ * A thread pays for the sites it executes rather than for the registry's
+ * capacity. Only the owner allocates blocks and writes entries; shutdown
+ * reads them after an acquire load of the block.
+ */
+template <typename Entry> struct SiteBlocks {
+  static constexpr std::size_t kBlockSites = std::size_t{1}
+                                             << __OPTIWEAVE_SITE_BLOCK_SHIFT;
+
+  struct Block {
+    Entry sites[kBlockSites];
+  };
+
+  std::atomic<Block *> blocks[__OPTIWEAVE_SITE_BLOCKS] = {};
+
+  /**
+   * @brief The owner's block holding a site, allocated on first use
+   * @return The block's first entry, or nullptr if allocation failed
+   */
+  Entry *block(std::uint32_t id) noexcept {
+    auto &slot = blocks[id >> __OPTIWEAVE_SITE_BLOCK_SHIFT];
+    Block *found = slot.load(std::memory_order_relaxed);
+    if (!found) {
+      found = new (std::nothrow) Block();
+      if (!found) {
+        return nullptr;
+      }
+      slot.store(found, std::memory_order_release);
+    }
+    return found->sites;
+  }
+
+  /**
+   * @brief Visit every allocated entry with its site id
+   */
+  template <typename Visit> void forEach(Visit visit) const {
+    for (std::size_t b = 0; b < __OPTIWEAVE_SITE_BLOCKS; ++b) {
+      const Block *found = blocks[b].load(std::memory_order_acquire);
+      for (std::size_t k = 0; found && k < kBlockSites; ++k) {
+        visit(static_cast<std::uint32_t>(b * kBlockSites + k),
+              found->sites[k]);
+      }
+    }
+  }
+};
+
+/// Comparison outcomes per site, [false, true]
+using BranchCounters = SiteBlocks<std::atomic<std::uint64_t>[2]>;
+
+/// Receiver types of virtual calls per site
+using ReceiverCaches = SiteBlocks<__optiweave_receiver_cache>;
+
+/// Calls on unordered containers per site
+using HashCounters = SiteBlocks<__optiweave_hash_counts>;
+
+/**
+ * @brief Per-thread runtime state
+ *
+ * Each record is owned by exactly one live thread, so everything except
+ * the in_use flag is written without atomics by its owner. Records are
+ * cache-line aligned to keep neighbouring threads from sharing lines.
+ */
+struct alignas(64) ThreadRecord {
+  std::atomic<bool> in_use{false};
+  std::uint32_t index = 0;
+  std::uint64_t os_tid = 0;
+
+  // Trace buffering; the ring belongs to the slot and outlives its threads
+  std::atomic<EventRing *> ring{nullptr};
+  std::uint32_t sample_counter = 0;
+  std::atomic<std::uint64_t> trace_dropped{0};
+  std::atomic<std::uint64_t> trace_sampled_out{0};
+  std::atomic<std::uint64_t> trace_waits{0};
+
+  // Heap attribution of subscript accesses
+  std::atomic<std::uint64_t> heap_attributed{0};
+  std::atomic<std::uint64_t> heap_unattributed{0};
+
+  // Heap bounds checking: allocation of the last checked pointer
+  HeapAllocation bounds_cache;
+  std::atomic<std::uint64_t> bounds_checked{0};
+  std::atomic<std::uint64_t> bounds_unchecked{0};
+
+  // Stride detection, allocated on first use and kept with the slot
+  StrideCursor *stride_cursors = nullptr;
+
+  // Operand value profiling, allocated on first use and kept with the slot
+  ValueSketch *value_sketches = nullptr;
+
+  // Comparison outcomes, virtual call receivers and hash container calls per
+  // site, written by the prelude; allocated on first use, kept with the
+  // slot, read at shutdown
+  std::atomic<BranchCounters *> branch_counters{nullptr};
+  std::atomic<ReceiverCaches *> receiver_caches{nullptr};
+  std::atomic<HashCounters *> hash_counters{nullptr};
+
+  // Traversal order of fused subscripts, allocated on first use
+  TraversalCursor *traversal_cursors = nullptr;
+
+  // Shadow call stack of probed functions, allocated on first use
+  CallTree *call_tree = nullptr;
+
+  // Alternate signal stack for crash handlers, kept with the slot
+  void *alt_stack = nullptr;
+  bool alt_stack_active = false;
+};
+
+/**
+ * @brief Fixed-capacity registry of threads producing events
+ *
+ * Slots are claimed with a CAS and released on thread exit, so a process
+ * with thread churn keeps reusing the same small set of indices.
+ */
+class ThreadRegistry {
+public:
+  static constexpr std::size_t kMaxThreads = 256;
+
+  ThreadRegistry();
+
+  ThreadRegistry(const ThreadRegistry &) = delete;
+  ThreadRegistry &operator=(const ThreadRegistry &) = delete;
+
+  /**
+   * @brief Claim a slot for the calling thread
+   * @return The claimed record, or nullptr if all slots are taken
+   */
+  ThreadRecord *acquire() noexcept;
+
+  /**
+   * @brief Return a slot claimed by acquire()
+   */
+  void release(ThreadRecord *record) noexcept;
+
+  /**
+   * @brief One past the highest slot index ever claimed
+   */
+  std::size_t highWater() const noexcept {
+    return high_water_.load(std::memory_order_acquire);
+  }
+
+  ThreadRecord &at(std::size_t index) noexcept { return records_[index]; }
+  const ThreadRecord &at(std::size_t index) const noexcept {
+    return records_[index];
+  }
+
+private:
+  std::array<ThreadRecord, kMaxThreads> records_;
+  std::atomic<std::uint32_t> high_water_{0};
+};
+
+/**
+ * @brief Kernel thread id of the calling thread
+ */
+std::uint64_t currentOsThreadId() noexcept;
+
+} // namespace optiweave::runtime
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Fixed-size binary trace record
+ *
+ * address is the effective address of the access (base + index * element
+ * size); for operations it is zero. thread is the runtime thread slot, which
+ * is unique among live threads.
+ */
+struct TraceEvent {
+  std::uint64_t timestamp_ns;
+  std::uint64_t address;
+  std::uint64_t index;
+  std::uint32_t site;
+  std::uint32_t thread;
+};
+
+static_assert(sizeof(TraceEvent) == 32, "trace format expects 32-byte events");
+
+/**
+ * @brief Single-producer/single-consumer ring of trace events
+ *
+ * The owning thread pushes, the trace writer drains. Storage comes from
+ * mmap rather than the heap so rings can be created while malloc is being
+ * interposed. The producer caches the consumer position and only re-reads
+ * it when the ring looks full, keeping the common push to one shared store.
+ */
+class EventRing {
+public:
+  /**
+   * @brief Allocate a ring
+   * @param capacity Number of events, rounded up to a power of two
+   * @return The ring, or nullptr if the mapping failed
+   */
+  static EventRing *create(std::size_t capacity) noexcept;
+
+  EventRing(const EventRing &) = delete;
+  EventRing &operator=(const EventRing &) = delete;
+
+  bool tryPush(const TraceEvent &event) noexcept {
+    std::uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ >= capacity_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head - cached_tail_ >= capacity_) {
+        return false;
+      }
+    }
+    slots_[head & mask_] = event;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Events currently buffered (approximate from either side)
+   */
+  std::size_t size() const noexcept {
+    return static_cast<std::size_t>(head_.load(std::memory_order_acquire) -
+                                    tail_.load(std::memory_order_acquire));
+  }
+
+  std::size_t capacity() const noexcept { return capacity_; }
+
+  /**
+   * @brief Move up to max events into out; consumer side only
+   * @return Number of events copied
+   */
+  std::size_t drain(TraceEvent *out, std::size_t max) noexcept;
+
+  /**
+   * @brief Unconsumed events as at most two contiguous spans, without
+   * consuming them. Safe to call from a signal handler.
+   */
+  void peek(const TraceEvent *&first, std::size_t &first_count,
+            const TraceEvent *&second, std::size_t &second_count) const
+      noexcept;
+
+private:
+  EventRing(TraceEvent *slots, std::size_t capacity);
+
+  TraceEvent *slots_;
+  std::size_t capacity_;
+  std::size_t mask_;
+  alignas(64) std::atomic<std::uint64_t> head_{0};
+  std::uint64_t cached_tail_ = 0;
+  alignas(64) std::atomic<std::uint64_t> tail_{0};
+};
+
+} // namespace optiweave::runtime
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <sys/types.h>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Asynchronous block writer used by the trace writer
+ *
+ * The trace writer owns a fixed set of buffers identified by a small index.
+ * submit() queues a positional write of one buffer and returns immediately;
+ * wait() blocks until that buffer may be reused. Backends complete short
+ * writes themselves, so a finished wait means the whole buffer is on its
+ * way to disk.
+ */
+class TraceIo {
+public:
+  static constexpr unsigned kMaxBuffers = 4;
+
+  virtual ~TraceIo() = default;
+
+  /**
+   * @brief Queue a write of buffer `slot`
+   * @return false if the write could not even be queued
+   */
+  virtual bool submit(unsigned slot, int fd, const void *data,
+                      std::size_t bytes, off_t offset) = 0;
+
+  /**
+   * @brief Wait for the write of buffer `slot` to finish
+   * @return false if that write failed
+   */
+  virtual bool wait(unsigned slot) = 0;
+
+  /**
+   * @brief Wait for every queued write
+   * @return false if any of them failed
+   */
+  virtual bool waitAll() = 0;
+
+  virtual const char *name() const = 0;
+
+  /**
+   * @brief Create the best available backend
+   * @param prefer_uring Try io_uring first when built with liburing; false
+   *                     always selects pwrite
+   */
+  static std::unique_ptr<TraceIo> create(bool prefer_uring);
+};
+
+} // namespace optiweave::runtime
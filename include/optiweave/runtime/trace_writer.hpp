@@ -0,0 +1,262 @@
+#pragma once
+
+#include "optiweave/runtime/trace_event.hpp"
+#include "optiweave/runtime/trace_io.hpp"
+#include "optiweave/runtime/thread_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief What a producer does when its ring is full
+ */
+enum class BackpressurePolicy {
+  Drop,   ///< Discard the event
+  Sample, ///< Once the ring is past its high-water mark keep 1 in N events
+  Block   ///< Spin (yielding) until the writer frees space
+};
+
+/**
+ * @brief Parse "drop", "sample" or "block"
+ * @return false if the name is not recognised
+ */
+bool parseBackpressurePolicy(const std::string &name,
+                             BackpressurePolicy &policy);
+
+const char *backpressurePolicyName(BackpressurePolicy policy);
+
+/**
+ * @brief Trace writer tuning
+ */
+struct TraceWriterConfig {
+  std::string directory = ".";
+  std::size_t block_bytes = 4u << 20;
+  std::size_t ring_events = 1u << 16;
+  std::uint64_t segment_bytes = 256ull << 20;
+  std::uint64_t disk_budget_bytes = 2048ull << 20;
+  BackpressurePolicy backpressure = BackpressurePolicy::Drop;
+  std::uint32_t sample_rate = 16;
+  unsigned flush_interval_ms = 50;
+  bool direct_io = false;
+  bool prefer_uring = true;
+  bool crash_flush = false; ///< Preopen a file for flushForCrash()
+};
+
+/**
+ * @brief On-disk segment format
+ *
+ * A segment starts with a 4 KiB file header followed by blocks. Every
+ * block starts with a TraceBlockHeader and is padded to a multiple of
+ * 4 KiB so that each write is aligned in offset and length, which keeps
+ * O_DIRECT usable and lets the kernel skip read-modify-write cycles.
+ */
+inline constexpr std::uint64_t kTraceFileMagic = 0x3145434152545750ULL;
+inline constexpr std::uint64_t kTraceBlockMagic = 0x4b4c424543525457ULL;
+inline constexpr std::uint32_t kTraceFormatVersion = 1;
+inline constexpr std::size_t kTraceAlignment = 4096;
+inline constexpr std::uint32_t kCrashSegmentIndex = 0xffffffffu;
+
+struct TraceFileHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t event_size;
+  std::int32_t pid;
+  std::uint32_t segment_index;
+  std::uint64_t start_time_ns;
+};
+
+struct alignas(64) TraceBlockHeader {
+  std::uint64_t magic;
+  std::uint32_t event_count;
+  std::uint32_t block_bytes;
+  std::uint64_t first_timestamp_ns;
+  std::uint64_t last_timestamp_ns;
+};
+
+/**
+ * @brief Counters reported at shutdown
+ */
+struct TraceWriterStats {
+  std::uint64_t events_written = 0;
+  std::uint64_t events_dropped = 0;
+  std::uint64_t events_sampled_out = 0;
+  std::uint64_t producer_waits = 0;
+  std::uint64_t blocks_written = 0;
+  std::uint64_t bytes_written = 0;
+  std::uint64_t segments_opened = 0;
+  std::uint64_t segments_deleted = 0;
+  std::uint64_t write_errors = 0;
+};
+
+/**
+ * @brief Background writer draining per-thread rings into large blocks
+ *
+ * Producers only touch their own ring. A single writer thread moves events
+ * into one of two block buffers; when a block fills (or the flush interval
+ * expires) it is handed to the I/O backend and the writer continues into
+ * the other buffer, so draining and disk writes overlap. Segments rotate
+ * at segment_bytes and the oldest are deleted to keep the directory within
+ * disk_budget_bytes.
+ */
+class TraceWriter {
+public:
+  TraceWriter(ThreadRegistry &threads, TraceWriterConfig config);
+  ~TraceWriter();
+
+  TraceWriter(const TraceWriter &) = delete;
+  TraceWriter &operator=(const TraceWriter &) = delete;
+
+  /**
+   * @brief Open the first segment and start the writer thread
+   * @return false if the trace directory is unusable
+   */
+  bool start();
+
+  /**
+   * @brief Drain everything, write the last block and join; idempotent
+   */
+  void stop();
+
+  /**
+   * @brief Write every buffered event to the crash file
+   *
+   * Called from a signal handler: uses only write(2) on the descriptor
+   * opened by start(), never allocates and never waits for the writer
+   * thread. Covers the block being written, the block being filled and
+   * all per-thread rings, so the crash file may repeat the last block of
+   * the live segment. Does nothing unless config().crash_flush is set.
+   */
+  void flushForCrash() noexcept;
+
+  /**
+   * @brief Path of trace.<pid>.crash.owt; removed by stop() if unused
+   */
+  const std::string &crashPath() const { return crash_path_; }
+
+  /**
+   * @brief Append an event from the thread owning `thread`
+   */
+  void append(ThreadRecord &thread, const TraceEvent &event) noexcept {
+    EventRing *ring = thread.ring.load(std::memory_order_relaxed);
+    if (!ring && !(ring = attachRing(thread))) {
+      bumpOwned(thread.trace_dropped);
+      return;
+    }
+
+    switch (config_.backpressure) {
+    case BackpressurePolicy::Drop:
+      break;
+    case BackpressurePolicy::Sample:
+      if (ring->size() >= sample_threshold_ &&
+          ++thread.sample_counter % config_.sample_rate != 0) {
+        bumpOwned(thread.trace_sampled_out);
+        return;
+      }
+      break;
+    case BackpressurePolicy::Block:
+      if (!ring->tryPush(event)) {
+        waitForSpace(thread, *ring, event);
+      }
+      return;
+    }
+
+    if (!ring->tryPush(event)) {
+      bumpOwned(thread.trace_dropped);
+    }
+  }
+
+  const TraceWriterConfig &config() const { return config_; }
+  const char *ioBackendName() const;
+
+  /**
+   * @brief Snapshot of the counters; exact once stop() returned
+   */
+  TraceWriterStats stats() const;
+
+  /**
+   * @brief Paths of the segments still on disk, oldest first; only valid
+   * before start() or after stop()
+   */
+  std::vector<std::string> segments() const;
+
+private:
+  struct Block {
+    char *data = nullptr;
+    std::atomic<std::size_t> events{0}; // also read by flushForCrash()
+  };
+
+  struct Segment {
+    std::string path;
+    std::uint64_t bytes = 0;
+  };
+
+  EventRing *attachRing(ThreadRecord &thread) noexcept;
+  void waitForSpace(ThreadRecord &thread, EventRing &ring,
+                    const TraceEvent &event) noexcept;
+
+  void run();
+  std::size_t drainRings();
+  bool flushBlock();
+  bool openSegment();
+  bool openCrashFile();
+  void closeSegment();
+  void enforceBudget(std::uint64_t incoming_bytes);
+
+  TraceEvent *blockEvents(Block &block) const;
+
+  ThreadRegistry &threads_;
+  TraceWriterConfig config_;
+  std::size_t events_per_block_ = 0;
+  std::size_t sample_threshold_ = 0;
+  std::unique_ptr<TraceIo> io_;
+
+  Block blocks_[2];
+  std::atomic<unsigned> active_block_{0};
+  std::atomic<int> inflight_block_{-1};
+  std::uint64_t block_started_ns_ = 0;
+
+  int fd_ = -1;
+  std::uint64_t file_offset_ = 0;
+  std::uint32_t segment_index_ = 0;
+  std::deque<Segment> closed_segments_;
+  std::uint64_t closed_bytes_ = 0;
+  std::string current_path_;
+
+  int crash_fd_ = -1;
+  char *crash_header_ = nullptr;
+  std::string crash_path_;
+  std::atomic<bool> crash_flushed_{false};
+
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  std::atomic<bool> stopping_{false};
+  bool stopped_ = false;
+
+  std::atomic<std::uint64_t> events_written_{0};
+  std::atomic<std::uint64_t> blocks_written_{0};
+  std::atomic<std::uint64_t> bytes_written_{0};
+  std::atomic<std::uint64_t> segments_opened_{0};
+  std::atomic<std::uint64_t> segments_deleted_{0};
+  std::atomic<std::uint64_t> write_errors_{0};
+  std::atomic<std::uint64_t> budget_dropped_{0};
+};
+
+/**
+ * @brief Read every event of one segment file
+ * @param path Segment path
+ * @param events Receives the events in file order
+ * @param error Filled with a message on failure
+ * @return true on success
+ */
+bool readTraceSegment(const std::string &path, std::vector<TraceEvent> &events,
+                      std::string &error);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Last indices one thread used at one fused subscript site
+ */
+struct TraversalCursor {
+  static constexpr std::uint32_t kMaxRank = 8;
+
+  SiteId site = kInvalidSite;
+  std::size_t last[kMaxRank] = {};
+};
+
+/**
+ * @brief Which dimension of a multi-dimensional subscript moves fastest
+ */
+struct SiteTraversalProfile {
+  std::uint64_t accesses = 0;
+  std::uint32_t rank = 0;
+  std::size_t element_size = 0;
+  std::size_t extents[TraversalCursor::kMaxRank] = {}; ///< 0 if unknown
+  /// Steps between consecutive accesses whose innermost changed index was
+  /// in this dimension
+  std::uint64_t innermost_changed[TraversalCursor::kMaxRank] = {};
+
+  /**
+   * @brief Dimension that most steps move along, or rank if none moved
+   */
+  std::uint32_t fastestDimension() const noexcept;
+
+  /**
+   * @brief Bytes between neighbours along a dimension of the row-major
+   * layout, or 0 if an inner extent is unknown
+   */
+  std::size_t dimensionStride(std::uint32_t dimension) const noexcept;
+};
+
+/**
+ * @brief Traversal order of fused multi-dimensional subscripts
+ *
+ * For each step between two accesses of a site by the same thread, the
+ * innermost dimension whose index changed is counted. A row-major walk
+ * changes the last index on almost every step; a column walk over a
+ * row-major array changes the first. Cursors are per thread and
+ * direct-mapped by site id; the totals are relaxed atomics.
+ */
+class TraversalProfiler {
+public:
+  static constexpr std::size_t kCursors = 64;
+
+  explicit TraversalProfiler(
+      std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~TraversalProfiler();
+
+  TraversalProfiler(const TraversalProfiler &) = delete;
+  TraversalProfiler &operator=(const TraversalProfiler &) = delete;
+
+  /**
+   * @brief Account one access
+   * @param cursors The calling thread's kCursors cursors
+   * @param rank Number of indices; dimensions past kMaxRank are ignored
+   */
+  void access(TraversalCursor *cursors, SiteId site, std::uint32_t rank,
+              const std::size_t *indices, const std::size_t *extents,
+              std::size_t element_size) noexcept;
+
+  /**
+   * @brief Profile of one site
+   * @return false if the site was never seen
+   */
+  bool siteProfile(SiteId site, SiteTraversalProfile &out) const noexcept;
+
+private:
+  struct SiteCounters;
+
+  const std::size_t capacity_;
+  std::unique_ptr<SiteCounters[]> sites_;
+};
+
+/**
+ * @brief Dimension each fused subscript site walks along, flagging walks
+ * that do not follow the row-major layout
+ */
+void writeTraversalReport(const TraversalProfiler &traversal,
+                          const SiteRegistry &sites, const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief Trip counts of one loop over all of its executions
+ */
+struct LoopTripProfile {
+  /// Bucket 0 holds zero-trip executions, bucket b > 0 holds [2^(b-1), 2^b)
+  static constexpr std::size_t kBuckets = 24;
+
+  std::uint64_t executions = 0;
+  std::uint64_t trips = 0;
+  std::uint64_t min_trips = 0;
+  std::uint64_t max_trips = 0;
+  std::uint64_t buckets[kBuckets] = {};
+
+  double meanTrips() const noexcept;
+
+  /**
+   * @brief Upper bound of the trip count below which a share of the
+   * executions fall, at bucket resolution
+   */
+  std::uint64_t percentileTrips(double share) const noexcept;
+
+  static std::size_t bucketOf(std::uint64_t trips) noexcept;
+};
+
+/**
+ * @brief What a loop's trip counts suggest doing with it
+ */
+enum class LoopAdvice {
+  TooShort,  ///< Typically under 4 trips: loop overhead dominates, leave it
+  Unroll,    ///< Short or constant: unroll (fully if constant)
+  Vectorize, ///< Long enough to amortize a vector prologue and epilogue
+  Tile,      ///< Thousands of trips: candidate for cache tiling
+};
+
+/**
+ * @brief Classify a loop by its median trip count
+ */
+LoopAdvice classifyLoop(const LoopTripProfile &profile) noexcept;
+
+const char *loopAdviceName(LoopAdvice advice) noexcept;
+
+/**
+ * @brief Per-loop trip-count histograms
+ *
+ * Instrumented loops count their iterations in a local of the prelude's
+ * LoopTripCounter and report once when the loop is left, so the totals are
+ * touched once per loop execution rather than once per iteration.
+ */
+class TripProfiler {
+public:
+  explicit TripProfiler(std::size_t site_capacity = SiteRegistry::kCapacity);
+  ~TripProfiler();
+
+  TripProfiler(const TripProfiler &) = delete;
+  TripProfiler &operator=(const TripProfiler &) = delete;
+
+  /**
+   * @brief Account one execution of a loop
+   */
+  void record(SiteId site, std::uint64_t trips) noexcept;
+
+  /**
+   * @brief Profile of one loop
+   * @return false if the loop never finished an execution
+   */
+  bool siteProfile(SiteId site, LoopTripProfile &out) const noexcept;
+
+private:
+  struct SiteCounters;
+
+  const std::size_t capacity_;
+  std::unique_ptr<SiteCounters[]> sites_;
+};
+
+/**
+ * @brief Trip-count histogram of each instrumented loop and what it
+ * suggests
+ */
+void writeLoopReport(const TripProfiler &trips, const SiteRegistry &sites,
+                     const std::string &path);
+
+} // namespace optiweave::runtime
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "optiweave/runtime/site_registry.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace optiweave::runtime {
+
+/**
+ * @brief One tracked value with its (over-)estimated count
+ */
+struct ValueCount {
+  std::int64_t value = 0;
+  std::uint64_t count = 0;
+  std::uint64_t error = 0; ///< count may exceed the true count by this much
+};
+
+/**
+ * @brief Most frequent operand values of one site
+ */
+struct SiteValueProfile {
+  std::uint64_t total = 0;
+  std::vector<ValueCount> top; ///< Descending by count
+
+  /**
+   * @brief Share of the evaluations guaranteed to use the top value
+   */
+  double topShare() const noexcept;
+
+  /**
+   * @brief Share of the evaluations guaranteed to use one of the tracked
+   * values for which `predicate` holds
+   */
+  template <typename Predicate>
+  double shareWhere(Predicate &&predicate) const noexcept {
+    std::uint64_t matching = 0;
+    for (const ValueCount &entry : top) {
+      if (predicate(entry.value)) {
+        matching += entry.count - entry.error;
+      }
+    }
+    return total ? static_cast<double>(matching) / total : 0.0;
+  }
+};
+
+/**
+ * @brief Space-saving sketch of the values seen at one site by one thread
+ *
+ * Keeps kCounters (value, count) pairs. A value that is not tracked takes
+ * over the smallest counter and inherits its count as error, so any value
+ * making up more than 1/kCounters of the evaluations is guaranteed to be
+ * tracked. Only the owning thread writes; fields are relaxed atomics so the
+ * report can read a sketch while its thread is still running, at the cost
+ * of occasionally pairing a value with the count of its predecessor.
+ */
+struct ValueSketch {
+  static constexpr std::size_t kCounters = 8;
+
+  std::atomic<SiteId> site{kInvalidSite};
+  std::atomic<std::uint64_t> total{0};
+  std::atomic<std::int64_t> values[kCounters] = {};
+  std::atomic<std::uint64_t> counts[kCounters] = {};
+  std::atomic<std::uint64_t> errors[kCounters] = {};
+
+  void add(std::int64_t value) noexcept;
+  void reset(SiteId owner) noexcept;
+};
+
+/**
+ * @brief Value profiling for operands such as divisors
+ *
+ * Each thread owns a direct-mapped table of kSketches sketches indexed by
+ * site id, so the hot path touches no shared memory. When a site takes a
+ * slot from another one, the evicted sketch is folded into a per-site
+ * summary under a mutex; at the end the live tables are folded in as well.
+ */
+class ValueProfiler {
+public:
+  static constexpr std::size_t kSketches = 64;
+
+  ValueProfiler() = default;
+
+  ValueProfiler(const ValueProfiler &) = delete;
+  ValueProfiler &operator=(const ValueProfiler &) = delete;
+
+  /**
+   * @brief Account one evaluation
+   * @param sketches The calling thread's kSketches sketches
+   */
+  void record(ValueSketch *sketches, SiteId site, std::int64_t value) noexcept;
+
+  /**
+   * @brief Fold a thread's table into the summaries; call once per table
+   */
+  void collect(const ValueSketch *sketches);
+
+  /**
+   * @brief Sites with at least one collected evaluation
+   */
+  std::vector<SiteId> sites() const;
+
+  /**
+   * @brief Collected profile of one site
+   * @return false if the site has none
+   */
+  bool siteProfile(SiteId site, SiteValueProfile &out) const;
+
+private:
+  void merge(const ValueSketch &sketch);
+
+  mutable std::mutex mutex_;
+  std::unordered_map<SiteId, SiteValueProfile> summaries_;
+};
+
+/**
+ * @brief What a site's divisors allow the division to be specialized into
+ */
+enum class DivisorPattern {
+  Varied,     ///< Nothing to specialize
+  FewValues,  ///< A handful of values cover the site: switch on them
+  PowerOfTwo, ///< Always a power of two: shift and mask
+  Constant,   ///< One value: compare once, divide by a constant
+};
+
+/**
+ * @brief Classify a divisor profile
+ * @param min_share Share of the evaluations a pattern has to cover
+ */
+DivisorPattern classifyDivisors(const SiteValueProfile &profile,
+                                double min_share = 0.99) noexcept;
+
+const char *divisorPatternName(DivisorPattern pattern) noexcept;
+
+/**
+ * @brief Divisors seen at each `/` and `%` site and the specialization
+ * they allow
+ */
+void writeDivisorReport(const ValueProfiler &values, const SiteRegistry &sites,
+                        const std::string &path);
+
+} // namespace optiweave::runtime
@@ -1,73 +1,156 @@
 #include "../../include/optiweave/core/ast_visitor.hpp"
+#include <clang/AST/Attr.h>
 #include <clang/AST/ParentMapContext.h>
+#include <clang/AST/TypeLoc.h>
 #include <clang/Basic/SourceManager.h>
 #include <clang/Lex/Lexer.h>
+#include <llvm/ADT/StringSwitch.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include <algorithm>
 #include <sstream>
 
 namespace optiweave::core {
 namespace {
 /**
-    @brief Get the string representation of a binary operator
+    @brief Name of the prelude wrapper suffix for a binary operator, as in
+    __primop_<name>; operator spellings are not valid identifiers
 */
-const char *getBinaryOperatorSpelling(clang::BinaryOperatorKind op) {
+const char *getBinaryOperatorName(clang::BinaryOperatorKind op) {
   switch (op) {
   case clang::BO_Add:
-    return "+";
+    return "add";
   case clang::BO_Sub:
-    return "-";
+    return "sub";
   case clang::BO_Mul:
-    return "*";
+    return "mul";
   case clang::BO_Div:
-    return "/";
+    return "div";
   case clang::BO_Rem:
-    return "%";
+    return "mod";
   case clang::BO_Assign:
-    return "=";
+    return "assign";
   case clang::BO_AddAssign:
-    return "+=";
+    return "add_assign";
   case clang::BO_SubAssign:
-    return "-=";
+    return "sub_assign";
   case clang::BO_MulAssign:
-    return "*=";
+    return "mul_assign";
   case clang::BO_DivAssign:
-    return "/=";
+    return "div_assign";
   case clang::BO_RemAssign:
-    return "%=";
+    return "mod_assign";
   case clang::BO_EQ:
-    return "==";
+    return "eq";
   case clang::BO_NE:
-    return "!=";
+    return "ne";
   case clang::BO_LT:
-    return "<";
+    return "lt";
   case clang::BO_GT:
-    return ">";
+    return "gt";
   case clang::BO_LE:
-    return "<=";
+    return "le";
   case clang::BO_GE:
-    return ">=";
+    return "ge";
   default:
     return "unknown";
   }
 }
+
+/**
+    @brief Looks for a reference to a variable after a given location
+*/
+class LaterUseFinder : public clang::RecursiveASTVisitor<LaterUseFinder> {
+public:
+  LaterUseFinder(const clang::VarDecl *var, clang::SourceLocation after,
+                 const clang::SourceManager &source_manager)
+      : var_(var), after_(after), source_manager_(source_manager) {}
+
+  bool VisitDeclRefExpr(clang::DeclRefExpr *ref) {
+    if (ref->getDecl() == var_ &&
+        source_manager_.isBeforeInTranslationUnit(after_,
+                                                  ref->getBeginLoc())) {
+      found = true;
+      return false;
+    }
+    return true;
+  }
+
+  bool found = false;
+
+private:
+  const clang::VarDecl *var_;
+  clang::SourceLocation after_;
+  const clang::SourceManager &source_manager_;
+};
+
+/**
+    @brief Collects the definitions of polymorphic classes, instantiations
+    included
+*/
+class PolymorphicClassCollector
+    : public clang::RecursiveASTVisitor<PolymorphicClassCollector> {
+public:
+  explicit PolymorphicClassCollector(
+      std::vector<const clang::CXXRecordDecl *> &classes)
+      : classes_(classes) {}
+
+  bool shouldVisitTemplateInstantiations() const { return true; }
+
+  bool VisitCXXRecordDecl(clang::CXXRecordDecl *record) {
+    if (record->isThisDeclarationADefinition() &&
+        !record->isDependentType() && record->isPolymorphic()) {
+      classes_.push_back(record);
+    }
+    return true;
+  }
+
+private:
+  std::vector<const clang::CXXRecordDecl *> &classes_;
+};
 } // namespace
 
 void TransformationStats::print(llvm::raw_ostream &os) const {
   os << "Transformation Statistics:\n";
   os << "  Array subscripts transformed: " << array_subscripts_transformed
      << "\n";
+  os << "  Subscript chains fused: " << subscript_chains_fused << "\n";
+  os << "  Container subscripts transformed: "
+     << container_subscripts_transformed << "\n";
   os << "  Arithmetic operators transformed: " << arithmetic_ops_transformed
      << "\n";
   os << "  Template instantiations skipped: "
      << template_instantiations_skipped << "\n";
+  os << "  Prefetches inserted: " << prefetches_inserted << "\n";
+  os << "  Branches annotated: " << branches_annotated << "\n";
+  os << "  Loops instrumented: " << loops_instrumented << "\n";
+  os << "  Functions probed: " << functions_probed << "\n";
+  os << "  Allocations instrumented: " << allocations_instrumented << "\n";
+  os << "  Growth calls instrumented: " << growth_calls_instrumented << "\n";
+  os << "  Reserves inserted: " << reserves_inserted << "\n";
+  os << "  Copies instrumented: " << copies_instrumented << "\n";
+  os << "  Virtual calls instrumented: " << virtual_calls_instrumented
+     << "\n";
+  os << "  Virtual calls guarded: " << virtual_calls_guarded << "\n";
+  os << "  Hash lookups instrumented: " << hash_lookups_instrumented << "\n";
   os << "  Errors encountered: " << errors_encountered << "\n";
 }
 
 ModernASTVisitor::ModernASTVisitor(clang::Rewriter &rewriter,
                                    clang::ASTContext &context,
                                    const TransformationConfig &config)
-    : rewriter_(rewriter), context_(context), config_(config) {}
+    : rewriter_(rewriter), context_(context), config_(config),
+      processed_ranges_(
+          AccountingAllocator<SourceRangeKey>(processed_ranges_memory_)),
+      polymorphic_classes_(ClassIndex::allocator_type(class_index_memory_)),
+      growth_tracked_(AccountingAllocator<const clang::VarDecl *>(
+          tracked_containers_memory_)),
+      reserved_(AccountingAllocator<const clang::VarDecl *>(
+          tracked_containers_memory_)) {
+  if (!config_.probe_filter.empty()) {
+    probe_filter_ = std::make_unique<llvm::Regex>(config_.probe_filter);
+  }
+}
 
 bool ModernASTVisitor::VisitArraySubscriptExpr(clang::ArraySubscriptExpr *
                                                expr) {
@@ -80,12 +163,35 @@ bool ModernASTVisitor::VisitArraySubscriptExpr(clang::ArraySubscriptExpr *
   }
 
   if (config_.transform_array_subscripts) {
-    if (transformArraySubscript(expr)) {
+    if (isFusedIntoParent(expr)) {
+      return true; // instrumented with the outermost subscript of the chain
+    }
+    std::vector<const clang::Expr *> indices;
+    if (const clang::Expr *root = collectSubscriptChain(expr, indices)) {
+      if (transformSubscriptChain(expr, root, indices)) {
+        markAsProcessed(expr);
+        ++stats_.subscript_chains_fused;
+      } else {
+        ++stats_.errors_encountered;
+      }
+    } else if (transformArraySubscript(expr)) {
       markAsProcessed(expr);
       ++stats_.array_subscripts_transformed;
     } else {
       ++stats_.errors_encountered;
     }
+  } else if (const PrefetchAdvice *advice = findPrefetchAdvice(expr)) {
+    // Prefetch insertion on its own, for optimizing the original source
+    std::string lhs_text = getSourceText(expr->getLHS()->getSourceRange());
+    std::string rhs_text = getSourceText(expr->getRHS()->getSourceRange());
+    std::string access_text = getOperandText(expr);
+    std::string replacement =
+        generatePrefetch(expr, *advice, lhs_text, rhs_text, access_text);
+    if (!replacement.empty() &&
+        !rewriter_.ReplaceText(expr->getSourceRange(), replacement)) {
+      markAsProcessed(expr);
+      ++stats_.prefetches_inserted;
+    }
   }
   return true;
 }
@@ -107,7 +213,7 @@ bool ModernASTVisitor::VisitBinaryOperator(clang::BinaryOperator *expr) {
              config_.transform_assignment_operators) {
     should_transform = true;
   } else if (expr->isComparisonOp() &&
-             config_.transform_comparisons_operators) {
+             config_.transform_comparison_operators) {
     should_transform = true;
   }
 
@@ -120,18 +226,751 @@ bool ModernASTVisitor::VisitBinaryOperator(clang::BinaryOperator *expr) {
     }
   }
 
-  return true;
+  return true;
+}
+
+bool ModernASTVisitor::VisitUnaryOperator(clang::UnaryOperator *expr) {
+  if (expr->isIncrementDecrementOp()) {
+    instrumentLoopIncrement(expr);
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitCXXOperatorCallExpr(clang::CXXOperatorCallExpr *
+                                                expr) {
+  if (expr->getOperator() == clang::OO_Equal) {
+    instrumentCopyAssignment(expr);
+    return true;
+  }
+
+  // Iterator increments of for loops
+  if (expr->getOperator() == clang::OO_PlusPlus ||
+      expr->getOperator() == clang::OO_MinusMinus) {
+    instrumentLoopIncrement(expr);
+    return true;
+  }
+
+  if (config_.profile_hash_lookups &&
+      expr->getOperator() == clang::OO_Subscript && expr->getNumArgs() == 2 &&
+      isHashContainer(expr->getArg(0)->getType())) {
+    if (shouldSkipExpression(expr) || isAlreadyProcessed(expr)) {
+      return true;
+    }
+    if (transformHashSubscript(expr)) {
+      markAsProcessed(expr);
+      ++stats_.hash_lookups_instrumented;
+    } else {
+      ++stats_.errors_encountered;
+    }
+    return true;
+  }
+
+  if (expr->getOperator() != clang::OO_Subscript || expr->getNumArgs() != 2 ||
+      !config_.transform_array_subscripts) {
+    return true;
+  }
+
+  if (shouldSkipExpression(expr)) {
+    return true;
+  }
+
+  if (isAlreadyProcessed(expr)) {
+    return true;
+  }
+
+  // Other class types keep their operator[]; only the contiguous standard
+  // containers, which the prelude records as data() + index, are rewritten
+  if (!isContiguousContainer(expr->getArg(0)->getType())) {
+    return true;
+  }
+
+  if (transformContainerSubscript(expr)) {
+    markAsProcessed(expr);
+    ++stats_.container_subscripts_transformed;
+  } else {
+    ++stats_.errors_encountered;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitIfStmt(clang::IfStmt *stmt) {
+  if (!config_.branch_profile || stmt->isConstexpr() || !stmt->getCond()) {
+    return true;
+  }
+  const clang::Stmt *then_stmt = stmt->getThen();
+  if (clang::isa<clang::AttributedStmt>(then_stmt) ||
+      then_stmt->getBeginLoc().isMacroID()) {
+    return true; // already annotated, or not ours to edit
+  }
+
+  // The condition must be a profiled comparison, possibly negated
+  const clang::Expr *condition = stmt->getCond()->IgnoreParenImpCasts();
+  bool negated = false;
+  while (const auto *unary = clang::dyn_cast<clang::UnaryOperator>(condition)) {
+    if (unary->getOpcode() != clang::UO_LNot) {
+      return true;
+    }
+    negated = !negated;
+    condition = unary->getSubExpr()->IgnoreParenImpCasts();
+  }
+  const auto *comparison = clang::dyn_cast<clang::BinaryOperator>(condition);
+  if (!comparison || !comparison->isComparisonOp() ||
+      (config_.skip_system_headers && isInSystemHeader(comparison))) {
+    return true;
+  }
+
+  const BranchProfile *profile = findBranchProfile(comparison);
+  int bias = profile ? profile->bias(config_.branch_threshold) : 0;
+  if (bias == 0) {
+    return true;
+  }
+  if (negated) {
+    bias = -bias;
+  }
+  if (!rewriter_.InsertTextBefore(then_stmt->getBeginLoc(),
+                                  bias > 0 ? "[[likely]] " : "[[unlikely]] ")) {
+    ++stats_.branches_annotated;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitFunctionDecl(clang::FunctionDecl *decl) {
+  if (!config_.probe_functions || !shouldProbeFunction(decl)) {
+    return true;
+  }
+
+  // The site is the function name; the probe goes after the opening brace
+  // so member initializers run before it
+  auto &source_manager = context_.getSourceManager();
+  unsigned column = source_manager.getExpansionColumnNumber(decl->getLocation());
+  const auto *body = clang::cast<clang::CompoundStmt>(decl->getBody());
+  if (rewriter_.InsertTextAfterToken(body->getLBracLoc(),
+                                     " __optiweave_probe(" +
+                                         std::to_string(column) + ");")) {
+    ++stats_.errors_encountered;
+  } else {
+    ++stats_.functions_probed;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::shouldProbeFunction(
+    const clang::FunctionDecl *decl) const {
+  if (!decl->doesThisDeclarationHaveABody() || decl->isConstexpr() ||
+      decl->isImplicit()) {
+    return false;
+  }
+  // Coroutine and function-try-block bodies are not compound statements
+  const auto *body = clang::dyn_cast_or_null<clang::CompoundStmt>(decl->getBody());
+  if (!body || body->getLBracLoc().isMacroID()) {
+    return false;
+  }
+  if (config_.skip_system_headers &&
+      context_.getSourceManager().isInSystemHeader(decl->getLocation())) {
+    return false;
+  }
+  // Lambdas are implicitly constexpr while they qualify; the probe would
+  // silently take that away
+  const auto *method = clang::dyn_cast<clang::CXXMethodDecl>(decl);
+  if (method && method->getParent()->isLambda()) {
+    return false;
+  }
+  return !probe_filter_ ||
+         probe_filter_->match(decl->getQualifiedNameAsString());
+}
+
+bool ModernASTVisitor::VisitCXXNewExpr(clang::CXXNewExpr *expr) {
+  if (!config_.track_allocations || shouldSkipExpression(expr) ||
+      isAlreadyProcessed(expr) || expr->getBeginLoc().isMacroID()) {
+    return true;
+  }
+  // Placement new constructs into storage someone else allocated
+  const clang::FunctionDecl *operator_new = expr->getOperatorNew();
+  if (operator_new && operator_new->isReservedGlobalPlacementOperator()) {
+    return true;
+  }
+
+  std::string site = generateAllocationSite(expr);
+  bool failed = true;
+  if (expr->isArray()) {
+    // Only the element count is wrapped; the allocated type of new T[n][4]
+    // is T[4], so the byte size is count * sizeof(T[4])
+    auto size = expr->getArraySize();
+    if (!size || !*size) {
+      return true;
+    }
+    clang::QualType element = expr->getAllocatedType();
+    std::string element_size =
+        element->isDependentType()
+            ? "sizeof(" + element.getAsString(context_.getPrintingPolicy()) +
+                  ")"
+            : std::to_string(
+                  context_.getTypeSizeInChars(element).getQuantity());
+    failed = rewriter_.ReplaceText((*size)->getSourceRange(),
+                                   "optiweave::track_new_array(" +
+                                       getOperandText(*size) + ", " +
+                                       element_size + ", " + site + ")");
+  } else {
+    failed = rewriter_.ReplaceText(expr->getSourceRange(),
+                                   "optiweave::track_new(" +
+                                       getOperandText(expr) + ", " + site +
+                                       ")");
+  }
+
+  if (failed) {
+    ++stats_.errors_encountered;
+  } else {
+    markAsProcessed(expr);
+    ++stats_.allocations_instrumented;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitCXXDeleteExpr(clang::CXXDeleteExpr *expr) {
+  const clang::Expr *argument = expr->getArgument();
+  if (!config_.track_allocations || shouldSkipExpression(expr) ||
+      isAlreadyProcessed(expr) || expr->getBeginLoc().isMacroID() ||
+      argument->getBeginLoc().isMacroID()) {
+    return true;
+  }
+
+  if (rewriter_.ReplaceText(argument->getSourceRange(),
+                            "optiweave::track_delete(" +
+                                getOperandText(argument) + ", " +
+                                generateAllocationSite(expr) + ")")) {
+    ++stats_.errors_encountered;
+  } else {
+    markAsProcessed(expr);
+    ++stats_.allocations_instrumented;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitCallExpr(clang::CallExpr *expr) {
+  if (!config_.track_allocations ||
+      clang::isa<clang::CXXOperatorCallExpr, clang::CXXMemberCallExpr>(expr) ||
+      shouldSkipExpression(expr) || isAlreadyProcessed(expr)) {
+    return true;
+  }
+  const clang::FunctionDecl *callee = expr->getDirectCallee();
+  if (!callee || !callee->getIdentifier() ||
+      !(callee->isExternC() || callee->isInStdNamespace())) {
+    return true;
+  }
+
+  // Only the C allocator entry points, called by name; calls through
+  // function pointers and macros are left alone
+  static constexpr std::pair<llvm::StringLiteral, unsigned> kAllocators[] = {
+      {"malloc", 1}, {"calloc", 2}, {"realloc", 2}, {"aligned_alloc", 2},
+      {"free", 1}};
+  llvm::StringRef name = callee->getName();
+  const auto *allocator =
+      std::find_if(std::begin(kAllocators), std::end(kAllocators),
+                   [&](const auto &entry) { return entry.first == name; });
+  const auto *callee_expr = expr->getCallee()->IgnoreParenImpCasts();
+  if (allocator == std::end(kAllocators) ||
+      expr->getNumArgs() != allocator->second ||
+      !clang::isa<clang::DeclRefExpr>(callee_expr) ||
+      callee_expr->getBeginLoc().isMacroID() ||
+      expr->getRParenLoc().isMacroID()) {
+    return true;
+  }
+
+  if (rewriter_.ReplaceText(callee_expr->getSourceRange(),
+                            "optiweave::traced_" + name.str()) ||
+      rewriter_.InsertTextBefore(expr->getRParenLoc(),
+                                 ", " + generateAllocationSite(expr))) {
+    ++stats_.errors_encountered;
+  } else {
+    markAsProcessed(expr);
+    ++stats_.allocations_instrumented;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitCXXConstructExpr(clang::CXXConstructExpr *expr) {
+  // Before the construction is recorded, which may take the rewritten
+  // text of the whole temporary
+  if (config_.track_copies) {
+    instrumentCopyConstruction(expr);
+  }
+
+  if (!config_.track_allocations || expr->isElidable() ||
+      !isAllocatingContainer(expr->getType()) ||
+      shouldSkipExpression(expr) || isAlreadyProcessed(expr) ||
+      expr->getBeginLoc().isMacroID()) {
+    return true;
+  }
+
+  if (transformContainerConstruction(expr)) {
+    markAsProcessed(expr);
+    ++stats_.allocations_instrumented;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::VisitCXXMemberCallExpr(
+    clang::CXXMemberCallExpr *expr) {
+  if (shouldSkipExpression(expr) || isAlreadyProcessed(expr)) {
+    return true;
+  }
+
+  const clang::MemberExpr *member =
+      config_.profile_virtual_calls || config_.receiver_profile
+          ? findVirtualCallee(expr)
+          : nullptr;
+  if (member) {
+    // A guarded call is not profiled again
+    if (config_.receiver_profile && guardVirtualCall(expr, member)) {
+      markAsProcessed(expr);
+      ++stats_.virtual_calls_guarded;
+    } else if (config_.profile_virtual_calls) {
+      if (transformVirtualCall(expr, member)) {
+        markAsProcessed(expr);
+        ++stats_.virtual_calls_instrumented;
+      } else {
+        ++stats_.errors_encountered;
+      }
+    }
+    return true;
+  }
+
+  const clang::CXXMethodDecl *method = expr->getMethodDecl();
+  if (config_.profile_hash_lookups && method && method->getIdentifier() &&
+      isHashContainer(expr->getObjectType())) {
+    bool probed = llvm::StringSwitch<bool>(method->getName())
+                      .Cases("find", "count", "contains", "equal_range", "at",
+                             true)
+                      .Cases("insert", "emplace", "try_emplace",
+                             "insert_or_assign", true)
+                      .Default(false);
+    // Members of classes derived from a container are left alone
+    if (probed && !expr->getImplicitObjectArgument()->isImplicitCXXThis()) {
+      if (transformHashCall(expr)) {
+        markAsProcessed(expr);
+        ++stats_.hash_lookups_instrumented;
+      } else {
+        ++stats_.errors_encountered;
+      }
+    }
+    return true;
+  }
+
+  if (!(config_.profile_container_growth || config_.reserve_advice)) {
+    return true;
+  }
+  const clang::VarDecl *var = findGrowingContainer(expr);
+  const clang::DeclStmt *decl_stmt = var ? findDeclaringStatement(var) : nullptr;
+  if (!decl_stmt) {
+    return true;
+  }
+
+  // The reserve goes in first so the tracker starts from the reserved
+  // capacity rather than counting it as a reallocation
+  if (config_.reserve_advice && reserved_.insert(var).second &&
+      insertReserve(var, decl_stmt)) {
+    ++stats_.reserves_inserted;
+  }
+  if (!config_.profile_container_growth) {
+    return true;
+  }
+  if (transformGrowthCall(expr, var, decl_stmt)) {
+    markAsProcessed(expr);
+    ++stats_.growth_calls_instrumented;
+  } else {
+    ++stats_.errors_encountered;
+  }
+  return true;
+}
+
+const clang::MemberExpr *ModernASTVisitor::findVirtualCallee(
+    const clang::CXXMemberCallExpr *expr) const {
+  const clang::CXXMethodDecl *method = expr->getMethodDecl();
+  if (!method || !method->isVirtual() || method->hasAttr<clang::FinalAttr>() ||
+      method->getParent()->hasAttr<clang::FinalAttr>()) {
+    return nullptr;
+  }
+  // Base::f() is already a direct call
+  const auto *member =
+      clang::dyn_cast<clang::MemberExpr>(expr->getCallee()->IgnoreParens());
+  if (!member || member->hasQualifier() || member->getBeginLoc().isMacroID() ||
+      member->getMemberLoc().isMacroID()) {
+    return nullptr;
+  }
+  return member;
+}
+
+bool ModernASTVisitor::transformVirtualCall(const clang::CXXMemberCallExpr *expr,
+                                            const clang::MemberExpr *member) {
+  // The static slot caches the runtime's site id, as for comparisons
+  auto &source_manager = context_.getSourceManager();
+  std::string site =
+      "__optiweave_site(" +
+      std::to_string(
+          source_manager.getExpansionColumnNumber(expr->getBeginLoc())) +
+      "), __optiweave_site_slot()";
+
+  // f() inside a member function calls through the implicit this
+  const clang::Expr *base = member->getBase();
+  if (base->isImplicitCXXThis()) {
+    return !rewriter_.InsertTextBefore(member->getMemberLoc(),
+                                       "optiweave::track_receiver_pointer("
+                                       "this, " +
+                                           site + ")->");
+  }
+
+  // ptr->f() on a smart pointer goes through operator->; the smart pointer
+  // itself is wrapped and dereferenced by the prelude
+  const auto *arrow = clang::dyn_cast<clang::CXXOperatorCallExpr>(base);
+  if (arrow && arrow->getOperator() == clang::OO_Arrow) {
+    base = arrow->getArg(0);
+  }
+  if (base->getBeginLoc().isMacroID() || base->getEndLoc().isMacroID()) {
+    return false;
+  }
+  std::string wrapper = member->isArrow() ? "optiweave::track_receiver_pointer("
+                                          : "optiweave::track_receiver(";
+  return !rewriter_.ReplaceText(base->getSourceRange(),
+                                wrapper + getOperandText(base) + ", " + site +
+                                    ")");
+}
+
+bool ModernASTVisitor::transformHashCall(const clang::CXXMemberCallExpr *expr) {
+  const auto *member =
+      clang::dyn_cast<clang::MemberExpr>(expr->getCallee()->IgnoreParens());
+  if (!member || member->getBeginLoc().isMacroID() ||
+      member->getOperatorLoc().isMacroID()) {
+    return false;
+  }
+  // The probe holds a reference, so temporaries are not probed
+  const clang::Expr *base = member->getBase();
+  if (!member->isArrow() && !base->isLValue()) {
+    return false;
+  }
+  const auto *arrow = clang::dyn_cast<clang::CXXOperatorCallExpr>(base);
+  if (arrow && arrow->getOperator() == clang::OO_Arrow) {
+    base = arrow->getArg(0);
+  }
+  if (base->getBeginLoc().isMacroID() || base->getEndLoc().isMacroID()) {
+    return false;
+  }
+
+  // m.find(k) and p->find(k) both become
+  // track_hash(<m>, site, slot, k)->find(k)
+  auto &source_manager = context_.getSourceManager();
+  std::string container = member->isArrow()
+                              ? "*(" + getOperandText(base) + ")"
+                              : getOperandText(base);
+  std::string key = hashKeyText(expr);
+  std::string probe =
+      "optiweave::track_hash(" + container + ", __optiweave_site(" +
+      std::to_string(
+          source_manager.getExpansionColumnNumber(expr->getBeginLoc())) +
+      "), __optiweave_site_slot()" + (key.empty() ? "" : ", " + key) + ")";
+  if (rewriter_.ReplaceText(base->getSourceRange(), probe) ||
+      (!member->isArrow() &&
+       rewriter_.ReplaceText(member->getOperatorLoc(), 1, "->"))) {
+    llvm::errs() << "Error: Failed to apply hash lookup transformation\n";
+    return false;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::transformHashSubscript(
+    const clang::CXXOperatorCallExpr *expr) {
+  const clang::Expr *base = expr->getArg(0);
+  if (!base->isLValue() || base->getBeginLoc().isMacroID() ||
+      base->getEndLoc().isMacroID()) {
+    return false;
+  }
+  auto &source_manager = context_.getSourceManager();
+  std::ostringstream oss;
+  oss << "(*optiweave::track_hash(" << getOperandText(base)
+      << ", __optiweave_site("
+      << source_manager.getExpansionColumnNumber(expr->getBeginLoc())
+      << "), __optiweave_site_slot()";
+  // The key is evaluated once more for the probe, as in transformHashCall
+  const clang::Expr *key = expr->getArg(1);
+  if (!key->HasSideEffects(context_) && !key->getBeginLoc().isMacroID() &&
+      !key->getEndLoc().isMacroID()) {
+    oss << ", " << getSourceText(key->getSourceRange());
+  }
+  oss << "))";
+  if (rewriter_.ReplaceText(base->getSourceRange(), oss.str())) {
+    llvm::errs() << "Error: Failed to apply hash lookup transformation\n";
+    return false;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::guardVirtualCall(const clang::CXXMemberCallExpr *expr,
+                                        const clang::MemberExpr *member) {
+  auto &source_manager = context_.getSourceManager();
+  auto location = source_manager.getExpansionLoc(expr->getBeginLoc());
+  const ReceiverProfile *profile = config_.receiver_profile->find(
+      source_manager.getFilename(location).str(),
+      source_manager.getExpansionLineNumber(location),
+      source_manager.getExpansionColumnNumber(location));
+  if (!profile || !profile->guardable(config_.guard_threshold)) {
+    return false;
+  }
+
+  // The receiver is evaluated by the guard and again by the call; the
+  // overrider's default arguments could differ from the ones called now
+  const clang::Expr *base = member->getBase();
+  if (base->HasSideEffects(context_)) {
+    return false;
+  }
+  for (const clang::Expr *arg : expr->arguments()) {
+    if (clang::isa<clang::CXXDefaultArgExpr>(arg)) {
+      return false;
+    }
+  }
+
+  clang::QualType object_type =
+      member->isArrow() ? base->getType()->getPointeeType() : base->getType();
+  const clang::CXXRecordDecl *receiver = object_type->getAsCXXRecordDecl();
+  const clang::CXXRecordDecl *target = findPolymorphicClass(profile->dominant);
+  if (!receiver || !target ||
+      (target != receiver && (!target->isDerivedFrom(receiver) ||
+                              target->isVirtuallyDerivedFrom(receiver))) ||
+      !source_manager.isBeforeInTranslationUnit(target->getBraceRange().getEnd(),
+                                                expr->getBeginLoc())) {
+    return false;
+  }
+  const clang::CXXMethodDecl *overrider =
+      expr->getMethodDecl()->getCorrespondingMethodInClass(target);
+  if (!overrider || overrider->getAccess() != clang::AS_public) {
+    return false;
+  }
+
+  std::string pointer;
+  if (base->isImplicitCXXThis()) {
+    pointer = "this";
+  } else if (const auto *arrow =
+                 clang::dyn_cast<clang::CXXOperatorCallExpr>(base);
+             arrow && arrow->getOperator() == clang::OO_Arrow) {
+    pointer = getOperandText(arrow->getArg(0));
+  } else {
+    pointer = getOperandText(base);
+  }
+  std::string object =
+      member->isArrow() ? "(*" + pointer + ")" : "(" + pointer + ")";
+
+  clang::PrintingPolicy policy = context_.getPrintingPolicy();
+  policy.SuppressTagKeyword = true;
+  policy.SuppressUnwrittenScope = true;
+  policy.FullyQualifiedName = true;
+  std::string target_name = context_.getRecordType(target).getAsString(policy);
+
+  std::string args;
+  for (const clang::Expr *arg : expr->arguments()) {
+    args += (args.empty() ? "" : ", ") + getOperandText(arg);
+  }
+
+  // (typeid(*p) == typeid(X) ? static_cast<X &>(*p).X::f(args) : p->f(args))
+  std::ostringstream oss;
+  oss << "(typeid(" << object << ") == typeid(" << target_name
+      << ") ? static_cast<" << (object_type.isConstQualified() ? "const " : "")
+      << target_name << " &>(" << object << ")." << target_name
+      << "::" << member->getMemberNameInfo().getAsString() << "(" << args
+      << ") : " << getOperandText(expr) << ")";
+  return !rewriter_.ReplaceText(expr->getSourceRange(), oss.str());
+}
+
+const clang::CXXRecordDecl *
+ModernASTVisitor::findPolymorphicClass(const std::string &name) {
+  if (!polymorphic_classes_indexed_) {
+    std::vector<const clang::CXXRecordDecl *> classes;
+    PolymorphicClassCollector collector(classes);
+    collector.TraverseDecl(context_.getTranslationUnitDecl());
+
+    // Printed the way the demangler prints, anonymous namespaces included
+    clang::PrintingPolicy policy = context_.getPrintingPolicy();
+    policy.SuppressTagKeyword = true;
+    policy.FullyQualifiedName = true;
+    for (const clang::CXXRecordDecl *record : classes) {
+      polymorphic_classes_.emplace(
+          context_.getRecordType(record).getAsString(policy), record);
+    }
+    polymorphic_classes_indexed_ = true;
+  }
+  auto found = polymorphic_classes_.find(name);
+  return found == polymorphic_classes_.end() ? nullptr : found->second;
+}
+
+void ModernASTVisitor::instrumentCopyConstruction(
+    const clang::CXXConstructExpr *expr) {
+  const clang::CXXConstructorDecl *constructor = expr->getConstructor();
+  if (!constructor->isCopyConstructor() || expr->isElidable() ||
+      expr->getNumArgs() == 0 || shouldSkipExpression(expr) ||
+      !isExpensiveCopy(expr->getType())) {
+    return;
+  }
+
+  // Lambda captures and range-for variables are initialized from text that
+  // is not the copied expression
+  auto parents = context_.getParents(*expr);
+  if (!parents.empty()) {
+    if (const auto *cleanups = parents[0].get<clang::ExprWithCleanups>()) {
+      parents = context_.getParents(*cleanups);
+    }
+  }
+  if (!parents.empty()) {
+    const auto *var = parents[0].get<clang::VarDecl>();
+    if (parents[0].get<clang::LambdaExpr>() ||
+        (var && var->isCXXForRangeDecl())) {
+      return;
+    }
+  }
+  instrumentCopySource(expr->getArg(0), "optiweave::track_copy");
+}
+
+void ModernASTVisitor::instrumentCopyAssignment(
+    const clang::CXXOperatorCallExpr *expr) {
+  if (!config_.track_copies || expr->getNumArgs() != 2 ||
+      shouldSkipExpression(expr)) {
+    return;
+  }
+  const auto *method =
+      clang::dyn_cast_or_null<clang::CXXMethodDecl>(expr->getCalleeDecl());
+  if (!method || !method->isCopyAssignmentOperator() ||
+      !isExpensiveCopy(expr->getArg(0)->getType())) {
+    return;
+  }
+  instrumentCopySource(expr->getArg(1), "optiweave::track_copy_assignment");
+}
+
+void ModernASTVisitor::instrumentCopySource(const clang::Expr *source,
+                                            llvm::StringRef wrapper) {
+  if (source->getSourceRange().isInvalid() ||
+      source->getBeginLoc().isMacroID() || source->getEndLoc().isMacroID() ||
+      clang::isa<clang::CXXDefaultArgExpr>(source->IgnoreImplicit())) {
+    return;
+  }
+
+  auto &source_manager = context_.getSourceManager();
+  unsigned column = source_manager.getExpansionColumnNumber(source->getBeginLoc());
+  std::string site = (isLastUse(source) ? "__optiweave_site_last_use("
+                                        : "__optiweave_site(") +
+                     std::to_string(column) + ")";
+  if (rewriter_.ReplaceText(source->getSourceRange(),
+                            wrapper.str() + "(" + getOperandText(source) +
+                                ", " + site + ")")) {
+    ++stats_.errors_encountered;
+  } else {
+    ++stats_.copies_instrumented;
+  }
+}
+
+bool ModernASTVisitor::isExpensiveCopy(clang::QualType type) const {
+  type = type.getNonReferenceType();
+  if (type->isDependentType() || type->isIncompleteType()) {
+    return false;
+  }
+  const clang::CXXRecordDecl *record = type->getAsCXXRecordDecl();
+  if (!record) {
+    return false;
+  }
+  return static_cast<size_t>(
+             context_.getTypeSizeInChars(type).getQuantity()) >=
+             config_.copy_threshold ||
+         ownsHeapMemory(record);
+}
+
+bool ModernASTVisitor::ownsHeapMemory(const clang::CXXRecordDecl *record,
+                                      unsigned depth) const {
+  if (isAllocatingContainer(context_.getRecordType(record))) {
+    return true;
+  }
+  if (depth >= 4 || !record->hasDefinition()) {
+    return false;
+  }
+  for (const auto &base : record->bases()) {
+    const auto *base_record = base.getType()->getAsCXXRecordDecl();
+    if (base_record && ownsHeapMemory(base_record, depth + 1)) {
+      return true;
+    }
+  }
+  for (const auto *field : record->fields()) {
+    const auto *field_record =
+        context_.getBaseElementType(field->getType())->getAsCXXRecordDecl();
+    if (field_record && ownsHeapMemory(field_record, depth + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ModernASTVisitor::isLastUse(const clang::Expr *source) const {
+  const auto *ref =
+      clang::dyn_cast<clang::DeclRefExpr>(source->IgnoreParenImpCasts());
+  if (!ref || ref->refersToEnclosingVariableOrCapture()) {
+    return false;
+  }
+  const auto *var = clang::dyn_cast<clang::VarDecl>(ref->getDecl());
+  if (!var || !var->hasLocalStorage() || var->getType()->isReferenceType() ||
+      var->getType().isConstQualified()) {
+    return false;
+  }
+
+  auto &source_manager = context_.getSourceManager();
+  auto contains = [&](clang::SourceRange range, clang::SourceLocation loc) {
+    return !source_manager.isBeforeInTranslationUnit(loc, range.getBegin()) &&
+           !source_manager.isBeforeInTranslationUnit(range.getEnd(), loc);
+  };
+
+  // Walk out to the function body; a loop the variable outlives reads it
+  // again on its next iteration
+  const clang::Stmt *body = nullptr;
+  auto node = clang::DynTypedNode::create(*source);
+  while (!body) {
+    auto parents = context_.getParents(node);
+    if (parents.empty()) {
+      return false;
+    }
+    node = parents[0];
+    if (const auto *function = node.get<clang::FunctionDecl>()) {
+      body = function->getBody();
+    } else if (const auto *lambda = node.get<clang::LambdaExpr>()) {
+      body = lambda->getBody();
+    } else if (const auto *loop = node.get<clang::Stmt>();
+               loop && clang::isa<clang::ForStmt, clang::WhileStmt,
+                                  clang::DoStmt, clang::CXXForRangeStmt>(
+                           loop)) {
+      const auto *for_loop = clang::dyn_cast<clang::ForStmt>(loop);
+      if (!contains(loop->getSourceRange(), var->getLocation()) ||
+          (for_loop && for_loop->getInit() &&
+           contains(for_loop->getInit()->getSourceRange(),
+                    var->getLocation()))) {
+        return false;
+      }
+    }
+  }
+
+  LaterUseFinder finder(var, source->getEndLoc(), source_manager);
+  finder.TraverseStmt(const_cast<clang::Stmt *>(body));
+  return !finder.found;
 }
 
-bool ModernASTVisitor::VisitUnaryOperator(clang::UnaryOperator *expr) {
-  // TODO: Implement unary operator transformation
-  return true;
-}
+void ModernASTVisitor::instrumentLoopIncrement(const clang::Expr *expr) {
+  if (!config_.profile_loop_trips || shouldSkipExpression(expr) ||
+      isAlreadyProcessed(expr)) {
+    return;
+  }
 
-bool ModernASTVisitor::VisitCXXOperatorCallExpr(clang::CXXOperatorCallExpr *
-                                                expr) {
-  // TODO: Implement overloaded operator transformation
-  return true;
+  const clang::ForStmt *loop = findIncrementedLoop(expr);
+  if (!loop || loop->getBeginLoc().isMacroID() ||
+      isInConstexprFunction(loop)) {
+    return;
+  }
+
+  if (transformLoopIncrement(loop)) {
+    markAsProcessed(expr);
+    ++stats_.loops_instrumented;
+  } else {
+    ++stats_.errors_encountered;
+  }
 }
 
 bool ModernASTVisitor::shouldSkipExpression(const clang::Expr *expr) const {
@@ -140,6 +979,20 @@ bool ModernASTVisitor::shouldSkipExpression(const clang::Expr *expr) const {
     return true;
   }
 
+  // Constant-evaluated expressions never run at run time, and no wrapper
+  // can be evaluated in them once it reads the runtime's configuration
+  if (isInConstantContext(expr)) {
+    return true;
+  }
+
+  // The comparison wrappers take a static slot, which is never usable in a
+  // constant expression, so comparisons in constexpr functions stay as
+  // written
+  const auto *binary = clang::dyn_cast<clang::BinaryOperator>(expr);
+  if (binary && binary->isComparisonOp() && isInConstexprFunction(expr)) {
+    return true;
+  }
+
   // Check for problematic contexts (sizeof, alignof, etc.)
   auto parents = context_.getParents(*expr);
   for (const auto &parent_node : parents) {
@@ -192,8 +1045,8 @@ bool ModernASTVisitor::transformArraySubscript(clang::ArraySubscriptExpr *
     auto rhs = expr->getRHS();
 
     // Get source text for operands
-    std::string lhs_text = getSourceText(lhs->getSourceRange());
-    std::string rhs_text = getSourceText(rhs->getSourceRange());
+    std::string lhs_text = getOperandText(lhs);
+    std::string rhs_text = getOperandText(rhs);
 
     if (lhs_text.empty() || rhs_text.empty()) {
       llvm::errs()
@@ -203,7 +1056,17 @@ bool ModernASTVisitor::transformArraySubscript(clang::ArraySubscriptExpr *
 
     // Generate instrumentation
     std::string instrumentation = generateArraySubscriptInstrumentation(
-        lhs->getType(), lhs_text, rhs_text);
+        lhs->getType(), lhs_text, rhs_text, generateSiteArgument(expr));
+    if (const PrefetchAdvice *advice = findPrefetchAdvice(expr)) {
+      // The prefetch address is computed from the uninstrumented operands
+      std::string prefetched = generatePrefetch(
+          expr, *advice, getSourceText(lhs->getSourceRange()),
+          getSourceText(rhs->getSourceRange()), instrumentation);
+      if (!prefetched.empty()) {
+        instrumentation = std::move(prefetched);
+        ++stats_.prefetches_inserted;
+      }
+    }
 
     // Apply transformation
     auto source_range = expr->getSourceRange();
@@ -221,14 +1084,222 @@ bool ModernASTVisitor::transformArraySubscript(clang::ArraySubscriptExpr *
   }
 }
 
+bool ModernASTVisitor::isFusableLink(
+    const clang::ArraySubscriptExpr *expr) const {
+  clang::QualType type = expr->getType();
+  if (!config_.fuse_subscripts || isTemplateDependentType(type)) {
+    return false;
+  }
+  // A row of a multi-dimensional array is only an address; a loaded row
+  // pointer is a real access, folded in only when asked to
+  return type->isConstantArrayType() ||
+         (config_.fuse_pointer_chains && type->isPointerType());
+}
+
+bool ModernASTVisitor::isFusedIntoParent(
+    const clang::ArraySubscriptExpr *expr) const {
+  if (!isFusableLink(expr)) {
+    return false;
+  }
+  const clang::Expr *current = expr;
+  for (;;) {
+    auto parents = context_.getParents(*current);
+    if (parents.size() != 1) {
+      return false;
+    }
+    const auto *parent = parents[0].get<clang::Expr>();
+    if (!parent) {
+      return false;
+    }
+    if (clang::isa<clang::ParenExpr>(parent) ||
+        clang::isa<clang::ImplicitCastExpr>(parent)) {
+      current = parent;
+      continue;
+    }
+    const auto *outer = clang::dyn_cast<clang::ArraySubscriptExpr>(parent);
+    return outer && outer->getBase()->IgnoreParenImpCasts() == expr;
+  }
+}
+
+const clang::Expr *ModernASTVisitor::collectSubscriptChain(
+    const clang::ArraySubscriptExpr *expr,
+    std::vector<const clang::Expr *> &indices) const {
+  indices.assign(1, expr->getIdx());
+  const clang::Expr *base = expr->getBase()->IgnoreParenImpCasts();
+  while (const auto *link = clang::dyn_cast<clang::ArraySubscriptExpr>(base)) {
+    if (!isFusableLink(link)) {
+      break;
+    }
+    indices.push_back(link->getIdx());
+    base = link->getBase()->IgnoreParenImpCasts();
+  }
+  if (indices.size() < 2 || isTemplateDependentType(base->getType())) {
+    return nullptr;
+  }
+  std::reverse(indices.begin(), indices.end());
+  return base;
+}
+
+bool ModernASTVisitor::transformSubscriptChain(
+    clang::ArraySubscriptExpr *expr, const clang::Expr *root,
+    const std::vector<const clang::Expr *> &indices) {
+  try {
+    std::string root_text = getOperandText(root);
+    if (root_text.empty()) {
+      llvm::errs()
+          << "Warning: Could not extract source text for subscript chain\n";
+      return false;
+    }
+
+    std::ostringstream oss;
+    oss << "__primop_subscript_nd<"
+        << root->getType().getAsString(context_.getPrintingPolicy())
+        << ">()(" << root_text << ", " << generateSiteArgument(expr);
+    for (const clang::Expr *index : indices) {
+      std::string index_text = getOperandText(index);
+      if (index_text.empty()) {
+        llvm::errs()
+            << "Warning: Could not extract source text for subscript chain\n";
+        return false;
+      }
+      oss << ", " << index_text;
+    }
+    oss << ")";
+    std::string instrumentation = oss.str();
+
+    if (const PrefetchAdvice *advice = findPrefetchAdvice(expr)) {
+      std::string prefetched = generatePrefetch(
+          expr, *advice, getSourceText(expr->getLHS()->getSourceRange()),
+          getSourceText(expr->getRHS()->getSourceRange()), instrumentation);
+      if (!prefetched.empty()) {
+        instrumentation = std::move(prefetched);
+        ++stats_.prefetches_inserted;
+      }
+    }
+
+    if (rewriter_.ReplaceText(expr->getSourceRange(), instrumentation)) {
+      llvm::errs() << "Error: Failed to apply subscript chain transformation\n";
+      return false;
+    }
+    return true;
+  } catch (const std::exception &e) {
+    llvm::errs() << "Exception in transformSubscriptChain: " << e.what()
+                 << "\n";
+    return false;
+  }
+}
+
+bool ModernASTVisitor::transformContainerSubscript(
+    clang::CXXOperatorCallExpr *expr) {
+  try {
+    const clang::Expr *object = expr->getArg(0);
+    const clang::Expr *index = expr->getArg(1);
+
+    std::string object_text = getOperandText(object);
+    std::string index_text = getOperandText(index);
+    if (object_text.empty() || index_text.empty()) {
+      llvm::errs()
+          << "Warning: Could not extract source text for container subscript\n";
+      return false;
+    }
+
+    // The prelude deduces the container type; spelling it would fail for
+    // element types the rewrite site cannot name
+    std::string instrumentation = "__primop_container_subscript(" +
+                                  object_text + ", " + index_text + ", " +
+                                  generateSiteArgument(expr) + ")";
+
+    if (rewriter_.ReplaceText(expr->getSourceRange(), instrumentation)) {
+      llvm::errs()
+          << "Error: Failed to apply container subscript transformation\n";
+      return false;
+    }
+    return true;
+  } catch (const std::exception &e) {
+    llvm::errs() << "Exception in transformContainerSubscript: " << e.what()
+                 << "\n";
+    return false;
+  }
+}
+
+bool ModernASTVisitor::isContiguousContainer(clang::QualType type) const {
+  const auto *record = type.getNonReferenceType()->getAsCXXRecordDecl();
+  if (!record || !record->isInStdNamespace() || !record->getIdentifier()) {
+    return false;
+  }
+  const auto *specialization =
+      clang::dyn_cast<clang::ClassTemplateSpecializationDecl>(record);
+  if (!specialization) {
+    return false;
+  }
+
+  llvm::StringRef name = record->getName();
+  if (name == "array" || name == "span") {
+    return true;
+  }
+  if (name == "vector") {
+    // std::vector<bool> hands out proxies and has no data()
+    const clang::TemplateArgumentList &args = specialization->getTemplateArgs();
+    return args.size() > 0 &&
+           !(args[0].getKind() == clang::TemplateArgument::Type &&
+             args[0].getAsType()->isBooleanType());
+  }
+  return false;
+}
+
+bool ModernASTVisitor::isHashContainer(clang::QualType type) const {
+  const auto *record = type.getNonReferenceType()->getAsCXXRecordDecl();
+  if (!record || !record->isInStdNamespace() || !record->getIdentifier()) {
+    return false;
+  }
+  return llvm::StringSwitch<bool>(record->getName())
+      .Cases("unordered_map", "unordered_set", true)
+      .Default(false);
+}
+
+std::string
+ModernASTVisitor::hashKeyText(const clang::CXXMemberCallExpr *expr) const {
+  const clang::CXXMethodDecl *method = expr->getMethodDecl();
+  if (expr->getNumArgs() == 0) {
+    return "";
+  }
+  // Lookups take the key first; insertions only when the first argument is
+  // a key rather than a hint or a map's value pair
+  const clang::Expr *key = expr->getArg(0);
+  bool lookup =
+      llvm::StringSwitch<bool>(method->getName())
+          .Cases("find", "count", "contains", "equal_range", "at", true)
+          .Default(false);
+  if (!lookup) {
+    const auto *specialization =
+        clang::dyn_cast_or_null<clang::ClassTemplateSpecializationDecl>(
+            expr->getObjectType()->getAsCXXRecordDecl());
+    if (!specialization ||
+        specialization->getTemplateArgs().size() == 0 ||
+        specialization->getTemplateArgs()[0].getKind() !=
+            clang::TemplateArgument::Type ||
+        !context_.hasSameUnqualifiedType(
+            key->getType(), specialization->getTemplateArgs()[0].getAsType())) {
+      return "";
+    }
+  }
+  // The probe evaluates the key once more, from the original text so that
+  // instrumentation inside it is not counted twice
+  if (key->HasSideEffects(context_) || key->getBeginLoc().isMacroID() ||
+      key->getEndLoc().isMacroID()) {
+    return "";
+  }
+  return getSourceText(key->getSourceRange());
+}
+
 bool ModernASTVisitor::transformBinaryOperator(clang::BinaryOperator *expr) {
   try {
     auto lhs = expr->getLHS();
     auto rhs = expr->getRHS();
 
     // Get source text for operands
-    std::string lhs_text = getSourceText(lhs->getSourceRange());
-    std::string rhs_text = getSourceText(rhs->getSourceRange());
+    std::string lhs_text = getOperandText(lhs);
+    std::string rhs_text = getOperandText(rhs);
 
     if (lhs_text.empty() || rhs_text.empty()) {
       llvm::errs()
@@ -236,10 +1307,17 @@ bool ModernASTVisitor::transformBinaryOperator(clang::BinaryOperator *expr) {
       return false;
     }
 
+    // Comparisons also take a static slot of their own, in which the
+    // prelude caches the runtime's site id for branch profiling
+    std::string site_text = generateSiteArgument(expr);
+    if (expr->isComparisonOp()) {
+      site_text += ", __optiweave_site_slot()";
+    }
+
     // Generate instrumentation
     std::string instrumentation = generateBinaryOperatorInstrumentation(
         expr->getOpcode(), lhs->getType(), rhs->getType(), lhs_text,
-        rhs_text);
+        rhs_text, site_text);
 
     // Apply transformation
     auto source_range = expr->getSourceRange();
@@ -259,7 +1337,7 @@ bool ModernASTVisitor::transformBinaryOperator(clang::BinaryOperator *expr) {
 
 std::string ModernASTVisitor::generateArraySubscriptInstrumentation(
     clang::QualType lhs_type, llvm::StringRef lhs_text,
-    llvm::StringRef rhs_text) const {
+    llvm::StringRef rhs_text, llvm::StringRef site_text) const {
 
   std::ostringstream oss;
 
@@ -267,13 +1345,15 @@ std::string ModernASTVisitor::generateArraySubscriptInstrumentation(
     // Template-dependent case - use runtime type detection
     oss << "__maybe_primop_subscript<"
         << "decltype(" << lhs_text.str() << "), "
-        << "!__has_subscript_overload<decltype(" << lhs_text.str() << ")>::value"
-        << ">()(" << lhs_text.str() << ", " << rhs_text.str() << ")";
+        << "__has_subscript_overload<decltype(" << lhs_text.str() << ")>::value"
+        << ">()(" << lhs_text.str() << ", " << rhs_text.str() << ", "
+        << site_text.str() << ")";
   } else {
     // Non-template case - use compile-time type
     std::string type_str = lhs_type.getAsString(context_.getPrintingPolicy());
     oss << "__primop_subscript<" << type_str << ">()"
-        << "(" << lhs_text.str() << ", " << rhs_text.str() << ")";
+        << "(" << lhs_text.str() << ", " << rhs_text.str() << ", "
+        << site_text.str() << ")";
   }
 
   return oss.str();
@@ -282,10 +1362,10 @@ std::string ModernASTVisitor::generateArraySubscriptInstrumentation(
 std::string ModernASTVisitor::generateBinaryOperatorInstrumentation(
     clang::BinaryOperatorKind op, clang::QualType lhs_type,
     clang::QualType rhs_type, llvm::StringRef lhs_text,
-    llvm::StringRef rhs_text) const {
+    llvm::StringRef rhs_text, llvm::StringRef site_text) const {
 
   std::ostringstream oss;
-  const char *op_name = getBinaryOperatorSpelling(op);
+  const char *op_name = getBinaryOperatorName(op);
 
   if (isTemplateDependentType(lhs_type) ||
       isTemplateDependentType(rhs_type)) {
@@ -293,7 +1373,8 @@ std::string ModernASTVisitor::generateBinaryOperatorInstrumentation(
     oss << "__maybe_primop_" << op_name << "<"
         << "decltype(" << lhs_text.str() << "), "
         << "decltype(" << rhs_text.str() << ")"
-        << ">()(" << lhs_text.str() << ", " << rhs_text.str() << ")";
+        << ">()(" << lhs_text.str() << ", " << rhs_text.str() << ", "
+        << site_text.str() << ")";
   } else {
     // Non-template case
     std::string lhs_type_str =
@@ -302,12 +1383,463 @@ std::string ModernASTVisitor::generateBinaryOperatorInstrumentation(
         rhs_type.getAsString(context_.getPrintingPolicy());
     oss << "__primop_" << op_name << "<" << lhs_type_str << ", "
         << rhs_type_str << ">()"
-        << "(" << lhs_text.str() << ", " << rhs_text.str() << ")";
+        << "(" << lhs_text.str() << ", " << rhs_text.str() << ", "
+        << site_text.str() << ")";
+  }
+
+  return oss.str();
+}
+
+const PrefetchAdvice *ModernASTVisitor::findPrefetchAdvice(
+    const clang::ArraySubscriptExpr *expr) const {
+  if (!config_.prefetch_advice) {
+    return nullptr;
+  }
+  auto &source_manager = context_.getSourceManager();
+  auto location = source_manager.getExpansionLoc(expr->getBeginLoc());
+  return config_.prefetch_advice->find(
+      source_manager.getFilename(location).str(),
+      source_manager.getExpansionLineNumber(location),
+      source_manager.getExpansionColumnNumber(location));
+}
+
+const clang::ForStmt *
+ModernASTVisitor::findIncrementedLoop(const clang::Expr *expr) const {
+  for (const auto &parent_node : context_.getParents(*expr)) {
+    const auto *loop = parent_node.get<clang::ForStmt>();
+    if (loop && loop->getInc() &&
+        loop->getInc()->IgnoreParens() == expr->IgnoreParens()) {
+      return loop;
+    }
+  }
+  return nullptr;
+}
+
+bool ModernASTVisitor::transformLoopIncrement(const clang::ForStmt *loop) {
+  if (loop->getRParenLoc().isMacroID()) {
+    return false;
+  }
+
+  auto &source_manager = context_.getSourceManager();
+  unsigned column = source_manager.getExpansionColumnNumber(loop->getBeginLoc());
+
+  // The block ends after the body; a body that is a single statement ends
+  // at its semicolon rather than at its last token
+  clang::SourceLocation end =
+      source_manager.getExpansionRange(loop->getEndLoc()).getEnd();
+  clang::SourceLocation after_semi = clang::Lexer::findLocationAfterToken(
+      end, clang::tok::semi, source_manager, context_.getLangOpts(), false);
+
+  // Count each entry into the body, in a block opened at the header's
+  // closing parenthesis: counting the increment would miss the last
+  // iteration of a loop left by break or return. Replacing the parenthesis
+  // rather than inserting before the body keeps the step out of the text of
+  // expressions that start the body.
+  if (rewriter_.ReplaceText(loop->getRParenLoc(), 1,
+                            ") { __optiweave_trips.step();") ||
+      rewriter_.InsertTextBefore(
+          loop->getBeginLoc(),
+          "{ optiweave::LoopTripCounter __optiweave_trips(__optiweave_site(" +
+              std::to_string(column) + ")); ")) {
+    llvm::errs() << "Error: Failed to apply loop increment transformation\n";
+    return false;
+  }
+  // Closes the body's block, then the counter's
+  bool failed = after_semi.isValid()
+                    ? rewriter_.InsertTextBefore(after_semi, " } }")
+                    : rewriter_.InsertTextAfterToken(end, " } }");
+  if (failed) {
+    llvm::errs() << "Error: Failed to close loop trip counter block\n";
+    return false;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::isInConstexprFunction(const clang::Stmt *stmt) const {
+  auto node = clang::DynTypedNode::create(*stmt);
+  while (true) {
+    auto parents = context_.getParents(node);
+    if (parents.empty()) {
+      return false;
+    }
+    node = parents[0];
+    if (const auto *function = node.get<clang::FunctionDecl>()) {
+      // Lambdas are implicitly constexpr only while they qualify
+      const auto *method = clang::dyn_cast<clang::CXXMethodDecl>(function);
+      if (method && method->getParent()->isLambda()) {
+        return function->isConsteval();
+      }
+      return function->isConstexpr();
+    }
+  }
+}
+
+bool ModernASTVisitor::isInConstantContext(const clang::Expr *expr) const {
+  auto node = clang::DynTypedNode::create(*expr);
+  const clang::Stmt *child = expr;
+  while (true) {
+    auto parents = context_.getParents(node);
+    if (parents.empty()) {
+      return false;
+    }
+    node = parents[0];
+
+    // Sema wraps checked constant expressions: case labels, enumerators,
+    // bit-field widths, static_assert conditions, consteval calls
+    if (node.get<clang::ConstantExpr>() ||
+        node.get<clang::TemplateArgumentLoc>()) {
+      return true;
+    }
+    // Array bounds, noexcept and decltype operands; only a VLA bound runs
+    if (const auto *type = node.get<clang::TypeLoc>()) {
+      if (!type->getAs<clang::VariableArrayTypeLoc>()) {
+        return true;
+      }
+      continue;
+    }
+    if (const auto *stmt = node.get<clang::Stmt>()) {
+      const auto *if_stmt = clang::dyn_cast<clang::IfStmt>(stmt);
+      if (if_stmt && if_stmt->isConstexpr() && if_stmt->getCond() == child) {
+        return true;
+      }
+      child = stmt;
+      continue;
+    }
+    if (const auto *decl = node.get<clang::Decl>()) {
+      if (clang::isa<clang::StaticAssertDecl, clang::EnumConstantDecl>(decl)) {
+        return true;
+      }
+      if (const auto *var = clang::dyn_cast<clang::VarDecl>(decl)) {
+        if (var->isConstexpr() || var->hasAttr<clang::ConstInitAttr>()) {
+          return true;
+        }
+      }
+      // A function body is evaluated at run time unless the function is
+      // constexpr, which callers check on their own
+      if (clang::isa<clang::FunctionDecl>(decl)) {
+        return false;
+      }
+      child = nullptr;
+    }
+  }
+}
+
+bool ModernASTVisitor::transformContainerConstruction(
+    const clang::CXXConstructExpr *expr) {
+  std::string site = generateAllocationSite(expr);
+
+  // Temporaries spelled in the source, std::vector<int>(n), pass through a
+  // wrapper that looks at the constructed container
+  if (clang::isa<clang::CXXTemporaryObjectExpr>(expr)) {
+    return !rewriter_.ReplaceText(expr->getSourceRange(),
+                                  "optiweave::track_temporary(" +
+                                      getOperandText(expr) + ", " + site +
+                                      ")");
+  }
+
+  // Automatic locals: the record follows the declaration, once the
+  // container holds what its constructor allocated. Implicit copies into
+  // arguments and return values have no text of their own.
+  auto parents = context_.getParents(*expr);
+  if (!parents.empty()) {
+    if (const auto *cleanups = parents[0].get<clang::ExprWithCleanups>()) {
+      parents = context_.getParents(*cleanups);
+    }
+  }
+  const auto *var = parents.empty() ? nullptr : parents[0].get<clang::VarDecl>();
+  if (!var || !var->hasLocalStorage() || clang::isa<clang::ParmVarDecl>(var) ||
+      !var->getIdentifier()) {
+    return false;
+  }
+  // Declarations in for-init and condition positions cannot take a statement
+  const clang::DeclStmt *decl_stmt = findDeclaringStatement(var);
+  if (!decl_stmt) {
+    return false;
+  }
+  return !rewriter_.InsertTextAfterToken(
+      decl_stmt->getEndLoc(), " optiweave::track_construction(" +
+                                  var->getName().str() + ", " + site + ");");
+}
+
+const clang::VarDecl *ModernASTVisitor::findGrowingContainer(
+    const clang::CXXMemberCallExpr *expr) const {
+  const clang::CXXMethodDecl *method = expr->getMethodDecl();
+  if (!method || !method->getIdentifier()) {
+    return nullptr;
+  }
+  const clang::CXXRecordDecl *record = method->getParent();
+  if (!record->isInStdNamespace() || !record->getIdentifier()) {
+    return nullptr;
+  }
+  llvm::StringRef name = method->getName();
+  bool growing = record->getName() == "vector"
+                     ? name == "push_back" || name == "emplace_back"
+                 : record->getName() == "basic_string"
+                     ? name == "push_back" || name == "append"
+                     : false;
+  if (!growing) {
+    return nullptr;
+  }
+
+  // Only v.push_back(x) on a variable of this function: the tracker is
+  // named after the variable and is not captured by lambdas
+  const auto *member =
+      clang::dyn_cast<clang::MemberExpr>(expr->getCallee()->IgnoreParens());
+  if (!member || member->isArrow() || member->getBeginLoc().isMacroID() ||
+      member->getOperatorLoc().isMacroID()) {
+    return nullptr;
+  }
+  const auto *ref = clang::dyn_cast<clang::DeclRefExpr>(
+      member->getBase()->IgnoreParenImpCasts());
+  if (!ref || ref->refersToEnclosingVariableOrCapture()) {
+    return nullptr;
+  }
+  const auto *var = clang::dyn_cast<clang::VarDecl>(ref->getDecl());
+  if (!var || !var->hasLocalStorage() || clang::isa<clang::ParmVarDecl>(var) ||
+      var->getType()->isReferenceType()) {
+    return nullptr;
+  }
+  return var;
+}
+
+const clang::DeclStmt *
+ModernASTVisitor::findDeclaringStatement(const clang::VarDecl *var) const {
+  auto parents = context_.getParents(*var);
+  const auto *decl_stmt =
+      parents.empty() ? nullptr : parents[0].get<clang::DeclStmt>();
+  if (!decl_stmt || decl_stmt->getBeginLoc().isMacroID() ||
+      decl_stmt->getEndLoc().isMacroID()) {
+    return nullptr;
+  }
+  auto stmt_parents = context_.getParents(*decl_stmt);
+  if (stmt_parents.empty() || !stmt_parents[0].get<clang::CompoundStmt>()) {
+    return nullptr;
+  }
+  return decl_stmt;
+}
+
+bool ModernASTVisitor::transformGrowthCall(const clang::CXXMemberCallExpr *expr,
+                                           const clang::VarDecl *var,
+                                           const clang::DeclStmt *decl_stmt) {
+  std::string tracker = "__optiweave_growth_" + var->getName().str();
+
+  // The tracker is named after the variable, so it is shadowed exactly
+  // where the variable is
+  if (growth_tracked_.insert(var).second) {
+    auto &source_manager = context_.getSourceManager();
+    unsigned column = source_manager.getExpansionColumnNumber(var->getLocation());
+    if (rewriter_.InsertTextAfterToken(
+            decl_stmt->getEndLoc(),
+            " optiweave::GrowthTracker " + tracker + "(" +
+                var->getName().str() + ", __optiweave_site(" +
+                std::to_string(column) + "));")) {
+      llvm::errs() << "Error: Failed to declare container growth tracker\n";
+      return false;
+    }
+  }
+
+  // v.push_back(x) becomes tracker.observe(v)->push_back(x); the
+  // observation checks the capacity once the call has returned
+  const auto *member = clang::cast<clang::MemberExpr>(
+      expr->getCallee()->IgnoreParens());
+  const clang::Expr *base = member->getBase();
+  if (rewriter_.ReplaceText(base->getSourceRange(),
+                            tracker + ".observe(" + getOperandText(base) +
+                                ")") ||
+      rewriter_.ReplaceText(member->getOperatorLoc(), 1, "->")) {
+    llvm::errs() << "Error: Failed to apply container growth transformation\n";
+    return false;
+  }
+  return true;
+}
+
+bool ModernASTVisitor::insertReserve(const clang::VarDecl *var,
+                                     const clang::DeclStmt *decl_stmt) {
+  // Keyed like the tracker's site: the column of the variable and the line
+  // the declaration ends on
+  auto &source_manager = context_.getSourceManager();
+  auto location = source_manager.getExpansionLoc(var->getLocation());
+  const ReserveAdvice *advice = config_.reserve_advice->find(
+      source_manager.getFilename(location).str(),
+      source_manager.getExpansionLineNumber(decl_stmt->getEndLoc()),
+      source_manager.getExpansionColumnNumber(location));
+  if (!advice || !advice->stable || advice->reserve == 0) {
+    return false;
+  }
+  return !rewriter_.InsertTextAfterToken(
+      decl_stmt->getEndLoc(), " " + var->getName().str() + ".reserve(" +
+                                  std::to_string(advice->reserve) + ");");
+}
+
+bool ModernASTVisitor::isAllocatingContainer(clang::QualType type) const {
+  const auto *record = type.getNonReferenceType()->getAsCXXRecordDecl();
+  if (!record || !record->isInStdNamespace() || !record->getIdentifier() ||
+      !clang::isa<clang::ClassTemplateSpecializationDecl>(record)) {
+    return false;
+  }
+  return llvm::StringSwitch<bool>(record->getName())
+      .Cases("vector", "basic_string", "deque", "list", "forward_list", true)
+      .Cases("map", "multimap", "set", "multiset", true)
+      .Cases("unordered_map", "unordered_multimap", "unordered_set",
+             "unordered_multiset", true)
+      .Default(false);
+}
+
+unsigned ModernASTVisitor::loopDepth(const clang::Stmt *stmt) const {
+  unsigned depth = 0;
+  const clang::Stmt *child = stmt;
+  auto node = clang::DynTypedNode::create(*stmt);
+  while (true) {
+    auto parents = context_.getParents(node);
+    if (parents.empty()) {
+      break;
+    }
+    node = parents[0];
+    // A lambda body runs when it is called, not where it is written
+    if (node.get<clang::FunctionDecl>() || node.get<clang::LambdaExpr>()) {
+      break;
+    }
+    const auto *parent = node.get<clang::Stmt>();
+    if (!parent) {
+      continue;
+    }
+    if (const auto *loop = clang::dyn_cast<clang::ForStmt>(parent)) {
+      depth += child != loop->getInit();
+    } else if (const auto *loop =
+                   clang::dyn_cast<clang::CXXForRangeStmt>(parent)) {
+      depth += child != loop->getInit() && child != loop->getRangeStmt() &&
+               child != loop->getBeginStmt() && child != loop->getEndStmt();
+    } else if (clang::isa<clang::WhileStmt, clang::DoStmt>(parent)) {
+      ++depth;
+    }
+    child = parent;
+  }
+  return depth;
+}
+
+std::string
+ModernASTVisitor::generateAllocationSite(const clang::Stmt *stmt) const {
+  auto &source_manager = context_.getSourceManager();
+  unsigned column = source_manager.getExpansionColumnNumber(stmt->getBeginLoc());
+  // The prelude keeps eight bits for the depth
+  unsigned depth = std::min(loopDepth(stmt), 255u);
+  if (depth == 0) {
+    return "__optiweave_site(" + std::to_string(column) + ")";
+  }
+  return "__optiweave_site_loop(" + std::to_string(column) + ", " +
+         std::to_string(depth) + ")";
+}
+
+const BranchProfile *
+ModernASTVisitor::findBranchProfile(const clang::BinaryOperator *expr) const {
+  auto &source_manager = context_.getSourceManager();
+  auto location = source_manager.getExpansionLoc(expr->getBeginLoc());
+  return config_.branch_profile->find(
+      source_manager.getFilename(location).str(),
+      source_manager.getExpansionLineNumber(location),
+      source_manager.getExpansionColumnNumber(location));
+}
+
+std::string ModernASTVisitor::generatePrefetch(
+    const clang::ArraySubscriptExpr *expr, const PrefetchAdvice &advice,
+    llvm::StringRef lhs_text, llvm::StringRef rhs_text,
+    llvm::StringRef access_text) const {
+  // The operands are evaluated once more for the prefetch address
+  if (expr->getBase()->HasSideEffects(context_) ||
+      expr->getIdx()->HasSideEffects(context_) ||
+      expr->getType()->isDependentType() ||
+      expr->getType()->isIncompleteType()) {
+    return "";
   }
 
+  std::int64_t element_size =
+      context_.getTypeSizeInChars(expr->getType()).getQuantity();
+  std::int64_t ahead =
+      static_cast<std::int64_t>(advice.distance) * advice.stride_bytes;
+
+  std::ostringstream oss;
+  oss << "(__builtin_prefetch(";
+  if (element_size > 0 && ahead % element_size == 0) {
+    oss << "&(" << lhs_text.str() << ")[(" << rhs_text.str() << ") + ("
+        << ahead / element_size << ")]";
+  } else {
+    oss << "reinterpret_cast<const char *>(&(" << lhs_text.str() << ")[("
+        << rhs_text.str() << ")]) + (" << ahead << ")";
+  }
+  oss << "), " << access_text.str() << ")";
   return oss.str();
 }
 
+std::string
+ModernASTVisitor::generateSiteArgument(const clang::Expr *expr) const {
+  // The runtime takes file, function and line from std::source_location at
+  // the call site; only the column changes once the line is rewritten.
+  auto &source_manager = context_.getSourceManager();
+  unsigned column = source_manager.getExpansionColumnNumber(expr->getBeginLoc());
+  const char *macro =
+      isStoreTarget(expr) ? "__optiweave_site_write(" : "__optiweave_site(";
+  return macro + std::to_string(column) + ")";
+}
+
+bool ModernASTVisitor::isStoreTarget(const clang::Expr *expr) const {
+  const clang::Expr *current = expr;
+  for (;;) {
+    auto parents = context_.getParents(*current);
+    if (parents.size() != 1) {
+      return false;
+    }
+    const auto *parent = parents[0].get<clang::Expr>();
+    if (!parent) {
+      return false;
+    }
+
+    // a[i].x = v stores into a[i] as much as a[i] = v does
+    if (clang::isa<clang::ParenExpr>(parent) ||
+        clang::isa<clang::ImplicitCastExpr>(parent) ||
+        clang::isa<clang::ArraySubscriptExpr>(parent)) {
+      if (const auto *cast = clang::dyn_cast<clang::ImplicitCastExpr>(parent);
+          cast && cast->getCastKind() == clang::CK_LValueToRValue) {
+        return false;
+      }
+      if (const auto *subscript =
+              clang::dyn_cast<clang::ArraySubscriptExpr>(parent);
+          subscript && subscript->getBase()->IgnoreParenImpCasts() !=
+                           current->IgnoreParenImpCasts()) {
+        return false; // used as the index
+      }
+      current = parent;
+      continue;
+    }
+    if (const auto *call = clang::dyn_cast<clang::CXXOperatorCallExpr>(parent)) {
+      bool is_object = call->getNumArgs() > 0 &&
+                       call->getArg(0)->IgnoreParenImpCasts() ==
+                           current->IgnoreParenImpCasts();
+      if (call->getOperator() == clang::OO_Subscript && is_object) {
+        current = parent; // v[i][j] = x stores into v[i] too
+        continue;
+      }
+      // Class-type elements are assigned through operator=, +=, ...
+      return call->isAssignmentOp() && is_object;
+    }
+    if (const auto *member = clang::dyn_cast<clang::MemberExpr>(parent)) {
+      if (member->isArrow()) {
+        return false; // a[i]->x stores through the pointer, not into a[i]
+      }
+      current = parent;
+      continue;
+    }
+
+    if (const auto *binary = clang::dyn_cast<clang::BinaryOperator>(parent)) {
+      return binary->isAssignmentOp() &&
+             binary->getLHS()->IgnoreParens() == current->IgnoreParens();
+    }
+    if (const auto *unary = clang::dyn_cast<clang::UnaryOperator>(parent)) {
+      return unary->isIncrementDecrementOp();
+    }
+    return false;
+  }
+}
+
 bool ModernASTVisitor::isTemplateDependentType(clang::QualType type) const {
   return type->isDependentType() || type->isInstantiationDependentType() ||
          type->isTemplateTypeParmType() || type->isUndeducedType();
@@ -331,11 +1863,28 @@ std::string ModernASTVisitor::getSourceText(clang::SourceRange range) const {
   return text.str();
 }
 
+std::string ModernASTVisitor::getOperandText(const clang::Expr *expr) const {
+  // Post-order traversal rewrites inner expressions first; build on their
+  // replacements rather than on the original text
+  std::string text = rewriter_.getRewrittenText(expr->getSourceRange());
+  return text.empty() ? getSourceText(expr->getSourceRange()) : text;
+}
+
+void ModernASTVisitor::reportMemory(MemoryReport &report) const {
+  report.add("Processed ranges", processed_ranges_memory_,
+             processed_ranges_.size(), "ranges");
+  report.add("Class index", class_index_memory_, polymorphic_classes_.size(),
+             "classes");
+  report.add("Tracked containers", tracked_containers_memory_,
+             growth_tracked_.size() + reserved_.size(), "variables");
+}
+
 // TransformationConsumer implementation
 TransformationConsumer::TransformationConsumer(
     clang::Rewriter &rewriter, clang::ASTContext &context,
     const TransformationConfig &config)
-    : context_(context) {
+    : rewriter_(rewriter), context_(context),
+      account_memory_(config.account_memory) {
   visitor_ = std::make_unique<ModernASTVisitor>(rewriter, context, config);
 }
 
@@ -344,6 +1893,15 @@ void TransformationConsumer::HandleTranslationUnit(clang::ASTContext &
   // Set traversal scope to the entire translation unit
   context.setTraversalScope({context.getTranslationUnitDecl()});
 
+  if (account_memory_) {
+    // The parent map is built on the first getParents() query and has no
+    // size API; charge it the heap growth of building it up front
+    std::size_t before = heapBytesInUse();
+    context.getParents(*context.getTranslationUnitDecl());
+    std::size_t after = heapBytesInUse();
+    parent_map_bytes_ = after > before ? after - before : 0;
+  }
+
   // Traverse the AST
   visitor_->TraverseDecl(context.getTranslationUnitDecl());
 
@@ -356,4 +1914,32 @@ const TransformationStats &TransformationConsumer::getStats() const {
   return visitor_->getStats();
 }
 
+MemoryReport TransformationConsumer::getMemoryReport() const {
+  MemoryReport report;
+  report.add("AST", context_.getASTAllocatedMemory());
+  report.add("AST side tables", context_.getSideTableAllocatedMemory());
+  if (parent_map_bytes_ > 0) {
+    report.add("Parent map", parent_map_bytes_);
+  }
+
+  const clang::SourceManager &sm = context_.getSourceManager();
+  report.add("Source manager",
+             sm.getContentCacheSize() + sm.getDataStructureSizes(),
+             sm.fileinfo_size(), "files");
+  clang::SourceManager::MemoryBufferSizes buffers = sm.getMemoryBufferSizes();
+  report.add("Source buffers", buffers.malloc_bytes + buffers.mmap_bytes);
+
+  std::size_t rewritten = 0;
+  std::size_t rewritten_files = 0;
+  for (auto it = rewriter_.buffer_begin(); it != rewriter_.buffer_end();
+       ++it) {
+    rewritten += it->second.size();
+    ++rewritten_files;
+  }
+  report.add("Rewrite buffers", rewritten, rewritten_files, "files");
+
+  visitor_->reportMemory(report);
+  return report;
+}
+
 } // namespace optiweave::core
\ No newline at end of file
@@ -0,0 +1,39 @@
+#include "../../include/optiweave/core/branch_profile.hpp"
+
+namespace optiweave::core {
+
+int BranchProfile::bias(double threshold) const {
+  std::uint64_t total = true_count + false_count;
+  if (total < kMinEvaluations) {
+    return 0;
+  }
+  if (static_cast<double>(true_count) >= threshold * total) {
+    return 1;
+  }
+  if (static_cast<double>(false_count) >= threshold * total) {
+    return -1;
+  }
+  return 0;
+}
+
+bool BranchProfileTable::load(const std::string &path, std::string &error) {
+  // file line column function operation true false ...
+  return readProfile(
+      path, 7,
+      [this](const ProfileRow &row) {
+        // Several instantiations of a template share the original location
+        BranchProfile &profile = entries_[row.site];
+        profile.true_count += std::stoull(row.fields[5]);
+        profile.false_count += std::stoull(row.fields[6]);
+      },
+      error);
+}
+
+const BranchProfile *BranchProfileTable::find(std::string_view file,
+                                              unsigned line,
+                                              unsigned column) const {
+  auto found = entries_.find(makeProfileSite(file, line, column));
+  return found == entries_.end() ? nullptr : &found->second;
+}
+
+} // namespace optiweave::core
@@ -0,0 +1,107 @@
+#include "../../include/optiweave/core/memory_accounting.hpp"
+
+#include <cstdio>
+#include <utility>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace optiweave::core {
+
+void MemoryReport::add(std::string subsystem, std::size_t bytes,
+                       std::size_t count, std::string unit) {
+  entries_.push_back({std::move(subsystem), bytes, count, std::move(unit)});
+}
+
+void MemoryReport::add(std::string subsystem, const MemoryAccount &account,
+                       std::size_t count, std::string unit) {
+  add(std::move(subsystem), account.bytes, count, std::move(unit));
+}
+
+std::size_t MemoryReport::totalBytes() const {
+  std::size_t total = 0;
+  for (const MemoryEntry &entry : entries_) {
+    total += entry.bytes;
+  }
+  return total;
+}
+
+std::string MemoryReport::format() const {
+  std::string text;
+  for (const MemoryEntry &entry : entries_) {
+    text += "  " + entry.subsystem + ": " + formatBytes(entry.bytes);
+    if (!entry.unit.empty()) {
+      text += " (" + std::to_string(entry.count) + " " + entry.unit + ")";
+    }
+    text += "\n";
+  }
+  text += "  Total: " + formatBytes(totalBytes()) + "\n";
+  return text;
+}
+
+void MemoryPeak::record(const std::string &file, const MemoryReport &report) {
+  for (const MemoryEntry &entry : report.entries()) {
+    Peak *peak = nullptr;
+    for (Peak &existing : peaks_) {
+      if (existing.subsystem == entry.subsystem) {
+        peak = &existing;
+        break;
+      }
+    }
+    if (!peak) {
+      peaks_.push_back({entry.subsystem, 0, ""});
+      peak = &peaks_.back();
+    }
+    if (entry.bytes > peak->bytes || peak->file.empty()) {
+      peak->bytes = entry.bytes;
+      peak->file = file;
+    }
+  }
+  std::size_t total = report.totalBytes();
+  if (total > largest_bytes_ || largest_file_.empty()) {
+    largest_bytes_ = total;
+    largest_file_ = file;
+  }
+}
+
+std::string MemoryPeak::format() const {
+  std::string text;
+  for (const Peak &peak : peaks_) {
+    text += "  " + peak.subsystem + ": " + formatBytes(peak.bytes) + " (" +
+            peak.file + ")\n";
+  }
+  if (!largest_file_.empty()) {
+    text += "  Largest translation unit: " + largest_file_ + ", " +
+            formatBytes(largest_bytes_) + "\n";
+  }
+  return text;
+}
+
+std::string formatBytes(std::size_t bytes) {
+  static const char *const kUnits[] = {"KiB", "MiB", "GiB"};
+  if (bytes < 1024) {
+    return std::to_string(bytes) + " B";
+  }
+  double value = static_cast<double>(bytes) / 1024;
+  std::size_t unit = 0;
+  while (value >= 1024 && unit + 1 < sizeof(kUnits) / sizeof(kUnits[0])) {
+    value /= 1024;
+    ++unit;
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.1f %s", value, kUnits[unit]);
+  return text;
+}
+
+std::size_t heapBytesInUse() {
+#if defined(__GLIBC__) &&                                                      \
+    (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+} // namespace optiweave::core
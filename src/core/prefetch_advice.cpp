@@ -0,0 +1,31 @@
+#include "../../include/optiweave/core/prefetch_advice.hpp"
+
+#include <stdexcept>
+
+namespace optiweave::core {
+
+bool PrefetchAdviceTable::load(const std::string &path, std::string &error) {
+  // file line column function stride_bytes distance ...
+  return readProfile(
+      path, 6,
+      [this](const ProfileRow &row) {
+        PrefetchAdvice advice;
+        advice.stride_bytes = std::stoll(row.fields[4]);
+        advice.distance =
+            static_cast<std::uint32_t>(std::stoul(row.fields[5]));
+        if (advice.stride_bytes == 0 || advice.distance == 0) {
+          throw std::invalid_argument("zero stride or distance");
+        }
+        entries_[row.site] = advice;
+      },
+      error);
+}
+
+const PrefetchAdvice *PrefetchAdviceTable::find(std::string_view file,
+                                                unsigned line,
+                                                unsigned column) const {
+  auto found = entries_.find(makeProfileSite(file, line, column));
+  return found == entries_.end() ? nullptr : &found->second;
+}
+
+} // namespace optiweave::core
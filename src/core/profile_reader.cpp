@@ -0,0 +1,63 @@
+#include "../../include/optiweave/core/profile_reader.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace optiweave::core {
+namespace {
+std::vector<std::string> splitTabs(const std::string &line) {
+  std::vector<std::string> fields;
+  std::string field;
+  std::istringstream stream(line);
+  while (std::getline(stream, field, '\t')) {
+    fields.push_back(field);
+  }
+  return fields;
+}
+} // namespace
+
+ProfileSite makeProfileSite(std::string_view file, unsigned line,
+                            unsigned column) {
+  auto slash = file.find_last_of("/\\");
+  return {std::string(slash == std::string_view::npos
+                          ? file
+                          : file.substr(slash + 1)),
+          line, column};
+}
+
+bool readProfile(const std::string &path, std::size_t min_fields,
+                 const std::function<void(const ProfileRow &)> &handle_row,
+                 std::string &error) {
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::string line;
+  std::size_t number = 0;
+  while (std::getline(in, line)) {
+    if (++number == 1 || line.empty()) {
+      continue;
+    }
+    ProfileRow row;
+    row.fields = splitTabs(line);
+    try {
+      if (row.fields.size() < std::max<std::size_t>(min_fields, 3)) {
+        throw std::invalid_argument("too few fields");
+      }
+      auto site_line = static_cast<unsigned>(std::stoul(row.fields[1]));
+      auto site_column = static_cast<unsigned>(std::stoul(row.fields[2]));
+      row.site = makeProfileSite(row.fields[0], site_line, site_column);
+      handle_row(row);
+    } catch (const std::exception &e) {
+      error = path + ":" + std::to_string(number) + ": " + e.what();
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace optiweave::core
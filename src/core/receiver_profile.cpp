@@ -0,0 +1,44 @@
+#include "../../include/optiweave/core/receiver_profile.hpp"
+
+#include <cmath>
+
+namespace optiweave::core {
+
+bool ReceiverProfile::guardable(double threshold) const {
+  return !dominant.empty() && calls >= kMinCalls &&
+         static_cast<double>(dominant_calls) >= threshold * calls;
+}
+
+bool ReceiverProfileTable::load(const std::string &path, std::string &error) {
+  // file line column function static_type calls shape dominant
+  // dominant_share receivers
+  return readProfile(
+      path, 9,
+      [this](const ProfileRow &row) {
+        std::uint64_t calls = std::stoull(row.fields[5]);
+        auto dominant_calls = static_cast<std::uint64_t>(std::llround(
+            std::stod(row.fields[8]) * static_cast<double>(calls)));
+
+        // Instantiations of a template share the call; a guard only fits
+        // them all if they favour the same type
+        auto [entry, inserted] = entries_.try_emplace(row.site);
+        ReceiverProfile &profile = entry->second;
+        if (inserted) {
+          profile.dominant = row.fields[7];
+        } else if (profile.dominant != row.fields[7]) {
+          profile.dominant.clear();
+        }
+        profile.calls += calls;
+        profile.dominant_calls += dominant_calls;
+      },
+      error);
+}
+
+const ReceiverProfile *ReceiverProfileTable::find(std::string_view file,
+                                                  unsigned line,
+                                                  unsigned column) const {
+  auto found = entries_.find(makeProfileSite(file, line, column));
+  return found == entries_.end() ? nullptr : &found->second;
+}
+
+} // namespace optiweave::core
@@ -0,0 +1,36 @@
+#include "../../include/optiweave/core/reserve_advice.hpp"
+
+#include <algorithm>
+
+namespace optiweave::core {
+
+bool ReserveAdviceTable::load(const std::string &path, std::string &error) {
+  // file line column function instances reallocations mean min median p90
+  // max stable reserve
+  return readProfile(
+      path, 13,
+      [this](const ProfileRow &row) {
+        ReserveAdvice advice{std::stoull(row.fields[12]),
+                             std::stoi(row.fields[11]) != 0};
+
+        // Instantiations of a template share the declaration; they stay
+        // stable only if they all settle on the same size
+        auto [entry, inserted] = entries_.emplace(row.site, advice);
+        if (!inserted) {
+          ReserveAdvice &merged = entry->second;
+          merged.stable = merged.stable && advice.stable &&
+                          merged.reserve == advice.reserve;
+          merged.reserve = std::max(merged.reserve, advice.reserve);
+        }
+      },
+      error);
+}
+
+const ReserveAdvice *ReserveAdviceTable::find(std::string_view file,
+                                              unsigned line,
+                                              unsigned column) const {
+  auto found = entries_.find(makeProfileSite(file, line, column));
+  return found == entries_.end() ? nullptr : &found->second;
+}
+
+} // namespace optiweave::core
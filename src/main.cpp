@@ -1,4 +1,9 @@
 #include "../include/optiweave/core/ast_visitor.hpp"
+#include "../include/optiweave/core/branch_profile.hpp"
+#include "../include/optiweave/core/memory_accounting.hpp"
+#include "../include/optiweave/core/receiver_profile.hpp"
+#include "../include/optiweave/core/reserve_advice.hpp"
+#include "../include/optiweave/core/prefetch_advice.hpp"
 #include "../include/optiweave/core/rewriter.hpp"
 
 #include <clang/Frontend/CompilerInstance.h>
@@ -8,8 +13,13 @@
 #include <clang/Tooling/Tooling.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
 #include <llvm/Support/Path.h>
+#include <llvm/Support/Regex.h>
 
+#include <sys/resource.h>
+
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -27,6 +37,18 @@ static cl::opt<bool> TransformArraySubscripts(
     cl::desc("Transform array subscript expressions (default: true)"),
     cl::init(true), cl::cat(OptiWeaveCategory));
 
+static cl::opt<bool> FuseSubscripts(
+    "fuse-subscripts",
+    cl::desc("Instrument a[i][j]... on multi-dimensional arrays as one access "
+             "recording every index (default: true)"),
+    cl::init(true), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> FusePointerChains(
+    "fuse-pointer-chains",
+    cl::desc("Also fuse subscript chains through row pointers (T **), "
+             "dropping the row pointer loads from the events"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
 static cl::opt<bool> TransformArithmetic(
     "arithmetic-ops",
     cl::desc("Transform arithmetic operators (+, -, *, /, %)"), cl::init(false),
@@ -42,6 +64,62 @@ static cl::opt<bool> TransformComparison(
     cl::desc("Transform comparison operators (<, >, ==, !=, etc.)"),
     cl::init(false), cl::cat(OptiWeaveCategory));
 
+static cl::opt<bool> LoopTrips(
+    "loop-trips",
+    cl::desc("Count the iterations of for loops with a ++/-- increment; "
+             "histograms with OPTIWEAVE_LOOPS=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> ProbeFunctions(
+    "probe-functions",
+    cl::desc("Insert an entry/exit probe into function bodies; call-path "
+             "profile with OPTIWEAVE_PROFILE=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<std::string> ProbeFilter(
+    "probe-filter",
+    cl::desc("Only probe functions whose qualified name matches this regex"),
+    cl::value_desc("regex"), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> TrackAllocations(
+    "allocations",
+    cl::desc("Record new/delete, malloc/free and standard container "
+             "constructions with their loop depth; report with "
+             "OPTIWEAVE_ALLOCATIONS=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> ContainerGrowth(
+    "container-growth",
+    cl::desc("Track peak sizes and reallocations of local vectors and "
+             "strings grown with push_back/emplace_back/append; report with "
+             "OPTIWEAVE_GROWTH=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> TrackCopies(
+    "copies",
+    cl::desc("Record copy constructions and copy assignments of large or "
+             "heap-owning types; report with OPTIWEAVE_COPIES=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<unsigned> CopyThreshold(
+    "copy-threshold",
+    cl::desc("Size in bytes from which --copies records a copy of a type "
+             "without heap-owning members (default: 64)"),
+    cl::init(64), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> VirtualCalls(
+    "virtual-calls",
+    cl::desc("Record the dynamic receiver types of virtual calls; report "
+             "with OPTIWEAVE_DISPATCH=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> HashLookups(
+    "hash-lookups",
+    cl::desc("Probe find, insert and operator[] on unordered containers for "
+             "load factor, chain length and rehashes; report with "
+             "OPTIWEAVE_HASH=1"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
 static cl::opt<std::string>
     PreludePath("prelude",
                 cl::desc("Path to custom prelude header (default: built-in)"),
@@ -52,6 +130,45 @@ static cl::opt<std::string> OutputDir(
     cl::desc("Output directory for transformed files (default: overwrite)"),
     cl::value_desc("directory"), cl::cat(OptiWeaveCategory));
 
+static cl::opt<std::string> InsertPrefetch(
+    "insert-prefetch",
+    cl::desc("Insert __builtin_prefetch at the subscripts listed in an advice "
+             "file written by the runtime (OPTIWEAVE_PREFETCH=1)"),
+    cl::value_desc("advice-file"), cl::cat(OptiWeaveCategory));
+
+static cl::opt<std::string> AnnotateBranches(
+    "annotate-branches",
+    cl::desc("Add [[likely]]/[[unlikely]] to if statements whose comparison "
+             "is biased in a profile written by the runtime "
+             "(OPTIWEAVE_BRANCHES=1)"),
+    cl::value_desc("profile"), cl::cat(OptiWeaveCategory));
+
+static cl::opt<std::string> InsertReserve(
+    "insert-reserve",
+    cl::desc("Reserve capacity after the declarations of containers that "
+             "reached the same size in every instance of a growth report "
+             "written by the runtime (OPTIWEAVE_GROWTH=1)"),
+    cl::value_desc("report"), cl::cat(OptiWeaveCategory));
+
+static cl::opt<std::string> Devirtualize(
+    "devirtualize",
+    cl::desc("Guard virtual calls whose receivers are mostly of one type in "
+             "a profile written by the runtime (OPTIWEAVE_DISPATCH=1) with "
+             "a typeid check and a direct call"),
+    cl::value_desc("profile"), cl::cat(OptiWeaveCategory));
+
+static cl::opt<double> GuardThreshold(
+    "guard-threshold",
+    cl::desc("Share of calls the dominant receiver type needs before "
+             "--devirtualize guards a call (default: 0.9)"),
+    cl::init(0.9), cl::cat(OptiWeaveCategory));
+
+static cl::opt<double> BranchThreshold(
+    "branch-threshold",
+    cl::desc("Share of evaluations one outcome needs before "
+             "--annotate-branches marks it likely (default: 0.9)"),
+    cl::init(0.9), cl::cat(OptiWeaveCategory));
+
 static cl::opt<bool> SkipSystemHeaders(
     "skip-system-headers",
     cl::desc("Skip transformations in system headers (default: true)"),
@@ -68,15 +185,63 @@ static cl::opt<bool>
     DryRun("dry-run", cl::desc("Parse and analyze without writing changes"),
            cl::init(false), cl::cat(OptiWeaveCategory));
 
+static cl::opt<bool> TimePhases(
+    "time-phases",
+    cl::desc("Print parse, transform and write time per translation unit"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
+static cl::opt<bool> MemoryStats(
+    "memory-stats",
+    cl::desc("Print the tool's memory by subsystem per translation unit, "
+             "and the peak over the run"),
+    cl::init(false), cl::cat(OptiWeaveCategory));
+
 namespace optiweave {
 
+/**
+ * @brief When each phase of one translation unit ended, for --time-phases
+ */
+struct PhaseTimes {
+  using Clock = std::chrono::steady_clock;
+
+  Clock::time_point begin;
+  Clock::time_point parsed;      ///< AST complete, traversal starting
+  Clock::time_point transformed; ///< Traversal done, rewrites pending
+};
+
+/**
+ * @brief Forwards to the transformation consumer and notes when parsing
+ * and the traversal finish
+ */
+class PhaseTimingConsumer : public ASTConsumer {
+public:
+  PhaseTimingConsumer(std::unique_ptr<ASTConsumer> consumer, PhaseTimes &times)
+      : consumer_(std::move(consumer)), times_(times) {}
+
+  void HandleTranslationUnit(ASTContext &context) override {
+    times_.parsed = PhaseTimes::Clock::now();
+    consumer_->HandleTranslationUnit(context);
+    times_.transformed = PhaseTimes::Clock::now();
+  }
+
+private:
+  std::unique_ptr<ASTConsumer> consumer_;
+  PhaseTimes &times_;
+};
+
 /**
  * @brief Frontend action for OptiWeave transformations
  */
 class OptiWeaveFrontendAction : public ASTFrontendAction {
 public:
-  explicit OptiWeaveFrontendAction(const core::TransformationConfig &config)
-      : config_(config) {}
+  OptiWeaveFrontendAction(const core::TransformationConfig &config,
+                          core::MemoryPeak &memory_peak)
+      : config_(config), memory_peak_(memory_peak) {}
+
+  bool BeginSourceFileAction(CompilerInstance &CI) override {
+    times_.begin = PhaseTimes::Clock::now();
+    return ASTFrontendAction::BeginSourceFileAction(CI);
+  }
 
   std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
                                                  StringRef file) override {
@@ -88,11 +253,48 @@ public:
     rewriter_.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
 
     // Create consumer with configuration
-    return std::make_unique<core::TransformationConsumer>(
+    auto consumer = std::make_unique<core::TransformationConsumer>(
         rewriter_, CI.getASTContext(), config_);
+    consumer_ = consumer.get();
+    if (TimePhases) {
+      return std::make_unique<PhaseTimingConsumer>(std::move(consumer),
+                                                   times_);
+    }
+    return consumer;
   }
 
   void EndSourceFileAction() override {
+    // The compiler instance still owns the consumer and the AST here
+    if (MemoryStats && consumer_) {
+      core::MemoryReport report = consumer_->getMemoryReport();
+      llvm::errs() << "=== Memory: " << getCurrentFile() << " ===\n"
+                   << report.format();
+      memory_peak_.record(getCurrentFile().str(), report);
+    }
+
+    writeChangedFiles();
+
+    if (TimePhases) {
+      auto seconds = [](PhaseTimes::Clock::duration d) {
+        return std::chrono::duration<double>(d).count();
+      };
+      auto written = PhaseTimes::Clock::now();
+      llvm::errs() << "=== Phase Times: " << getCurrentFile() << " ===\n";
+      llvm::errs() << "  Parse: "
+                   << llvm::format("%.6f", seconds(times_.parsed - times_.begin))
+                   << " s\n";
+      llvm::errs() << "  Transform: "
+                   << llvm::format("%.6f",
+                                   seconds(times_.transformed - times_.parsed))
+                   << " s\n";
+      llvm::errs() << "  Write: "
+                   << llvm::format("%.6f", seconds(written - times_.transformed))
+                   << " s\n";
+    }
+  }
+
+private:
+  void writeChangedFiles() {
     auto &source_manager = rewriter_.getSourceMgr();
 
     if (DryRun) {
@@ -140,9 +342,11 @@ public:
     }
   }
 
-private:
   Rewriter rewriter_;
   core::TransformationConfig config_;
+  PhaseTimes times_;
+  core::MemoryPeak &memory_peak_;
+  core::TransformationConsumer *consumer_ = nullptr; // owned by the CI
 };
 
 /**
@@ -150,18 +354,34 @@ private:
  */
 class OptiWeaveFrontendActionFactory : public FrontendActionFactory {
 public:
-  explicit OptiWeaveFrontendActionFactory(
-      const core::TransformationConfig &config)
-      : config_(config) {}
+  OptiWeaveFrontendActionFactory(const core::TransformationConfig &config,
+                                 core::MemoryPeak &memory_peak)
+      : config_(config), memory_peak_(memory_peak) {}
 
   std::unique_ptr<FrontendAction> create() override {
-    return std::make_unique<OptiWeaveFrontendAction>(config_);
+    return std::make_unique<OptiWeaveFrontendAction>(config_, memory_peak_);
   }
 
 private:
   core::TransformationConfig config_;
+  core::MemoryPeak &memory_peak_;
 };
 
+/**
+ * @brief Peak resident set size of the process, for --memory-stats
+ */
+std::size_t peakResidentBytes() {
+  struct rusage usage {};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<std::size_t>(usage.ru_maxrss); // bytes
+#else
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024; // KiB
+#endif
+}
+
 /**
  * @brief Setup include paths for prelude
  */
@@ -247,6 +467,45 @@ Usage Examples:
   # Use custom prelude and output directory
   optiweave --prelude=my_prelude.hpp --output-dir=./transformed source.cpp --
 
+  # Profile strided streams, then insert prefetches into the original source
+  OPTIWEAVE_PREFETCH=1 OPTIWEAVE_PREFETCH_ADVICE=advice.tsv ./instrumented
+  optiweave --array-subscripts=false --insert-prefetch=advice.tsv source.cpp --
+
+  # Profile comparisons, then annotate biased branches in the original source
+  OPTIWEAVE_BRANCHES=1 OPTIWEAVE_BRANCHES_REPORT=branches.tsv ./instrumented
+  optiweave --array-subscripts=false --annotate-branches=branches.tsv source.cpp --
+
+  # Flame graph of the functions in one namespace
+  optiweave --array-subscripts=false --probe-functions \
+            --probe-filter='^engine::' source.cpp --
+  OPTIWEAVE_PROFILE=1 OPTIWEAVE_PROFILE_FOLDED=out.folded ./instrumented
+  flamegraph.pl out.folded > flame.svg
+
+  # Find allocations inside hot loops
+  optiweave --array-subscripts=false --allocations source.cpp --
+  OPTIWEAVE_ALLOCATIONS=1 ./instrumented
+
+  # Profile vector/string growth, then reserve stable sizes in the source
+  optiweave --array-subscripts=false --container-growth source.cpp --
+  OPTIWEAVE_GROWTH=1 OPTIWEAVE_GROWTH_REPORT=growth.tsv ./instrumented
+  optiweave --array-subscripts=false --insert-reserve=growth.tsv source.cpp --
+
+  # Find deep copies, and copies that could be moves
+  optiweave --array-subscripts=false --copies --copy-threshold=256 source.cpp --
+  OPTIWEAVE_COPIES=1 ./instrumented
+
+  # Profile virtual call receivers, then guard the monomorphic ones
+  optiweave --array-subscripts=false --virtual-calls source.cpp --
+  OPTIWEAVE_DISPATCH=1 OPTIWEAVE_DISPATCH_REPORT=dispatch.tsv ./instrumented
+  optiweave --array-subscripts=false --devirtualize=dispatch.tsv source.cpp --
+
+  # Check load factors and hash quality of unordered containers
+  optiweave --array-subscripts=false --hash-lookups source.cpp --
+  OPTIWEAVE_HASH=1 ./instrumented
+
+  # Memory of the tool by subsystem (AST, parent map, rewrite buffers, ...)
+  optiweave --arithmetic-ops --memory-stats $(find src -name "*.cpp") --
+
   # Dry run to check what would be transformed
   optiweave --dry-run --stats --verbose source.cpp --
 
@@ -296,16 +555,91 @@ int main(int argc, const char **argv) {
   // Configure transformation
   optiweave::core::TransformationConfig config;
   config.transform_array_subscripts = TransformArraySubscripts;
+  config.fuse_subscripts = FuseSubscripts;
+  config.fuse_pointer_chains = FusePointerChains;
   config.transform_arithmetic_operators = TransformArithmetic;
   config.transform_assignment_operators = TransformAssignment;
   config.transform_comparison_operators = TransformComparison;
+  config.profile_loop_trips = LoopTrips;
+  config.probe_functions = ProbeFunctions;
+  config.probe_filter = ProbeFilter;
+  config.track_allocations = TrackAllocations;
+  config.profile_container_growth = ContainerGrowth;
+  config.track_copies = TrackCopies;
+  config.copy_threshold = CopyThreshold;
+  config.profile_virtual_calls = VirtualCalls;
+  config.profile_hash_lookups = HashLookups;
   config.skip_system_headers = SkipSystemHeaders;
+  config.account_memory = MemoryStats;
   config.prelude_path = prelude_path;
 
+  if (!InsertPrefetch.empty()) {
+    auto advice = std::make_shared<optiweave::core::PrefetchAdviceTable>();
+    std::string error;
+    if (!advice->load(InsertPrefetch, error)) {
+      llvm::errs() << "Error reading prefetch advice: " << error << "\n";
+      return 1;
+    }
+    config.prefetch_advice = std::move(advice);
+  }
+
+  if (!ProbeFilter.empty()) {
+    std::string error;
+    if (!llvm::Regex(ProbeFilter).isValid(error)) {
+      llvm::errs() << "Error: invalid --probe-filter: " << error << "\n";
+      return 1;
+    }
+  }
+
+  if (!AnnotateBranches.empty()) {
+    if (BranchThreshold <= 0.5 || BranchThreshold > 1.0) {
+      llvm::errs() << "Error: --branch-threshold must be in (0.5, 1]\n";
+      return 1;
+    }
+    auto profile = std::make_shared<optiweave::core::BranchProfileTable>();
+    std::string error;
+    if (!profile->load(AnnotateBranches, error)) {
+      llvm::errs() << "Error reading branch profile: " << error << "\n";
+      return 1;
+    }
+    config.branch_profile = std::move(profile);
+    config.branch_threshold = BranchThreshold;
+  }
+
+  if (!InsertReserve.empty()) {
+    auto advice = std::make_shared<optiweave::core::ReserveAdviceTable>();
+    std::string error;
+    if (!advice->load(InsertReserve, error)) {
+      llvm::errs() << "Error reading growth report: " << error << "\n";
+      return 1;
+    }
+    config.reserve_advice = std::move(advice);
+  }
+
+  if (!Devirtualize.empty()) {
+    if (GuardThreshold <= 0.5 || GuardThreshold > 1.0) {
+      llvm::errs() << "Error: --guard-threshold must be in (0.5, 1]\n";
+      return 1;
+    }
+    auto profile = std::make_shared<optiweave::core::ReceiverProfileTable>();
+    std::string error;
+    if (!profile->load(Devirtualize, error)) {
+      llvm::errs() << "Error reading dispatch profile: " << error << "\n";
+      return 1;
+    }
+    config.receiver_profile = std::move(profile);
+    config.guard_threshold = GuardThreshold;
+  }
+
   if (Verbose) {
     llvm::errs() << "OptiWeave Configuration:\n";
     llvm::errs() << "  Array subscripts: "
                  << (config.transform_array_subscripts ? "ON" : "OFF") << "\n";
+    llvm::errs() << "  Subscript fusion: "
+                 << (!config.fuse_subscripts       ? "OFF"
+                     : config.fuse_pointer_chains ? "ON (with pointer chains)"
+                                                  : "ON")
+                 << "\n";
     llvm::errs() << "  Arithmetic ops: "
                  << (config.transform_arithmetic_operators ? "ON" : "OFF")
                  << "\n";
@@ -315,13 +649,66 @@ int main(int argc, const char **argv) {
     llvm::errs() << "  Comparison ops: "
                  << (config.transform_comparison_operators ? "ON" : "OFF")
                  << "\n";
+    llvm::errs() << "  Loop trip counts: "
+                 << (config.profile_loop_trips ? "ON" : "OFF") << "\n";
+    llvm::errs() << "  Function probes: "
+                 << (!config.probe_functions    ? "OFF"
+                     : config.probe_filter.empty() ? "ON"
+                                                   : "ON (" +
+                                                         config.probe_filter +
+                                                         ")")
+                 << "\n";
+    llvm::errs() << "  Allocation sites: "
+                 << (config.track_allocations ? "ON" : "OFF") << "\n";
+    llvm::errs() << "  Container growth: "
+                 << (config.profile_container_growth ? "ON" : "OFF") << "\n";
+    llvm::errs() << "  Expensive copies: "
+                 << (config.track_copies
+                         ? "ON (>= " + std::to_string(config.copy_threshold) +
+                               " bytes or heap-owning)"
+                         : std::string("OFF"))
+                 << "\n";
+    llvm::errs() << "  Virtual call receivers: "
+                 << (config.profile_virtual_calls ? "ON" : "OFF") << "\n";
+    llvm::errs() << "  Hash container lookups: "
+                 << (config.profile_hash_lookups ? "ON" : "OFF") << "\n";
     llvm::errs() << "  Skip system headers: "
                  << (config.skip_system_headers ? "ON" : "OFF") << "\n";
+    llvm::errs() << "  Prefetch advice: "
+                 << (config.prefetch_advice
+                         ? InsertPrefetch.getValue() + " (" +
+                               std::to_string(config.prefetch_advice->size()) +
+                               " sites)"
+                         : std::string("none"))
+                 << "\n";
+    llvm::errs() << "  Branch profile: "
+                 << (config.branch_profile
+                         ? AnnotateBranches.getValue() + " (" +
+                               std::to_string(config.branch_profile->size()) +
+                               " sites)"
+                         : std::string("none"))
+                 << "\n";
+    llvm::errs() << "  Reserve advice: "
+                 << (config.reserve_advice
+                         ? InsertReserve.getValue() + " (" +
+                               std::to_string(config.reserve_advice->size()) +
+                               " sites)"
+                         : std::string("none"))
+                 << "\n";
+    llvm::errs() << "  Dispatch profile: "
+                 << (config.receiver_profile
+                         ? Devirtualize.getValue() + " (" +
+                               std::to_string(config.receiver_profile->size()) +
+                               " sites)"
+                         : std::string("none"))
+                 << "\n";
     llvm::errs() << "  Prelude path: "
                  << (prelude_path.empty() ? "built-in" : prelude_path) << "\n";
     llvm::errs() << "  Output directory: "
                  << (OutputDir.empty() ? "overwrite" : OutputDir.getValue())
                  << "\n";
+    llvm::errs() << "  Memory stats: " << (MemoryStats ? "ON" : "OFF")
+                 << "\n";
     llvm::errs() << "  Dry run: " << (DryRun ? "ON" : "OFF") << "\n";
   }
 
@@ -340,9 +727,18 @@ int main(int argc, const char **argv) {
   Tool.appendArgumentsAdjuster(getInsertArgumentAdjuster("-std=c++20"));
 
   // Create factory and run tool
-  optiweave::OptiWeaveFrontendActionFactory factory(config);
+  optiweave::core::MemoryPeak memory_peak;
+  optiweave::OptiWeaveFrontendActionFactory factory(config, memory_peak);
   int result = Tool.run(&factory);
 
+  if (MemoryStats) {
+    llvm::errs() << "=== Memory Peak ===\n"
+                 << memory_peak.format() << "  Peak resident set: "
+                 << optiweave::core::formatBytes(
+                        optiweave::peakResidentBytes())
+                 << "\n";
+  }
+
   if (result == 0) {
     if (Verbose) {
       llvm::errs() << "Transformation completed successfully\n";
@@ -0,0 +1,162 @@
+#include "../../include/optiweave/runtime/call_profiler.hpp"
+#include "../../include/optiweave/runtime/thread_registry.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+CallTree::CallTree() : nodes_(new CallNode[kMaxNodes]) {}
+
+void CallTree::enter(const __optiweave_site_info *function,
+                     std::uint64_t now) noexcept {
+  if (overflow_ > 0 || depth_ == kMaxDepth) {
+    ++overflow_;
+    bumpOwned(dropped_, 1);
+    return;
+  }
+
+  CallNode &parent = nodes_[current_];
+  std::uint32_t child = parent.first_child;
+  while (child != CallNode::kNone && nodes_[child].function != function) {
+    child = nodes_[child].next_sibling;
+  }
+  if (child == CallNode::kNone) {
+    std::uint32_t size = size_.load(std::memory_order_relaxed);
+    if (size == kMaxNodes) {
+      // Keep the stack balanced; the time stays with the caller
+      frames_[depth_++] = {CallNode::kNone, now};
+      bumpOwned(dropped_, 1);
+      return;
+    }
+    child = size;
+    CallNode &created = nodes_[child];
+    created.function = function;
+    created.parent = current_;
+    created.next_sibling = parent.first_child;
+    parent.first_child = child;
+    size_.store(size + 1, std::memory_order_release);
+  }
+
+  frames_[depth_++] = {current_, now};
+  current_ = child;
+}
+
+void CallTree::exit(std::uint64_t now) noexcept {
+  if (overflow_ > 0) {
+    --overflow_;
+    return;
+  }
+  if (depth_ == 0) {
+    return; // probe entered before the tree existed
+  }
+  const Frame &frame = frames_[--depth_];
+  if (frame.node == CallNode::kNone) {
+    return;
+  }
+  CallNode &node = nodes_[current_];
+  bumpOwned(node.calls, 1);
+  bumpOwned(node.cycles, now - frame.start);
+  current_ = frame.node;
+}
+
+void CallTree::unwind() noexcept {
+  depth_ = 0;
+  overflow_ = 0;
+  current_ = 0;
+}
+
+void foldCallTree(const CallTree &tree,
+                  std::map<std::string, CallPathTotals> &paths) {
+  std::uint32_t size = tree.size();
+  // Parents are created before their children, so one pass builds paths
+  std::vector<std::string> names(size);
+  std::vector<std::uint64_t> child_cycles(size, 0);
+  for (std::uint32_t i = 1; i < size; ++i) {
+    const CallNode &node = tree.node(i);
+    std::uint64_t cycles = node.cycles.load(std::memory_order_relaxed);
+    if (node.parent != 0) {
+      child_cycles[node.parent] += cycles;
+    }
+  }
+  for (std::uint32_t i = 1; i < size; ++i) {
+    const CallNode &node = tree.node(i);
+    names[i] = node.parent == 0 ? std::string(node.function->function)
+                                : names[node.parent] + ";" +
+                                      node.function->function;
+    std::uint64_t cycles = node.cycles.load(std::memory_order_relaxed);
+    CallPathTotals &totals = paths[names[i]];
+    totals.calls += node.calls.load(std::memory_order_relaxed);
+    totals.inclusive_cycles += cycles;
+    // A child still running has not added its time to the parent yet
+    totals.exclusive_cycles +=
+        cycles > child_cycles[i] ? cycles - child_cycles[i] : 0;
+  }
+}
+
+void writeProfileReport(const ThreadRegistry &threads, double ns_per_cycle,
+                        const std::string &folded_path,
+                        const std::string &report_path) {
+  std::map<std::string, CallPathTotals> paths;
+  std::uint64_t dropped = 0;
+  for (std::size_t i = 0, end = threads.highWater(); i < end; ++i) {
+    if (const CallTree *tree = threads.at(i).call_tree) {
+      foldCallTree(*tree, paths);
+      dropped += tree->dropped();
+    }
+  }
+  auto toNs = [ns_per_cycle](std::uint64_t cycles) {
+    return static_cast<std::uint64_t>(cycles * ns_per_cycle);
+  };
+
+  std::FILE *folded = std::fopen(folded_path.c_str(), "w");
+  std::FILE *report = std::fopen(report_path.c_str(), "w");
+  if (!folded || !report) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n",
+                 (folded ? report_path : folded_path).c_str());
+    if (folded) {
+      std::fclose(folded);
+    }
+    if (report) {
+      std::fclose(report);
+    }
+    return;
+  }
+  std::fprintf(report, "path\tcalls\tinclusive_ns\texclusive_ns\n");
+  std::map<std::string, std::uint64_t> exclusive_by_function;
+  for (const auto &[path, totals] : paths) {
+    std::uint64_t exclusive = toNs(totals.exclusive_cycles);
+    if (exclusive > 0) {
+      std::fprintf(folded, "%s %" PRIu64 "\n", path.c_str(), exclusive);
+    }
+    std::fprintf(report, "%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                 path.c_str(), totals.calls, toNs(totals.inclusive_cycles),
+                 exclusive);
+    std::size_t leaf = path.rfind(';');
+    exclusive_by_function[leaf == std::string::npos ? path
+                                                    : path.substr(leaf + 1)] +=
+        exclusive;
+  }
+  std::fclose(folded);
+  std::fclose(report);
+
+  std::fprintf(stderr,
+               "OptiWeave: profile: %zu call paths, %" PRIu64
+               " calls dropped, folded stacks in %s\n",
+               paths.size(), dropped, folded_path.c_str());
+  std::vector<std::pair<std::string, std::uint64_t>> hottest(
+      exclusive_by_function.begin(), exclusive_by_function.end());
+  std::sort(hottest.begin(), hottest.end(),
+            [](const auto &a, const auto &b) { return a.second > b.second; });
+  for (std::size_t i = 0; i < std::min<std::size_t>(hottest.size(), 5); ++i) {
+    std::fprintf(stderr, "OptiWeave:   %12.3f ms  %s\n",
+                 hottest[i].second / 1e6, hottest[i].first.c_str());
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,149 @@
+#include "../../include/optiweave/runtime/crash_handler.hpp"
+#include "../../include/optiweave/runtime/trace_writer.hpp"
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+
+namespace optiweave::runtime {
+namespace {
+
+constexpr int kSignals[] = {SIGSEGV, SIGBUS, SIGABRT};
+constexpr std::size_t kSignalCount = sizeof(kSignals) / sizeof(kSignals[0]);
+constexpr std::size_t kAltStackBytes = 64 * 1024;
+
+std::atomic<TraceWriter *> g_writer{nullptr};
+struct sigaction g_previous[kSignalCount];
+bool g_installed = false;
+
+// OS thread id of the thread flushing; 0 while nobody is
+std::atomic<std::uint64_t> g_flusher{0};
+std::atomic<bool> g_flushed{false};
+
+/**
+    @brief Re-deliver the signal to the handler that was there before us
+*/
+void chainToPrevious(std::size_t slot, int signal, siginfo_t *info,
+                     void *context) {
+  const struct sigaction &previous = g_previous[slot];
+  sigaction(signal, &previous, nullptr);
+
+  if (previous.sa_flags & SA_SIGINFO) {
+    if (previous.sa_sigaction) {
+      previous.sa_sigaction(signal, info, context);
+    }
+    return;
+  }
+  if (previous.sa_handler == SIG_IGN) {
+    return;
+  }
+  if (previous.sa_handler == SIG_DFL) {
+    // Blocked until we return, then delivered with the default action.
+    // Hardware faults would also re-trigger on return; raising covers
+    // signals sent with kill(2) as well.
+    raise(signal);
+    return;
+  }
+  previous.sa_handler(signal);
+}
+
+/**
+    @brief Everything here must stay async-signal-safe
+*/
+void crashHandler(int signal, siginfo_t *info, void *context) {
+  std::size_t slot = 0;
+  while (slot < kSignalCount && kSignals[slot] != signal) {
+    ++slot;
+  }
+
+  std::uint64_t self = currentOsThreadId();
+  std::uint64_t expected = 0;
+  if (g_flusher.compare_exchange_strong(expected, self,
+                                        std::memory_order_acq_rel)) {
+    if (TraceWriter *writer = g_writer.load(std::memory_order_acquire)) {
+      writer->flushForCrash();
+    }
+    g_flushed.store(true, std::memory_order_release);
+  } else if (expected != self) {
+    // Another thread is flushing; give it the chance to finish before the
+    // default action takes the process down
+    while (!g_flushed.load(std::memory_order_acquire)) {
+    }
+  }
+  // expected == self: we faulted inside our own flush, just chain
+
+  if (slot < kSignalCount) {
+    chainToPrevious(slot, signal, info, context);
+  }
+}
+
+} // namespace
+
+bool installCrashHandlers(TraceWriter &writer) noexcept {
+  if (g_installed) {
+    return true;
+  }
+  g_writer.store(&writer, std::memory_order_release);
+
+  struct sigaction action {};
+  action.sa_sigaction = crashHandler;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  sigemptyset(&action.sa_mask);
+
+  for (std::size_t slot = 0; slot < kSignalCount; ++slot) {
+    if (sigaction(kSignals[slot], &action, &g_previous[slot]) != 0) {
+      for (std::size_t undo = 0; undo < slot; ++undo) {
+        sigaction(kSignals[undo], &g_previous[undo], nullptr);
+      }
+      g_writer.store(nullptr, std::memory_order_release);
+      return false;
+    }
+  }
+  g_installed = true;
+  return true;
+}
+
+void uninstallCrashHandlers() noexcept {
+  if (!g_installed) {
+    return;
+  }
+  for (std::size_t slot = 0; slot < kSignalCount; ++slot) {
+    sigaction(kSignals[slot], &g_previous[slot], nullptr);
+  }
+  g_writer.store(nullptr, std::memory_order_release);
+  g_installed = false;
+}
+
+void enableAltStack(ThreadRecord &record) noexcept {
+  if (!record.alt_stack) {
+    void *memory = mmap(nullptr, kAltStackBytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      return;
+    }
+    record.alt_stack = memory;
+  }
+
+  stack_t current{};
+  if (sigaltstack(nullptr, &current) == 0 && !(current.ss_flags & SS_DISABLE)) {
+    return; // the application brought its own
+  }
+  stack_t stack{};
+  stack.ss_sp = record.alt_stack;
+  stack.ss_size = kAltStackBytes;
+  record.alt_stack_active = sigaltstack(&stack, nullptr) == 0;
+}
+
+void disableAltStack(ThreadRecord &record) noexcept {
+  if (!record.alt_stack_active) {
+    return;
+  }
+  stack_t stack{};
+  stack.ss_flags = SS_DISABLE;
+  sigaltstack(&stack, nullptr);
+  record.alt_stack_active = false;
+}
+
+} // namespace optiweave::runtime
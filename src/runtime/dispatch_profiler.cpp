@@ -0,0 +1,172 @@
+#include "../../include/optiweave/runtime/dispatch_profiler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+namespace optiweave::runtime {
+
+struct DispatchProfiler::SiteCache {
+  std::atomic<const std::type_info *> types[kEntries] = {};
+  std::atomic<std::uint64_t> counts[kEntries] = {};
+  std::atomic<std::uint64_t> overflow{0};
+};
+
+DispatchShape DispatchProfile::shape() const noexcept {
+  if (overflow > 0) {
+    return DispatchShape::Megamorphic;
+  }
+  switch (receivers.size()) {
+  case 0:
+  case 1:
+    return DispatchShape::Monomorphic;
+  case 2:
+    return DispatchShape::Bimorphic;
+  default:
+    return DispatchShape::Polymorphic;
+  }
+}
+
+double DispatchProfile::dominantShare() const noexcept {
+  if (!calls || receivers.empty()) {
+    return 0.0;
+  }
+  return static_cast<double>(receivers.front().count) / calls;
+}
+
+const char *dispatchShapeName(DispatchShape shape) noexcept {
+  switch (shape) {
+  case DispatchShape::Monomorphic:
+    return "monomorphic";
+  case DispatchShape::Bimorphic:
+    return "bimorphic";
+  case DispatchShape::Polymorphic:
+    return "polymorphic";
+  case DispatchShape::Megamorphic:
+    break;
+  }
+  return "megamorphic";
+}
+
+DispatchProfiler::DispatchProfiler(std::size_t site_capacity)
+    : capacity_(site_capacity), sites_(new SiteCache[site_capacity]) {}
+
+DispatchProfiler::~DispatchProfiler() = default;
+
+void DispatchProfiler::record(SiteId site, const std::type_info *type,
+                              std::uint64_t calls) noexcept {
+  if (site >= capacity_) {
+    return;
+  }
+  SiteCache &cache = sites_[site];
+  // Slots fill from the front and are never released, so the first empty
+  // one ends the search
+  for (std::size_t i = 0; i < kEntries; ++i) {
+    const std::type_info *seen = cache.types[i].load(std::memory_order_acquire);
+    if (!seen && cache.types[i].compare_exchange_strong(
+                     seen, type, std::memory_order_acq_rel)) {
+      seen = type;
+    }
+    if (seen == type) {
+      cache.counts[i].fetch_add(calls, std::memory_order_relaxed);
+      return;
+    }
+  }
+  cache.overflow.fetch_add(calls, std::memory_order_relaxed);
+}
+
+void DispatchProfiler::recordOverflow(SiteId site,
+                                      std::uint64_t calls) noexcept {
+  if (site < capacity_ && calls) {
+    sites_[site].overflow.fetch_add(calls, std::memory_order_relaxed);
+  }
+}
+
+bool DispatchProfiler::siteProfile(SiteId site, DispatchProfile &out) const {
+  if (site >= capacity_) {
+    return false;
+  }
+  const SiteCache &cache = sites_[site];
+  out = DispatchProfile{};
+  out.overflow = cache.overflow.load(std::memory_order_relaxed);
+  out.calls = out.overflow;
+  for (std::size_t i = 0; i < kEntries; ++i) {
+    const std::type_info *type = cache.types[i].load(std::memory_order_acquire);
+    std::uint64_t count = cache.counts[i].load(std::memory_order_relaxed);
+    if (type && count) {
+      out.receivers.push_back({type, count});
+      out.calls += count;
+    }
+  }
+  if (out.calls == 0) {
+    return false;
+  }
+  std::sort(out.receivers.begin(), out.receivers.end(),
+            [](const ReceiverCount &a, const ReceiverCount &b) {
+              return a.count > b.count;
+            });
+  return true;
+}
+
+void writeDispatchReport(const DispatchProfiler &dispatch,
+                         const SiteRegistry &sites, const std::string &path) {
+  std::vector<std::pair<SiteId, DispatchProfile>> calls;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    DispatchProfile profile;
+    if (sites.get(id) && dispatch.siteProfile(id, profile)) {
+      calls.emplace_back(id, std::move(profile));
+    }
+  }
+  std::sort(calls.begin(), calls.end(), [](const auto &a, const auto &b) {
+    return a.second.calls > b.second.calls;
+  });
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\tstatic_type\tcalls\t"
+                    "shape\tdominant\tdominant_share\treceivers\n");
+  std::size_t guardable = 0;
+  for (const auto &[id, profile] : calls) {
+    const SiteRecord *site = sites.get(id);
+    // "<type>:<calls>" per cached type
+    std::string receivers;
+    for (const ReceiverCount &receiver : profile.receivers) {
+      receivers += (receivers.empty() ? "" : ",") +
+                   demangleType(receiver.type->name()) + ":" +
+                   std::to_string(receiver.count);
+    }
+    DispatchShape shape = profile.shape();
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%s\t%" PRIu64 "\t%s\t%s\t%.3f\t%s\n",
+                 site->file, site->line, site->column, site->function,
+                 demangleType(site->type).c_str(), profile.calls,
+                 dispatchShapeName(shape),
+                 demangleType(profile.receivers.front().type->name()).c_str(),
+                 profile.dominantShare(), receivers.c_str());
+    guardable += shape == DispatchShape::Monomorphic ||
+                 shape == DispatchShape::Bimorphic;
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: dispatch: %zu virtual call sites, %zu mono- or "
+               "bimorphic, report in %s\n",
+               calls.size(), guardable, path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(calls.size(), 5); ++i) {
+    const auto &[id, profile] = calls[i];
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " calls %s  %s, %.0f%% %s\n",
+                 profile.calls, describeSite(sites, id).c_str(),
+                 dispatchShapeName(profile.shape()),
+                 profile.dominantShare() * 100,
+                 demangleType(profile.receivers.front().type->name()).c_str());
+  }
+}
+
+} // namespace optiweave::runtime
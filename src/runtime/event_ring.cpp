@@ -0,0 +1,75 @@
+#include "../../include/optiweave/runtime/trace_event.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+namespace optiweave::runtime {
+namespace {
+
+constexpr std::size_t kRingHeaderBytes =
+    (sizeof(EventRing) + 63) & ~static_cast<std::size_t>(63);
+
+std::size_t roundUpToPowerOfTwo(std::size_t value) {
+  std::size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+} // namespace
+
+EventRing::EventRing(TraceEvent *slots, std::size_t capacity)
+    : slots_(slots), capacity_(capacity), mask_(capacity - 1) {}
+
+EventRing *EventRing::create(std::size_t capacity) noexcept {
+  capacity = roundUpToPowerOfTwo(std::max<std::size_t>(capacity, 2));
+  std::size_t bytes = kRingHeaderBytes + capacity * sizeof(TraceEvent);
+
+  // Rings live for the rest of the process, so the mapping is never undone
+  void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+  auto *slots = reinterpret_cast<TraceEvent *>(static_cast<char *>(memory) +
+                                               kRingHeaderBytes);
+  return new (memory) EventRing(slots, capacity);
+}
+
+std::size_t EventRing::drain(TraceEvent *out, std::size_t max) noexcept {
+  std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+  std::uint64_t head = head_.load(std::memory_order_acquire);
+  auto count = static_cast<std::size_t>(
+      std::min<std::uint64_t>(head - tail, max));
+  if (count == 0) {
+    return 0;
+  }
+
+  std::size_t start = static_cast<std::size_t>(tail & mask_);
+  std::size_t first = std::min(count, capacity_ - start);
+  std::memcpy(out, slots_ + start, first * sizeof(TraceEvent));
+  std::memcpy(out + first, slots_, (count - first) * sizeof(TraceEvent));
+
+  tail_.store(tail + count, std::memory_order_release);
+  return count;
+}
+
+void EventRing::peek(const TraceEvent *&first, std::size_t &first_count,
+                     const TraceEvent *&second,
+                     std::size_t &second_count) const noexcept {
+  std::uint64_t tail = tail_.load(std::memory_order_acquire);
+  std::uint64_t head = head_.load(std::memory_order_acquire);
+  auto count = static_cast<std::size_t>(
+      std::min<std::uint64_t>(head - tail, capacity_));
+
+  std::size_t start = static_cast<std::size_t>(tail & mask_);
+  first = slots_ + start;
+  first_count = std::min(count, capacity_ - start);
+  second = slots_;
+  second_count = count - first_count;
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,296 @@
+#include "../../include/optiweave/runtime/false_sharing.hpp"
+#include "../../include/optiweave/runtime/heap_tracker.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+
+namespace optiweave::runtime {
+
+struct FalseSharingDetector::Entry {
+  std::atomic<std::uintptr_t> tag{0}; // line number + 1, 0 while free
+  std::atomic<std::uint32_t> lock{0};
+  std::uint64_t window = 0;
+  std::uint32_t used = 0;
+  LineAccessSummary threads[kThreadsPerLine];
+  std::uint64_t conflicts = 0;
+  std::uint64_t true_sharing = 0;
+  LineAccessSummary first;
+  LineAccessSummary second;
+};
+
+namespace {
+constexpr std::size_t kProbes = 8;
+constexpr unsigned kLineShift = 6;
+static_assert(FalseSharingDetector::kLineBytes == 1u << kLineShift);
+
+inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+class SpinGuard {
+public:
+  explicit SpinGuard(std::atomic<std::uint32_t> &lock) noexcept : lock_(lock) {
+    while (lock_.exchange(1, std::memory_order_acquire) != 0) {
+      cpuRelax();
+    }
+  }
+  ~SpinGuard() { lock_.store(0, std::memory_order_release); }
+
+  SpinGuard(const SpinGuard &) = delete;
+  SpinGuard &operator=(const SpinGuard &) = delete;
+
+private:
+  std::atomic<std::uint32_t> &lock_;
+};
+
+std::uint64_t mixBits(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+std::uint64_t byteMask(std::size_t offset, std::size_t bytes) {
+  std::uint64_t mask = bytes >= 64 ? ~std::uint64_t{0}
+                                   : (std::uint64_t{1} << bytes) - 1;
+  return mask << offset;
+}
+
+/**
+    @brief Byte ranges set in a line mask, e.g. "0-7,16-23"
+*/
+std::string maskRanges(std::uint64_t mask) {
+  std::string result;
+  for (unsigned byte = 0; byte < 64;) {
+    if (!(mask >> byte & 1)) {
+      ++byte;
+      continue;
+    }
+    unsigned end = byte;
+    while (end + 1 < 64 && (mask >> (end + 1) & 1)) {
+      ++end;
+    }
+    if (!result.empty()) {
+      result += ",";
+    }
+    result += std::to_string(byte) + "-" + std::to_string(end);
+    byte = end + 1;
+  }
+  return result.empty() ? "-" : result;
+}
+} // namespace
+
+FalseSharingDetector::FalseSharingDetector(const FalseSharingConfig &config)
+    : window_ns_(std::max<std::uint64_t>(config.window_ns, 1)),
+      mask_(std::bit_ceil(std::max<std::size_t>(config.table_lines, kProbes)) -
+            1),
+      entries_(new Entry[mask_ + 1]) {}
+
+FalseSharingDetector::~FalseSharingDetector() = default;
+
+FalseSharingDetector::Entry *
+FalseSharingDetector::claim(std::uintptr_t line,
+                            std::uint64_t window) noexcept {
+  std::uintptr_t tag = line + 1;
+  std::uint64_t hash = mixBits(line);
+  for (std::size_t probe = 0; probe < kProbes; ++probe) {
+    Entry &entry = entries_[(hash + probe) & mask_];
+    std::uintptr_t current = entry.tag.load(std::memory_order_acquire);
+    if (current == tag) {
+      return &entry;
+    }
+    if (current == 0) {
+      if (entry.tag.compare_exchange_strong(current, tag,
+                                            std::memory_order_acq_rel) ||
+          current == tag) {
+        return &entry;
+      }
+    }
+
+    // Take over a line that went quiet without ever conflicting
+    SpinGuard guard(entry.lock);
+    if (entry.conflicts == 0 && entry.window < window &&
+        entry.tag.load(std::memory_order_relaxed) != tag) {
+      entry.used = 0;
+      entry.true_sharing = 0;
+      entry.tag.store(tag, std::memory_order_release);
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void FalseSharingDetector::access(std::uintptr_t address, std::size_t bytes,
+                                  bool write, std::uint32_t thread, SiteId site,
+                                  std::uint64_t now_ns) noexcept {
+  std::uint64_t window = now_ns / window_ns_ + 1;
+  std::uintptr_t end = address + std::max<std::size_t>(bytes, 1);
+  // Elements may straddle lines; charge each line its own bytes
+  for (std::uintptr_t line = address >> kLineShift;
+       line <= (end - 1) >> kLineShift; ++line) {
+    std::uintptr_t first = std::max(address, line << kLineShift);
+    std::uintptr_t last = std::min(end, (line + 1) << kLineShift);
+    std::uint64_t mask = byteMask(first & (kLineBytes - 1),
+                                  static_cast<std::size_t>(last - first));
+    accessLine(line, mask, write, thread, site, window);
+  }
+}
+
+void FalseSharingDetector::accessLine(std::uintptr_t line, std::uint64_t mask,
+                                      bool write, std::uint32_t thread,
+                                      SiteId site,
+                                      std::uint64_t window) noexcept {
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    Entry *entry = claim(line, window);
+    if (!entry) {
+      break;
+    }
+    SpinGuard guard(entry->lock);
+    if (entry->tag.load(std::memory_order_relaxed) != line + 1) {
+      continue; // recycled for another line while we waited
+    }
+    if (entry->window != window) {
+      entry->window = window;
+      entry->used = 0;
+    }
+
+    LineAccessSummary *own = nullptr;
+    const LineAccessSummary *rival = nullptr;
+    bool overlap = false;
+    for (std::uint32_t i = 0; i < entry->used; ++i) {
+      LineAccessSummary &other = entry->threads[i];
+      if (other.thread == thread) {
+        own = &other;
+        continue;
+      }
+      std::uint64_t theirs = other.read_mask | other.write_mask;
+      if (mask & theirs) {
+        overlap = overlap || write || (mask & other.write_mask) != 0;
+      } else if (write || other.write_mask != 0) {
+        rival = &other;
+      }
+    }
+    if (!own && entry->used < kThreadsPerLine) {
+      own = &entry->threads[entry->used++];
+      *own = {thread, 0, 0, kInvalidSite};
+    }
+    if (own) {
+      (write ? own->write_mask : own->read_mask) |= mask;
+      own->site = site;
+    }
+
+    if (overlap) {
+      ++entry->true_sharing;
+    }
+    if (rival) {
+      if (entry->conflicts++ == 0) {
+        entry->first = own ? *own
+                           : LineAccessSummary{thread, write ? 0 : mask,
+                                               write ? mask : 0, site};
+        entry->second = *rival;
+      }
+    }
+    return;
+  }
+  dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<FalseSharingFinding> FalseSharingDetector::findings() const {
+  std::vector<FalseSharingFinding> result;
+  for (std::size_t i = 0; i <= mask_; ++i) {
+    Entry &entry = entries_[i];
+    SpinGuard guard(entry.lock);
+    std::uintptr_t tag = entry.tag.load(std::memory_order_relaxed);
+    if (tag != 0 && entry.conflicts > 0) {
+      result.push_back({(tag - 1) << kLineShift, entry.conflicts,
+                        entry.true_sharing, entry.first, entry.second});
+    }
+  }
+  std::sort(result.begin(), result.end(),
+            [](const FalseSharingFinding &a, const FalseSharingFinding &b) {
+              return a.conflicts > b.conflicts;
+            });
+  return result;
+}
+
+void writeFalseSharingReport(const FalseSharingDetector &detector,
+                             const SiteRegistry &sites,
+                             const std::string &path) {
+  std::vector<FalseSharingFinding> findings = detector.findings();
+  HeapTracker &heap = HeapTracker::global();
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "line\tconflicts\ttrue_sharing\tallocation\t"
+                    "thread_a\tsite_a\ttype_a\twrites_a\treads_a\t"
+                    "thread_b\tsite_b\ttype_b\twrites_b\treads_b\n");
+  auto typeOf = [&](SiteId id) {
+    const SiteRecord *site = sites.get(id);
+    return demangleType(site ? site->type : nullptr);
+  };
+  for (const FalseSharingFinding &finding : findings) {
+    std::string allocation = "-";
+    HeapAllocation found;
+    if (heap.enabled() && heap.find(finding.line, found)) {
+      allocation = describeCodeAddress(found.site) + " +" +
+                   std::to_string(finding.line - found.base);
+    }
+    std::fprintf(out,
+                 "0x%" PRIxPTR "\t%" PRIu64 "\t%" PRIu64
+                 "\t%s\t%u\t%s\t%s\t%s\t%s\t%u\t%s\t%s\t%s\t%s\n",
+                 finding.line, finding.conflicts, finding.true_sharing,
+                 allocation.c_str(), finding.first.thread,
+                 describeSite(sites, finding.first.site).c_str(),
+                 typeOf(finding.first.site).c_str(),
+                 maskRanges(finding.first.write_mask).c_str(),
+                 maskRanges(finding.first.read_mask).c_str(),
+                 finding.second.thread,
+                 describeSite(sites, finding.second.site).c_str(),
+                 typeOf(finding.second.site).c_str(),
+                 maskRanges(finding.second.write_mask).c_str(),
+                 maskRanges(finding.second.read_mask).c_str());
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: false sharing: %zu cache lines, report in %s\n",
+               findings.size(), path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(findings.size(), 5); ++i) {
+    const FalseSharingFinding &finding = findings[i];
+    std::fprintf(stderr,
+                 "OptiWeave:   line 0x%" PRIxPTR ": %" PRIu64
+                 " conflicts between %s (%s, bytes %s) and %s (%s, bytes %s)\n",
+                 finding.line, finding.conflicts,
+                 describeSite(sites, finding.first.site).c_str(),
+                 typeOf(finding.first.site).c_str(),
+                 maskRanges(finding.first.write_mask |
+                            finding.first.read_mask)
+                     .c_str(),
+                 describeSite(sites, finding.second.site).c_str(),
+                 typeOf(finding.second.site).c_str(),
+                 maskRanges(finding.second.write_mask |
+                            finding.second.read_mask)
+                     .c_str());
+  }
+  if (detector.droppedAccesses() > 0) {
+    std::fprintf(stderr,
+                 "OptiWeave: false sharing: %" PRIu64
+                 " accesses not tracked (line table full)\n",
+                 detector.droppedAccesses());
+  }
+}
+
+} // namespace optiweave::runtime
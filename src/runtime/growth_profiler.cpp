@@ -0,0 +1,101 @@
+#include "../../include/optiweave/runtime/growth_profiler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+bool GrowthProfile::stable() const noexcept {
+  return sizes.executions > 0 && sizes.min_trips == sizes.max_trips;
+}
+
+std::uint64_t GrowthProfile::recommendedReserve() const noexcept {
+  if (reallocations == 0) {
+    return 0;
+  }
+  return stable() ? sizes.max_trips : sizes.percentileTrips(0.9);
+}
+
+GrowthProfiler::GrowthProfiler(std::size_t site_capacity)
+    : capacity_(site_capacity), sizes_(site_capacity),
+      reallocations_(new std::atomic<std::uint64_t>[site_capacity]()) {}
+
+GrowthProfiler::~GrowthProfiler() = default;
+
+void GrowthProfiler::record(SiteId site, std::uint64_t peak_size,
+                            std::uint64_t reallocations) noexcept {
+  if (site >= capacity_) {
+    return;
+  }
+  sizes_.record(site, peak_size);
+  reallocations_[site].fetch_add(reallocations, std::memory_order_relaxed);
+}
+
+bool GrowthProfiler::siteProfile(SiteId site,
+                                 GrowthProfile &out) const noexcept {
+  if (!sizes_.siteProfile(site, out.sizes)) {
+    return false;
+  }
+  out.reallocations = reallocations_[site].load(std::memory_order_relaxed);
+  return true;
+}
+
+void writeGrowthReport(const GrowthProfiler &growth, const SiteRegistry &sites,
+                       const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\tinstances\t"
+                    "reallocations\tmean_size\tmin\tmedian\tp90\tmax\t"
+                    "stable\treserve\n");
+
+  std::vector<std::pair<SiteId, GrowthProfile>> containers;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    const SiteRecord *site = sites.get(id);
+    GrowthProfile profile;
+    if (!site || !growth.siteProfile(id, profile)) {
+      continue;
+    }
+    const LoopTripProfile &sizes = profile.sizes;
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%" PRIu64 "\t%" PRIu64 "\t%.1f\t%" PRIu64
+                 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%d\t%" PRIu64 "\n",
+                 site->file, site->line, site->column, site->function,
+                 sizes.executions, profile.reallocations, sizes.meanTrips(),
+                 sizes.min_trips, sizes.percentileTrips(0.5),
+                 sizes.percentileTrips(0.9), sizes.max_trips,
+                 profile.stable() ? 1 : 0, profile.recommendedReserve());
+    containers.emplace_back(id, profile);
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: growth: %zu containers tracked, report in %s\n",
+               containers.size(), path.c_str());
+  std::sort(containers.begin(), containers.end(),
+            [](const auto &a, const auto &b) {
+              return a.second.reallocations > b.second.reallocations;
+            });
+  for (std::size_t i = 0; i < std::min<std::size_t>(containers.size(), 5);
+       ++i) {
+    const auto &[id, profile] = containers[i];
+    if (profile.reallocations == 0) {
+      break;
+    }
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " reallocations %s  %" PRIu64
+                 " instances, reserve(%" PRIu64 ")%s\n",
+                 profile.reallocations, describeSite(sites, id).c_str(),
+                 profile.sizes.executions, profile.recommendedReserve(),
+                 profile.stable() ? ", stable" : "");
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,180 @@
+#include "../../include/optiweave/runtime/hash_profiler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+struct HashProfiler::SiteCounters {
+  std::atomic<std::uint64_t> lookups{0};
+  std::atomic<std::uint64_t> rehashes{0};
+  std::atomic<std::uint64_t> size_sum{0};
+  std::atomic<std::uint64_t> max_size{0};
+  std::atomic<std::uint64_t> bucket_sum{0};
+  std::atomic<std::uint64_t> sampled_lookups{0};
+  std::atomic<std::uint64_t> sampled_chain{0};
+};
+
+double HashSiteProfile::meanSize() const noexcept {
+  return lookups ? static_cast<double>(size_sum) / lookups : 0.0;
+}
+
+double HashSiteProfile::meanLoadFactor() const noexcept {
+  return bucket_sum ? static_cast<double>(size_sum) / bucket_sum : 0.0;
+}
+
+double HashSiteProfile::chainLength() const noexcept {
+  return sampled_lookups
+             ? static_cast<double>(sampled_chain) / sampled_lookups
+             : 0.0;
+}
+
+double HashSiteProfile::expectedChainLength() const noexcept {
+  // Keys thrown uniformly into buckets: a stored key shares its bucket
+  // with the load factor's worth of others on average
+  return 1.0 + meanLoadFactor();
+}
+
+HashAdvice adviseHashSite(const HashSiteProfile &profile) noexcept {
+  if (profile.sampled_lookups >= HashSiteProfile::kMinSampledLookups &&
+      profile.chainLength() > 2.0 &&
+      profile.chainLength() > 2.0 * profile.expectedChainLength()) {
+    return HashAdvice::BetterHash;
+  }
+  if (profile.rehashes > 1) {
+    return HashAdvice::Reserve;
+  }
+  if (profile.max_size <= 32) {
+    return HashAdvice::FlatMap;
+  }
+  return HashAdvice::Fine;
+}
+
+const char *hashAdviceName(HashAdvice advice) noexcept {
+  switch (advice) {
+  case HashAdvice::BetterHash:
+    return "better_hash";
+  case HashAdvice::Reserve:
+    return "reserve";
+  case HashAdvice::FlatMap:
+    return "flat_map";
+  case HashAdvice::Fine:
+    break;
+  }
+  return "fine";
+}
+
+HashProfiler::HashProfiler(std::size_t site_capacity)
+    : capacity_(site_capacity), sites_(new SiteCounters[site_capacity]) {}
+
+HashProfiler::~HashProfiler() = default;
+
+void HashProfiler::record(SiteId site,
+                          const HashSiteProfile &counts) noexcept {
+  if (site >= capacity_ || counts.lookups == 0) {
+    return;
+  }
+  SiteCounters &counters = sites_[site];
+  counters.lookups.fetch_add(counts.lookups, std::memory_order_relaxed);
+  counters.rehashes.fetch_add(counts.rehashes, std::memory_order_relaxed);
+  counters.size_sum.fetch_add(counts.size_sum, std::memory_order_relaxed);
+  counters.bucket_sum.fetch_add(counts.bucket_sum, std::memory_order_relaxed);
+  counters.sampled_lookups.fetch_add(counts.sampled_lookups,
+                                     std::memory_order_relaxed);
+  counters.sampled_chain.fetch_add(counts.sampled_chain,
+                                   std::memory_order_relaxed);
+  std::uint64_t high = counters.max_size.load(std::memory_order_relaxed);
+  while (counts.max_size > high &&
+         !counters.max_size.compare_exchange_weak(high, counts.max_size,
+                                                  std::memory_order_relaxed)) {
+  }
+}
+
+bool HashProfiler::siteProfile(SiteId site,
+                               HashSiteProfile &out) const noexcept {
+  if (site >= capacity_) {
+    return false;
+  }
+  const SiteCounters &counters = sites_[site];
+  out.lookups = counters.lookups.load(std::memory_order_relaxed);
+  if (out.lookups == 0) {
+    return false;
+  }
+  out.rehashes = counters.rehashes.load(std::memory_order_relaxed);
+  out.size_sum = counters.size_sum.load(std::memory_order_relaxed);
+  out.max_size = counters.max_size.load(std::memory_order_relaxed);
+  out.bucket_sum = counters.bucket_sum.load(std::memory_order_relaxed);
+  out.sampled_lookups =
+      counters.sampled_lookups.load(std::memory_order_relaxed);
+  out.sampled_chain = counters.sampled_chain.load(std::memory_order_relaxed);
+  return true;
+}
+
+void writeHashReport(const HashProfiler &hash, const SiteRegistry &sites,
+                     const std::string &path) {
+  std::vector<std::pair<SiteId, HashSiteProfile>> lookups;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    HashSiteProfile profile;
+    if (sites.get(id) && hash.siteProfile(id, profile)) {
+      lookups.emplace_back(id, profile);
+    }
+  }
+  std::sort(lookups.begin(), lookups.end(), [](const auto &a, const auto &b) {
+    return a.second.lookups > b.second.lookups;
+  });
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\tcontainer\tlookups\t"
+                    "rehashes\tmean_size\tmax_size\tload_factor\t"
+                    "chain_length\texpected_chain\tadvice\n");
+  std::size_t actionable = 0;
+  for (const auto &[id, profile] : lookups) {
+    const SiteRecord *site = sites.get(id);
+    HashAdvice advice = adviseHashSite(profile);
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%s\t%" PRIu64 "\t%" PRIu64
+                 "\t%.1f\t%" PRIu64 "\t%.3f\t%.3f\t%.3f\t%s\n",
+                 site->file, site->line, site->column, site->function,
+                 demangleType(site->type).c_str(), profile.lookups,
+                 profile.rehashes, profile.meanSize(), profile.max_size,
+                 profile.meanLoadFactor(), profile.chainLength(),
+                 profile.expectedChainLength(), hashAdviceName(advice));
+    actionable += advice != HashAdvice::Fine;
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: hash: %zu unordered container sites, %zu with "
+               "advice, report in %s\n",
+               lookups.size(), actionable, path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(lookups.size(), 5); ++i) {
+    const auto &[id, profile] = lookups[i];
+    HashAdvice advice = adviseHashSite(profile);
+    std::string detail;
+    if (advice == HashAdvice::Reserve) {
+      detail = ": reserve(" + std::to_string(profile.max_size) + ")";
+    } else if (advice == HashAdvice::BetterHash) {
+      char chains[64];
+      std::snprintf(chains, sizeof(chains), ": chains %.1f, expected %.1f",
+                    profile.chainLength(), profile.expectedChainLength());
+      detail = chains;
+    }
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " lookups %s  load %.2f, %" PRIu64
+                 " rehashes, %s%s\n",
+                 profile.lookups, describeSite(sites, id).c_str(),
+                 profile.meanLoadFactor(), profile.rehashes,
+                 hashAdviceName(advice), detail.c_str());
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,220 @@
+// Replacement allocation functions feeding HeapTracker::global().
+//
+// Built as the optiweave_heap object library: linking it into an
+// instrumented program overrides malloc and friends, which forward to
+// glibc's __libc_* entry points after recording the allocation.
+// OPTIWEAVE_HEAP=0 turns tracking off without relinking.
+
+#include "../../include/optiweave/runtime/heap_tracker.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if !defined(__GLIBC__)
+#error "optiweave_heap forwards to glibc's __libc_malloc family"
+#endif
+
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void *ptr);
+}
+
+namespace {
+
+using optiweave::runtime::HeapTracker;
+
+enum : int { kUnknown = 0, kOn = 1, kOff = 2 };
+std::atomic<int> g_state{kUnknown};
+
+/**
+    @brief Tracking switch, resolved on the first allocation. getenv does not
+    allocate, so it is safe this early.
+*/
+bool tracking() noexcept {
+  int state = g_state.load(std::memory_order_relaxed);
+  if (state == kUnknown) {
+    const char *value = std::getenv("OPTIWEAVE_HEAP");
+    state = value && std::strcmp(value, "0") == 0 ? kOff : kOn;
+    if (state == kOn) {
+      HeapTracker::global().enable();
+    }
+    g_state.store(state, std::memory_order_relaxed);
+  }
+  return state == kOn;
+}
+
+void *track(void *ptr, std::size_t size, void *site) noexcept {
+  if (ptr && tracking()) {
+    HeapTracker::global().onAllocate(ptr, size, site);
+  }
+  return ptr;
+}
+
+void untrack(void *ptr) noexcept {
+  if (ptr && tracking()) {
+    HeapTracker::global().onFree(ptr);
+  }
+}
+
+void *alignedAllocate(std::size_t alignment, std::size_t size) noexcept {
+  return __libc_memalign(alignment < sizeof(void *) ? sizeof(void *) : alignment,
+                         size);
+}
+
+/**
+    @brief operator new semantics: retry through the new-handler, then throw
+*/
+void *allocateOrThrow(std::size_t size, std::size_t alignment, void *site) {
+  if (size == 0) {
+    size = 1;
+  }
+  for (;;) {
+    void *ptr = alignment ? alignedAllocate(alignment, size)
+                          : __libc_malloc(size);
+    if (ptr) {
+      return track(ptr, size, site);
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *allocateNoThrow(std::size_t size, std::size_t alignment,
+                      void *site) noexcept {
+  try {
+    return allocateOrThrow(size, alignment, site);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void release(void *ptr) noexcept {
+  untrack(ptr);
+  __libc_free(ptr);
+}
+
+} // namespace
+
+#define OPTIWEAVE_CALLER __builtin_return_address(0)
+
+extern "C" {
+
+void *malloc(std::size_t size) {
+  return track(__libc_malloc(size), size, OPTIWEAVE_CALLER);
+}
+
+void *calloc(std::size_t count, std::size_t size) {
+  return track(__libc_calloc(count, size), count * size, OPTIWEAVE_CALLER);
+}
+
+void *realloc(void *ptr, std::size_t size) {
+  void *site = OPTIWEAVE_CALLER;
+  if (!ptr) {
+    return track(__libc_malloc(size), size, site);
+  }
+  // Untrack first: once __libc_realloc returns, another thread may already
+  // have been handed the old address
+  untrack(ptr);
+  void *moved = __libc_realloc(ptr, size);
+  if (moved) {
+    return track(moved, size, site);
+  }
+  if (size != 0) {
+    // Failed, the old block is still valid
+    track(ptr, size, site);
+  }
+  return nullptr;
+}
+
+void free(void *ptr) { release(ptr); }
+
+void *memalign(std::size_t alignment, std::size_t size) {
+  return track(alignedAllocate(alignment, size), size, OPTIWEAVE_CALLER);
+}
+
+void *aligned_alloc(std::size_t alignment, std::size_t size) {
+  return track(alignedAllocate(alignment, size), size, OPTIWEAVE_CALLER);
+}
+
+int posix_memalign(void **out, std::size_t alignment, std::size_t size) {
+  if (alignment % sizeof(void *) != 0 ||
+      (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  void *ptr = alignedAllocate(alignment, size);
+  if (!ptr) {
+    return ENOMEM;
+  }
+  *out = track(ptr, size, OPTIWEAVE_CALLER);
+  return 0;
+}
+
+} // extern "C"
+
+void *operator new(std::size_t size) {
+  return allocateOrThrow(size, 0, OPTIWEAVE_CALLER);
+}
+void *operator new[](std::size_t size) {
+  return allocateOrThrow(size, 0, OPTIWEAVE_CALLER);
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return allocateNoThrow(size, 0, OPTIWEAVE_CALLER);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return allocateNoThrow(size, 0, OPTIWEAVE_CALLER);
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment),
+                         OPTIWEAVE_CALLER);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocateOrThrow(size, static_cast<std::size_t>(alignment),
+                         OPTIWEAVE_CALLER);
+}
+void *operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return allocateNoThrow(size, static_cast<std::size_t>(alignment),
+                         OPTIWEAVE_CALLER);
+}
+void *operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return allocateNoThrow(size, static_cast<std::size_t>(alignment),
+                         OPTIWEAVE_CALLER);
+}
+
+void operator delete(void *ptr) noexcept { release(ptr); }
+void operator delete[](void *ptr) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { release(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  release(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  release(ptr);
+}
+void operator delete(void *ptr, std::align_val_t) noexcept { release(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept { release(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  release(ptr);
+}
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+  release(ptr);
+}
+void operator delete(void *ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  release(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  release(ptr);
+}
@@ -0,0 +1,680 @@
+#include "../../include/optiweave/runtime/heap_tracker.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+#include "../../include/optiweave/runtime/thread_registry.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <sys/mman.h>
+
+namespace optiweave::runtime {
+
+// Memory from mapZeroed() is all zero bytes, which is the initial state of
+// every field below, so nodes are used without running constructors.
+
+struct HeapTracker::Record {
+  std::atomic<std::uintptr_t> base{0};
+  std::atomic<std::uint64_t> size{0};
+  std::atomic<std::uintptr_t> site{0};
+  std::atomic<std::uint64_t> accesses{0};
+  std::atomic<std::uint32_t> next{0}; // page chain or free list, id + 1
+  std::atomic<std::uint32_t> generation{0};
+  std::atomic<std::uint32_t> live{0};
+};
+
+struct HeapTracker::Leaf {
+  struct Page {
+    std::atomic<std::uint32_t> small_head{0};
+    std::atomic<std::uint32_t> large[2]{};
+  };
+
+  std::atomic<std::uint32_t> lock{0};
+  std::atomic<std::uint32_t> sequence{0};
+  Page pages[kLevelSize];
+};
+
+struct HeapTracker::Mid {
+  std::atomic<Leaf *> leaves[kLevelSize];
+};
+
+struct HeapTracker::SiteSlot {
+  std::atomic<std::uintptr_t> site{0};
+  std::atomic<std::uint64_t> allocations{0};
+  std::atomic<std::uint64_t> bytes{0};
+  std::atomic<std::uint64_t> freed_accesses{0};
+};
+
+namespace {
+
+constinit HeapTracker g_heap_tracker;
+
+constexpr std::uintptr_t kPageLimit = std::uintptr_t{1} << 36; // 48-bit VAs
+constexpr int kReadAttempts = 16;
+constexpr int kMaxChain = 4096;
+
+void *mapZeroed(std::size_t bytes) noexcept {
+  void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return memory == MAP_FAILED ? nullptr : memory;
+}
+
+/**
+    @brief Load a lazily mapped node, creating it if asked; losers of the
+    publishing race unmap their copy
+*/
+template <typename T>
+T *loadOrMap(std::atomic<T *> &slot, std::size_t bytes, bool create) noexcept {
+  T *node = slot.load(std::memory_order_acquire);
+  if (node || !create) {
+    return node;
+  }
+  auto *fresh = static_cast<T *>(mapZeroed(bytes));
+  if (!fresh) {
+    return nullptr;
+  }
+  if (slot.compare_exchange_strong(node, fresh, std::memory_order_acq_rel)) {
+    return fresh;
+  }
+  munmap(fresh, bytes);
+  return node;
+}
+
+inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+std::uint64_t mixBits(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/**
+    @brief Exclusive access to a leaf for the duration of a scope; readers
+    see an odd sequence number meanwhile and retry
+*/
+class LeafWriteGuard {
+public:
+  explicit LeafWriteGuard(std::atomic<std::uint32_t> &lock,
+                          std::atomic<std::uint32_t> &sequence) noexcept
+      : lock_(lock), sequence_(sequence) {
+    while (lock_.exchange(1, std::memory_order_acquire) != 0) {
+      cpuRelax();
+    }
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  ~LeafWriteGuard() {
+    sequence_.store(sequence_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    lock_.store(0, std::memory_order_release);
+  }
+
+  LeafWriteGuard(const LeafWriteGuard &) = delete;
+  LeafWriteGuard &operator=(const LeafWriteGuard &) = delete;
+
+private:
+  std::atomic<std::uint32_t> &lock_;
+  std::atomic<std::uint32_t> &sequence_;
+};
+
+} // namespace
+
+HeapTracker &HeapTracker::global() noexcept { return g_heap_tracker; }
+
+HeapTracker::Record *HeapTracker::records() const noexcept {
+  return loadOrMap(records_, kMaxAllocations * sizeof(Record), true);
+}
+
+HeapTracker::SiteSlot *HeapTracker::sites() const noexcept {
+  return loadOrMap(sites_, kMaxSites * sizeof(SiteSlot), true);
+}
+
+HeapTracker::Leaf *HeapTracker::leafFor(std::uintptr_t page,
+                                        bool create) const noexcept {
+  if (page >= kPageLimit) {
+    return nullptr;
+  }
+  Mid *mid = loadOrMap(root_[page >> (2 * kLevelBits)], sizeof(Mid), create);
+  if (!mid) {
+    return nullptr;
+  }
+  return loadOrMap(mid->leaves[(page >> kLevelBits) & (kLevelSize - 1)],
+                   sizeof(Leaf), create);
+}
+
+std::uint32_t HeapTracker::allocateRecord() noexcept {
+  Record *pool = records();
+  if (!pool) {
+    return kMaxAllocations;
+  }
+
+  // Tagged head: the tag changes on every pop, which rules out ABA
+  std::uint64_t head = free_head_.load(std::memory_order_acquire);
+  while (static_cast<std::uint32_t>(head) != 0) {
+    std::uint32_t id = static_cast<std::uint32_t>(head) - 1;
+    std::uint64_t next = pool[id].next.load(std::memory_order_relaxed);
+    std::uint64_t desired = (((head >> 32) + 1) << 32) | next;
+    if (free_head_.compare_exchange_weak(head, desired,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+      return id;
+    }
+  }
+
+  std::uint32_t id = next_unused_.load(std::memory_order_relaxed);
+  do {
+    if (id >= kMaxAllocations) {
+      return kMaxAllocations;
+    }
+  } while (!next_unused_.compare_exchange_weak(id, id + 1,
+                                               std::memory_order_relaxed));
+  return id;
+}
+
+void HeapTracker::releaseRecord(std::uint32_t id) noexcept {
+  Record &record = records()[id];
+  std::uint64_t head = free_head_.load(std::memory_order_relaxed);
+  std::uint64_t desired = 0;
+  do {
+    record.next.store(static_cast<std::uint32_t>(head),
+                      std::memory_order_relaxed);
+    desired = (((head >> 32) + 1) << 32) | (id + 1);
+  } while (!free_head_.compare_exchange_weak(head, desired,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
+}
+
+HeapTracker::SiteSlot *HeapTracker::siteSlot(std::uintptr_t site,
+                                             bool create) const noexcept {
+  SiteSlot *table = sites();
+  if (!table || site == 0) {
+    return nullptr;
+  }
+  std::uint64_t hash = mixBits(site);
+  for (std::size_t probe = 0; probe < kMaxSites; ++probe) {
+    SiteSlot &slot = table[(hash + probe) & (kMaxSites - 1)];
+    std::uintptr_t current = slot.site.load(std::memory_order_acquire);
+    if (current == site) {
+      return &slot;
+    }
+    if (current == 0) {
+      if (!create) {
+        return nullptr;
+      }
+      if (slot.site.compare_exchange_strong(current, site,
+                                            std::memory_order_acq_rel) ||
+          current == site) {
+        return &slot;
+      }
+    }
+  }
+  return nullptr;
+}
+
+bool HeapTracker::onAllocate(const void *ptr, std::size_t size,
+                             const void *site) noexcept {
+  auto base = reinterpret_cast<std::uintptr_t>(ptr);
+  if (!ptr) {
+    return false;
+  }
+
+  std::uint32_t id = allocateRecord();
+  if (id >= kMaxAllocations) {
+    untracked_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  Record &record = records()[id];
+  record.base.store(base, std::memory_order_relaxed);
+  record.size.store(size, std::memory_order_relaxed);
+  record.site.store(reinterpret_cast<std::uintptr_t>(site),
+                    std::memory_order_relaxed);
+  record.accesses.store(0, std::memory_order_relaxed);
+  record.generation.store(record.generation.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+  record.live.store(1, std::memory_order_relaxed);
+
+  std::uintptr_t first_page = base >> kPageShift;
+  std::uintptr_t last_page = (base + std::max<std::size_t>(size, 1) - 1) >>
+                             kPageShift;
+  bool linked = size <= (std::size_t{1} << kPageShift)
+                    ? linkSmall(id, first_page)
+                    : linkLarge(id, first_page, last_page);
+  if (!linked) {
+    record.live.store(0, std::memory_order_relaxed);
+    releaseRecord(id);
+    untracked_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  if (SiteSlot *slot = siteSlot(reinterpret_cast<std::uintptr_t>(site), true)) {
+    slot->allocations.fetch_add(1, std::memory_order_relaxed);
+    slot->bytes.fetch_add(size, std::memory_order_relaxed);
+  }
+  live_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool HeapTracker::linkSmall(std::uint32_t id, std::uintptr_t page) noexcept {
+  Leaf *leaf = leafFor(page, true);
+  if (!leaf) {
+    return false;
+  }
+  Leaf::Page &entry = leaf->pages[page & (kLevelSize - 1)];
+  LeafWriteGuard guard(leaf->lock, leaf->sequence);
+  records()[id].next.store(entry.small_head.load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+  entry.small_head.store(id + 1, std::memory_order_relaxed);
+  return true;
+}
+
+bool HeapTracker::linkLarge(std::uint32_t id, std::uintptr_t first_page,
+                            std::uintptr_t last_page) noexcept {
+  Record *pool = records();
+  for (std::uintptr_t page = first_page; page <= last_page;) {
+    Leaf *leaf = leafFor(page, true);
+    if (!leaf) {
+      return false;
+    }
+    std::uintptr_t leaf_end =
+        std::min(last_page, page | (kLevelSize - 1)); // inclusive
+    LeafWriteGuard guard(leaf->lock, leaf->sequence);
+    for (; page <= leaf_end; ++page) {
+      Leaf::Page &entry = leaf->pages[page & (kLevelSize - 1)];
+      // Two large allocations at most share a page; anything else in the
+      // slot is stale (freed behind our back) and may be overwritten
+      std::atomic<std::uint32_t> *target = &entry.large[1];
+      for (auto &slot : entry.large) {
+        std::uint32_t other = slot.load(std::memory_order_relaxed);
+        if (other == 0 || !pool[other - 1].live.load(std::memory_order_relaxed)) {
+          target = &slot;
+          break;
+        }
+      }
+      target->store(id + 1, std::memory_order_relaxed);
+    }
+  }
+  return true;
+}
+
+std::uint32_t HeapTracker::unlinkSmall(std::uintptr_t base) noexcept {
+  std::uintptr_t page = base >> kPageShift;
+  Leaf *leaf = leafFor(page, false);
+  if (!leaf) {
+    return kMaxAllocations;
+  }
+  Record *pool = records();
+  Leaf::Page &entry = leaf->pages[page & (kLevelSize - 1)];
+
+  LeafWriteGuard guard(leaf->lock, leaf->sequence);
+  std::atomic<std::uint32_t> *link = &entry.small_head;
+  for (int steps = 0; steps < kMaxChain; ++steps) {
+    std::uint32_t current = link->load(std::memory_order_relaxed);
+    if (current == 0) {
+      break;
+    }
+    Record &record = pool[current - 1];
+    if (record.base.load(std::memory_order_relaxed) == base) {
+      link->store(record.next.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+      return current - 1;
+    }
+    link = &record.next;
+  }
+  return kMaxAllocations;
+}
+
+std::uint32_t HeapTracker::unlinkLarge(std::uintptr_t base) noexcept {
+  std::uintptr_t first_page = base >> kPageShift;
+  Leaf *leaf = leafFor(first_page, false);
+  if (!leaf) {
+    return kMaxAllocations;
+  }
+  Record *pool = records();
+
+  std::uint32_t id = kMaxAllocations;
+  for (const auto &slot : leaf->pages[first_page & (kLevelSize - 1)].large) {
+    std::uint32_t candidate = slot.load(std::memory_order_acquire);
+    if (candidate != 0 &&
+        pool[candidate - 1].base.load(std::memory_order_relaxed) == base) {
+      id = candidate - 1;
+      break;
+    }
+  }
+  if (id == kMaxAllocations) {
+    return id;
+  }
+
+  std::uintptr_t last_page =
+      (base + pool[id].size.load(std::memory_order_relaxed) - 1) >> kPageShift;
+  for (std::uintptr_t page = first_page; page <= last_page;) {
+    Leaf *current = leafFor(page, false);
+    std::uintptr_t leaf_end = std::min(last_page, page | (kLevelSize - 1));
+    if (!current) {
+      page = leaf_end + 1;
+      continue;
+    }
+    LeafWriteGuard guard(current->lock, current->sequence);
+    for (; page <= leaf_end; ++page) {
+      for (auto &slot : current->pages[page & (kLevelSize - 1)].large) {
+        std::uint32_t expected = id + 1;
+        slot.compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+      }
+    }
+  }
+  return id;
+}
+
+void HeapTracker::onFree(const void *ptr) noexcept {
+  auto base = reinterpret_cast<std::uintptr_t>(ptr);
+  if (!ptr || !records_.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  std::uint32_t id = unlinkSmall(base);
+  if (id == kMaxAllocations) {
+    id = unlinkLarge(base);
+  }
+  if (id == kMaxAllocations) {
+    return; // not ours, e.g. allocated before tracking started
+  }
+
+  Record &record = records()[id];
+  if (SiteSlot *slot =
+          siteSlot(record.site.load(std::memory_order_relaxed), false)) {
+    slot->freed_accesses.fetch_add(
+        record.accesses.load(std::memory_order_relaxed),
+        std::memory_order_relaxed);
+  }
+  record.live.store(0, std::memory_order_release);
+  releaseRecord(id);
+  live_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool HeapTracker::findInPage(std::uintptr_t page, std::uintptr_t address,
+                             bool small_only,
+                             HeapAllocation &out) const noexcept {
+  const Leaf *leaf = leafFor(page, false);
+  if (!leaf) {
+    return false;
+  }
+  const Record *pool = records_.load(std::memory_order_acquire);
+  const Leaf::Page &entry = leaf->pages[page & (kLevelSize - 1)];
+
+  auto contains = [&](std::uint32_t link, HeapAllocation &candidate) {
+    const Record &record = pool[link - 1];
+    std::uintptr_t base = record.base.load(std::memory_order_relaxed);
+    std::uint64_t size = record.size.load(std::memory_order_relaxed);
+    if (address < base || address - base >= size) {
+      return false;
+    }
+    candidate.id = link - 1;
+    candidate.generation = record.generation.load(std::memory_order_relaxed);
+    candidate.base = base;
+    candidate.size = size;
+    candidate.site = record.site.load(std::memory_order_relaxed);
+    return true;
+  };
+
+  for (int attempt = 0; attempt < kReadAttempts; ++attempt) {
+    std::uint32_t before = leaf->sequence.load(std::memory_order_acquire);
+    if (before & 1u) {
+      cpuRelax();
+      continue;
+    }
+
+    HeapAllocation candidate;
+    bool found = false;
+    if (!small_only) {
+      for (const auto &slot : entry.large) {
+        std::uint32_t link = slot.load(std::memory_order_relaxed);
+        if (link != 0 && link <= kMaxAllocations && contains(link, candidate)) {
+          found = true;
+          break;
+        }
+      }
+    }
+    std::uint32_t link = entry.small_head.load(std::memory_order_relaxed);
+    for (int steps = 0; !found && link != 0 && link <= kMaxAllocations &&
+                        steps < kMaxChain;
+         ++steps) {
+      if (contains(link, candidate)) {
+        found = true;
+        break;
+      }
+      link = pool[link - 1].next.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (leaf->sequence.load(std::memory_order_relaxed) == before) {
+      if (found) {
+        out = candidate;
+      }
+      return found;
+    }
+  }
+  return false;
+}
+
+bool HeapTracker::find(std::uintptr_t address,
+                       HeapAllocation &out) const noexcept {
+  if (!records_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  std::uintptr_t page = address >> kPageShift;
+  // Small allocations can start on the previous page and spill into this one
+  return findInPage(page, address, false, out) ||
+         (page > 0 && findInPage(page - 1, address, true, out));
+}
+
+bool HeapTracker::isCurrent(const HeapAllocation &allocation) const noexcept {
+  const Record *pool = records_.load(std::memory_order_acquire);
+  if (!pool || allocation.id >= kMaxAllocations) {
+    return false;
+  }
+  const Record &record = pool[allocation.id];
+  return record.generation.load(std::memory_order_acquire) ==
+             allocation.generation &&
+         record.live.load(std::memory_order_relaxed);
+}
+
+BoundsStatus HeapTracker::checkBounds(std::uintptr_t pointer,
+                                      std::uintptr_t address,
+                                      std::size_t bytes,
+                                      HeapAllocation &cache) const noexcept {
+  if (pointer - cache.base >= cache.size || !isCurrent(cache)) {
+    if (!find(pointer, cache)) {
+      cache = HeapAllocation{};
+      return BoundsStatus::Untracked;
+    }
+  }
+  // Unsigned arithmetic: addresses below base wrap to huge offsets
+  std::uintptr_t offset = address - cache.base;
+  if (offset <= cache.size && cache.size - offset >= bytes) {
+    return BoundsStatus::InBounds;
+  }
+  return BoundsStatus::OutOfBounds;
+}
+
+bool HeapTracker::recordAccess(std::uintptr_t address) noexcept {
+  HeapAllocation allocation;
+  if (!find(address, allocation)) {
+    return false;
+  }
+  countAccess(allocation);
+  return true;
+}
+
+void HeapTracker::countAccess(const HeapAllocation &allocation) noexcept {
+  records()[allocation.id].accesses.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint64_t
+HeapTracker::accessCount(const HeapAllocation &allocation) const noexcept {
+  const Record *pool = records_.load(std::memory_order_acquire);
+  if (!pool || allocation.id >= kMaxAllocations) {
+    return 0;
+  }
+  const Record &record = pool[allocation.id];
+  if (record.generation.load(std::memory_order_relaxed) !=
+      allocation.generation) {
+    return 0;
+  }
+  return record.accesses.load(std::memory_order_relaxed);
+}
+
+std::vector<HeapSiteStats> HeapTracker::siteStats() const {
+  std::vector<HeapSiteStats> stats;
+  const SiteSlot *table = sites_.load(std::memory_order_acquire);
+  const Record *pool = records_.load(std::memory_order_acquire);
+  if (!table || !pool) {
+    return stats;
+  }
+
+  // Allocating here goes through the tracker when it is interposed, so all
+  // memory is obtained before the live records are scanned
+  stats.reserve(kMaxSites);
+  for (std::size_t i = 0; i < kMaxSites; ++i) {
+    std::uintptr_t site = table[i].site.load(std::memory_order_acquire);
+    if (site == 0) {
+      continue;
+    }
+    HeapSiteStats entry;
+    entry.site = site;
+    entry.allocations = table[i].allocations.load(std::memory_order_relaxed);
+    entry.bytes = table[i].bytes.load(std::memory_order_relaxed);
+    entry.accesses = table[i].freed_accesses.load(std::memory_order_relaxed);
+    stats.push_back(entry);
+  }
+  auto by_site = [](const HeapSiteStats &a, const HeapSiteStats &b) {
+    return a.site < b.site;
+  };
+  std::sort(stats.begin(), stats.end(), by_site);
+
+  std::uint32_t used = std::min<std::uint32_t>(
+      next_unused_.load(std::memory_order_acquire), kMaxAllocations);
+  for (std::uint32_t id = 0; id < used; ++id) {
+    const Record &record = pool[id];
+    if (!record.live.load(std::memory_order_acquire)) {
+      continue;
+    }
+    HeapSiteStats key;
+    key.site = record.site.load(std::memory_order_relaxed);
+    auto it = std::lower_bound(stats.begin(), stats.end(), key, by_site);
+    if (it == stats.end() || it->site != key.site) {
+      continue;
+    }
+    ++it->live_allocations;
+    it->live_bytes += record.size.load(std::memory_order_relaxed);
+    it->accesses += record.accesses.load(std::memory_order_relaxed);
+  }
+
+  std::sort(stats.begin(), stats.end(),
+            [](const HeapSiteStats &a, const HeapSiteStats &b) {
+              return a.accesses > b.accesses;
+            });
+  return stats;
+}
+
+std::vector<std::pair<HeapAllocation, std::uint64_t>>
+HeapTracker::hottestAllocations(std::size_t limit) const {
+  std::vector<std::pair<HeapAllocation, std::uint64_t>> hottest;
+  const Record *pool = records_.load(std::memory_order_acquire);
+  if (!pool) {
+    return hottest;
+  }
+
+  std::uint32_t used = std::min<std::uint32_t>(
+      next_unused_.load(std::memory_order_acquire), kMaxAllocations);
+  for (std::uint32_t id = 0; id < used; ++id) {
+    const Record &record = pool[id];
+    if (!record.live.load(std::memory_order_acquire)) {
+      continue;
+    }
+    HeapAllocation allocation;
+    allocation.id = id;
+    allocation.generation = record.generation.load(std::memory_order_relaxed);
+    allocation.base = record.base.load(std::memory_order_relaxed);
+    allocation.size = record.size.load(std::memory_order_relaxed);
+    allocation.site = record.site.load(std::memory_order_relaxed);
+    hottest.emplace_back(allocation,
+                         record.accesses.load(std::memory_order_relaxed));
+  }
+
+  auto hotter = [](const auto &a, const auto &b) { return a.second > b.second; };
+  if (hottest.size() > limit) {
+    std::partial_sort(hottest.begin(), hottest.begin() + limit, hottest.end(),
+                      hotter);
+    hottest.resize(limit);
+  } else {
+    std::sort(hottest.begin(), hottest.end(), hotter);
+  }
+  return hottest;
+}
+
+void writeHeapReport(const HeapTracker &heap, const ThreadRegistry &threads,
+                     const std::string &path) {
+  std::vector<HeapSiteStats> sites = heap.siteStats();
+
+  std::uint64_t attributed = 0;
+  std::uint64_t unattributed = 0;
+  for (std::size_t i = 0, end = threads.highWater(); i < end; ++i) {
+    attributed += threads.at(i).heap_attributed.load(std::memory_order_relaxed);
+    unattributed +=
+        threads.at(i).heap_unattributed.load(std::memory_order_relaxed);
+  }
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "site\tlocation\tallocations\tbytes\tlive_allocations\t"
+                    "live_bytes\taccesses\taccesses_per_kib\n");
+  for (const HeapSiteStats &site : sites) {
+    double per_kib =
+        site.bytes ? 1024.0 * static_cast<double>(site.accesses) /
+                         static_cast<double>(site.bytes)
+                   : 0.0;
+    std::fprintf(out,
+                 "0x%" PRIxPTR "\t%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64
+                 "\t%" PRIu64 "\t%" PRIu64 "\t%.2f\n",
+                 site.site, describeCodeAddress(site.site).c_str(),
+                 site.allocations, site.bytes, site.live_allocations,
+                 site.live_bytes, site.accesses, per_kib);
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: heap: %" PRIu64 " accesses attributed, %" PRIu64
+               " outside the heap, %zu allocation sites, report in %s\n",
+               attributed, unattributed, sites.size(), path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(sites.size(), 5); ++i) {
+    if (sites[i].accesses == 0) {
+      break;
+    }
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " accesses  %10" PRIu64
+                 " bytes  %s\n",
+                 sites[i].accesses, sites[i].bytes,
+                 describeCodeAddress(sites[i].site).c_str());
+  }
+  if (heap.untrackedAllocations() > 0) {
+    std::fprintf(stderr,
+                 "OptiWeave: heap: %" PRIu64
+                 " allocations untracked (tracker full)\n",
+                 heap.untrackedAllocations());
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,34 @@
+// Storage for the globals declared by templates/prelude.hpp. Kept in its own
+// translation unit because the prelude and the runtime headers both declare
+// the C hook interface.
+#include "prelude.hpp"
+
+#include <cstdlib>
+
+namespace optiweave {
+namespace {
+bool enabled(const char *name) {
+  const char *value = std::getenv(name);
+  return value && *value && std::string(value) != "0";
+}
+
+InstrumentationConfig configFromEnvironment() {
+  InstrumentationConfig config;
+  config.check_heap_bounds = enabled("OPTIWEAVE_BOUNDS");
+  config.profile_divisors = enabled("OPTIWEAVE_DIVISORS");
+  config.check_denormals = enabled("OPTIWEAVE_DENORMALS");
+  config.profile_branches = enabled("OPTIWEAVE_BRANCHES");
+  config.profile_loops = enabled("OPTIWEAVE_LOOPS");
+  config.profile_functions = enabled("OPTIWEAVE_PROFILE");
+  config.track_allocations = enabled("OPTIWEAVE_ALLOCATIONS");
+  config.profile_growth = enabled("OPTIWEAVE_GROWTH");
+  config.track_copies = enabled("OPTIWEAVE_COPIES");
+  config.profile_dispatch = enabled("OPTIWEAVE_DISPATCH");
+  config.profile_hashing = enabled("OPTIWEAVE_HASH");
+  return config;
+}
+} // namespace
+
+InstrumentationConfig g_config = configFromEnvironment();
+
+} // namespace optiweave
@@ -0,0 +1,57 @@
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+
+namespace optiweave::runtime {
+
+std::string describeCodeAddress(std::uintptr_t address) {
+  char buffer[512];
+  Dl_info info{};
+  if (!dladdr(reinterpret_cast<void *>(address), &info) || !info.dli_fname) {
+    std::snprintf(buffer, sizeof(buffer), "0x%" PRIxPTR, address);
+    return buffer;
+  }
+  const char *module = std::strrchr(info.dli_fname, '/');
+  module = module ? module + 1 : info.dli_fname;
+  if (info.dli_sname) {
+    int status = 0;
+    char *demangled =
+        abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::snprintf(buffer, sizeof(buffer), "%s+0x%" PRIxPTR " (%s)",
+                  status == 0 ? demangled : info.dli_sname,
+                  address - reinterpret_cast<std::uintptr_t>(info.dli_saddr),
+                  module);
+    std::free(demangled);
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%s+0x%" PRIxPTR, module,
+                  address - reinterpret_cast<std::uintptr_t>(info.dli_fbase));
+  }
+  return buffer;
+}
+
+std::string describeSite(const SiteRegistry &sites, SiteId id) {
+  const SiteRecord *site = sites.get(id);
+  if (!site) {
+    return "?";
+  }
+  return std::string(site->file) + ":" + std::to_string(site->line) + ":" +
+         std::to_string(site->column) + " in " + site->function;
+}
+
+std::string demangleType(const char *mangled) {
+  if (!mangled) {
+    return "?";
+  }
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+  std::string result = status == 0 ? demangled : mangled;
+  std::free(demangled);
+  return result;
+}
+
+} // namespace optiweave::runtime
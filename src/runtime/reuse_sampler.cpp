@@ -0,0 +1,295 @@
+#include "../../include/optiweave/runtime/reuse_sampler.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <new>
+#include <string>
+#include <tuple>
+
+namespace optiweave::runtime {
+namespace {
+constexpr double kHashSpace = 18446744073709551616.0; // 2^64
+
+std::uint64_t thresholdForRate(std::uint32_t one_in) {
+  if (one_in <= 1) {
+    return ~std::uint64_t{0};
+  }
+  return static_cast<std::uint64_t>(kHashSpace / one_in);
+}
+
+/**
+    @brief Bucket of an estimated distance, see ReuseHistogram
+*/
+std::size_t bucketFor(double distance) {
+  if (distance < 1.0) {
+    return 0;
+  }
+  auto bucket = static_cast<std::size_t>(std::floor(std::log2(distance))) + 1;
+  return std::min(bucket, ReuseHistogram::kBuckets - 1);
+}
+} // namespace
+
+void ReuseHistogram::merge(const ReuseHistogram &other) noexcept {
+  accesses += other.accesses;
+  cold += other.cold;
+  for (std::size_t b = 0; b < kBuckets; ++b) {
+    buckets[b] += other.buckets[b];
+  }
+}
+
+double ReuseHistogram::missRatio(std::uint64_t cache_lines) const noexcept {
+  if (accesses <= 0) {
+    return 0.0;
+  }
+  // A reuse hits iff fewer than cache_lines other lines came in between
+  double misses = cold;
+  for (std::size_t b = 1; b < kBuckets; ++b) {
+    if (std::ldexp(1.0, static_cast<int>(b) - 1) >=
+        static_cast<double>(cache_lines)) {
+      misses += buckets[b];
+    }
+  }
+  return std::min(1.0, misses / accesses);
+}
+
+std::uint64_t ReuseHistogram::linesNeeded(double tolerance) const noexcept {
+  double capacity_misses = 0;
+  for (std::size_t b = 1; b < kBuckets; ++b) {
+    capacity_misses += buckets[b];
+  }
+  // Walk up the sizes, each one turning bucket k + 1 into hits
+  for (std::size_t k = 0; k + 1 < kBuckets; ++k) {
+    if (capacity_misses <= tolerance * accesses) {
+      return std::uint64_t{1} << k;
+    }
+    capacity_misses -= buckets[k + 1];
+  }
+  return std::uint64_t{1} << (kBuckets - 1);
+}
+
+ReuseSampler::ReuseSampler(const ReuseSamplerConfig &config,
+                           std::size_t site_capacity)
+    : line_shift_(config.line_shift),
+      max_lines_(std::max<std::size_t>(config.max_lines, 1)),
+      threshold_(thresholdForRate(config.sample_one_in)),
+      fenwick_(4 * max_lines_ + 1, 0), sites_(site_capacity) {
+  lines_.reserve(max_lines_ + 1);
+}
+
+ReuseSampler::~ReuseSampler() = default;
+
+double ReuseSampler::samplingRate() const noexcept {
+  return static_cast<double>(threshold_.load(std::memory_order_relaxed)) /
+         kHashSpace;
+}
+
+void ReuseSampler::mark(std::uint32_t time, int delta) {
+  for (std::size_t i = time; i < fenwick_.size(); i += i & (~i + 1)) {
+    fenwick_[i] += delta;
+  }
+}
+
+std::uint32_t ReuseSampler::markedAfter(std::uint32_t time) const {
+  std::int32_t upto = 0;
+  for (std::size_t i = time; i > 0; i -= i & (~i + 1)) {
+    upto += fenwick_[i];
+  }
+  return marked_ - static_cast<std::uint32_t>(upto);
+}
+
+void ReuseSampler::compactClock() {
+  std::vector<std::pair<std::uint32_t, Line *>> order;
+  order.reserve(lines_.size());
+  for (auto &[address, line] : lines_) {
+    order.emplace_back(line.time, &line);
+  }
+  std::sort(order.begin(), order.end(),
+            [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  std::fill(fenwick_.begin(), fenwick_.end(), 0);
+  clock_ = 0;
+  for (auto &[time, line] : order) {
+    line->time = ++clock_;
+    mark(line->time, 1);
+  }
+}
+
+void ReuseSampler::evictLargest() {
+  auto largest = std::prev(by_hash_.end());
+  auto found = lines_.find(largest->second);
+  mark(found->second.time, -1);
+  --marked_;
+  lines_.erase(found);
+  threshold_.store(largest->first, std::memory_order_relaxed);
+  by_hash_.erase(largest);
+}
+
+ReuseHistogram &ReuseSampler::histogramFor(SiteId site) {
+  static ReuseHistogram overflow;
+  if (site >= sites_.size()) {
+    return overflow;
+  }
+  if (!sites_[site]) {
+    sites_[site] = std::make_unique<ReuseHistogram>();
+  }
+  return *sites_[site];
+}
+
+void ReuseSampler::record(std::uintptr_t line, std::uint64_t hash,
+                          SiteId site) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The threshold may have dropped since the unlocked check
+  std::uint64_t threshold = threshold_.load(std::memory_order_relaxed);
+  if (hash >= threshold) {
+    return;
+  }
+  double rate = static_cast<double>(threshold) / kHashSpace;
+  double weight = 1.0 / rate;
+
+  // Every allocation comes before the first change to the counters, so
+  // running out of memory drops the sample and leaves the state as it was
+  ReuseHistogram *histogram;
+  decltype(lines_)::iterator it;
+  bool inserted;
+  try {
+    if (clock_ + 1 >= fenwick_.size()) {
+      compactClock();
+    }
+    histogram = &histogramFor(site);
+    std::tie(it, inserted) = lines_.try_emplace(line);
+    if (inserted) {
+      try {
+        by_hash_.emplace(hash, line);
+      } catch (...) {
+        lines_.erase(it);
+        throw;
+      }
+    }
+  } catch (const std::bad_alloc &) {
+    return;
+  }
+
+  std::uint32_t now = ++clock_;
+  histogram->accesses += weight;
+  total_.accesses += weight;
+
+  if (!inserted) {
+    double distance = markedAfter(it->second.time) / rate;
+    std::size_t bucket = bucketFor(distance);
+    histogram->buckets[bucket] += weight;
+    total_.buckets[bucket] += weight;
+    mark(it->second.time, -1);
+    it->second.time = now;
+    mark(now, 1);
+    return;
+  }
+
+  histogram->cold += weight;
+  total_.cold += weight;
+  it->second = {hash, now};
+  mark(now, 1);
+  ++marked_;
+  if (lines_.size() > max_lines_) {
+    evictLargest();
+  }
+}
+
+ReuseHistogram ReuseSampler::total() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return total_;
+}
+
+bool ReuseSampler::siteHistogram(SiteId site, ReuseHistogram &out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (site >= sites_.size() || !sites_[site]) {
+    return false;
+  }
+  out = *sites_[site];
+  return true;
+}
+
+void writeReuseReport(const ReuseSampler &reuse, const SiteRegistry &sites,
+                      const std::string &path) {
+  constexpr double kTolerance = 0.01;
+  std::size_t line_bytes = reuse.lineBytes();
+
+  std::map<std::string, ReuseHistogram> functions;
+  std::vector<std::pair<SiteId, ReuseHistogram>> per_site;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    const SiteRecord *site = sites.get(id);
+    ReuseHistogram histogram;
+    if (site && reuse.siteHistogram(id, histogram)) {
+      functions[site->function].merge(histogram);
+      per_site.emplace_back(id, histogram);
+    }
+  }
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "scope\tname\taccesses\tworking_set_bytes\t"
+                    "bytes_needed\tcache_bytes\tmiss_ratio\n");
+  auto writeCurve = [&](const char *scope, const std::string &name,
+                        const ReuseHistogram &histogram) {
+    std::uint64_t needed = histogram.linesNeeded(kTolerance);
+    for (std::uint64_t lines = 1;; lines <<= 1) {
+      std::fprintf(out, "%s\t%s\t%.0f\t%.0f\t%" PRIu64 "\t%" PRIu64
+                        "\t%.4f\n",
+                   scope, name.c_str(), histogram.accesses,
+                   histogram.cold * static_cast<double>(line_bytes),
+                   needed * line_bytes, lines * line_bytes,
+                   histogram.missRatio(lines));
+      // Past the knee the curve is flat at the cold-miss ratio
+      if (lines >= 2 * needed) {
+        break;
+      }
+    }
+  };
+
+  ReuseHistogram total = reuse.total();
+  writeCurve("all", "*", total);
+  for (const auto &[function, histogram] : functions) {
+    writeCurve("function", function, histogram);
+  }
+  for (const auto &[id, histogram] : per_site) {
+    const SiteRecord *site = sites.get(id);
+    writeCurve("site",
+               std::string(site->file) + ":" + std::to_string(site->line) +
+                   ":" + std::to_string(site->column) + " " + site->operation,
+               histogram);
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: mrc: ~%.0f accesses, working set ~%.0f KiB, "
+               "sampling 1 in %.0f lines at exit, report in %s\n",
+               total.accesses,
+               total.cold * static_cast<double>(line_bytes) / 1024.0,
+               1.0 / reuse.samplingRate(), path.c_str());
+
+  std::vector<std::pair<std::string, ReuseHistogram>> busiest(
+      functions.begin(), functions.end());
+  std::sort(busiest.begin(), busiest.end(), [](const auto &a, const auto &b) {
+    return a.second.accesses > b.second.accesses;
+  });
+  for (std::size_t i = 0; i < std::min<std::size_t>(busiest.size(), 5); ++i) {
+    const ReuseHistogram &histogram = busiest[i].second;
+    auto missesAt = [&](std::uint64_t bytes) {
+      return 100.0 * histogram.missRatio(bytes / line_bytes);
+    };
+    std::fprintf(stderr,
+                 "OptiWeave:   %-40s needs %10.1f KiB  miss 32K %5.1f%%  1M %5.1f%%  32M %5.1f%%\n",
+                 busiest[i].first.c_str(),
+                 static_cast<double>(histogram.linesNeeded(kTolerance) *
+                                     line_bytes) /
+                     1024.0,
+                 missesAt(32u << 10), missesAt(1u << 20), missesAt(32u << 20));
+  }
+}
+
+} // namespace optiweave::runtime
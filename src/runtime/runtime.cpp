@@ -0,0 +1,939 @@
+#include "../../include/optiweave/runtime/runtime.hpp"
+#include "../../include/optiweave/runtime/clock.hpp"
+#include "../../include/optiweave/runtime/crash_handler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+
+namespace optiweave::runtime {
+namespace {
+bool envFlag(const char *name) {
+  const char *value = std::getenv(name);
+  return value && *value && std::strcmp(value, "0") != 0;
+}
+
+std::string envString(const char *name) {
+  const char *value = std::getenv(name);
+  return value ? std::string(value) : std::string();
+}
+
+/**
+    @brief Read a positive integer, keeping `fallback` if unset or invalid
+*/
+std::uint64_t envNumber(const char *name, std::uint64_t fallback) {
+  const char *value = std::getenv(name);
+  if (!value || !*value) {
+    return fallback;
+  }
+  char *end = nullptr;
+  unsigned long long parsed = std::strtoull(value, &end, 10);
+  if (*end != '\0' || parsed == 0) {
+    std::fprintf(stderr, "OptiWeave: ignoring invalid %s=%s\n", name, value);
+    return fallback;
+  }
+  return parsed;
+}
+
+/**
+    @brief A thread's SiteBlocks, allocated by the owning thread on first
+    use; release publishes them to the shutdown merge
+*/
+template <typename Blocks>
+Blocks *ownedBlocks(std::atomic<Blocks *> &slot) noexcept {
+  Blocks *blocks = slot.load(std::memory_order_relaxed);
+  if (!blocks) {
+    blocks = new (std::nothrow) Blocks();
+    if (blocks) {
+      slot.store(blocks, std::memory_order_release);
+    }
+  }
+  return blocks;
+}
+
+/**
+    @brief Visit every thread's entries of one kind of SiteBlocks with their
+    site ids; the acquire pairs with the owner's release in ownedBlocks
+*/
+template <typename Blocks, typename Visit>
+void mergeThreadBlocks(const ThreadRegistry &threads,
+                       std::atomic<Blocks *> ThreadRecord::*member,
+                       Visit visit) {
+  for (std::size_t i = 0, end = threads.highWater(); i < end; ++i) {
+    const Blocks *blocks =
+        (threads.at(i).*member).load(std::memory_order_acquire);
+    if (blocks) {
+      blocks->forEach(visit);
+    }
+  }
+}
+
+void shutdownAtExit() { Runtime::instance().shutdown(); }
+} // namespace
+
+/**
+    @brief Ties a ThreadRecord to the lifetime of the owning thread
+*/
+struct ThreadHandle {
+  ThreadRecord *record = nullptr;
+
+  ThreadHandle() : record(Runtime::instance().attachThread()) {}
+  ~ThreadHandle() { Runtime::instance().detachThread(record); }
+};
+
+RuntimeConfig RuntimeConfig::fromEnvironment() {
+  RuntimeConfig config;
+  config.telemetry = envFlag("OPTIWEAVE_TELEMETRY");
+  config.telemetry_name = envString("OPTIWEAVE_TELEMETRY_NAME");
+  config.keep_telemetry = envFlag("OPTIWEAVE_TELEMETRY_KEEP");
+
+  config.trace = envFlag("OPTIWEAVE_TRACE");
+  config.crash_handlers = envString("OPTIWEAVE_TRACE_CRASH") != "0";
+  std::string bounds = envString("OPTIWEAVE_BOUNDS");
+  config.bounds = !bounds.empty() && bounds != "0";
+  config.bounds_abort = bounds == "abort";
+  config.reuse = envFlag("OPTIWEAVE_MRC");
+  config.reuse_config.sample_one_in = static_cast<std::uint32_t>(envNumber(
+      "OPTIWEAVE_MRC_SAMPLE", config.reuse_config.sample_one_in));
+  config.reuse_config.max_lines =
+      envNumber("OPTIWEAVE_MRC_LINES", config.reuse_config.max_lines);
+  config.reuse_report = envString("OPTIWEAVE_MRC_REPORT");
+  if (config.reuse_report.empty()) {
+    config.reuse_report = "optiweave-mrc." +
+                          std::to_string(static_cast<int>(getpid())) + ".tsv";
+  }
+  config.false_sharing = envFlag("OPTIWEAVE_FALSE_SHARING");
+  config.false_sharing_config.window_ns =
+      envNumber("OPTIWEAVE_FALSE_SHARING_WINDOW_US",
+                config.false_sharing_config.window_ns / 1000) *
+      1000;
+  config.false_sharing_report = envString("OPTIWEAVE_FALSE_SHARING_REPORT");
+  if (config.false_sharing_report.empty()) {
+    config.false_sharing_report =
+        "optiweave-sharing." + std::to_string(static_cast<int>(getpid())) +
+        ".tsv";
+  }
+  config.prefetch = envFlag("OPTIWEAVE_PREFETCH");
+  config.prefetch_config.latency_ns = envNumber(
+      "OPTIWEAVE_PREFETCH_LATENCY_NS", config.prefetch_config.latency_ns);
+  config.prefetch_advice = envString("OPTIWEAVE_PREFETCH_ADVICE");
+  if (config.prefetch_advice.empty()) {
+    config.prefetch_advice = "optiweave-prefetch." +
+                             std::to_string(static_cast<int>(getpid())) +
+                             ".tsv";
+  }
+  config.divisors = envFlag("OPTIWEAVE_DIVISORS");
+  config.divisors_report = envString("OPTIWEAVE_DIVISORS_REPORT");
+  if (config.divisors_report.empty()) {
+    config.divisors_report = "optiweave-divisors." +
+                             std::to_string(static_cast<int>(getpid())) +
+                             ".tsv";
+  }
+  config.denormals = envFlag("OPTIWEAVE_DENORMALS");
+  config.denormals_report = envString("OPTIWEAVE_DENORMALS_REPORT");
+  if (config.denormals_report.empty()) {
+    config.denormals_report = "optiweave-denormals." +
+                              std::to_string(static_cast<int>(getpid())) +
+                              ".tsv";
+  }
+  config.traversal = envFlag("OPTIWEAVE_TRAVERSAL");
+  config.traversal_report = envString("OPTIWEAVE_TRAVERSAL_REPORT");
+  if (config.traversal_report.empty()) {
+    config.traversal_report = "optiweave-traversal." +
+                              std::to_string(static_cast<int>(getpid())) +
+                              ".tsv";
+  }
+  config.branches = envFlag("OPTIWEAVE_BRANCHES");
+  config.branches_report = envString("OPTIWEAVE_BRANCHES_REPORT");
+  if (config.branches_report.empty()) {
+    config.branches_report = "optiweave-branches." +
+                             std::to_string(static_cast<int>(getpid())) +
+                             ".tsv";
+  }
+  config.loops = envFlag("OPTIWEAVE_LOOPS");
+  config.loops_report = envString("OPTIWEAVE_LOOPS_REPORT");
+  if (config.loops_report.empty()) {
+    config.loops_report =
+        "optiweave-loops." + std::to_string(static_cast<int>(getpid())) +
+        ".tsv";
+  }
+  config.profile = envFlag("OPTIWEAVE_PROFILE");
+  config.profile_folded = envString("OPTIWEAVE_PROFILE_FOLDED");
+  if (config.profile_folded.empty()) {
+    config.profile_folded = "optiweave-profile." +
+                            std::to_string(static_cast<int>(getpid())) +
+                            ".folded";
+  }
+  config.profile_report = envString("OPTIWEAVE_PROFILE_REPORT");
+  if (config.profile_report.empty()) {
+    config.profile_report = "optiweave-profile." +
+                            std::to_string(static_cast<int>(getpid())) +
+                            ".tsv";
+  }
+  config.allocations = envFlag("OPTIWEAVE_ALLOCATIONS");
+  config.allocations_report = envString("OPTIWEAVE_ALLOCATIONS_REPORT");
+  if (config.allocations_report.empty()) {
+    config.allocations_report = "optiweave-allocations." +
+                                std::to_string(static_cast<int>(getpid())) +
+                                ".tsv";
+  }
+  config.growth = envFlag("OPTIWEAVE_GROWTH");
+  config.growth_report = envString("OPTIWEAVE_GROWTH_REPORT");
+  if (config.growth_report.empty()) {
+    config.growth_report =
+        "optiweave-growth." + std::to_string(static_cast<int>(getpid())) +
+        ".tsv";
+  }
+  config.copies = envFlag("OPTIWEAVE_COPIES");
+  config.copies_report = envString("OPTIWEAVE_COPIES_REPORT");
+  if (config.copies_report.empty()) {
+    config.copies_report =
+        "optiweave-copies." + std::to_string(static_cast<int>(getpid())) +
+        ".tsv";
+  }
+  config.dispatch = envFlag("OPTIWEAVE_DISPATCH");
+  config.dispatch_report = envString("OPTIWEAVE_DISPATCH_REPORT");
+  if (config.dispatch_report.empty()) {
+    config.dispatch_report =
+        "optiweave-dispatch." + std::to_string(static_cast<int>(getpid())) +
+        ".tsv";
+  }
+  config.hash = envFlag("OPTIWEAVE_HASH");
+  config.hash_report = envString("OPTIWEAVE_HASH_REPORT");
+  if (config.hash_report.empty()) {
+    config.hash_report =
+        "optiweave-hash." + std::to_string(static_cast<int>(getpid())) +
+        ".tsv";
+  }
+  config.heap_report = envString("OPTIWEAVE_HEAP_REPORT");
+  if (config.heap_report.empty()) {
+    config.heap_report = "optiweave-heap." +
+                         std::to_string(static_cast<int>(getpid())) + ".tsv";
+  }
+  TraceWriterConfig &trace = config.trace_config;
+  if (std::string dir = envString("OPTIWEAVE_TRACE_DIR"); !dir.empty()) {
+    trace.directory = dir;
+  }
+  trace.block_bytes =
+      envNumber("OPTIWEAVE_TRACE_BLOCK_KB", trace.block_bytes >> 10) << 10;
+  trace.ring_events = envNumber("OPTIWEAVE_TRACE_RING", trace.ring_events);
+  trace.segment_bytes =
+      envNumber("OPTIWEAVE_TRACE_SEGMENT_MB", trace.segment_bytes >> 20) << 20;
+  trace.disk_budget_bytes =
+      envNumber("OPTIWEAVE_TRACE_BUDGET_MB", trace.disk_budget_bytes >> 20)
+      << 20;
+  trace.sample_rate = static_cast<std::uint32_t>(
+      envNumber("OPTIWEAVE_TRACE_SAMPLE", trace.sample_rate));
+  trace.direct_io = envFlag("OPTIWEAVE_TRACE_DIRECT");
+  if (std::string io = envString("OPTIWEAVE_TRACE_IO"); !io.empty()) {
+    trace.prefer_uring = io != "pwrite";
+  }
+  if (std::string policy = envString("OPTIWEAVE_TRACE_BACKPRESSURE");
+      !policy.empty() &&
+      !parseBackpressurePolicy(policy, trace.backpressure)) {
+    std::fprintf(stderr,
+                 "OptiWeave: unknown OPTIWEAVE_TRACE_BACKPRESSURE=%s, "
+                 "using drop\n",
+                 policy.c_str());
+  }
+  return config;
+}
+
+Runtime &Runtime::instance() {
+  static Runtime *runtime = [] {
+    auto *created = new Runtime();
+    std::atexit(shutdownAtExit);
+    return created;
+  }();
+  return *runtime;
+}
+
+Runtime::Runtime() : config_(RuntimeConfig::fromEnvironment()) {
+  if (config_.bounds) {
+    bounds_reported_ =
+        std::make_unique<std::atomic<bool>[]>(SiteRegistry::kCapacity);
+  }
+  if (config_.reuse) {
+    reuse_ = std::make_unique<ReuseSampler>(config_.reuse_config);
+  }
+  if (config_.prefetch) {
+    strides_ = std::make_unique<StrideProfiler>();
+  }
+  if (config_.divisors) {
+    values_ = std::make_unique<ValueProfiler>();
+  }
+  if (config_.denormals) {
+    denormals_ = std::make_unique<DenormalCounts[]>(SiteRegistry::kCapacity);
+  }
+  if (config_.traversal) {
+    traversal_ = std::make_unique<TraversalProfiler>();
+  }
+  if (config_.branches) {
+    branches_ = std::make_unique<BranchCounts[]>(SiteRegistry::kCapacity);
+  }
+  if (config_.loops) {
+    trips_ = std::make_unique<TripProfiler>();
+  }
+  if (config_.allocations) {
+    allocations_ =
+        std::make_unique<AllocationCounts[]>(SiteRegistry::kCapacity);
+  }
+  if (config_.growth) {
+    growth_ = std::make_unique<GrowthProfiler>();
+  }
+  if (config_.copies) {
+    copies_ = std::make_unique<CopyCounts[]>(SiteRegistry::kCapacity);
+  }
+  if (config_.dispatch) {
+    dispatch_ = std::make_unique<DispatchProfiler>();
+  }
+  if (config_.hash) {
+    hash_ = std::make_unique<HashProfiler>();
+  }
+  start_ns_ = monotonicNanoseconds();
+  start_cycles_ = readCycleCounter();
+  if (config_.false_sharing) {
+    false_sharing_ =
+        std::make_unique<FalseSharingDetector>(config_.false_sharing_config);
+  }
+
+  if (config_.telemetry) {
+    std::string name = config_.telemetry_name.empty()
+                           ? telemetrySegmentName(static_cast<int>(getpid()))
+                           : config_.telemetry_name;
+    auto publisher = std::make_unique<TelemetryPublisher>();
+    if (publisher->open(name, SiteRegistry::kCapacity,
+                        ThreadRegistry::kMaxThreads, config_.keep_telemetry)) {
+      telemetry_ = std::move(publisher);
+    }
+  }
+
+  if (config_.trace) {
+    TraceWriterConfig trace_config = config_.trace_config;
+    trace_config.crash_flush = config_.crash_handlers;
+    auto writer = std::make_unique<TraceWriter>(threads_, trace_config);
+    if (writer->start()) {
+      trace_ = std::move(writer);
+      crash_handlers_installed_ =
+          trace_->config().crash_flush && installCrashHandlers(*trace_);
+    }
+  }
+}
+
+void Runtime::shutdown() {
+  if (shut_down_) {
+    return;
+  }
+  shut_down_ = true;
+
+  // Producers may outlive this call (other threads, static destructors
+  // registered before the runtime), so the mapping stays until exit
+  if (telemetry_) {
+    telemetry_->unlink();
+  }
+
+  HeapTracker &heap = HeapTracker::global();
+  if (heap.enabled()) {
+    writeHeapReport(heap, threads_, config_.heap_report);
+  }
+  if (config_.bounds) {
+    std::uint64_t checked = 0;
+    std::uint64_t unchecked = 0;
+    for (std::size_t i = 0, end = threads_.highWater(); i < end; ++i) {
+      checked += threads_.at(i).bounds_checked.load(std::memory_order_relaxed);
+      unchecked +=
+          threads_.at(i).bounds_unchecked.load(std::memory_order_relaxed);
+    }
+    std::fprintf(stderr,
+                 "OptiWeave: bounds: %" PRIu64 " subscripts checked, %" PRIu64
+                 " violations, %" PRIu64 " outside the tracked heap\n",
+                 checked, bounds_violations_.load(std::memory_order_relaxed),
+                 unchecked);
+  }
+  if (reuse_) {
+    writeReuseReport(*reuse_, sites_, config_.reuse_report);
+  }
+  if (strides_) {
+    writePrefetchAdvice(*strides_, reuse_.get(), sites_,
+                        config_.prefetch_config, config_.prefetch_advice);
+  }
+  if (values_) {
+    for (std::size_t i = 0, end = threads_.highWater(); i < end; ++i) {
+      if (const ValueSketch *sketches = threads_.at(i).value_sketches) {
+        values_->collect(sketches);
+      }
+    }
+    writeDivisorReport(*values_, sites_, config_.divisors_report);
+  }
+  if (traversal_) {
+    writeTraversalReport(*traversal_, sites_, config_.traversal_report);
+  }
+  if (denormals_) {
+    writeDenormalReport(denormals_.get(), sites_, config_.denormals_report);
+  }
+  if (branches_) {
+    mergeThreadBlocks(threads_, &ThreadRecord::branch_counters,
+                      [&](SiteId id, const auto &outcomes) {
+                        branches_[id].outcomes[0] +=
+                            outcomes[0].load(std::memory_order_relaxed);
+                        branches_[id].outcomes[1] +=
+                            outcomes[1].load(std::memory_order_relaxed);
+                      });
+    writeBranchReport(branches_.get(), sites_, config_.branches_report);
+  }
+  if (trips_) {
+    writeLoopReport(*trips_, sites_, config_.loops_report);
+  }
+  if (growth_) {
+    writeGrowthReport(*growth_, sites_, config_.growth_report);
+  }
+  if (copies_) {
+    writeCopyReport(copies_.get(), sites_, config_.copies_report);
+  }
+  if (dispatch_) {
+    mergeThreadBlocks(
+        threads_, &ThreadRecord::receiver_caches,
+        [&](SiteId id, const __optiweave_receiver_cache &cache) {
+          for (std::size_t k = 0; k < __OPTIWEAVE_RECEIVER_ENTRIES; ++k) {
+            const void *type = cache.types[k].load(std::memory_order_relaxed);
+            std::uint64_t calls =
+                cache.counts[k].load(std::memory_order_relaxed);
+            if (type && calls) {
+              dispatch_->record(
+                  id, static_cast<const std::type_info *>(type), calls);
+            }
+          }
+          dispatch_->recordOverflow(
+              id, cache.overflow.load(std::memory_order_relaxed));
+        });
+    writeDispatchReport(*dispatch_, sites_, config_.dispatch_report);
+  }
+  if (hash_) {
+    mergeThreadBlocks(
+        threads_, &ThreadRecord::hash_counters,
+        [&](SiteId id, const __optiweave_hash_counts &counts) {
+          HashSiteProfile thread;
+          thread.lookups = counts.lookups.load(std::memory_order_relaxed);
+          thread.rehashes = counts.rehashes.load(std::memory_order_relaxed);
+          thread.size_sum = counts.size_sum.load(std::memory_order_relaxed);
+          thread.max_size = counts.max_size.load(std::memory_order_relaxed);
+          thread.bucket_sum =
+              counts.bucket_sum.load(std::memory_order_relaxed);
+          thread.sampled_lookups =
+              counts.sampled_lookups.load(std::memory_order_relaxed);
+          thread.sampled_chain =
+              counts.sampled_chain.load(std::memory_order_relaxed);
+          hash_->record(id, thread);
+        });
+    writeHashReport(*hash_, sites_, config_.hash_report);
+  }
+  std::uint64_t run_ns = monotonicNanoseconds() - start_ns_;
+  if (allocations_) {
+    writeAllocationReport(allocations_.get(), sites_, run_ns / 1e9,
+                          config_.allocations_report);
+  }
+  if (config_.profile) {
+    std::uint64_t cycles = readCycleCounter() - start_cycles_;
+    writeProfileReport(threads_,
+                       cycles ? static_cast<double>(run_ns) / cycles : 1.0,
+                       config_.profile_folded, config_.profile_report);
+  }
+  if (false_sharing_) {
+    writeFalseSharingReport(*false_sharing_, sites_,
+                            config_.false_sharing_report);
+  }
+
+  if (trace_) {
+    if (crash_handlers_installed_) {
+      uninstallCrashHandlers();
+    }
+    trace_->stop();
+    writeSiteTable(sites_, trace_->config().directory);
+
+    TraceWriterStats stats = trace_->stats();
+    std::fprintf(stderr,
+                 "OptiWeave: trace: %" PRIu64 " events in %" PRIu64
+                 " blocks (%" PRIu64 " bytes, %s), %" PRIu64 " dropped, %" PRIu64
+                 " sampled out, %" PRIu64 " producer waits, %" PRIu64
+                 " segments deleted, %" PRIu64 " write errors\n",
+                 stats.events_written, stats.blocks_written, stats.bytes_written,
+                 trace_->ioBackendName(), stats.events_dropped,
+                 stats.events_sampled_out, stats.producer_waits,
+                 stats.segments_deleted, stats.write_errors);
+  }
+}
+
+ThreadRecord *Runtime::currentThread() noexcept {
+  thread_local ThreadHandle handle;
+  return handle.record;
+}
+
+ThreadRecord *Runtime::attachThread() noexcept {
+  ThreadRecord *record = threads_.acquire();
+  if (record && telemetry_) {
+    telemetry_->publishThread(record->index, record->os_tid, true);
+  }
+  if (record && crash_handlers_installed_) {
+    enableAltStack(*record);
+  }
+  return record;
+}
+
+void Runtime::detachThread(ThreadRecord *record) noexcept {
+  if (!record) {
+    return;
+  }
+  if (telemetry_) {
+    telemetry_->publishThread(record->index, record->os_tid, false);
+  }
+  if (record->call_tree) {
+    record->call_tree->unwind();
+  }
+  disableAltStack(*record);
+  threads_.release(record);
+}
+
+SiteId Runtime::resolveSite(const char *operation,
+                            const __optiweave_site_info &site) noexcept {
+  bool inserted = false;
+  SiteId id = sites_.intern(operation, site, &inserted);
+  if (inserted && telemetry_) {
+    if (const SiteRecord *record = sites_.get(id)) {
+      telemetry_->publishSite(id, *record);
+    }
+  }
+  return id;
+}
+
+void Runtime::recordAccess(const char *operation, const void *ptr,
+                           std::size_t index, std::size_t element_size,
+                           const __optiweave_site_info &site) noexcept {
+  recordAddress(resolveSite(operation, site), currentThread(),
+                reinterpret_cast<std::uintptr_t>(ptr) + index * element_size,
+                index, element_size, site);
+}
+
+void Runtime::recordAccessNd(const char *operation, const void *element,
+                             std::size_t element_size, std::uint32_t rank,
+                             const std::size_t *indices,
+                             const std::size_t *extents,
+                             const __optiweave_site_info &site) noexcept {
+  SiteId id = resolveSite(operation, site);
+  ThreadRecord *thread = currentThread();
+
+  // Row-major element number for the trace; only the last index when an
+  // inner extent is unknown (pointer-to-pointer chains)
+  std::size_t flat = 0;
+  for (std::uint32_t d = 0; d < rank; ++d) {
+    if (d > 0 && extents[d] == 0) {
+      flat = indices[rank - 1];
+      break;
+    }
+    flat = (d > 0 ? flat * extents[d] : 0) + indices[d];
+  }
+
+  if (traversal_ && thread) {
+    if (!thread->traversal_cursors) {
+      thread->traversal_cursors =
+          new (std::nothrow) TraversalCursor[TraversalProfiler::kCursors];
+    }
+    if (thread->traversal_cursors) {
+      traversal_->access(thread->traversal_cursors, id, rank, indices,
+                         extents, element_size);
+    }
+  }
+  recordAddress(id, thread, reinterpret_cast<std::uintptr_t>(element), flat,
+                element_size, site);
+}
+
+void Runtime::recordAddress(SiteId id, ThreadRecord *thread,
+                            std::uintptr_t address, std::size_t index,
+                            std::size_t element_size,
+                            const __optiweave_site_info &site) noexcept {
+  if (telemetry_) {
+    telemetry_->recordEvent(id, thread ? thread->index : ~0u);
+  }
+
+  HeapTracker &heap = HeapTracker::global();
+  if (heap.enabled() && thread) {
+    bumpOwned(heap.recordAccess(address) ? thread->heap_attributed
+                                         : thread->heap_unattributed);
+  }
+  if (reuse_) {
+    reuse_->access(address, id);
+  }
+  if (strides_ && thread) {
+    if (!thread->stride_cursors) {
+      thread->stride_cursors =
+          new (std::nothrow) StrideCursor[StrideProfiler::kCursors];
+    }
+    if (thread->stride_cursors) {
+      strides_->access(thread->stride_cursors, id, address,
+                       monotonicNanoseconds());
+    }
+  }
+  if (false_sharing_ && thread) {
+    false_sharing_->access(address, element_size,
+                           (site.flags & __OPTIWEAVE_SITE_WRITE) != 0,
+                           thread->index, id, monotonicNanoseconds());
+  }
+  if (trace_ && thread) {
+    trace_->append(*thread,
+                   {monotonicNanoseconds(), address, index, id, thread->index});
+  }
+}
+
+void Runtime::recordOperation(const char *operation,
+                              const __optiweave_site_info &site) noexcept {
+  SiteId id = resolveSite(operation, site);
+  ThreadRecord *thread = currentThread();
+
+  if (telemetry_) {
+    telemetry_->recordEvent(id, thread ? thread->index : ~0u);
+  }
+  if (trace_ && thread) {
+    trace_->append(*thread, {monotonicNanoseconds(), 0, 0, id, thread->index});
+  }
+}
+
+void Runtime::recordValue(const char *operation, std::int64_t value,
+                          const __optiweave_site_info &site) noexcept {
+  ThreadRecord *thread = currentThread();
+  if (!values_ || !thread) {
+    return;
+  }
+  if (!thread->value_sketches) {
+    thread->value_sketches =
+        new (std::nothrow) ValueSketch[ValueProfiler::kSketches];
+    if (!thread->value_sketches) {
+      return;
+    }
+  }
+  values_->record(thread->value_sketches, resolveSite(operation, site), value);
+}
+
+void Runtime::recordDenormal(const char *operation, std::uint32_t operands,
+                             const __optiweave_site_info &site) noexcept {
+  if (!denormals_) {
+    return;
+  }
+  SiteId id = resolveSite(operation, site);
+  if (id >= SiteRegistry::kCapacity) {
+    return;
+  }
+  DenormalCounts &counts = denormals_[id];
+  counts.hits.fetch_add(1, std::memory_order_relaxed);
+  if (operands & __OPTIWEAVE_DENORMAL_LHS) {
+    counts.lhs.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (operands & __OPTIWEAVE_DENORMAL_RHS) {
+    counts.rhs.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (operands & __OPTIWEAVE_DENORMAL_RESULT) {
+    counts.result.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+std::uint32_t Runtime::branchSite(const char *operation,
+                                  const __optiweave_site_info &site) noexcept {
+  if (!branches_) {
+    return __OPTIWEAVE_NO_SITE;
+  }
+  SiteId id = resolveSite(operation, site);
+  return id < SiteRegistry::kCapacity ? id : __OPTIWEAVE_NO_SITE;
+}
+
+std::atomic<std::uint64_t> (
+    *Runtime::branchCounters(std::uint32_t id) noexcept)[2] {
+  ThreadRecord *thread = currentThread();
+  if (!branches_ || !thread || id >= SiteRegistry::kCapacity) {
+    return nullptr;
+  }
+  BranchCounters *counters = ownedBlocks(thread->branch_counters);
+  return counters ? counters->block(id) : nullptr;
+}
+
+void Runtime::recordAllocation(const char *operation, std::size_t bytes,
+                               const __optiweave_site_info &site) noexcept {
+  if (!allocations_) {
+    return;
+  }
+  SiteId id = resolveSite(operation, site);
+  if (id >= SiteRegistry::kCapacity) {
+    return;
+  }
+  allocations_[id].events.fetch_add(1, std::memory_order_relaxed);
+  allocations_[id].bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Runtime::recordDeallocation(const char *operation,
+                                 const __optiweave_site_info &site) noexcept {
+  if (!allocations_) {
+    return;
+  }
+  SiteId id = resolveSite(operation, site);
+  if (id >= SiteRegistry::kCapacity) {
+    return;
+  }
+  allocations_[id].deallocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Runtime::enterFunction(const __optiweave_site_info *function) noexcept {
+  ThreadRecord *thread = currentThread();
+  if (!config_.profile || !thread) {
+    return;
+  }
+  if (!thread->call_tree) {
+    thread->call_tree = new (std::nothrow) CallTree();
+    if (!thread->call_tree) {
+      return;
+    }
+  }
+  thread->call_tree->enter(function, readCycleCounter());
+}
+
+void Runtime::exitFunction() noexcept {
+  std::uint64_t now = readCycleCounter();
+  ThreadRecord *thread = currentThread();
+  if (thread && thread->call_tree) {
+    thread->call_tree->exit(now);
+  }
+}
+
+void Runtime::recordTrips(std::uint64_t trips,
+                          const __optiweave_site_info &site) noexcept {
+  if (trips_) {
+    trips_->record(resolveSite("loop", site), trips);
+  }
+}
+
+void Runtime::recordGrowth(std::uint64_t peak_size,
+                           std::uint64_t reallocations,
+                           const __optiweave_site_info &site) noexcept {
+  if (growth_) {
+    growth_->record(resolveSite("growth", site), peak_size, reallocations);
+  }
+}
+
+void Runtime::recordCopy(const char *operation, std::size_t bytes,
+                         const __optiweave_site_info &site) noexcept {
+  if (!copies_) {
+    return;
+  }
+  SiteId id = resolveSite(operation, site);
+  if (id < SiteRegistry::kCapacity) {
+    copies_[id].events.fetch_add(1, std::memory_order_relaxed);
+    copies_[id].bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+std::uint32_t
+Runtime::dispatchSite(const __optiweave_site_info &site) noexcept {
+  if (!dispatch_) {
+    return __OPTIWEAVE_NO_SITE;
+  }
+  SiteId id = resolveSite("virtual", site);
+  return id < SiteRegistry::kCapacity ? id : __OPTIWEAVE_NO_SITE;
+}
+
+__optiweave_receiver_cache *
+Runtime::receiverCaches(std::uint32_t id) noexcept {
+  ThreadRecord *thread = currentThread();
+  if (!dispatch_ || !thread || id >= SiteRegistry::kCapacity) {
+    return nullptr;
+  }
+  ReceiverCaches *caches = ownedBlocks(thread->receiver_caches);
+  return caches ? caches->block(id) : nullptr;
+}
+
+std::uint32_t Runtime::hashSite(const __optiweave_site_info &site) noexcept {
+  if (!hash_) {
+    return __OPTIWEAVE_NO_SITE;
+  }
+  SiteId id = resolveSite("hash", site);
+  return id < SiteRegistry::kCapacity ? id : __OPTIWEAVE_NO_SITE;
+}
+
+__optiweave_hash_counts *Runtime::hashCounters(std::uint32_t id) noexcept {
+  ThreadRecord *thread = currentThread();
+  if (!hash_ || !thread || id >= SiteRegistry::kCapacity) {
+    return nullptr;
+  }
+  HashCounters *counters = ownedBlocks(thread->hash_counters);
+  return counters ? counters->block(id) : nullptr;
+}
+
+void Runtime::checkBounds(const void *ptr, std::size_t index,
+                          std::size_t element_size,
+                          const __optiweave_site_info &site) noexcept {
+  HeapTracker &heap = HeapTracker::global();
+  ThreadRecord *thread = currentThread();
+  if (!heap.enabled() || !thread) {
+    if (!heap.enabled() && !bounds_warned_.exchange(true)) {
+      std::fprintf(stderr, "OptiWeave: OPTIWEAVE_BOUNDS needs the program to "
+                           "link optiweave_heap; not checking\n");
+    }
+    return;
+  }
+
+  auto pointer = reinterpret_cast<std::uintptr_t>(ptr);
+  std::uintptr_t address = pointer + index * element_size;
+  switch (heap.checkBounds(pointer, address, element_size,
+                           thread->bounds_cache)) {
+  case BoundsStatus::InBounds:
+    bumpOwned(thread->bounds_checked);
+    return;
+  case BoundsStatus::Untracked:
+    bumpOwned(thread->bounds_unchecked);
+    return;
+  case BoundsStatus::OutOfBounds:
+    break;
+  }
+
+  bumpOwned(thread->bounds_checked);
+  bounds_violations_.fetch_add(1, std::memory_order_relaxed);
+  SiteId id = resolveSite("pointer_subscript", site);
+  reportBoundsViolation(id, site, address, index, element_size,
+                        thread->bounds_cache);
+}
+
+void Runtime::reportBoundsViolation(SiteId id,
+                                    const __optiweave_site_info &site,
+                                    std::uintptr_t address, std::size_t index,
+                                    std::size_t element_size,
+                                    const HeapAllocation &allocation) noexcept {
+  bool first = id >= SiteRegistry::kCapacity || !bounds_reported_ ||
+               !bounds_reported_[id].exchange(true);
+  if (!first && !config_.bounds_abort) {
+    return;
+  }
+
+  char where[128];
+  if (address < allocation.base) {
+    std::snprintf(where, sizeof(where), "%" PRIuPTR " bytes before the start",
+                  allocation.base - address);
+  } else {
+    std::snprintf(where, sizeof(where), "%" PRIuPTR " bytes past the end",
+                  address + element_size - (allocation.base + allocation.size));
+  }
+  std::fprintf(stderr,
+               "OptiWeave: Heap bounds violation! Index %zu reaches %s of a "
+               "%zu-byte allocation at %s:%u:%u in %s\n"
+               "OptiWeave:   allocated at %s\n",
+               index, where, allocation.size, site.file, site.line,
+               site.column, site.function,
+               describeCodeAddress(allocation.site).c_str());
+
+  if (config_.bounds_abort) {
+    std::abort();
+  }
+}
+
+} // namespace optiweave::runtime
+
+extern "C" {
+void __optiweave_log_access(const char *operation, const void *ptr,
+                            std::size_t index, std::size_t element_size,
+                            const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordAccess(
+      operation, ptr, index, element_size, *site);
+}
+
+void __optiweave_log_access_nd(const char *operation, const void *element,
+                               std::size_t element_size, std::uint32_t rank,
+                               const std::size_t *indices,
+                               const std::size_t *extents,
+                               const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordAccessNd(
+      operation, element, element_size, rank, indices, extents, *site);
+}
+
+void __optiweave_log_operation(const char *operation,
+                               const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordOperation(operation, *site);
+}
+
+void __optiweave_check_bounds(const void *ptr, std::size_t index,
+                              std::size_t element_size,
+                              const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().checkBounds(ptr, index, element_size,
+                                                      *site);
+}
+
+void __optiweave_profile_value(const char *operation, std::int64_t value,
+                               const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordValue(operation, value, *site);
+}
+
+void __optiweave_report_denormal(const char *operation, std::uint32_t operands,
+                                 const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordDenormal(operation, operands,
+                                                         *site);
+}
+
+std::uint32_t __optiweave_branch_site(const char *operation,
+                                     const __optiweave_site_info *site) {
+  return optiweave::runtime::Runtime::instance().branchSite(operation, *site);
+}
+
+std::atomic<std::uint64_t> (*__optiweave_branch_counters(std::uint32_t id))[2] {
+  return optiweave::runtime::Runtime::instance().branchCounters(id);
+}
+
+void __optiweave_record_allocation(const char *operation, std::size_t bytes,
+                                   const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordAllocation(operation, bytes,
+                                                           *site);
+}
+
+void __optiweave_record_deallocation(const char *operation,
+                                     const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordDeallocation(operation,
+                                                             *site);
+}
+
+void __optiweave_enter_function(const __optiweave_site_info *function) {
+  optiweave::runtime::Runtime::instance().enterFunction(function);
+}
+
+void __optiweave_exit_function(void) {
+  optiweave::runtime::Runtime::instance().exitFunction();
+}
+
+void __optiweave_record_trips(std::uint64_t trips,
+                              const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordTrips(trips, *site);
+}
+
+void __optiweave_record_copy(const char *operation, std::size_t bytes,
+                             const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordCopy(operation, bytes, *site);
+}
+
+std::uint32_t __optiweave_dispatch_site(const __optiweave_site_info *site) {
+  return optiweave::runtime::Runtime::instance().dispatchSite(*site);
+}
+
+__optiweave_receiver_cache *__optiweave_receiver_caches(std::uint32_t id) {
+  return optiweave::runtime::Runtime::instance().receiverCaches(id);
+}
+
+std::uint32_t __optiweave_hash_site(const __optiweave_site_info *site) {
+  return optiweave::runtime::Runtime::instance().hashSite(*site);
+}
+
+__optiweave_hash_counts *__optiweave_hash_counters(std::uint32_t id) {
+  return optiweave::runtime::Runtime::instance().hashCounters(id);
+}
+
+void __optiweave_record_growth(std::uint64_t peak_size,
+                               std::uint64_t reallocations,
+                               const __optiweave_site_info *site) {
+  optiweave::runtime::Runtime::instance().recordGrowth(peak_size,
+                                                       reallocations, *site);
+}
+}
@@ -0,0 +1,247 @@
+#include "../../include/optiweave/runtime/site_counters.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+void writeDenormalReport(const DenormalCounts *counts,
+                         const SiteRegistry &sites, const std::string &path) {
+  std::vector<std::pair<SiteId, std::uint64_t>> hit;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    if (std::uint64_t hits = counts[id].hits.load(std::memory_order_relaxed)) {
+      hit.emplace_back(id, hits);
+    }
+  }
+  std::sort(hit.begin(), hit.end(),
+            [](const auto &a, const auto &b) { return a.second > b.second; });
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\toperation\ttype\t"
+                    "hits\tsubnormal_lhs\tsubnormal_rhs\tsubnormal_result\n");
+  for (const auto &[id, hits] : hit) {
+    const SiteRecord *site = sites.get(id);
+    const DenormalCounts &count = counts[id];
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%s\t%s\t%" PRIu64 "\t%" PRIu64
+                 "\t%" PRIu64 "\t%" PRIu64 "\n",
+                 site->file, site->line, site->column, site->function,
+                 site->operation, demangleType(site->type).c_str(), hits,
+                 count.lhs.load(std::memory_order_relaxed),
+                 count.rhs.load(std::memory_order_relaxed),
+                 count.result.load(std::memory_order_relaxed));
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: denormals: %zu sites saw subnormal values, "
+               "report in %s\n",
+               hit.size(), path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(hit.size(), 5); ++i) {
+    const auto &[id, hits] = hit[i];
+    const DenormalCounts &count = counts[id];
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " %s  %s (%" PRIu64
+                 " produced, %" PRIu64 " consumed)\n",
+                 hits, describeSite(sites, id).c_str(),
+                 sites.get(id)->operation,
+                 count.result.load(std::memory_order_relaxed),
+                 hits - count.result.load(std::memory_order_relaxed));
+  }
+  if (!hit.empty()) {
+    std::fprintf(stderr,
+                 "OptiWeave:   flush denormals to zero (FTZ/DAZ) around these "
+                 "loops or rescale their data\n");
+  }
+}
+
+void writeBranchReport(const BranchCounts *counts, const SiteRegistry &sites,
+                       const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\toperation\ttrue\t"
+                    "false\ttrue_share\n");
+
+  // Same cut-off as the tool's default --branch-threshold
+  constexpr double kBiased = 0.9;
+  struct Biased {
+    SiteId id;
+    std::uint64_t total;
+    double true_share;
+  };
+  std::vector<Biased> biased;
+  std::size_t profiled = 0;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    const SiteRecord *site = sites.get(id);
+    std::uint64_t no = counts[id].outcomes[0];
+    std::uint64_t yes = counts[id].outcomes[1];
+    if (!site || no + yes == 0) {
+      continue;
+    }
+    ++profiled;
+    double true_share = static_cast<double>(yes) / (no + yes);
+    std::fprintf(out, "%s\t%u\t%u\t%s\t%s\t%" PRIu64 "\t%" PRIu64 "\t%.4f\n",
+                 site->file, site->line, site->column, site->function,
+                 site->operation, yes, no, true_share);
+    if (true_share >= kBiased || true_share <= 1.0 - kBiased) {
+      biased.push_back({id, no + yes, true_share});
+    }
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: branches: %zu of %zu comparison sites are at least "
+               "%.0f%% biased, profile in %s\n",
+               biased.size(), profiled, kBiased * 100, path.c_str());
+  std::sort(biased.begin(), biased.end(),
+            [](const Biased &a, const Biased &b) { return a.total > b.total; });
+  for (std::size_t i = 0; i < std::min<std::size_t>(biased.size(), 5); ++i) {
+    std::fprintf(stderr, "OptiWeave:   %12" PRIu64 " %s  %s %.1f%% true\n",
+                 biased[i].total, describeSite(sites, biased[i].id).c_str(),
+                 sites.get(biased[i].id)->operation,
+                 biased[i].true_share * 100);
+  }
+}
+
+void writeAllocationReport(const AllocationCounts *counts,
+                           const SiteRegistry &sites, double seconds,
+                           const std::string &path) {
+  // Only allocations are ranked; delete and free sites follow them
+  std::vector<std::pair<SiteId, std::uint64_t>> active;
+  std::vector<SiteId> releasing;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    if (std::uint64_t events =
+            counts[id].events.load(std::memory_order_relaxed)) {
+      active.emplace_back(id, events);
+    } else if (counts[id].deallocations.load(std::memory_order_relaxed)) {
+      releasing.push_back(id);
+    }
+  }
+  std::sort(active.begin(), active.end(), [counts](const auto &a,
+                                                   const auto &b) {
+    if (a.second != b.second) {
+      return a.second > b.second;
+    }
+    return counts[a.first].bytes.load(std::memory_order_relaxed) >
+           counts[b.first].bytes.load(std::memory_order_relaxed);
+  });
+  auto loopDepth = [](const SiteRecord *site) {
+    return (site->flags & __OPTIWEAVE_SITE_LOOP_MASK) >>
+           __OPTIWEAVE_SITE_LOOP_SHIFT;
+  };
+  seconds = std::max(seconds, 1e-9);
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\toperation\tloop_depth\t"
+                    "events\tbytes\tevents_per_sec\tbytes_per_sec\t"
+                    "deallocations\n");
+  std::size_t in_loops = 0;
+  for (const auto &[id, events] : active) {
+    const SiteRecord *site = sites.get(id);
+    std::uint64_t bytes = counts[id].bytes.load(std::memory_order_relaxed);
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%s\t%u\t%" PRIu64 "\t%" PRIu64
+                 "\t%.1f\t%.1f\t%" PRIu64 "\n",
+                 site->file, site->line, site->column, site->function,
+                 site->operation, loopDepth(site), events, bytes,
+                 events / seconds, bytes / seconds,
+                 counts[id].deallocations.load(std::memory_order_relaxed));
+    in_loops += loopDepth(site) > 0;
+  }
+  for (SiteId id : releasing) {
+    const SiteRecord *site = sites.get(id);
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%s\t%u\t0\t0\t0.0\t0.0\t%" PRIu64 "\n",
+                 site->file, site->line, site->column, site->function,
+                 site->operation, loopDepth(site),
+                 counts[id].deallocations.load(std::memory_order_relaxed));
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: allocations: %zu sites, %zu of them inside loops, "
+               "%zu deallocation sites, report in %s\n",
+               active.size(), in_loops, releasing.size(), path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(active.size(), 5); ++i) {
+    const auto &[id, events] = active[i];
+    const SiteRecord *site = sites.get(id);
+    std::string where = loopDepth(site) > 0
+                            ? ", in loop (depth " +
+                                  std::to_string(loopDepth(site)) + ")"
+                            : "";
+    std::fprintf(stderr, "OptiWeave:   %12.0f/s %s  %s, %" PRIu64 " bytes%s\n",
+                 events / seconds, describeSite(sites, id).c_str(),
+                 site->operation,
+                 counts[id].bytes.load(std::memory_order_relaxed),
+                 where.c_str());
+  }
+}
+
+void writeCopyReport(const CopyCounts *counts, const SiteRegistry &sites,
+                     const std::string &path) {
+  std::vector<std::pair<SiteId, std::uint64_t>> active;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    if (counts[id].events.load(std::memory_order_relaxed)) {
+      active.emplace_back(id, counts[id].bytes.load(std::memory_order_relaxed));
+    }
+  }
+  std::sort(active.begin(), active.end(),
+            [](const auto &a, const auto &b) { return a.second > b.second; });
+
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\toperation\ttype\t"
+                    "copies\tbytes\tmean_bytes\tlast_use\n");
+  std::size_t movable = 0;
+  for (const auto &[id, bytes] : active) {
+    const SiteRecord *site = sites.get(id);
+    std::uint64_t events = counts[id].events.load(std::memory_order_relaxed);
+    bool last_use = site->flags & __OPTIWEAVE_SITE_LAST_USE;
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%s\t%s\t%" PRIu64 "\t%" PRIu64
+                 "\t%.1f\t%d\n",
+                 site->file, site->line, site->column, site->function,
+                 site->operation, demangleType(site->type).c_str(), events,
+                 bytes, static_cast<double>(bytes) / events, last_use ? 1 : 0);
+    movable += last_use;
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: copies: %zu sites, %zu copy a local at its last "
+               "use, report in %s\n",
+               active.size(), movable, path.c_str());
+  for (std::size_t i = 0; i < std::min<std::size_t>(active.size(), 5); ++i) {
+    const auto &[id, bytes] = active[i];
+    const SiteRecord *site = sites.get(id);
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " bytes %s  %" PRIu64
+                 " copies of %s%s\n",
+                 bytes, describeSite(sites, id).c_str(),
+                 counts[id].events.load(std::memory_order_relaxed),
+                 demangleType(site->type).c_str(),
+                 site->flags & __OPTIWEAVE_SITE_LAST_USE
+                     ? "; last use, std::move it"
+                     : "");
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,111 @@
+#include "../../include/optiweave/runtime/site_registry.hpp"
+
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+namespace optiweave::runtime {
+namespace {
+/**
+    @brief splitmix64 finalizer, good enough to spread pointer bits
+*/
+std::uint64_t mixBits(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+bool sameSite(const SiteRecord &record, const char *operation,
+              const __optiweave_site_info &site) {
+  return record.operation == operation && record.file == site.file &&
+         record.line == site.line && record.column == site.column;
+}
+} // namespace
+
+SiteRegistry::SiteRegistry()
+    : slots_(new Slot[kCapacity]),
+      by_id_(new std::atomic<const Slot *>[kCapacity]) {
+  for (std::size_t i = 0; i < kCapacity; ++i) {
+    by_id_[i].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+SiteId SiteRegistry::intern(const char *operation,
+                            const __optiweave_site_info &site,
+                            bool *inserted) noexcept {
+  if (inserted) {
+    *inserted = false;
+  }
+
+  std::uint64_t key = reinterpret_cast<std::uintptr_t>(site.file) ^
+                      (reinterpret_cast<std::uintptr_t>(operation) << 1) ^
+                      (static_cast<std::uint64_t>(site.line) << 32) ^
+                      site.column;
+  std::uint64_t hash = mixBits(key);
+
+  for (std::size_t probe = 0; probe < kCapacity; ++probe) {
+    Slot &slot = slots_[(hash + probe) & (kCapacity - 1)];
+    std::uint32_t state = slot.state.load(std::memory_order_acquire);
+
+    if (state == kEmpty &&
+        slot.state.compare_exchange_strong(state, kClaimed,
+                                           std::memory_order_acq_rel)) {
+      slot.record.operation = operation;
+      slot.record.file = site.file;
+      slot.record.function = site.function;
+      slot.record.line = site.line;
+      slot.record.column = site.column;
+      slot.record.flags = site.flags;
+      slot.record.type = site.type;
+      slot.id = next_id_.fetch_add(1, std::memory_order_acq_rel);
+      by_id_[slot.id].store(&slot, std::memory_order_release);
+      slot.state.store(kReady, std::memory_order_release);
+      if (inserted) {
+        *inserted = true;
+      }
+      return slot.id;
+    }
+
+    // Another thread is publishing this slot; it finishes in a few stores
+    while (state == kClaimed) {
+      state = slot.state.load(std::memory_order_acquire);
+    }
+
+    if (sameSite(slot.record, operation, site)) {
+      return slot.id;
+    }
+  }
+
+  return kInvalidSite;
+}
+
+const SiteRecord *SiteRegistry::get(SiteId id) const noexcept {
+  if (id >= kCapacity) {
+    return nullptr;
+  }
+  const Slot *slot = by_id_[id].load(std::memory_order_acquire);
+  return slot ? &slot->record : nullptr;
+}
+
+void writeSiteTable(const SiteRegistry &sites, const std::string &directory) {
+  std::string path = directory + "/trace." +
+                     std::to_string(static_cast<int>(getpid())) + ".sites.tsv";
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "id\toperation\tfile\tline\tcolumn\tfunction\n");
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    if (const SiteRecord *site = sites.get(id)) {
+      std::fprintf(out, "%u\t%s\t%s\t%u\t%u\t%s\n", id, site->operation,
+                   site->file, site->line, site->column, site->function);
+    }
+  }
+  std::fclose(out);
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,170 @@
+#include "../../include/optiweave/runtime/stride_profiler.hpp"
+#include "../../include/optiweave/runtime/reuse_sampler.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+namespace optiweave::runtime {
+
+struct StrideProfiler::SiteCounters {
+  std::atomic<std::uint64_t> accesses{0};
+  std::atomic<std::uint64_t> regular{0};
+  std::atomic<std::uint64_t> new_lines{0};
+  std::atomic<std::int64_t> candidate{0};
+  std::atomic<std::int64_t> votes{0};
+  std::atomic<std::uint64_t> gap_ns{0};
+  std::atomic<std::uint64_t> gaps{0};
+};
+
+namespace {
+constexpr unsigned kLineShift = 6;
+
+void add(std::atomic<std::uint64_t> &counter, std::uint64_t amount = 1) {
+  counter.fetch_add(amount, std::memory_order_relaxed);
+}
+} // namespace
+
+StrideProfiler::StrideProfiler(std::size_t site_capacity)
+    : capacity_(site_capacity), sites_(new SiteCounters[site_capacity]) {}
+
+StrideProfiler::~StrideProfiler() = default;
+
+void StrideProfiler::access(StrideCursor *cursors, SiteId site,
+                            std::uintptr_t address,
+                            std::uint64_t now_ns) noexcept {
+  if (site >= capacity_) {
+    return;
+  }
+  SiteCounters &counters = sites_[site];
+  add(counters.accesses);
+
+  StrideCursor &cursor = cursors[site % kCursors];
+  if (cursor.site != site) {
+    // First access, or the slot was taken by another site: start over
+    cursor = {site, 0, address, now_ns};
+    return;
+  }
+
+  auto stride = static_cast<std::int64_t>(address - cursor.last_address);
+  if (stride != 0 && stride == cursor.last_stride) {
+    add(counters.regular);
+  }
+  if ((address >> kLineShift) != (cursor.last_address >> kLineShift)) {
+    add(counters.new_lines);
+  }
+  if (now_ns - cursor.last_ns < kMaxGapNs) {
+    add(counters.gap_ns, now_ns - cursor.last_ns);
+    add(counters.gaps);
+  }
+
+  // Majority vote over strides; races only blur the vote count
+  if (stride != 0) {
+    if (counters.candidate.load(std::memory_order_relaxed) == stride) {
+      counters.votes.fetch_add(1, std::memory_order_relaxed);
+    } else if (counters.votes.load(std::memory_order_relaxed) <= 0) {
+      counters.candidate.store(stride, std::memory_order_relaxed);
+      counters.votes.store(1, std::memory_order_relaxed);
+    } else {
+      counters.votes.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  cursor.last_stride = stride;
+  cursor.last_address = address;
+  cursor.last_ns = now_ns;
+}
+
+bool StrideProfiler::siteProfile(SiteId site,
+                                 SiteStrideProfile &out) const noexcept {
+  if (site >= capacity_) {
+    return false;
+  }
+  const SiteCounters &counters = sites_[site];
+  out.accesses = counters.accesses.load(std::memory_order_relaxed);
+  if (out.accesses == 0) {
+    return false;
+  }
+  out.regular = counters.regular.load(std::memory_order_relaxed);
+  out.new_lines = counters.new_lines.load(std::memory_order_relaxed);
+  out.stride = counters.candidate.load(std::memory_order_relaxed);
+  out.gap_ns = counters.gap_ns.load(std::memory_order_relaxed);
+  out.gaps = counters.gaps.load(std::memory_order_relaxed);
+  return true;
+}
+
+bool recommendPrefetch(const SiteStrideProfile &profile,
+                       const PrefetchAdviceConfig &config, double miss_ratio,
+                       std::uint32_t &distance) noexcept {
+  if (profile.accesses < config.min_accesses ||
+      profile.regularFraction() < config.min_regular || profile.stride == 0) {
+    return false;
+  }
+  // Streams that stay within a line are served by the line already fetched
+  // and by the hardware prefetcher
+  if (static_cast<std::uint64_t>(std::abs(profile.stride)) <
+          (std::uint64_t{1} << kLineShift) ||
+      profile.new_lines * 2 < profile.accesses) {
+    return false;
+  }
+  if (miss_ratio >= 0 && miss_ratio < config.min_miss_ratio) {
+    return false;
+  }
+
+  // Far enough ahead that the line arrives by the time the loop gets there.
+  // Measured iteration times include the instrumentation, so this errs on
+  // the short side.
+  double per_access = std::max(profile.nsPerAccess(), 1.0);
+  double iterations = std::ceil(static_cast<double>(config.latency_ns) /
+                                per_access);
+  distance = static_cast<std::uint32_t>(
+      std::clamp(iterations, 2.0, static_cast<double>(config.max_distance)));
+  return true;
+}
+
+void writePrefetchAdvice(const StrideProfiler &strides,
+                         const ReuseSampler *reuse, const SiteRegistry &sites,
+                         const PrefetchAdviceConfig &config,
+                         const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\tstride_bytes\tdistance\t"
+                    "accesses\tregular\tns_per_access\tmiss_ratio\n");
+
+  std::size_t advised = 0;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    const SiteRecord *site = sites.get(id);
+    SiteStrideProfile profile;
+    if (!site || !strides.siteProfile(id, profile)) {
+      continue;
+    }
+    // Without curves, assume the stream misses whenever it changes lines
+    double miss_ratio = -1;
+    ReuseHistogram histogram;
+    if (reuse && reuse->siteHistogram(id, histogram)) {
+      miss_ratio = histogram.missRatio((1u << 20) / reuse->lineBytes());
+    }
+    std::uint32_t distance = 0;
+    if (!recommendPrefetch(profile, config, miss_ratio, distance)) {
+      continue;
+    }
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%" PRId64 "\t%u\t%" PRIu64
+                 "\t%.3f\t%.1f\t%.3f\n",
+                 site->file, site->line, site->column, site->function,
+                 profile.stride, distance, profile.accesses,
+                 profile.regularFraction(), profile.nsPerAccess(), miss_ratio);
+    ++advised;
+  }
+  std::fclose(out);
+  std::fprintf(stderr,
+               "OptiWeave: prefetch: %zu sites advised, apply with "
+               "optiweave --insert-prefetch=%s\n",
+               advised, path.c_str());
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,361 @@
+#include "../../include/optiweave/runtime/telemetry.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace optiweave::runtime {
+namespace {
+constexpr const char *kSegmentPrefix = "optiweave.";
+
+std::uint64_t nowNanoseconds(clockid_t clock) {
+  timespec ts{};
+  clock_gettime(clock, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * 1000000000ULL +
+         static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+std::size_t alignUp(std::size_t value, std::size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+    @brief Copy a C string into a fixed field, keeping the tail of long
+    paths since that is the part that identifies a file
+*/
+template <std::size_t N> void copyField(char (&dest)[N], const char *src) {
+  if (!src) {
+    dest[0] = '\0';
+    return;
+  }
+  std::size_t length = std::strlen(src);
+  if (length >= N) {
+    src += length - (N - 1);
+    length = N - 1;
+  }
+  std::memcpy(dest, src, length);
+  dest[length] = '\0';
+}
+
+template <std::size_t N> std::string readField(const char (&src)[N]) {
+  return std::string(src, strnlen(src, N));
+}
+
+void beginWrite(std::atomic<std::uint32_t> &sequence) {
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void endWrite(std::atomic<std::uint32_t> &sequence) {
+  sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+}
+
+/**
+    @brief Run a copy under a seqlock read section
+    @return false if the record was never published
+*/
+template <typename CopyFn>
+bool readConsistent(const std::atomic<std::uint32_t> &sequence, CopyFn copy) {
+  for (;;) {
+    std::uint32_t before = sequence.load(std::memory_order_acquire);
+    if (before == 0) {
+      return false;
+    }
+    if (before & 1u) {
+      continue;
+    }
+    copy();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+}
+
+const char *programName() {
+#if defined(__GLIBC__)
+  return program_invocation_short_name;
+#else
+  return "";
+#endif
+}
+} // namespace
+
+std::string telemetrySegmentName(int pid) {
+  return "/" + std::string(kSegmentPrefix) + std::to_string(pid);
+}
+
+TelemetryPublisher::~TelemetryPublisher() { close(); }
+
+bool TelemetryPublisher::open(const std::string &name,
+                              std::uint32_t site_capacity,
+                              std::uint32_t thread_capacity, bool keep) {
+  close();
+
+  std::size_t sites_offset = alignUp(sizeof(TelemetryHeader), 64);
+  std::size_t threads_offset =
+      alignUp(sites_offset + sizeof(TelemetrySite) * site_capacity, 64);
+  std::size_t size = alignUp(
+      threads_offset + sizeof(TelemetryThread) * thread_capacity, 4096);
+
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::fprintf(stderr, "OptiWeave: cannot create telemetry segment %s: %s\n",
+                 name.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    std::fprintf(stderr, "OptiWeave: cannot size telemetry segment %s: %s\n",
+                 name.c_str(), std::strerror(errno));
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    std::fprintf(stderr, "OptiWeave: cannot map telemetry segment %s: %s\n",
+                 name.c_str(), std::strerror(errno));
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  // ftruncate zero-fills, so every sequence starts at 0 ("unpublished")
+  auto *bytes = static_cast<char *>(base);
+  header_ = new (bytes) TelemetryHeader;
+  sites_ = reinterpret_cast<TelemetrySite *>(bytes + sites_offset);
+  threads_ = reinterpret_cast<TelemetryThread *>(bytes + threads_offset);
+
+  header_->version = kTelemetryVersion;
+  header_->site_capacity = site_capacity;
+  header_->thread_capacity = thread_capacity;
+  header_->pid = static_cast<std::int32_t>(getpid());
+  header_->start_time_ns = nowNanoseconds(CLOCK_REALTIME);
+  header_->sites_offset = sites_offset;
+  header_->threads_offset = threads_offset;
+  copyField(header_->program, programName());
+  // Publishing the magic last tells readers the layout fields are valid
+  header_->magic.store(kTelemetryMagic, std::memory_order_release);
+
+  name_ = name;
+  keep_ = keep;
+  linked_ = true;
+  base_ = base;
+  size_ = size;
+  site_capacity_ = site_capacity;
+  thread_capacity_ = thread_capacity;
+  return true;
+}
+
+void TelemetryPublisher::close() {
+  if (!base_) {
+    return;
+  }
+  munmap(base_, size_);
+  unlink();
+  base_ = nullptr;
+  header_ = nullptr;
+  sites_ = nullptr;
+  threads_ = nullptr;
+  site_capacity_ = 0;
+  thread_capacity_ = 0;
+}
+
+void TelemetryPublisher::unlink() noexcept {
+  if (!linked_) {
+    return;
+  }
+  linked_ = false;
+  if (!keep_) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+void TelemetryPublisher::publishSite(SiteId id,
+                                     const SiteRecord &record) noexcept {
+  if (!header_ || id >= site_capacity_) {
+    return;
+  }
+
+  TelemetrySite &site = sites_[id];
+  beginWrite(site.sequence);
+  site.line = record.line;
+  site.column = record.column;
+  copyField(site.operation, record.operation);
+  copyField(site.file, record.file);
+  copyField(site.function, record.function);
+  endWrite(site.sequence);
+
+  std::uint32_t seen = header_->site_count.load(std::memory_order_relaxed);
+  while (seen <= id && !header_->site_count.compare_exchange_weak(
+                           seen, id + 1, std::memory_order_release)) {
+  }
+}
+
+void TelemetryPublisher::publishThread(std::uint32_t index,
+                                       std::uint64_t os_tid,
+                                       bool active) noexcept {
+  if (!header_ || index >= thread_capacity_) {
+    return;
+  }
+
+  TelemetryThread &thread = threads_[index];
+  beginWrite(thread.sequence);
+  thread.os_tid = os_tid;
+  thread.active = active ? 1 : 0;
+  if (active) {
+    thread.events.store(0, std::memory_order_relaxed);
+  }
+  endWrite(thread.sequence);
+
+  std::uint32_t seen = header_->thread_count.load(std::memory_order_relaxed);
+  while (seen <= index && !header_->thread_count.compare_exchange_weak(
+                              seen, index + 1, std::memory_order_release)) {
+  }
+}
+
+TelemetryReader::~TelemetryReader() { detach(); }
+
+bool TelemetryReader::attach(const std::string &name, std::string &error) {
+  detach();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    error = "cannot open " + name + ": " + std::strerror(errno);
+    return false;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) < sizeof(TelemetryHeader)) {
+    error = "segment " + name + " is too small";
+    ::close(fd);
+    return false;
+  }
+
+  std::size_t size = static_cast<std::size_t>(info.st_size);
+  void *base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    error = "cannot map " + name + ": " + std::strerror(errno);
+    return false;
+  }
+
+  const auto *header = static_cast<const TelemetryHeader *>(base);
+  if (header->magic.load(std::memory_order_acquire) != kTelemetryMagic ||
+      header->version != kTelemetryVersion ||
+      header->threads_offset +
+              sizeof(TelemetryThread) * header->thread_capacity >
+          size) {
+    error = "segment " + name + " is not an OptiWeave telemetry segment";
+    munmap(base, size);
+    return false;
+  }
+
+  base_ = base;
+  size_ = size;
+  header_ = header;
+  return true;
+}
+
+void TelemetryReader::detach() {
+  if (base_) {
+    munmap(const_cast<void *>(base_), size_);
+  }
+  base_ = nullptr;
+  header_ = nullptr;
+  size_ = 0;
+}
+
+TelemetrySnapshot TelemetryReader::snapshot() const {
+  TelemetrySnapshot result;
+  if (!header_) {
+    return result;
+  }
+
+  const auto *bytes = static_cast<const char *>(base_);
+  const auto *sites =
+      reinterpret_cast<const TelemetrySite *>(bytes + header_->sites_offset);
+  const auto *threads = reinterpret_cast<const TelemetryThread *>(
+      bytes + header_->threads_offset);
+
+  result.pid = header_->pid;
+  result.program = readField(header_->program);
+  result.start_time_ns = header_->start_time_ns;
+  result.taken_at_ns = nowNanoseconds(CLOCK_MONOTONIC);
+  result.dropped_events =
+      header_->dropped_events.load(std::memory_order_relaxed);
+
+  std::uint32_t site_count = std::min(
+      header_->site_count.load(std::memory_order_acquire),
+      header_->site_capacity);
+  result.sites.reserve(site_count);
+  for (std::uint32_t id = 0; id < site_count; ++id) {
+    const TelemetrySite &site = sites[id];
+    SiteSnapshot copy;
+    bool published = readConsistent(site.sequence, [&] {
+      copy.line = site.line;
+      copy.column = site.column;
+      copy.operation = readField(site.operation);
+      copy.file = readField(site.file);
+      copy.function = readField(site.function);
+    });
+    if (!published) {
+      continue;
+    }
+    copy.id = id;
+    copy.count = site.count.load(std::memory_order_relaxed);
+    result.sites.push_back(std::move(copy));
+  }
+
+  std::uint32_t thread_count = std::min(
+      header_->thread_count.load(std::memory_order_acquire),
+      header_->thread_capacity);
+  for (std::uint32_t index = 0; index < thread_count; ++index) {
+    const TelemetryThread &thread = threads[index];
+    ThreadSnapshot copy;
+    bool published = readConsistent(thread.sequence, [&] {
+      copy.os_tid = thread.os_tid;
+      copy.active = thread.active != 0;
+    });
+    if (!published) {
+      continue;
+    }
+    copy.index = index;
+    copy.events = thread.events.load(std::memory_order_relaxed);
+    result.threads.push_back(copy);
+  }
+
+  return result;
+}
+
+std::vector<std::string> listTelemetrySegments() {
+  std::vector<std::string> names;
+  DIR *dir = opendir("/dev/shm");
+  if (!dir) {
+    return names;
+  }
+  while (dirent *entry = readdir(dir)) {
+    if (std::strncmp(entry->d_name, kSegmentPrefix,
+                     std::strlen(kSegmentPrefix)) == 0) {
+      names.push_back("/" + std::string(entry->d_name));
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+} // namespace optiweave::runtime
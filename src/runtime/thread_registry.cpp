@@ -0,0 +1,54 @@
+#include "../../include/optiweave/runtime/thread_registry.hpp"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace optiweave::runtime {
+
+ThreadRegistry::ThreadRegistry() {
+  for (std::size_t i = 0; i < kMaxThreads; ++i) {
+    records_[i].index = static_cast<std::uint32_t>(i);
+  }
+}
+
+ThreadRecord *ThreadRegistry::acquire() noexcept {
+  for (auto &record : records_) {
+    bool expected = false;
+    if (record.in_use.load(std::memory_order_relaxed) ||
+        !record.in_use.compare_exchange_strong(expected, true,
+                                               std::memory_order_acq_rel)) {
+      continue;
+    }
+
+    record.os_tid = currentOsThreadId();
+
+    std::uint32_t seen = high_water_.load(std::memory_order_relaxed);
+    while (seen <= record.index &&
+           !high_water_.compare_exchange_weak(seen, record.index + 1,
+                                              std::memory_order_acq_rel)) {
+    }
+    return &record;
+  }
+  return nullptr;
+}
+
+void ThreadRegistry::release(ThreadRecord *record) noexcept {
+  if (record) {
+    record->in_use.store(false, std::memory_order_release);
+  }
+}
+
+std::uint64_t currentOsThreadId() noexcept {
+#if defined(__linux__)
+  return static_cast<std::uint64_t>(::syscall(SYS_gettid));
+#elif defined(__APPLE__)
+  std::uint64_t tid = 0;
+  pthread_threadid_np(nullptr, &tid);
+  return tid;
+#else
+  return 0;
+#endif
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,275 @@
+#include "../../include/optiweave/runtime/trace_io.hpp"
+
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#if defined(OPTIWEAVE_HAVE_LIBURING)
+#include <liburing.h>
+#endif
+
+namespace optiweave::runtime {
+namespace {
+
+/**
+    @brief pwrite until done, retrying EINTR and short writes
+*/
+bool writeFully(int fd, const char *data, std::size_t bytes, off_t offset) {
+  while (bytes > 0) {
+    ssize_t written = pwrite(fd, data, bytes, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::fprintf(stderr, "OptiWeave: trace write failed: %s\n",
+                   std::strerror(errno));
+      return false;
+    }
+    data += written;
+    bytes -= static_cast<std::size_t>(written);
+    offset += written;
+  }
+  return true;
+}
+
+/**
+    @brief Portable backend: a dedicated thread issuing pwrite(2)
+*/
+class PwriteIo final : public TraceIo {
+public:
+  PwriteIo() : worker_([this] { run(); }) {}
+
+  ~PwriteIo() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    worker_.join();
+  }
+
+  bool submit(unsigned slot, int fd, const void *data, std::size_t bytes,
+              off_t offset) override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_[slot] = true;
+      failed_[slot] = false;
+      queue_.push_back({slot, fd, static_cast<const char *>(data), bytes,
+                        offset});
+    }
+    wake_.notify_all();
+    return true;
+  }
+
+  bool wait(unsigned slot) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return !pending_[slot]; });
+    return !failed_[slot];
+  }
+
+  bool waitAll() override {
+    bool ok = true;
+    for (unsigned slot = 0; slot < kMaxBuffers; ++slot) {
+      ok = wait(slot) && ok;
+    }
+    return ok;
+  }
+
+  const char *name() const override { return "pwrite"; }
+
+private:
+  struct Request {
+    unsigned slot;
+    int fd;
+    const char *data;
+    std::size_t bytes;
+    off_t offset;
+  };
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      wake_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      Request request = queue_.front();
+      queue_.pop_front();
+
+      lock.unlock();
+      bool ok = writeFully(request.fd, request.data, request.bytes,
+                           request.offset);
+      lock.lock();
+
+      pending_[request.slot] = false;
+      failed_[request.slot] = !ok;
+      done_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::deque<Request> queue_;
+  std::array<bool, kMaxBuffers> pending_{};
+  std::array<bool, kMaxBuffers> failed_{};
+  bool stopping_ = false;
+  std::thread worker_;
+};
+
+#if defined(OPTIWEAVE_HAVE_LIBURING)
+/**
+    @brief io_uring backend; submission and completion both happen on the
+    trace writer thread, so no extra thread or lock is needed
+*/
+class UringIo final : public TraceIo {
+public:
+  bool init() {
+    initialized_ = io_uring_queue_init(2 * kMaxBuffers, &ring_, 0) == 0;
+    return initialized_;
+  }
+
+  ~UringIo() override {
+    if (initialized_) {
+      waitAll();
+      io_uring_queue_exit(&ring_);
+    }
+  }
+
+  bool submit(unsigned slot, int fd, const void *data, std::size_t bytes,
+              off_t offset) override {
+    requests_[slot] = {fd, static_cast<const char *>(data), bytes, offset};
+    pending_[slot] = true;
+    failed_[slot] = false;
+    return queue(slot);
+  }
+
+  bool wait(unsigned slot) override {
+    while (pending_[slot]) {
+      io_uring_cqe *cqe = nullptr;
+      int rc = io_uring_wait_cqe(&ring_, &cqe);
+      if (rc == -EINTR) {
+        continue;
+      }
+      if (rc < 0) {
+        // Ring is unusable; finish everything synchronously
+        for (unsigned other = 0; other < kMaxBuffers; ++other) {
+          if (pending_[other]) {
+            complete(other, writeFully(requests_[other].fd,
+                                       requests_[other].data,
+                                       requests_[other].bytes,
+                                       requests_[other].offset));
+          }
+        }
+        break;
+      }
+      auto done = static_cast<unsigned>(
+          reinterpret_cast<std::uintptr_t>(io_uring_cqe_get_data(cqe)));
+      int result = cqe->res;
+      io_uring_cqe_seen(&ring_, cqe);
+      handleCompletion(done, result);
+    }
+    return !failed_[slot];
+  }
+
+  bool waitAll() override {
+    bool ok = true;
+    for (unsigned slot = 0; slot < kMaxBuffers; ++slot) {
+      ok = wait(slot) && ok;
+    }
+    return ok;
+  }
+
+  const char *name() const override { return "io_uring"; }
+
+private:
+  struct Request {
+    int fd = -1;
+    const char *data = nullptr;
+    std::size_t bytes = 0;
+    off_t offset = 0;
+  };
+
+  bool queue(unsigned slot) {
+    io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
+    if (!sqe) {
+      io_uring_submit(&ring_);
+      sqe = io_uring_get_sqe(&ring_);
+    }
+    if (!sqe) {
+      complete(slot, writeFully(requests_[slot].fd, requests_[slot].data,
+                                requests_[slot].bytes, requests_[slot].offset));
+      return !failed_[slot];
+    }
+    const Request &request = requests_[slot];
+    io_uring_prep_write(sqe, request.fd, request.data,
+                        static_cast<unsigned>(request.bytes),
+                        static_cast<__u64>(request.offset));
+    io_uring_sqe_set_data(
+        sqe, reinterpret_cast<void *>(static_cast<std::uintptr_t>(slot)));
+    return io_uring_submit(&ring_) >= 0;
+  }
+
+  void handleCompletion(unsigned slot, int result) {
+    if (slot >= kMaxBuffers || !pending_[slot]) {
+      return;
+    }
+    Request &request = requests_[slot];
+    if (result < 0) {
+      std::fprintf(stderr, "OptiWeave: trace write failed: %s\n",
+                   std::strerror(-result));
+      complete(slot, false);
+      return;
+    }
+    auto written = static_cast<std::size_t>(result);
+    if (written < request.bytes) {
+      // Short write: resubmit the remainder
+      request.data += written;
+      request.bytes -= written;
+      request.offset += static_cast<off_t>(written);
+      if (!queue(slot)) {
+        complete(slot, false);
+      }
+      return;
+    }
+    complete(slot, true);
+  }
+
+  void complete(unsigned slot, bool ok) {
+    pending_[slot] = false;
+    failed_[slot] = !ok;
+  }
+
+  io_uring ring_{};
+  bool initialized_ = false;
+  std::array<Request, kMaxBuffers> requests_{};
+  std::array<bool, kMaxBuffers> pending_{};
+  std::array<bool, kMaxBuffers> failed_{};
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<TraceIo> TraceIo::create(bool prefer_uring) {
+#if defined(OPTIWEAVE_HAVE_LIBURING)
+  if (prefer_uring) {
+    auto uring = std::make_unique<UringIo>();
+    if (uring->init()) {
+      return uring;
+    }
+    // Kernels without io_uring (or with it disabled) fall through
+  }
+#else
+  (void)prefer_uring; // pwrite is the only backend
+#endif
+  return std::make_unique<PwriteIo>();
+}
+
+} // namespace optiweave::runtime
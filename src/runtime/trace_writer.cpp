@@ -0,0 +1,599 @@
+#include "../../include/optiweave/runtime/trace_writer.hpp"
+#include "../../include/optiweave/runtime/clock.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace optiweave::runtime {
+namespace {
+
+constexpr std::size_t roundUp(std::size_t value, std::size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+char *allocateAligned(std::size_t bytes) {
+  void *memory = nullptr;
+  if (posix_memalign(&memory, kTraceAlignment, bytes) != 0) {
+    return nullptr;
+  }
+  std::memset(memory, 0, bytes);
+  return static_cast<char *>(memory);
+}
+
+/**
+    @brief Open a segment, falling back to buffered I/O if the filesystem
+    refuses O_DIRECT (tmpfs, some overlay setups)
+*/
+int openSegmentFile(const std::string &path, bool direct_io) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#ifdef O_DIRECT
+  if (direct_io) {
+    int fd = open(path.c_str(), flags | O_DIRECT, 0644);
+    if (fd >= 0 || errno != EINVAL) {
+      return fd;
+    }
+  }
+#else
+  (void)direct_io;
+#endif
+  return open(path.c_str(), flags, 0644);
+}
+
+// Source of padding bytes for the crash path, which cannot allocate
+const char kZeroPage[kTraceAlignment] = {};
+
+/**
+    @brief write(2) until done; async-signal-safe
+*/
+bool writeAll(int fd, const void *data, std::size_t bytes) noexcept {
+  auto cursor = static_cast<const char *>(data);
+  while (bytes > 0) {
+    ssize_t written = write(fd, cursor, bytes);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    cursor += written;
+    bytes -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+/**
+    @brief Write events from up to two spans as one block; async-signal-safe
+*/
+void writeCrashBlock(int fd, const TraceEvent *first, std::size_t first_count,
+                     const TraceEvent *second, std::size_t second_count) {
+  std::size_t count = first_count + second_count;
+  if (count == 0) {
+    return;
+  }
+  std::size_t used = sizeof(TraceBlockHeader) + count * sizeof(TraceEvent);
+  std::size_t bytes = roundUp(used, kTraceAlignment);
+
+  TraceBlockHeader header{};
+  header.magic = kTraceBlockMagic;
+  header.event_count = static_cast<std::uint32_t>(count);
+  header.block_bytes = static_cast<std::uint32_t>(bytes);
+  header.first_timestamp_ns = ~0ULL;
+  auto widen = [&header](const TraceEvent *span, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      header.first_timestamp_ns =
+          std::min(header.first_timestamp_ns, span[i].timestamp_ns);
+      header.last_timestamp_ns =
+          std::max(header.last_timestamp_ns, span[i].timestamp_ns);
+    }
+  };
+  widen(first, first_count);
+  widen(second, second_count);
+
+  writeAll(fd, &header, sizeof(header));
+  writeAll(fd, first, first_count * sizeof(TraceEvent));
+  writeAll(fd, second, second_count * sizeof(TraceEvent));
+  for (std::size_t pad = bytes - used; pad > 0;) {
+    std::size_t chunk = std::min(pad, sizeof(kZeroPage));
+    writeAll(fd, kZeroPage, chunk);
+    pad -= chunk;
+  }
+}
+
+} // namespace
+
+bool parseBackpressurePolicy(const std::string &name,
+                             BackpressurePolicy &policy) {
+  if (name == "drop") {
+    policy = BackpressurePolicy::Drop;
+  } else if (name == "sample") {
+    policy = BackpressurePolicy::Sample;
+  } else if (name == "block") {
+    policy = BackpressurePolicy::Block;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *backpressurePolicyName(BackpressurePolicy policy) {
+  switch (policy) {
+  case BackpressurePolicy::Drop:
+    return "drop";
+  case BackpressurePolicy::Sample:
+    return "sample";
+  case BackpressurePolicy::Block:
+    return "block";
+  }
+  return "unknown";
+}
+
+TraceWriter::TraceWriter(ThreadRegistry &threads, TraceWriterConfig config)
+    : threads_(threads), config_(std::move(config)) {
+  config_.block_bytes =
+      roundUp(std::max(config_.block_bytes, 2 * kTraceAlignment),
+              kTraceAlignment);
+  events_per_block_ =
+      (config_.block_bytes - sizeof(TraceBlockHeader)) / sizeof(TraceEvent);
+
+  // A segment holds at least one block, and the budget at least two
+  // segments so that rotation always has something to delete
+  config_.segment_bytes = std::max<std::uint64_t>(
+      config_.segment_bytes, kTraceAlignment + config_.block_bytes);
+  if (config_.disk_budget_bytes < 2 * config_.segment_bytes) {
+    config_.segment_bytes =
+        std::max<std::uint64_t>(config_.disk_budget_bytes / 2,
+                                kTraceAlignment + config_.block_bytes);
+    config_.disk_budget_bytes = 2 * config_.segment_bytes;
+  }
+
+  config_.ring_events = std::max<std::size_t>(config_.ring_events, 64);
+  config_.sample_rate = std::max<std::uint32_t>(config_.sample_rate, 1);
+  sample_threshold_ = config_.ring_events / 4 * 3;
+}
+
+TraceWriter::~TraceWriter() {
+  stop();
+  for (Block &block : blocks_) {
+    std::free(block.data);
+  }
+  std::free(crash_header_);
+}
+
+bool TraceWriter::start() {
+  if (running_.load(std::memory_order_relaxed) || stopped_) {
+    return running_.load(std::memory_order_relaxed);
+  }
+
+  if (mkdir(config_.directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    std::fprintf(stderr, "OptiWeave: cannot create trace directory %s: %s\n",
+                 config_.directory.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  for (Block &block : blocks_) {
+    block.data = allocateAligned(config_.block_bytes);
+    if (!block.data) {
+      std::fprintf(stderr, "OptiWeave: cannot allocate trace buffers\n");
+      return false;
+    }
+  }
+
+  io_ = TraceIo::create(config_.prefer_uring);
+  if (!openSegment()) {
+    return false;
+  }
+  if (config_.crash_flush && !openCrashFile()) {
+    // Tracing still works, the last events are just lost on a crash
+    config_.crash_flush = false;
+  }
+
+  block_started_ns_ = monotonicNanoseconds();
+  running_.store(true, std::memory_order_release);
+  thread_ = std::thread([this] { run(); });
+  return true;
+}
+
+void TraceWriter::stop() {
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+
+  if (!running_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  stopping_.store(true, std::memory_order_release);
+  thread_.join();
+  running_.store(false, std::memory_order_release);
+
+  if (crash_fd_ >= 0) {
+    close(crash_fd_);
+    crash_fd_ = -1;
+    if (!crash_flushed_.load(std::memory_order_acquire)) {
+      unlink(crash_path_.c_str());
+    }
+  }
+}
+
+void TraceWriter::flushForCrash() noexcept {
+  if (crash_fd_ < 0 || crash_flushed_.exchange(true)) {
+    return;
+  }
+  int fd = crash_fd_;
+  writeAll(fd, crash_header_, kTraceAlignment);
+
+  // Submitted to the I/O backend, which may not get to finish it
+  int inflight = inflight_block_.load(std::memory_order_acquire);
+  if (inflight >= 0) {
+    const char *data = blocks_[inflight].data;
+    auto header = reinterpret_cast<const TraceBlockHeader *>(data);
+    writeAll(fd, data, header->block_bytes);
+  }
+
+  // Drained from the rings but not yet submitted
+  Block &active = blocks_[active_block_.load(std::memory_order_acquire)];
+  std::size_t pending = std::min(active.events.load(std::memory_order_acquire),
+                                 events_per_block_);
+  writeCrashBlock(fd, blockEvents(active), pending, nullptr, 0);
+
+  // Still sitting in the per-thread rings
+  for (std::size_t i = 0, end = threads_.highWater(); i < end; ++i) {
+    EventRing *ring = threads_.at(i).ring.load(std::memory_order_acquire);
+    if (!ring) {
+      continue;
+    }
+    const TraceEvent *first = nullptr;
+    const TraceEvent *second = nullptr;
+    std::size_t first_count = 0;
+    std::size_t second_count = 0;
+    ring->peek(first, first_count, second, second_count);
+    writeCrashBlock(fd, first, first_count, second, second_count);
+  }
+}
+
+const char *TraceWriter::ioBackendName() const {
+  return io_ ? io_->name() : "none";
+}
+
+TraceWriterStats TraceWriter::stats() const {
+  TraceWriterStats stats;
+  stats.events_written = events_written_.load(std::memory_order_relaxed);
+  stats.events_dropped = budget_dropped_.load(std::memory_order_relaxed);
+  stats.blocks_written = blocks_written_.load(std::memory_order_relaxed);
+  stats.bytes_written = bytes_written_.load(std::memory_order_relaxed);
+  stats.segments_opened = segments_opened_.load(std::memory_order_relaxed);
+  stats.segments_deleted = segments_deleted_.load(std::memory_order_relaxed);
+  stats.write_errors = write_errors_.load(std::memory_order_relaxed);
+
+  for (std::size_t i = 0, end = threads_.highWater(); i < end; ++i) {
+    const ThreadRecord &thread = threads_.at(i);
+    stats.events_dropped +=
+        thread.trace_dropped.load(std::memory_order_relaxed);
+    stats.events_sampled_out +=
+        thread.trace_sampled_out.load(std::memory_order_relaxed);
+    stats.producer_waits += thread.trace_waits.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+std::vector<std::string> TraceWriter::segments() const {
+  std::vector<std::string> paths;
+  for (const Segment &segment : closed_segments_) {
+    paths.push_back(segment.path);
+  }
+  if (!current_path_.empty()) {
+    paths.push_back(current_path_);
+  }
+  return paths;
+}
+
+EventRing *TraceWriter::attachRing(ThreadRecord &thread) noexcept {
+  if (!running_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  EventRing *ring = EventRing::create(config_.ring_events);
+  if (ring) {
+    thread.ring.store(ring, std::memory_order_release);
+  }
+  return ring;
+}
+
+void TraceWriter::waitForSpace(ThreadRecord &thread, EventRing &ring,
+                               const TraceEvent &event) noexcept {
+  bumpOwned(thread.trace_waits);
+  while (!ring.tryPush(event)) {
+    if (!running_.load(std::memory_order_acquire) ||
+        stopping_.load(std::memory_order_acquire)) {
+      // Nobody will drain this ring any more
+      bumpOwned(thread.trace_dropped);
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+TraceEvent *TraceWriter::blockEvents(Block &block) const {
+  return reinterpret_cast<TraceEvent *>(block.data + sizeof(TraceBlockHeader));
+}
+
+void TraceWriter::run() {
+  const std::uint64_t interval_ns =
+      static_cast<std::uint64_t>(config_.flush_interval_ms) * 1000000ULL;
+
+  while (!stopping_.load(std::memory_order_acquire)) {
+    std::size_t drained = drainRings();
+
+    if (blocks_[active_block_.load(std::memory_order_relaxed)].events.load(
+            std::memory_order_relaxed) > 0 &&
+        monotonicNanoseconds() - block_started_ns_ >= interval_ns) {
+      flushBlock();
+    }
+    if (drained == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  // Producers may still be running; take what is there now and finish
+  while (drainRings() > 0) {
+  }
+  flushBlock();
+  closeSegment();
+}
+
+std::size_t TraceWriter::drainRings() {
+  std::size_t total = 0;
+  for (std::size_t i = 0, end = threads_.highWater(); i < end; ++i) {
+    EventRing *ring = threads_.at(i).ring.load(std::memory_order_acquire);
+    if (!ring) {
+      continue;
+    }
+    for (;;) {
+      Block &block = blocks_[active_block_.load(std::memory_order_relaxed)];
+      std::size_t filled = block.events.load(std::memory_order_relaxed);
+      std::size_t got = ring->drain(blockEvents(block) + filled,
+                                    events_per_block_ - filled);
+      if (got == 0) {
+        break;
+      }
+      block.events.store(filled + got, std::memory_order_release);
+      total += got;
+      if (filled + got == events_per_block_) {
+        flushBlock();
+      }
+    }
+  }
+  return total;
+}
+
+bool TraceWriter::flushBlock() {
+  unsigned slot = active_block_.load(std::memory_order_relaxed);
+  Block &block = blocks_[slot];
+  std::size_t count = block.events.load(std::memory_order_relaxed);
+  if (count == 0) {
+    return true;
+  }
+
+  const TraceEvent *events = blockEvents(block);
+  std::size_t used = sizeof(TraceBlockHeader) + count * sizeof(TraceEvent);
+  std::size_t bytes = roundUp(used, kTraceAlignment);
+  std::memset(block.data + used, 0, bytes - used);
+
+  // Rings are drained one after another, so the block is not sorted
+  auto header = reinterpret_cast<TraceBlockHeader *>(block.data);
+  header->magic = kTraceBlockMagic;
+  header->event_count = static_cast<std::uint32_t>(count);
+  header->block_bytes = static_cast<std::uint32_t>(bytes);
+  header->first_timestamp_ns = events[0].timestamp_ns;
+  header->last_timestamp_ns = events[0].timestamp_ns;
+  for (std::size_t i = 1; i < count; ++i) {
+    header->first_timestamp_ns =
+        std::min(header->first_timestamp_ns, events[i].timestamp_ns);
+    header->last_timestamp_ns =
+        std::max(header->last_timestamp_ns, events[i].timestamp_ns);
+  }
+
+  if (fd_ >= 0 && file_offset_ > kTraceAlignment &&
+      file_offset_ + bytes > config_.segment_bytes) {
+    closeSegment();
+    openSegment();
+  }
+
+  bool ok = false;
+  if (fd_ >= 0) {
+    enforceBudget(bytes);
+    if (closed_bytes_ + file_offset_ + bytes <= config_.disk_budget_bytes) {
+      ok = io_->submit(slot, fd_, block.data, bytes,
+                       static_cast<off_t>(file_offset_));
+    } else {
+      budget_dropped_.fetch_add(count, std::memory_order_relaxed);
+    }
+  }
+
+  if (ok) {
+    file_offset_ += bytes;
+    events_written_.fetch_add(count, std::memory_order_relaxed);
+    blocks_written_.fetch_add(1, std::memory_order_relaxed);
+    bytes_written_.fetch_add(bytes, std::memory_order_relaxed);
+  } else if (fd_ >= 0) {
+    write_errors_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Fill the other buffer while this one is in flight
+  unsigned next = slot ^ 1u;
+  if (!io_->wait(next)) {
+    write_errors_.fetch_add(1, std::memory_order_relaxed);
+  }
+  inflight_block_.store(ok ? static_cast<int>(slot) : -1,
+                        std::memory_order_release);
+  if (!ok) {
+    block.events.store(0, std::memory_order_release);
+  }
+  blocks_[next].events.store(0, std::memory_order_release);
+  active_block_.store(next, std::memory_order_release);
+  block_started_ns_ = monotonicNanoseconds();
+  return ok;
+}
+
+bool TraceWriter::openSegment() {
+  char name[64];
+  std::snprintf(name, sizeof(name), "trace.%d.%u.owt",
+                static_cast<int>(getpid()), segment_index_);
+  std::string path = config_.directory + "/" + name;
+
+  fd_ = openSegmentFile(path, config_.direct_io);
+  if (fd_ < 0) {
+    std::fprintf(stderr, "OptiWeave: cannot open trace segment %s: %s\n",
+                 path.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  // The header page goes through the same aligned path as the blocks
+  char *page = allocateAligned(kTraceAlignment);
+  if (!page) {
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+  TraceFileHeader header{};
+  header.magic = kTraceFileMagic;
+  header.version = kTraceFormatVersion;
+  header.event_size = sizeof(TraceEvent);
+  header.pid = static_cast<std::int32_t>(getpid());
+  header.segment_index = segment_index_;
+  header.start_time_ns = monotonicNanoseconds();
+  std::memcpy(page, &header, sizeof(header));
+
+  enforceBudget(kTraceAlignment);
+  ssize_t written = pwrite(fd_, page, kTraceAlignment, 0);
+  std::free(page);
+  if (written != static_cast<ssize_t>(kTraceAlignment)) {
+    std::fprintf(stderr, "OptiWeave: cannot write trace segment %s\n",
+                 path.c_str());
+    close(fd_);
+    fd_ = -1;
+    return false;
+  }
+
+  current_path_ = std::move(path);
+  file_offset_ = kTraceAlignment;
+  ++segment_index_;
+  segments_opened_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool TraceWriter::openCrashFile() {
+  char name[64];
+  std::snprintf(name, sizeof(name), "trace.%d.crash.owt",
+                static_cast<int>(getpid()));
+  crash_path_ = config_.directory + "/" + name;
+
+  crash_header_ = allocateAligned(kTraceAlignment);
+  if (!crash_header_) {
+    return false;
+  }
+  crash_fd_ = open(crash_path_.c_str(),
+                   O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (crash_fd_ < 0) {
+    std::fprintf(stderr, "OptiWeave: cannot open crash trace %s: %s\n",
+                 crash_path_.c_str(), std::strerror(errno));
+    return false;
+  }
+
+  TraceFileHeader header{};
+  header.magic = kTraceFileMagic;
+  header.version = kTraceFormatVersion;
+  header.event_size = sizeof(TraceEvent);
+  header.pid = static_cast<std::int32_t>(getpid());
+  header.segment_index = kCrashSegmentIndex;
+  header.start_time_ns = monotonicNanoseconds();
+  std::memcpy(crash_header_, &header, sizeof(header));
+  return true;
+}
+
+void TraceWriter::closeSegment() {
+  if (fd_ < 0) {
+    return;
+  }
+  if (!io_->waitAll()) {
+    write_errors_.fetch_add(1, std::memory_order_relaxed);
+  }
+  inflight_block_.store(-1, std::memory_order_release);
+  close(fd_);
+  fd_ = -1;
+
+  closed_segments_.push_back({current_path_, file_offset_});
+  closed_bytes_ += file_offset_;
+  current_path_.clear();
+  file_offset_ = 0;
+}
+
+void TraceWriter::enforceBudget(std::uint64_t incoming_bytes) {
+  while (!closed_segments_.empty() &&
+         closed_bytes_ + file_offset_ + incoming_bytes >
+             config_.disk_budget_bytes) {
+    const Segment &oldest = closed_segments_.front();
+    if (unlink(oldest.path.c_str()) != 0 && errno != ENOENT) {
+      std::fprintf(stderr, "OptiWeave: cannot delete trace segment %s: %s\n",
+                   oldest.path.c_str(), std::strerror(errno));
+    }
+    closed_bytes_ -= oldest.bytes;
+    closed_segments_.pop_front();
+    segments_deleted_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool readTraceSegment(const std::string &path, std::vector<TraceEvent> &events,
+                      std::string &error) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  TraceFileHeader header{};
+  if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != kTraceFileMagic) {
+    error = path + " is not an OptiWeave trace segment";
+    return false;
+  }
+  if (header.version != kTraceFormatVersion ||
+      header.event_size != sizeof(TraceEvent)) {
+    error = path + " has an unsupported trace format version";
+    return false;
+  }
+  in.seekg(static_cast<std::streamoff>(kTraceAlignment));
+
+  std::vector<char> buffer;
+  for (;;) {
+    TraceBlockHeader block{};
+    if (!in.read(reinterpret_cast<char *>(&block), sizeof(block))) {
+      break; // end of segment
+    }
+    if (block.magic != kTraceBlockMagic ||
+        block.block_bytes < sizeof(block) + block.event_count *
+                                                sizeof(TraceEvent)) {
+      error = path + " contains a corrupt block";
+      return false;
+    }
+    buffer.resize(block.block_bytes - sizeof(block));
+    if (!in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+      error = path + " ends inside a block";
+      return false;
+    }
+    std::size_t first = events.size();
+    events.resize(first + block.event_count);
+    std::memcpy(events.data() + first, buffer.data(),
+                block.event_count * sizeof(TraceEvent));
+  }
+  return true;
+}
+
+} // namespace optiweave::runtime
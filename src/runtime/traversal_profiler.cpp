@@ -0,0 +1,177 @@
+#include "../../include/optiweave/runtime/traversal_profiler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace optiweave::runtime {
+namespace {
+/**
+    @brief "64x32", with "?" for extents the type does not fix
+*/
+std::string formatExtents(const SiteTraversalProfile &profile) {
+  std::string result;
+  for (std::uint32_t d = 0; d < profile.rank; ++d) {
+    if (d > 0) {
+      result += "x";
+    }
+    result += profile.extents[d] ? std::to_string(profile.extents[d]) : "?";
+  }
+  return result;
+}
+} // namespace
+
+struct TraversalProfiler::SiteCounters {
+  std::atomic<std::uint64_t> accesses{0};
+  std::atomic<std::uint32_t> rank{0};
+  std::atomic<std::size_t> element_size{0};
+  std::atomic<std::size_t> extents[TraversalCursor::kMaxRank] = {};
+  std::atomic<std::uint64_t> innermost_changed[TraversalCursor::kMaxRank] = {};
+};
+
+std::uint32_t SiteTraversalProfile::fastestDimension() const noexcept {
+  std::uint32_t fastest = rank;
+  std::uint64_t most = 0;
+  for (std::uint32_t d = 0; d < rank; ++d) {
+    if (innermost_changed[d] > most) {
+      most = innermost_changed[d];
+      fastest = d;
+    }
+  }
+  return fastest;
+}
+
+std::size_t
+SiteTraversalProfile::dimensionStride(std::uint32_t dimension) const noexcept {
+  std::size_t stride = element_size;
+  for (std::uint32_t d = dimension + 1; d < rank; ++d) {
+    if (extents[d] == 0) {
+      return 0;
+    }
+    stride *= extents[d];
+  }
+  return stride;
+}
+
+TraversalProfiler::TraversalProfiler(std::size_t site_capacity)
+    : capacity_(site_capacity), sites_(new SiteCounters[site_capacity]) {}
+
+TraversalProfiler::~TraversalProfiler() = default;
+
+void TraversalProfiler::access(TraversalCursor *cursors, SiteId site,
+                               std::uint32_t rank, const std::size_t *indices,
+                               const std::size_t *extents,
+                               std::size_t element_size) noexcept {
+  if (site >= capacity_ || rank == 0) {
+    return;
+  }
+  rank = std::min(rank, TraversalCursor::kMaxRank);
+  SiteCounters &counters = sites_[site];
+  if (counters.accesses.fetch_add(1, std::memory_order_relaxed) == 0) {
+    // Shape is fixed by the site's type; the first access publishes it
+    for (std::uint32_t d = 0; d < rank; ++d) {
+      counters.extents[d].store(extents[d], std::memory_order_relaxed);
+    }
+    counters.element_size.store(element_size, std::memory_order_relaxed);
+    counters.rank.store(rank, std::memory_order_release);
+  }
+
+  TraversalCursor &cursor = cursors[site % kCursors];
+  if (cursor.site == site) {
+    for (std::uint32_t d = rank; d-- > 0;) {
+      if (indices[d] != cursor.last[d]) {
+        counters.innermost_changed[d].fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    }
+  }
+  cursor.site = site;
+  std::copy(indices, indices + rank, cursor.last);
+}
+
+bool TraversalProfiler::siteProfile(SiteId site,
+                                    SiteTraversalProfile &out) const noexcept {
+  if (site >= capacity_) {
+    return false;
+  }
+  const SiteCounters &counters = sites_[site];
+  out.accesses = counters.accesses.load(std::memory_order_relaxed);
+  out.rank = counters.rank.load(std::memory_order_acquire);
+  if (out.accesses == 0 || out.rank == 0) {
+    return false;
+  }
+  out.element_size = counters.element_size.load(std::memory_order_relaxed);
+  for (std::uint32_t d = 0; d < out.rank; ++d) {
+    out.extents[d] = counters.extents[d].load(std::memory_order_relaxed);
+    out.innermost_changed[d] =
+        counters.innermost_changed[d].load(std::memory_order_relaxed);
+  }
+  return true;
+}
+
+void writeTraversalReport(const TraversalProfiler &traversal,
+                          const SiteRegistry &sites, const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\ttype\textents\t"
+                    "accesses\tfastest_dimension\tstride_bytes\torder\t"
+                    "changed_per_dimension\n");
+
+  std::vector<std::pair<SiteId, SiteTraversalProfile>> strided;
+  std::size_t profiled = 0;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    const SiteRecord *site = sites.get(id);
+    SiteTraversalProfile profile;
+    if (!site || !traversal.siteProfile(id, profile)) {
+      continue;
+    }
+    ++profiled;
+    std::uint32_t fastest = profile.fastestDimension();
+    const char *order = fastest == profile.rank       ? "constant"
+                        : fastest + 1 == profile.rank ? "row_major"
+                        : fastest == 0                ? "column_major"
+                                                      : "strided";
+    std::string changed;
+    for (std::uint32_t d = 0; d < profile.rank; ++d) {
+      changed += (d ? "," : "") + std::to_string(profile.innermost_changed[d]);
+    }
+    std::fprintf(out, "%s\t%u\t%u\t%s\t%s\t%s\t%" PRIu64 "\t%u\t%zu\t%s\t%s\n",
+                 site->file, site->line, site->column, site->function,
+                 demangleType(site->type).c_str(),
+                 formatExtents(profile).c_str(), profile.accesses, fastest,
+                 fastest < profile.rank ? profile.dimensionStride(fastest) : 0,
+                 order, changed.c_str());
+    if (fastest + 1 < profile.rank) {
+      strided.emplace_back(id, profile);
+    }
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: traversal: %zu of %zu fused subscript sites walk "
+               "across rows, report in %s\n",
+               strided.size(), profiled, path.c_str());
+  std::sort(strided.begin(), strided.end(), [](const auto &a, const auto &b) {
+    return a.second.accesses > b.second.accesses;
+  });
+  for (std::size_t i = 0; i < std::min<std::size_t>(strided.size(), 5); ++i) {
+    const auto &[id, profile] = strided[i];
+    std::uint32_t fastest = profile.fastestDimension();
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " %s  %s[%s] along dimension %u "
+                 "(%zu-byte steps)\n",
+                 profile.accesses, describeSite(sites, id).c_str(),
+                 demangleType(sites.get(id)->type).c_str(),
+                 formatExtents(profile).c_str(), fastest,
+                 profile.dimensionStride(fastest));
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,173 @@
+#include "../../include/optiweave/runtime/trip_profiler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cinttypes>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace optiweave::runtime {
+
+struct TripProfiler::SiteCounters {
+  std::atomic<std::uint64_t> executions{0};
+  std::atomic<std::uint64_t> trips{0};
+  std::atomic<std::uint64_t> min_trips{
+      std::numeric_limits<std::uint64_t>::max()};
+  std::atomic<std::uint64_t> max_trips{0};
+  std::atomic<std::uint64_t> buckets[LoopTripProfile::kBuckets] = {};
+};
+
+std::size_t LoopTripProfile::bucketOf(std::uint64_t trips) noexcept {
+  std::size_t bucket = static_cast<std::size_t>(std::bit_width(trips));
+  return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+double LoopTripProfile::meanTrips() const noexcept {
+  return executions ? static_cast<double>(trips) / executions : 0.0;
+}
+
+std::uint64_t LoopTripProfile::percentileTrips(double share) const noexcept {
+  std::uint64_t seen = 0;
+  for (std::size_t b = 0; b < kBuckets; ++b) {
+    seen += buckets[b];
+    if (static_cast<double>(seen) >= share * executions) {
+      std::uint64_t upper = b == 0 ? 0 : (std::uint64_t{1} << b) - 1;
+      return b + 1 == kBuckets || upper > max_trips ? max_trips : upper;
+    }
+  }
+  return max_trips;
+}
+
+LoopAdvice classifyLoop(const LoopTripProfile &profile) noexcept {
+  std::uint64_t median = profile.percentileTrips(0.5);
+  if (median < 4) {
+    return LoopAdvice::TooShort;
+  }
+  if (median < 16 ||
+      (profile.min_trips == profile.max_trips && profile.max_trips <= 64)) {
+    return LoopAdvice::Unroll;
+  }
+  if (median < 4096) {
+    return LoopAdvice::Vectorize;
+  }
+  return LoopAdvice::Tile;
+}
+
+const char *loopAdviceName(LoopAdvice advice) noexcept {
+  switch (advice) {
+  case LoopAdvice::TooShort:
+    return "too_short";
+  case LoopAdvice::Unroll:
+    return "unroll";
+  case LoopAdvice::Vectorize:
+    return "vectorize";
+  case LoopAdvice::Tile:
+    break;
+  }
+  return "tile";
+}
+
+TripProfiler::TripProfiler(std::size_t site_capacity)
+    : capacity_(site_capacity), sites_(new SiteCounters[site_capacity]) {}
+
+TripProfiler::~TripProfiler() = default;
+
+void TripProfiler::record(SiteId site, std::uint64_t trips) noexcept {
+  if (site >= capacity_) {
+    return;
+  }
+  SiteCounters &counters = sites_[site];
+  counters.executions.fetch_add(1, std::memory_order_relaxed);
+  counters.trips.fetch_add(trips, std::memory_order_relaxed);
+  counters.buckets[LoopTripProfile::bucketOf(trips)].fetch_add(
+      1, std::memory_order_relaxed);
+
+  std::uint64_t low = counters.min_trips.load(std::memory_order_relaxed);
+  while (trips < low && !counters.min_trips.compare_exchange_weak(
+                            low, trips, std::memory_order_relaxed)) {
+  }
+  std::uint64_t high = counters.max_trips.load(std::memory_order_relaxed);
+  while (trips > high && !counters.max_trips.compare_exchange_weak(
+                             high, trips, std::memory_order_relaxed)) {
+  }
+}
+
+bool TripProfiler::siteProfile(SiteId site,
+                               LoopTripProfile &out) const noexcept {
+  if (site >= capacity_) {
+    return false;
+  }
+  const SiteCounters &counters = sites_[site];
+  out.executions = counters.executions.load(std::memory_order_relaxed);
+  if (out.executions == 0) {
+    return false;
+  }
+  out.trips = counters.trips.load(std::memory_order_relaxed);
+  out.min_trips = counters.min_trips.load(std::memory_order_relaxed);
+  out.max_trips = counters.max_trips.load(std::memory_order_relaxed);
+  for (std::size_t b = 0; b < LoopTripProfile::kBuckets; ++b) {
+    out.buckets[b] = counters.buckets[b].load(std::memory_order_relaxed);
+  }
+  return true;
+}
+
+void writeLoopReport(const TripProfiler &trips, const SiteRegistry &sites,
+                     const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\texecutions\ttrips\t"
+                    "mean\tmin\tmedian\tp90\tmax\tadvice\thistogram\n");
+
+  std::vector<std::pair<SiteId, LoopTripProfile>> loops;
+  for (SiteId id = 0; id < sites.size(); ++id) {
+    const SiteRecord *site = sites.get(id);
+    LoopTripProfile profile;
+    if (!site || !trips.siteProfile(id, profile)) {
+      continue;
+    }
+    // "<upper bound>:<executions>" for every non-empty bucket
+    std::string histogram;
+    for (std::size_t b = 0; b < LoopTripProfile::kBuckets; ++b) {
+      if (profile.buckets[b]) {
+        histogram += (histogram.empty() ? "" : ",") +
+                     std::to_string(b ? (std::uint64_t{1} << b) - 1 : 0) +
+                     ":" + std::to_string(profile.buckets[b]);
+      }
+    }
+    std::fprintf(out,
+                 "%s\t%u\t%u\t%s\t%" PRIu64 "\t%" PRIu64 "\t%.1f\t%" PRIu64
+                 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\t%s\n",
+                 site->file, site->line, site->column, site->function,
+                 profile.executions, profile.trips, profile.meanTrips(),
+                 profile.min_trips, profile.percentileTrips(0.5),
+                 profile.percentileTrips(0.9), profile.max_trips,
+                 loopAdviceName(classifyLoop(profile)), histogram.c_str());
+    loops.emplace_back(id, profile);
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr, "OptiWeave: loops: %zu loops profiled, report in %s\n",
+               loops.size(), path.c_str());
+  std::sort(loops.begin(), loops.end(), [](const auto &a, const auto &b) {
+    return a.second.trips > b.second.trips;
+  });
+  for (std::size_t i = 0; i < std::min<std::size_t>(loops.size(), 5); ++i) {
+    const auto &[id, profile] = loops[i];
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " %s  %" PRIu64
+                 " executions, median %" PRIu64 " trips: %s\n",
+                 profile.trips, describeSite(sites, id).c_str(),
+                 profile.executions, profile.percentileTrips(0.5),
+                 loopAdviceName(classifyLoop(profile)));
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,265 @@
+#include "../../include/optiweave/runtime/value_profiler.hpp"
+#include "../../include/optiweave/runtime/report.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace optiweave::runtime {
+namespace {
+constexpr std::size_t kSummaryValues = 2 * ValueSketch::kCounters;
+
+template <typename T> T load(const std::atomic<T> &field) noexcept {
+  return field.load(std::memory_order_relaxed);
+}
+
+template <typename T> void store(std::atomic<T> &field, T value) noexcept {
+  field.store(value, std::memory_order_relaxed);
+}
+
+/**
+    @brief Print a profiled value according to the operand's type
+*/
+std::string formatValue(std::int64_t value, const char *mangled_type) {
+  // Itanium codes of the unsigned integer types
+  bool is_unsigned = mangled_type && mangled_type[0] &&
+                     !mangled_type[1] && std::strchr("htjmyo", mangled_type[0]);
+  return is_unsigned ? std::to_string(static_cast<std::uint64_t>(value))
+                     : std::to_string(value);
+}
+} // namespace
+
+double SiteValueProfile::topShare() const noexcept {
+  if (!total || top.empty()) {
+    return 0.0;
+  }
+  return static_cast<double>(top.front().count - top.front().error) / total;
+}
+
+void ValueSketch::add(std::int64_t value) noexcept {
+  store(total, load(total) + 1);
+
+  // Counters fill from the front, so the first empty one ends the search
+  std::size_t smallest = 0;
+  for (std::size_t i = 0; i < kCounters; ++i) {
+    std::uint64_t count = load(counts[i]);
+    if (count == 0) {
+      store(values[i], value);
+      store(errors[i], std::uint64_t{0});
+      store(counts[i], std::uint64_t{1});
+      return;
+    }
+    if (load(values[i]) == value) {
+      store(counts[i], count + 1);
+      return;
+    }
+    if (count < load(counts[smallest])) {
+      smallest = i;
+    }
+  }
+
+  std::uint64_t floor = load(counts[smallest]);
+  store(values[smallest], value);
+  store(errors[smallest], floor);
+  store(counts[smallest], floor + 1);
+}
+
+void ValueSketch::reset(SiteId owner) noexcept {
+  store(total, std::uint64_t{0});
+  for (std::size_t i = 0; i < kCounters; ++i) {
+    store(counts[i], std::uint64_t{0});
+  }
+  site.store(owner, std::memory_order_release);
+}
+
+void ValueProfiler::record(ValueSketch *sketches, SiteId site,
+                           std::int64_t value) noexcept {
+  ValueSketch &sketch = sketches[site % kSketches];
+  SiteId owner = sketch.site.load(std::memory_order_relaxed);
+  if (owner != site) {
+    if (owner != kInvalidSite) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      merge(sketch);
+    }
+    sketch.reset(site);
+  }
+  sketch.add(value);
+}
+
+void ValueProfiler::collect(const ValueSketch *sketches) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::size_t i = 0; i < kSketches; ++i) {
+    if (sketches[i].site.load(std::memory_order_acquire) != kInvalidSite) {
+      merge(sketches[i]);
+    }
+  }
+}
+
+void ValueProfiler::merge(const ValueSketch &sketch) {
+  std::uint64_t total = load(sketch.total);
+  if (total == 0) {
+    return;
+  }
+  SiteValueProfile &summary =
+      summaries_[sketch.site.load(std::memory_order_relaxed)];
+  summary.total += total;
+
+  for (std::size_t i = 0; i < ValueSketch::kCounters; ++i) {
+    std::uint64_t count = load(sketch.counts[i]);
+    if (count == 0) {
+      break;
+    }
+    std::int64_t value = load(sketch.values[i]);
+    auto found = std::find_if(
+        summary.top.begin(), summary.top.end(),
+        [value](const ValueCount &entry) { return entry.value == value; });
+    if (found == summary.top.end()) {
+      summary.top.push_back({value, 0, 0});
+      found = summary.top.end() - 1;
+    }
+    found->count += count;
+    found->error += std::min(load(sketch.errors[i]), count);
+  }
+
+  std::sort(summary.top.begin(), summary.top.end(),
+            [](const ValueCount &a, const ValueCount &b) {
+              return a.count > b.count;
+            });
+  if (summary.top.size() > kSummaryValues) {
+    summary.top.resize(kSummaryValues);
+  }
+}
+
+std::vector<SiteId> ValueProfiler::sites() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<SiteId> ids;
+  ids.reserve(summaries_.size());
+  for (const auto &[id, summary] : summaries_) {
+    ids.push_back(id);
+  }
+  std::sort(ids.begin(), ids.end());
+  return ids;
+}
+
+bool ValueProfiler::siteProfile(SiteId site, SiteValueProfile &out) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = summaries_.find(site);
+  if (found == summaries_.end()) {
+    return false;
+  }
+  out = found->second;
+  return true;
+}
+
+DivisorPattern classifyDivisors(const SiteValueProfile &profile,
+                                double min_share) noexcept {
+  if (profile.total == 0) {
+    return DivisorPattern::Varied;
+  }
+  if (profile.topShare() >= min_share) {
+    return DivisorPattern::Constant;
+  }
+  auto powerOfTwo = [](std::int64_t value) {
+    std::uint64_t magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value)
+                                        : static_cast<std::uint64_t>(value);
+    return magnitude != 0 && (magnitude & (magnitude - 1)) == 0;
+  };
+  if (profile.shareWhere(powerOfTwo) >= min_share) {
+    return DivisorPattern::PowerOfTwo;
+  }
+  // The few values a switch would be worth writing out for
+  std::uint64_t covered = 0;
+  for (std::size_t i = 0; i < std::min<std::size_t>(profile.top.size(), 4);
+       ++i) {
+    covered += profile.top[i].count - profile.top[i].error;
+  }
+  if (static_cast<double>(covered) >= min_share * profile.total) {
+    return DivisorPattern::FewValues;
+  }
+  return DivisorPattern::Varied;
+}
+
+const char *divisorPatternName(DivisorPattern pattern) noexcept {
+  switch (pattern) {
+  case DivisorPattern::Constant:
+    return "constant";
+  case DivisorPattern::PowerOfTwo:
+    return "power_of_two";
+  case DivisorPattern::FewValues:
+    return "few_values";
+  case DivisorPattern::Varied:
+    break;
+  }
+  return "varied";
+}
+
+void writeDivisorReport(const ValueProfiler &values, const SiteRegistry &sites,
+                        const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out) {
+    std::fprintf(stderr, "OptiWeave: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::fprintf(out, "file\tline\tcolumn\tfunction\toperation\ttype\t"
+                    "evaluations\tpattern\ttop_share\tvalues\n");
+
+  struct Flagged {
+    SiteId id;
+    SiteValueProfile profile;
+    DivisorPattern pattern;
+  };
+  std::vector<Flagged> flagged;
+  std::size_t profiled = 0;
+  for (SiteId id : values.sites()) {
+    const SiteRecord *site = sites.get(id);
+    SiteValueProfile profile;
+    if (!site || !values.siteProfile(id, profile)) {
+      continue;
+    }
+    ++profiled;
+    DivisorPattern pattern = classifyDivisors(profile);
+
+    std::string listed;
+    for (std::size_t i = 0; i < std::min<std::size_t>(profile.top.size(), 4);
+         ++i) {
+      char share[32];
+      std::snprintf(share, sizeof(share), ":%.1f%%",
+                    100.0 * profile.top[i].count / profile.total);
+      listed += (i ? "," : "") + formatValue(profile.top[i].value, site->type) +
+                share;
+    }
+    std::fprintf(out, "%s\t%u\t%u\t%s\t%s\t%s\t%" PRIu64 "\t%s\t%.4f\t%s\n",
+                 site->file, site->line, site->column, site->function,
+                 site->operation, demangleType(site->type).c_str(),
+                 profile.total, divisorPatternName(pattern),
+                 profile.topShare(), listed.c_str());
+    if (pattern != DivisorPattern::Varied) {
+      flagged.push_back({id, std::move(profile), pattern});
+    }
+  }
+  std::fclose(out);
+
+  std::fprintf(stderr,
+               "OptiWeave: divisors: %zu of %zu sites can be specialized, "
+               "report in %s\n",
+               flagged.size(), profiled, path.c_str());
+  std::sort(flagged.begin(), flagged.end(),
+            [](const Flagged &a, const Flagged &b) {
+              return a.profile.total > b.profile.total;
+            });
+  for (std::size_t i = 0; i < std::min<std::size_t>(flagged.size(), 5); ++i) {
+    const Flagged &entry = flagged[i];
+    const SiteRecord *site = sites.get(entry.id);
+    std::fprintf(stderr,
+                 "OptiWeave:   %12" PRIu64 " %s  %s, mostly %s (%.1f%%)\n",
+                 entry.profile.total, describeSite(sites, entry.id).c_str(),
+                 divisorPatternName(entry.pattern),
+                 formatValue(entry.profile.top.front().value, site->type)
+                     .c_str(),
+                 100.0 * entry.profile.topShare());
+  }
+}
+
+} // namespace optiweave::runtime
@@ -0,0 +1,206 @@
+// optiweave-top: live viewer for the runtime's shared-memory telemetry.
+//
+// Attaches read-only to /dev/shm/optiweave.<pid> and periodically prints the
+// hottest instrumented sites and per-thread event rates. The instrumented
+// process is never signalled, paused or made to wait.
+
+#include "../../include/optiweave/runtime/telemetry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace optiweave::runtime;
+
+namespace {
+
+struct Options {
+  std::string target;
+  unsigned interval_ms = 1000;
+  std::size_t top = 20;
+  bool once = false;
+  bool list = false;
+  bool sort_by_total = false;
+};
+
+void printHelp() {
+  std::printf(R"(Usage: optiweave-top [options] <pid | /segment-name>
+
+Options:
+  --interval=MS   Refresh interval in milliseconds (default: 1000)
+  --top=N         Number of sites to show (default: 20)
+  --sort=rate     Sort sites by events/sec over the last interval (default)
+  --sort=total    Sort sites by total events since start
+  --once          Print one refresh and exit
+  --list          List telemetry segments present in /dev/shm
+  -h, --help      Show this help
+
+The instrumented program must run with OPTIWEAVE_TELEMETRY=1.
+)");
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-h" || arg == "--help") {
+      printHelp();
+      std::exit(0);
+    } else if (arg.rfind("--interval=", 0) == 0) {
+      options.interval_ms =
+          static_cast<unsigned>(std::strtoul(arg.c_str() + 11, nullptr, 10));
+    } else if (arg.rfind("--top=", 0) == 0) {
+      options.top = std::strtoul(arg.c_str() + 6, nullptr, 10);
+    } else if (arg == "--sort=rate") {
+      options.sort_by_total = false;
+    } else if (arg == "--sort=total") {
+      options.sort_by_total = true;
+    } else if (arg == "--once") {
+      options.once = true;
+    } else if (arg == "--list") {
+      options.list = true;
+    } else if (!arg.empty() && arg[0] != '-' && options.target.empty()) {
+      options.target = arg;
+    } else {
+      std::fprintf(stderr, "optiweave-top: unknown argument '%s'\n",
+                   arg.c_str());
+      return false;
+    }
+  }
+  if (options.interval_ms == 0) {
+    options.interval_ms = 1000;
+  }
+  return options.list || !options.target.empty();
+}
+
+std::string segmentNameFor(const std::string &target) {
+  if (target[0] == '/') {
+    return target;
+  }
+  return telemetrySegmentName(std::atoi(target.c_str()));
+}
+
+std::string basename(const std::string &path) {
+  auto slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+void render(const Options &options, const TelemetrySnapshot &previous,
+            const TelemetrySnapshot &current) {
+  double seconds =
+      static_cast<double>(current.taken_at_ns - previous.taken_at_ns) / 1e9;
+  if (seconds <= 0.0) {
+    seconds = 1.0;
+  }
+
+  std::unordered_map<SiteId, std::uint64_t> previous_counts;
+  for (const auto &site : previous.sites) {
+    previous_counts[site.id] = site.count;
+  }
+
+  struct Row {
+    const SiteSnapshot *site;
+    double rate;
+  };
+  std::vector<Row> rows;
+  std::uint64_t total_events = 0;
+  double total_rate = 0.0;
+  for (const auto &site : current.sites) {
+    auto it = previous_counts.find(site.id);
+    std::uint64_t before = it == previous_counts.end() ? 0 : it->second;
+    double rate = static_cast<double>(site.count - before) / seconds;
+    rows.push_back({&site, rate});
+    total_events += site.count;
+    total_rate += rate;
+  }
+
+  std::sort(rows.begin(), rows.end(), [&](const Row &a, const Row &b) {
+    if (options.sort_by_total) {
+      return a.site->count > b.site->count;
+    }
+    return a.rate != b.rate ? a.rate > b.rate : a.site->count > b.site->count;
+  });
+
+  if (!options.once) {
+    std::printf("\033[H\033[2J");
+  }
+  std::printf("optiweave-top - pid %d (%s)  sites: %zu  events: %llu  "
+              "rate: %.0f/s  dropped: %llu\n\n",
+              current.pid, current.program.c_str(), current.sites.size(),
+              static_cast<unsigned long long>(total_events), total_rate,
+              static_cast<unsigned long long>(current.dropped_events));
+
+  std::printf("%14s %14s  %-20s %s\n", "EVENTS/S", "TOTAL", "OPERATION",
+              "LOCATION");
+  for (std::size_t i = 0; i < rows.size() && i < options.top; ++i) {
+    const SiteSnapshot &site = *rows[i].site;
+    std::printf("%14.0f %14llu  %-20s %s:%u:%u %s\n", rows[i].rate,
+                static_cast<unsigned long long>(site.count),
+                site.operation.c_str(), basename(site.file).c_str(),
+                site.line, site.column, site.function.c_str());
+  }
+
+  std::unordered_map<std::uint32_t, std::uint64_t> previous_events;
+  for (const auto &thread : previous.threads) {
+    previous_events[thread.index] = thread.events;
+  }
+
+  std::printf("\n%6s %10s %14s %14s\n", "SLOT", "TID", "EVENTS/S", "EVENTS");
+  for (const auto &thread : current.threads) {
+    if (!thread.active) {
+      continue;
+    }
+    auto it = previous_events.find(thread.index);
+    std::uint64_t before = it == previous_events.end() ? 0 : it->second;
+    // A reused slot restarts its counter; treat that interval as fresh
+    std::uint64_t delta = thread.events >= before ? thread.events - before
+                                                  : thread.events;
+    std::printf("%6u %10llu %14.0f %14llu\n", thread.index,
+                static_cast<unsigned long long>(thread.os_tid),
+                static_cast<double>(delta) / seconds,
+                static_cast<unsigned long long>(thread.events));
+  }
+  std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printHelp();
+    return 1;
+  }
+
+  if (options.list) {
+    for (const auto &name : listTelemetrySegments()) {
+      std::printf("%s\n", name.c_str());
+    }
+    return 0;
+  }
+
+  TelemetryReader reader;
+  std::string error;
+  if (!reader.attach(segmentNameFor(options.target), error)) {
+    std::fprintf(stderr, "optiweave-top: %s\n", error.c_str());
+    return 1;
+  }
+
+  TelemetrySnapshot previous = reader.snapshot();
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.interval_ms));
+    TelemetrySnapshot current = reader.snapshot();
+    render(options, previous, current);
+    if (options.once) {
+      break;
+    }
+    previous = std::move(current);
+  }
+
+  return 0;
+}
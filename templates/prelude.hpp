@@ -4,28 +4,131 @@
 // This file is automatically included before transformed source code
 
 #include <chrono>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
+#include <source_location>
+#include <span>
 #include <string>
 #include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
 // Forward declarations for instrumentation functions
+// (implemented by the optiweave_runtime library, see
+// include/optiweave/runtime/abi.hpp)
+#define __OPTIWEAVE_SITE_WRITE 0x1u
+#define __OPTIWEAVE_SITE_LAST_USE 0x2u
+#define __OPTIWEAVE_SITE_LOOP_SHIFT 8u
+#define __OPTIWEAVE_SITE_LOOP_MASK 0xff00u
+#define __OPTIWEAVE_DENORMAL_LHS 0x1u
+#define __OPTIWEAVE_DENORMAL_RHS 0x2u
+#define __OPTIWEAVE_DENORMAL_RESULT 0x4u
+#define __OPTIWEAVE_NO_SITE 0xffffffffu
+#define __OPTIWEAVE_SITE_BLOCK_SHIFT 8u
+#define __OPTIWEAVE_SITE_BLOCKS 64u
+#define __OPTIWEAVE_RECEIVER_ENTRIES 4u
+
 extern "C" {
+struct __optiweave_site_info {
+  const char *file;
+  const char *function;
+  std::uint32_t line;
+  std::uint32_t column;
+  std::uint32_t flags;
+  const char *type;
+};
+
 void __optiweave_log_access(const char *operation, const void *ptr,
-                            std::size_t index, const char *file, int line);
-void __optiweave_log_operation(const char *operation, const char *lhs_type,
-                               const char *rhs_type, const char *file,
-                               int line);
+                            std::size_t index, std::size_t element_size,
+                            const __optiweave_site_info *site);
+void __optiweave_log_access_nd(const char *operation, const void *element,
+                               std::size_t element_size, std::uint32_t rank,
+                               const std::size_t *indices,
+                               const std::size_t *extents,
+                               const __optiweave_site_info *site);
+void __optiweave_log_operation(const char *operation,
+                               const __optiweave_site_info *site);
+void __optiweave_check_bounds(const void *ptr, std::size_t index,
+                              std::size_t element_size,
+                              const __optiweave_site_info *site);
+void __optiweave_profile_value(const char *operation, std::int64_t value,
+                              const __optiweave_site_info *site);
+void __optiweave_report_denormal(const char *operation, std::uint32_t operands,
+                                 const __optiweave_site_info *site);
+std::uint32_t __optiweave_branch_site(const char *operation,
+                                     const __optiweave_site_info *site);
+std::atomic<std::uint64_t> (*__optiweave_branch_counters(std::uint32_t id))[2];
+struct __optiweave_receiver_cache {
+  std::atomic<const void *> types[__OPTIWEAVE_RECEIVER_ENTRIES];
+  std::atomic<std::uint64_t> counts[__OPTIWEAVE_RECEIVER_ENTRIES];
+  std::atomic<std::uint64_t> overflow;
+};
+void __optiweave_record_trips(std::uint64_t trips,
+                              const __optiweave_site_info *site);
+void __optiweave_enter_function(const __optiweave_site_info *function);
+void __optiweave_exit_function(void);
+void __optiweave_record_allocation(const char *operation, std::size_t bytes,
+                                   const __optiweave_site_info *site);
+void __optiweave_record_deallocation(const char *operation,
+                                     const __optiweave_site_info *site);
+void __optiweave_record_growth(std::uint64_t peak_size,
+                               std::uint64_t reallocations,
+                               const __optiweave_site_info *site);
+void __optiweave_record_copy(const char *operation, std::size_t bytes,
+                             const __optiweave_site_info *site);
+std::uint32_t __optiweave_dispatch_site(const __optiweave_site_info *site);
+__optiweave_receiver_cache *__optiweave_receiver_caches(std::uint32_t id);
+struct __optiweave_hash_counts {
+  std::atomic<std::uint64_t> lookups;
+  std::atomic<std::uint64_t> rehashes;
+  std::atomic<std::uint64_t> size_sum;
+  std::atomic<std::uint64_t> max_size;
+  std::atomic<std::uint64_t> bucket_sum;
+  std::atomic<std::uint64_t> sampled_lookups;
+  std::atomic<std::uint64_t> sampled_chain;
+};
+std::uint32_t __optiweave_hash_site(const __optiweave_site_info *site);
+__optiweave_hash_counts *__optiweave_hash_counters(std::uint32_t id);
 }
 
 namespace optiweave {
 
+/**
+ * @brief Describe the instrumented expression at the call site
+ * @param column Column of the expression in the original source, emitted by
+ *        the tool because rewriting shifts columns in the transformed file
+ * @param flags __OPTIWEAVE_SITE_* bits the tool derived from the context
+ */
+constexpr __optiweave_site_info
+site_here(std::uint32_t column = 0, std::uint32_t flags = 0,
+          std::source_location loc = std::source_location::current()) {
+  return {loc.file_name(), loc.function_name(), loc.line(), column, flags,
+          nullptr};
+}
+
 /**
  * @brief Configuration for runtime instrumentation
  */
 struct InstrumentationConfig {
   bool log_array_accesses = true;
   bool log_arithmetic_ops = false;
+  bool check_heap_bounds = false; // OPTIWEAVE_BOUNDS, needs optiweave_heap
+  bool profile_divisors = false;  // OPTIWEAVE_DIVISORS
+  bool check_denormals = false;   // OPTIWEAVE_DENORMALS
+  bool profile_branches = false;  // OPTIWEAVE_BRANCHES
+  bool profile_loops = false;     // OPTIWEAVE_LOOPS
+  bool profile_functions = false; // OPTIWEAVE_PROFILE
+  bool track_allocations = false; // OPTIWEAVE_ALLOCATIONS
+  bool profile_growth = false;    // OPTIWEAVE_GROWTH
+  bool track_copies = false;      // OPTIWEAVE_COPIES
+  bool profile_dispatch = false;  // OPTIWEAVE_DISPATCH
+  bool profile_hashing = false;   // OPTIWEAVE_HASH
   bool log_to_stderr = true;
   bool log_to_file = false;
   std::string log_file_path = "optiweave.log";
@@ -38,6 +141,19 @@ struct InstrumentationConfig {
  */
 extern InstrumentationConfig g_config;
 
+/**
+ * @brief Test an instrumentation flag of g_config
+ *
+ * With OPTIWEAVE_NULL_POLICY defined every flag is the constant false, so
+ * the wrappers fold to the bare operation and the runtime is not needed.
+ * The codegen-equivalence test relies on this.
+ */
+#ifdef OPTIWEAVE_NULL_POLICY
+#define __OPTIWEAVE_ENABLED(flag) false
+#else
+#define __OPTIWEAVE_ENABLED(flag) (optiweave::g_config.flag)
+#endif
+
 /**
  * @brief SFINAE helper to detect if a type has operator[] overloaded
  */
@@ -104,18 +220,20 @@ struct __primop_subscript<Element[Size]> {
   using element_type = Element;
   using size_type = std::size_t;
 
-  constexpr element_type &operator()(Element (&arr)[Size],
-                                     size_type index) const {
-    if (g_config.log_array_accesses) {
-      __optiweave_log_access("array_subscript", arr, index, __FILE__, __LINE__);
+  constexpr element_type &operator()(Element (&arr)[Size], size_type index,
+                                     __optiweave_site_info where) const {
+    if (__OPTIWEAVE_ENABLED(log_array_accesses)) {
+      where.type = typeid(Element).name();
+      __optiweave_log_access("array_subscript", arr, index, sizeof(Element),
+                             &where);
     }
 
 // Bounds checking in debug mode
 #ifdef OPTIWEAVE_DEBUG
     if (index >= Size) {
       std::cerr << "OptiWeave: Array bounds violation! Index " << index
-                << " >= Size " << Size << " at " << __FILE__ << ":" << __LINE__
-                << std::endl;
+                << " >= Size " << Size << " at " << where.file << ":"
+                << where.line << std::endl;
     }
 #endif
 
@@ -130,16 +248,21 @@ template <typename Element> struct __primop_subscript<Element *> {
   using element_type = Element;
   using size_type = std::size_t;
 
-  constexpr element_type &operator()(Element *ptr, size_type index) const {
-    if (g_config.log_array_accesses) {
-      __optiweave_log_access("pointer_subscript", ptr, index, __FILE__,
-                             __LINE__);
+  constexpr element_type &operator()(Element *ptr, size_type index,
+                                     __optiweave_site_info where) const {
+    if (__OPTIWEAVE_ENABLED(check_heap_bounds)) {
+      __optiweave_check_bounds(ptr, index, sizeof(Element), &where);
+    }
+    if (__OPTIWEAVE_ENABLED(log_array_accesses)) {
+      where.type = typeid(Element).name();
+      __optiweave_log_access("pointer_subscript", ptr, index, sizeof(Element),
+                             &where);
     }
 
 #ifdef OPTIWEAVE_DEBUG
     if (ptr == nullptr) {
-      std::cerr << "OptiWeave: Null pointer dereference at " << __FILE__ << ":"
-                << __LINE__ << std::endl;
+      std::cerr << "OptiWeave: Null pointer dereference at " << where.file
+                << ":" << where.line << std::endl;
     }
 #endif
 
@@ -147,6 +270,223 @@ template <typename Element> struct __primop_subscript<Element *> {
   }
 };
 
+/**
+ * @brief Record a subscript of a contiguous container as data() + index,
+ * the same way a pointer subscript is recorded
+ */
+template <typename Element>
+void log_contiguous_access(const Element *data,
+                           [[maybe_unused]] std::size_t size,
+                           std::size_t index, __optiweave_site_info &where) {
+  if (__OPTIWEAVE_ENABLED(check_heap_bounds)) {
+    __optiweave_check_bounds(data, index, sizeof(Element), &where);
+  }
+  if (__OPTIWEAVE_ENABLED(log_array_accesses)) {
+    where.type = typeid(Element).name();
+    __optiweave_log_access("container_subscript", data, index,
+                           sizeof(Element), &where);
+  }
+
+#ifdef OPTIWEAVE_DEBUG
+  if (index >= size) {
+    std::cerr << "OptiWeave: Container bounds violation! Index " << index
+              << " >= size " << size << " at " << where.file << ":"
+              << where.line << std::endl;
+  }
+#endif
+}
+
+/**
+ * @brief Specialization for std::vector (not std::vector<bool>, which has
+ * no data())
+ */
+template <typename Element, typename Allocator>
+struct __primop_subscript<std::vector<Element, Allocator>> {
+  using container_type = std::vector<Element, Allocator>;
+  using size_type = typename container_type::size_type;
+
+  constexpr Element &operator()(container_type &container, size_type index,
+                                __optiweave_site_info where) const {
+    log_contiguous_access(container.data(), container.size(), index, where);
+    return container[index];
+  }
+
+  constexpr const Element &operator()(const container_type &container,
+                                      size_type index,
+                                      __optiweave_site_info where) const {
+    log_contiguous_access(container.data(), container.size(), index, where);
+    return container[index];
+  }
+};
+
+/**
+ * @brief Specialization for std::array
+ */
+template <typename Element, std::size_t Size>
+struct __primop_subscript<std::array<Element, Size>> {
+  using container_type = std::array<Element, Size>;
+  using size_type = std::size_t;
+
+  constexpr Element &operator()(container_type &container, size_type index,
+                                __optiweave_site_info where) const {
+    log_contiguous_access(container.data(), Size, index, where);
+    return container[index];
+  }
+
+  constexpr const Element &operator()(const container_type &container,
+                                      size_type index,
+                                      __optiweave_site_info where) const {
+    log_contiguous_access(container.data(), Size, index, where);
+    return container[index];
+  }
+};
+
+/**
+ * @brief Specialization for std::span; spans are views, so one overload
+ * serves const and non-const spans alike
+ */
+template <typename Element, std::size_t Extent>
+struct __primop_subscript<std::span<Element, Extent>> {
+  using size_type = std::size_t;
+
+  constexpr Element &operator()(const std::span<Element, Extent> &view,
+                                size_type index,
+                                __optiweave_site_info where) const {
+    log_contiguous_access(view.data(), view.size(), index, where);
+    return view[index];
+  }
+};
+
+/**
+ * @brief Containers whose subscripts have a __primop_subscript
+ * specialization
+ */
+template <typename T> struct is_contiguous_container : std::false_type {};
+template <typename Element, typename Allocator>
+struct is_contiguous_container<std::vector<Element, Allocator>>
+    : std::bool_constant<!std::is_same_v<Element, bool>> {};
+template <typename Element, std::size_t Size>
+struct is_contiguous_container<std::array<Element, Size>> : std::true_type {};
+template <typename Element, std::size_t Extent>
+struct is_contiguous_container<std::span<Element, Extent>> : std::true_type {};
+
+/**
+ * @brief The tool's rewrite of a standard container's c[i]
+ *
+ * The container type is deduced rather than spelled at the rewrite site,
+ * so element types in anonymous namespaces or local classes work, and the
+ * container's value category is kept: a temporary vector still yields a
+ * non-const element, as its operator[] does.
+ */
+template <typename Container>
+constexpr decltype(auto)
+__primop_container_subscript(Container &&container, std::size_t index,
+                             __optiweave_site_info where) {
+  log_contiguous_access(container.data(), container.size(), index, where);
+  return std::forward<Container>(container)[index];
+}
+
+/**
+ * @brief Apply a chain of subscripts, root[i][j]...
+ */
+template <typename Subscripted>
+constexpr auto &subscript_chain(Subscripted &&element) {
+  return element;
+}
+
+template <typename Subscripted, typename Index, typename... Rest>
+constexpr auto &subscript_chain(Subscripted &&subscripted, Index index,
+                                Rest... rest) {
+  return subscript_chain(subscripted[index], rest...);
+}
+
+/**
+ * @brief Extent of each dimension peeled off Chain by successive
+ * subscripts; 0 where it is not part of the type (pointer levels)
+ */
+template <typename Chain>
+constexpr void fill_extents(std::size_t *extents, std::size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if constexpr (std::is_array_v<Chain>) {
+    *extents = std::extent_v<Chain>;
+    fill_extents<std::remove_extent_t<Chain>>(extents + 1, count - 1);
+  } else if constexpr (std::is_pointer_v<Chain>) {
+    *extents = 0;
+    fill_extents<std::remove_pointer_t<Chain>>(extents + 1, count - 1);
+  }
+}
+
+/**
+ * @brief Record one event for a fused subscript chain
+ */
+template <typename Root, typename Element, typename... Indices>
+void log_subscript_chain(const Element &element, __optiweave_site_info &where,
+                         Indices... indices) {
+  constexpr std::size_t rank = sizeof...(Indices);
+  const std::size_t index_values[rank] = {
+      static_cast<std::size_t>(indices)...};
+  std::size_t extents[rank] = {};
+  fill_extents<Root>(extents, rank);
+
+#ifdef OPTIWEAVE_DEBUG
+  for (std::size_t d = 0; d < rank; ++d) {
+    if (extents[d] != 0 && index_values[d] >= extents[d]) {
+      std::cerr << "OptiWeave: Array bounds violation! Index " << index_values[d]
+                << " >= Size " << extents[d] << " in dimension " << d
+                << " at " << where.file << ":" << where.line << std::endl;
+    }
+  }
+#endif
+
+  if (__OPTIWEAVE_ENABLED(log_array_accesses)) {
+    where.type = typeid(Element).name();
+    __optiweave_log_access_nd("array_subscript_nd", &element, sizeof(Element),
+                              static_cast<std::uint32_t>(rank), index_values,
+                              extents, &where);
+  }
+}
+
+/**
+ * @brief Fused instrumentation for a chain of subscripts a[i][j]...
+ *
+ * Root is a multi-dimensional array type. The element is recorded once,
+ * with every index and the extent of every dimension, instead of one event
+ * per intermediate row. The site precedes the indices because they are a
+ * pack.
+ */
+template <typename Root> struct __primop_subscript_nd {
+  template <typename... Indices>
+  constexpr auto &operator()(Root &root, __optiweave_site_info where,
+                             Indices... indices) const {
+    auto &element = subscript_chain(root, indices...);
+    log_subscript_chain<Root>(element, where, indices...);
+    return element;
+  }
+};
+
+/**
+ * @brief Specialization for chains rooted at a pointer: pointers to arrays,
+ * and pointer-to-pointer chains when the tool fuses them
+ *
+ * The outermost extent is unknown (recorded as 0) and only the first
+ * subscript is bounds-checked against the heap.
+ */
+template <typename Pointee> struct __primop_subscript_nd<Pointee *> {
+  template <typename Index, typename... Rest>
+  constexpr auto &operator()(Pointee *root, __optiweave_site_info where,
+                             Index index, Rest... rest) const {
+    if (__OPTIWEAVE_ENABLED(check_heap_bounds)) {
+      __optiweave_check_bounds(root, static_cast<std::size_t>(index),
+                               sizeof(Pointee), &where);
+    }
+    auto &element = subscript_chain(root, index, rest...);
+    log_subscript_chain<Pointee *>(element, where, index, rest...);
+    return element;
+  }
+};
+
 /**
  * @brief Template for handling potentially overloaded subscript operators
  */
@@ -154,14 +494,22 @@ template <typename Subscripted, bool HasOverload>
 struct __maybe_primop_subscript {
   // Default case: use the overloaded operator
   template <typename IndexType>
-  constexpr auto operator()(Subscripted &&obj, IndexType &&index) const
+  constexpr auto operator()(Subscripted &&obj, IndexType &&index,
+                            __optiweave_site_info where) const
       -> decltype(std::forward<Subscripted>(
           obj)[std::forward<IndexType>(index)]) {
+    using Container = std::remove_cvref_t<Subscripted>;
+    if constexpr (is_contiguous_container<Container>::value) {
+      // Dependent code that instantiated to a standard container
+      return __primop_subscript<Container>()(
+          obj, static_cast<std::size_t>(index), where);
+    }
 
-    if (g_config.log_array_accesses) {
-      __optiweave_log_access("overloaded_subscript", &obj,
-                             static_cast<std::size_t>(index), __FILE__,
-                             __LINE__);
+    if (__OPTIWEAVE_ENABLED(log_array_accesses)) {
+      where.type = typeid(decltype(obj[index])).name();
+      __optiweave_log_access(
+          "overloaded_subscript", &obj, static_cast<std::size_t>(index),
+          sizeof(std::remove_reference_t<decltype(obj[index])>), &where);
     }
 
     return std::forward<Subscripted>(obj)[std::forward<IndexType>(index)];
@@ -173,86 +521,339 @@ struct __maybe_primop_subscript {
  */
 template <typename Subscripted>
 struct __maybe_primop_subscript<Subscripted, false>
-    : __primop_subscript<Subscripted> {};
+    : __primop_subscript<std::remove_cvref_t<Subscripted>> {};
+
+template <typename T> bool is_subnormal(const T &value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return std::fpclassify(value) == FP_SUBNORMAL;
+  } else {
+    return false;
+  }
+}
+
+/**
+ * @brief Report subnormal floating-point operands or results of an
+ * arithmetic site; the report call is off the common path
+ */
+template <typename LHS, typename RHS, typename Result>
+void check_denormals(const char *operation, const LHS &lhs, const RHS &rhs,
+                     const Result &result, __optiweave_site_info &where) {
+  if constexpr (std::is_floating_point_v<LHS> ||
+                std::is_floating_point_v<RHS> ||
+                std::is_floating_point_v<Result>) {
+    std::uint32_t operands =
+        (is_subnormal(lhs) ? __OPTIWEAVE_DENORMAL_LHS : 0u) |
+        (is_subnormal(rhs) ? __OPTIWEAVE_DENORMAL_RHS : 0u) |
+        (is_subnormal(result) ? __OPTIWEAVE_DENORMAL_RESULT : 0u);
+    if (operands != 0) [[unlikely]] {
+      where.type = typeid(Result).name();
+      __optiweave_report_denormal(operation, operands, &where);
+    }
+  }
+}
 
 /**
  * @brief Arithmetic operation instrumentation templates
  */
 template <typename LHS, typename RHS> struct __primop_add {
-  constexpr auto operator()(const LHS &lhs, const RHS &rhs) const
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where) const
       -> decltype(lhs + rhs) {
 
-    if (g_config.log_arithmetic_ops) {
-      __optiweave_log_operation("add", typeid(LHS).name(), typeid(RHS).name(),
-                                __FILE__, __LINE__);
+    if (__OPTIWEAVE_ENABLED(log_arithmetic_ops)) {
+      __optiweave_log_operation("add", &where);
     }
 
-    return lhs + rhs;
+    auto result = lhs + rhs;
+    if (__OPTIWEAVE_ENABLED(check_denormals)) {
+      check_denormals("add", lhs, rhs, result, where);
+    }
+    return result;
   }
 };
 
 template <typename LHS, typename RHS> struct __primop_sub {
-  constexpr auto operator()(const LHS &lhs, const RHS &rhs) const
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where) const
       -> decltype(lhs - rhs) {
 
-    if (g_config.log_arithmetic_ops) {
-      __optiweave_log_operation("sub", typeid(LHS).name(), typeid(RHS).name(),
-                                __FILE__, __LINE__);
+    if (__OPTIWEAVE_ENABLED(log_arithmetic_ops)) {
+      __optiweave_log_operation("sub", &where);
     }
 
-    return lhs - rhs;
+    auto result = lhs - rhs;
+    if (__OPTIWEAVE_ENABLED(check_denormals)) {
+      check_denormals("sub", lhs, rhs, result, where);
+    }
+    return result;
   }
 };
 
 template <typename LHS, typename RHS> struct __primop_mul {
-  constexpr auto operator()(const LHS &lhs, const RHS &rhs) const
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where) const
       -> decltype(lhs * rhs) {
 
-    if (g_config.log_arithmetic_ops) {
-      __optiweave_log_operation("mul", typeid(LHS).name(), typeid(RHS).name(),
-                                __FILE__, __LINE__);
+    if (__OPTIWEAVE_ENABLED(log_arithmetic_ops)) {
+      __optiweave_log_operation("mul", &where);
     }
 
-    return lhs * rhs;
+    auto result = lhs * rhs;
+    if (__OPTIWEAVE_ENABLED(check_denormals)) {
+      check_denormals("mul", lhs, rhs, result, where);
+    }
+    return result;
   }
 };
 
 template <typename LHS, typename RHS> struct __primop_div {
-  constexpr auto operator()(const LHS &lhs, const RHS &rhs) const
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where) const
       -> decltype(lhs / rhs) {
 
-    if (g_config.log_arithmetic_ops) {
-      __optiweave_log_operation("div", typeid(LHS).name(), typeid(RHS).name(),
-                                __FILE__, __LINE__);
+    if (__OPTIWEAVE_ENABLED(log_arithmetic_ops)) {
+      __optiweave_log_operation("div", &where);
+    }
+
+    if constexpr (std::is_integral_v<std::remove_cvref_t<RHS>>) {
+      if (__OPTIWEAVE_ENABLED(profile_divisors)) {
+        where.type = typeid(RHS).name();
+        __optiweave_profile_value("div", static_cast<std::int64_t>(rhs),
+                                  &where);
+      }
     }
 
 #ifdef OPTIWEAVE_DEBUG
     if constexpr (std::is_arithmetic_v<RHS>) {
       if (rhs == RHS{}) {
-        std::cerr << "OptiWeave: Division by zero at " << __FILE__ << ":"
-                  << __LINE__ << std::endl;
+        std::cerr << "OptiWeave: Division by zero at " << where.file << ":"
+                  << where.line << std::endl;
       }
     }
 #endif
 
-    return lhs / rhs;
+    auto result = lhs / rhs;
+    if (__OPTIWEAVE_ENABLED(check_denormals)) {
+      check_denormals("div", lhs, rhs, result, where);
+    }
+    return result;
   }
 };
 
+template <typename LHS, typename RHS> struct __primop_mod {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where) const
+      -> decltype(lhs % rhs) {
+
+    if (__OPTIWEAVE_ENABLED(log_arithmetic_ops)) {
+      __optiweave_log_operation("mod", &where);
+    }
+
+    if constexpr (std::is_integral_v<std::remove_cvref_t<RHS>>) {
+      if (__OPTIWEAVE_ENABLED(profile_divisors)) {
+        where.type = typeid(RHS).name();
+        __optiweave_profile_value("mod", static_cast<std::int64_t>(rhs),
+                                  &where);
+      }
+    }
+
+#ifdef OPTIWEAVE_DEBUG
+    if (rhs == RHS{}) {
+      std::cerr << "OptiWeave: Modulo by zero at " << where.file << ":"
+                << where.line << std::endl;
+    }
+#endif
+
+    return lhs % rhs;
+  }
+};
+
+/**
+ * @brief Site id of one comparison or virtual call, cached after its first
+ * evaluation
+ *
+ * The tool gives every such call site its own static slot through
+ * __optiweave_site_slot(), so the runtime resolves the site once rather
+ * than on every evaluation.
+ */
+struct SiteSlot {
+  static constexpr std::uint32_t kUnresolved = 0xfffffffeu;
+  std::atomic<std::uint32_t> id{kUnresolved};
+};
+
+/**
+ * @brief Increment a counter that only the calling thread writes; a
+ * relaxed load/store pair keeps the instruction unlocked while the runtime
+ * can still read a torn-free value
+ */
+inline void bump_owned(std::atomic<std::uint64_t> &counter,
+                       std::uint64_t amount = 1) {
+  counter.store(counter.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+/**
+ * @brief The calling thread's entry for a site in per-thread blocks owned by
+ * the runtime; each block is fetched on the thread's first use of it
+ */
+template <typename Entry, Entry *(*Fetch)(std::uint32_t)>
+Entry *thread_site_entry(Entry *(&blocks)[__OPTIWEAVE_SITE_BLOCKS],
+                         std::uint32_t id) {
+  Entry *&block = blocks[id >> __OPTIWEAVE_SITE_BLOCK_SHIFT];
+  if (!block) [[unlikely]] {
+    block = Fetch(id);
+    if (!block) {
+      return nullptr;
+    }
+  }
+  return &block[id & ((1u << __OPTIWEAVE_SITE_BLOCK_SHIFT) - 1)];
+}
+
+// The calling thread's outcome counters, [site][false, true]
+using BranchOutcomes = std::atomic<std::uint64_t>[2];
+inline thread_local BranchOutcomes
+    *thread_branch_blocks[__OPTIWEAVE_SITE_BLOCKS] = {};
+
+/**
+ * @brief Count one outcome of a comparison in the calling thread's counters
+ *
+ * The counter is indexed by the outcome, so the profile costs no branch on
+ * the result itself, and it is private to the thread, so no locked
+ * increment. The runtime sums the threads' counters at shutdown.
+ */
+inline void count_branch(const char *operation, bool outcome, SiteSlot &slot,
+                         const __optiweave_site_info &where) {
+  // Threads racing on the first evaluation resolve the same id
+  std::uint32_t id = slot.id.load(std::memory_order_relaxed);
+  if (id == SiteSlot::kUnresolved) [[unlikely]] {
+    id = __optiweave_branch_site(operation, &where);
+    slot.id.store(id, std::memory_order_relaxed);
+  }
+  if (id == __OPTIWEAVE_NO_SITE) {
+    return;
+  }
+  if (BranchOutcomes *outcomes =
+          thread_site_entry<BranchOutcomes, __optiweave_branch_counters>(
+              thread_branch_blocks, id)) {
+    bump_owned((*outcomes)[outcome]);
+  }
+}
+
+/**
+ * @brief Comparison instrumentation templates
+ */
+template <typename LHS, typename RHS> struct __primop_eq {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where,
+                            SiteSlot &slot) const
+      -> decltype(lhs == rhs) {
+    auto result = lhs == rhs;
+    if (__OPTIWEAVE_ENABLED(profile_branches)) {
+      count_branch("eq", static_cast<bool>(result), slot, where);
+    }
+    return result;
+  }
+};
+
+template <typename LHS, typename RHS> struct __primop_ne {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where,
+                            SiteSlot &slot) const
+      -> decltype(lhs != rhs) {
+    auto result = lhs != rhs;
+    if (__OPTIWEAVE_ENABLED(profile_branches)) {
+      count_branch("ne", static_cast<bool>(result), slot, where);
+    }
+    return result;
+  }
+};
+
+template <typename LHS, typename RHS> struct __primop_lt {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where,
+                            SiteSlot &slot) const
+      -> decltype(lhs < rhs) {
+    auto result = lhs < rhs;
+    if (__OPTIWEAVE_ENABLED(profile_branches)) {
+      count_branch("lt", static_cast<bool>(result), slot, where);
+    }
+    return result;
+  }
+};
+
+template <typename LHS, typename RHS> struct __primop_gt {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where,
+                            SiteSlot &slot) const
+      -> decltype(lhs > rhs) {
+    auto result = lhs > rhs;
+    if (__OPTIWEAVE_ENABLED(profile_branches)) {
+      count_branch("gt", static_cast<bool>(result), slot, where);
+    }
+    return result;
+  }
+};
+
+template <typename LHS, typename RHS> struct __primop_le {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where,
+                            SiteSlot &slot) const
+      -> decltype(lhs <= rhs) {
+    auto result = lhs <= rhs;
+    if (__OPTIWEAVE_ENABLED(profile_branches)) {
+      count_branch("le", static_cast<bool>(result), slot, where);
+    }
+    return result;
+  }
+};
+
+template <typename LHS, typename RHS> struct __primop_ge {
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where,
+                            SiteSlot &slot) const
+      -> decltype(lhs >= rhs) {
+    auto result = lhs >= rhs;
+    if (__OPTIWEAVE_ENABLED(profile_branches)) {
+      count_branch("ge", static_cast<bool>(result), slot, where);
+    }
+    return result;
+  }
+};
+
+// Dependent operands: the wrappers above already return what the
+// (possibly overloaded) operator returns
+template <typename LHS, typename RHS>
+struct __maybe_primop_eq : __primop_eq<LHS, RHS> {};
+template <typename LHS, typename RHS>
+struct __maybe_primop_ne : __primop_ne<LHS, RHS> {};
+template <typename LHS, typename RHS>
+struct __maybe_primop_lt : __primop_lt<LHS, RHS> {};
+template <typename LHS, typename RHS>
+struct __maybe_primop_gt : __primop_gt<LHS, RHS> {};
+template <typename LHS, typename RHS>
+struct __maybe_primop_le : __primop_le<LHS, RHS> {};
+template <typename LHS, typename RHS>
+struct __maybe_primop_ge : __primop_ge<LHS, RHS> {};
+
 /**
  * @brief Template for handling potentially overloaded arithmetic operators
  */
 template <typename LHS, typename RHS, bool HasOverload>
 struct __maybe_primop_add {
-  constexpr auto operator()(const LHS &lhs, const RHS &rhs) const
+  constexpr auto operator()(const LHS &lhs, const RHS &rhs,
+                            __optiweave_site_info where) const
       -> decltype(lhs + rhs) {
 
-    if (g_config.log_arithmetic_ops) {
-      __optiweave_log_operation("overloaded_add", typeid(LHS).name(),
-                                typeid(RHS).name(), __FILE__, __LINE__);
+    if (__OPTIWEAVE_ENABLED(log_arithmetic_ops)) {
+      __optiweave_log_operation("overloaded_add", &where);
     }
 
-    return lhs + rhs;
+    // May be a reference or proxy; keep exactly what the operator returned
+    decltype(lhs + rhs) result = lhs + rhs;
+    if (__OPTIWEAVE_ENABLED(check_denormals)) {
+      check_denormals("overloaded_add", lhs, rhs, result, where);
+    }
+    return result;
   }
 };
 
@@ -261,6 +862,462 @@ struct __maybe_primop_add<LHS, RHS, false> : __primop_add<LHS, RHS> {};
 
 // Similar patterns for other arithmetic operations...
 
+/**
+ * @brief Iteration counter of one execution of an instrumented loop
+ *
+ * The tool declares one in a block around the loop and calls step() at the
+ * top of its body, so iterations left by break or return count too; the
+ * count stays in a register or on the stack and reaches the runtime once,
+ * when the loop is left by any path.
+ */
+class LoopTripCounter {
+private:
+  __optiweave_site_info where_;
+  std::uint64_t trips_ = 0;
+
+public:
+  explicit LoopTripCounter(__optiweave_site_info where) : where_(where) {}
+
+  LoopTripCounter(const LoopTripCounter &) = delete;
+  LoopTripCounter &operator=(const LoopTripCounter &) = delete;
+
+  ~LoopTripCounter() {
+    if (__OPTIWEAVE_ENABLED(profile_loops)) {
+      __optiweave_record_trips(trips_, &where_);
+    }
+  }
+
+  void step() { ++trips_; }
+};
+
+/**
+ * @brief Entry/exit probe the tool places at the top of a function body
+ *
+ * The runtime reads the cycle counter and keeps the shadow call stack; the
+ * probe itself only passes the address of the function's static site, so
+ * no strings are built and nothing is printed.
+ */
+class FunctionProbe {
+private:
+  bool active_;
+
+public:
+  explicit FunctionProbe(const __optiweave_site_info *function)
+      : active_(__OPTIWEAVE_ENABLED(profile_functions)) {
+    if (active_) {
+      __optiweave_enter_function(function);
+    }
+  }
+
+  FunctionProbe(const FunctionProbe &) = delete;
+  FunctionProbe &operator=(const FunctionProbe &) = delete;
+
+  ~FunctionProbe() {
+    if (active_) {
+      __optiweave_exit_function();
+    }
+  }
+};
+
+/**
+ * @brief Allocation and deallocation wrappers
+ *
+ * Each passes its operand through unchanged, so the tool can wrap a new
+ * expression, an array count or a delete operand in place and every
+ * operand is still evaluated once.
+ */
+inline void record_allocation(const char *operation, std::size_t bytes,
+                              __optiweave_site_info &where) {
+  if (__OPTIWEAVE_ENABLED(track_allocations)) {
+    __optiweave_record_allocation(operation, bytes, &where);
+  }
+}
+
+template <typename Pointee>
+Pointee *track_new(Pointee *ptr, __optiweave_site_info where) {
+  record_allocation("new", sizeof(Pointee), where);
+  return ptr;
+}
+
+template <typename Count>
+Count track_new_array(Count count, std::size_t element_size,
+                      __optiweave_site_info where) {
+  record_allocation("new[]", static_cast<std::size_t>(count) * element_size,
+                    where);
+  return count;
+}
+
+inline void record_deallocation(const char *operation,
+                                __optiweave_site_info &where) {
+  if (__OPTIWEAVE_ENABLED(track_allocations)) {
+    __optiweave_record_deallocation(operation, &where);
+  }
+}
+
+template <typename Pointer>
+Pointer &&track_delete(Pointer &&ptr, __optiweave_site_info where) {
+  record_deallocation("delete", where);
+  return std::forward<Pointer>(ptr);
+}
+
+/**
+ * @brief Heap bytes a container holds: its capacity where it has one (a
+ * string's inline buffer excluded), else its elements, not counting node
+ * overhead
+ */
+template <typename Container>
+std::size_t allocated_bytes(const Container &container) {
+  using Value = typename Container::value_type;
+  if constexpr (requires { container.capacity(); }) {
+    std::size_t empty = 0;
+    if constexpr (std::is_default_constructible_v<Container>) {
+      empty = Container().capacity();
+    }
+    std::size_t capacity = container.capacity();
+    return capacity > empty ? capacity * sizeof(Value) : 0;
+  } else if constexpr (requires { container.bucket_count(); }) {
+    // A single bucket is the inline one of an empty table
+    std::size_t buckets = container.bucket_count();
+    return (buckets > 1 ? buckets * sizeof(void *) : 0) +
+           container.size() * sizeof(Value);
+  } else {
+    return container.size() * sizeof(Value);
+  }
+}
+
+/**
+ * @brief Record what a container allocated while it was constructed;
+ * containers that start out empty allocate nothing and are not counted
+ */
+template <typename Container>
+void track_construction(const Container &container,
+                        __optiweave_site_info where) {
+  if (__OPTIWEAVE_ENABLED(track_allocations)) {
+    if (std::size_t bytes = allocated_bytes(container)) {
+      __optiweave_record_allocation("container", bytes, &where);
+    }
+  }
+}
+
+/**
+ * @brief track_construction for a temporary, which is moved through
+ */
+template <typename Container>
+Container track_temporary(Container container, __optiweave_site_info where) {
+  track_construction(container, where);
+  return container;
+}
+
+inline void *traced_malloc(std::size_t size, __optiweave_site_info where) {
+  record_allocation("malloc", size, where);
+  return std::malloc(size);
+}
+
+inline void *traced_calloc(std::size_t count, std::size_t size,
+                           __optiweave_site_info where) {
+  record_allocation("calloc", count * size, where);
+  return std::calloc(count, size);
+}
+
+inline void *traced_realloc(void *ptr, std::size_t size,
+                            __optiweave_site_info where) {
+  record_allocation("realloc", size, where);
+  return std::realloc(ptr, size);
+}
+
+inline void *traced_aligned_alloc(std::size_t alignment, std::size_t size,
+                                  __optiweave_site_info where) {
+  record_allocation("aligned_alloc", size, where);
+  return std::aligned_alloc(alignment, size);
+}
+
+inline void traced_free(void *ptr, __optiweave_site_info where) {
+  record_deallocation("free", where);
+  std::free(ptr);
+}
+
+/**
+ * @brief Bytes a copy of value duplicates: the object itself plus, for
+ * containers, the elements it holds (not counting node overhead)
+ */
+template <typename Value> std::size_t copied_bytes(const Value &value) {
+  if constexpr (requires {
+                  value.size();
+                  typename Value::value_type;
+                }) {
+    return sizeof(Value) +
+           value.size() * sizeof(typename Value::value_type);
+  } else {
+    return sizeof(Value);
+  }
+}
+
+/**
+ * @brief Copy-construction and copy-assignment wrappers
+ *
+ * The tool wraps the source of the copy; it is forwarded unchanged so the
+ * same constructor or assignment operator is chosen.
+ */
+template <typename Source>
+Source &&track_copy(Source &&source, __optiweave_site_info where) {
+  if (__OPTIWEAVE_ENABLED(track_copies)) {
+    using Value = std::remove_cvref_t<Source>;
+    where.type = typeid(Value).name();
+    __optiweave_record_copy("copy", copied_bytes(source), &where);
+  }
+  return std::forward<Source>(source);
+}
+
+template <typename Source>
+Source &&track_copy_assignment(Source &&source, __optiweave_site_info where) {
+  if (__OPTIWEAVE_ENABLED(track_copies)) {
+    using Value = std::remove_cvref_t<Source>;
+    where.type = typeid(Value).name();
+    __optiweave_record_copy("copy=", copied_bytes(source), &where);
+  }
+  return std::forward<Source>(source);
+}
+
+// The calling thread's receiver caches, one per virtual call site
+inline thread_local __optiweave_receiver_cache
+    *thread_receiver_blocks[__OPTIWEAVE_SITE_BLOCKS] = {};
+
+/**
+ * @brief Count one virtual call in the calling thread's receiver cache
+ *
+ * Type slots are claimed first come, first served; calls on further types
+ * only count as overflow. The runtime merges the threads' caches at
+ * shutdown.
+ */
+inline void count_receiver(const std::type_info &type, SiteSlot &slot,
+                           const __optiweave_site_info &where) {
+  std::uint32_t id = slot.id.load(std::memory_order_relaxed);
+  if (id == SiteSlot::kUnresolved) [[unlikely]] {
+    id = __optiweave_dispatch_site(&where);
+    slot.id.store(id, std::memory_order_relaxed);
+  }
+  if (id == __OPTIWEAVE_NO_SITE) {
+    return;
+  }
+  __optiweave_receiver_cache *cache =
+      thread_site_entry<__optiweave_receiver_cache,
+                        __optiweave_receiver_caches>(thread_receiver_blocks,
+                                                     id);
+  if (!cache) {
+    return;
+  }
+  for (std::uint32_t i = 0; i < __OPTIWEAVE_RECEIVER_ENTRIES; ++i) {
+    const void *seen = cache->types[i].load(std::memory_order_relaxed);
+    if (!seen) {
+      seen = &type;
+      cache->types[i].store(seen, std::memory_order_relaxed);
+    }
+    if (seen == &type) {
+      bump_owned(cache->counts[i]);
+      return;
+    }
+  }
+  bump_owned(cache->overflow);
+}
+
+/**
+ * @brief Receiver wrappers for virtual calls
+ *
+ * The tool wraps the object expression of obj.f() or ptr->f() and counts
+ * the receiver's dynamic type per site and thread. typeid on a polymorphic
+ * object is a load from its vtable.
+ */
+template <typename Receiver>
+Receiver &&track_receiver(Receiver &&receiver, __optiweave_site_info where,
+                          SiteSlot &slot) {
+  if (__OPTIWEAVE_ENABLED(profile_dispatch)) {
+    using Static = std::remove_cvref_t<Receiver>;
+    where.type = typeid(Static).name();
+    count_receiver(typeid(receiver), slot, where);
+  }
+  return std::forward<Receiver>(receiver);
+}
+
+/// Pointers and smart pointers: null receivers are left to the call
+template <typename Pointer>
+Pointer &&track_receiver_pointer(Pointer &&pointer,
+                                 __optiweave_site_info where, SiteSlot &slot) {
+  if (__OPTIWEAVE_ENABLED(profile_dispatch) && pointer) {
+    using Static = std::remove_cvref_t<decltype(*pointer)>;
+    where.type = typeid(Static).name();
+    count_receiver(typeid(*pointer), slot, where);
+  }
+  return std::forward<Pointer>(pointer);
+}
+
+/**
+ * @brief Watches one std::vector or std::string for reallocations
+ *
+ * The tool declares one right after the container and routes its
+ * push_back/emplace_back/append calls through observe(). The observation
+ * lives until the end of the full expression, so the capacity is checked
+ * after the call; the destructor reports the peak size before the
+ * container itself is destroyed or moved into a return value.
+ */
+template <typename Container> class GrowthTracker {
+private:
+  const Container &container_;
+  __optiweave_site_info where_;
+  std::size_t capacity_;
+  std::size_t peak_size_;
+  std::uint64_t reallocations_ = 0;
+
+  void note() {
+    std::size_t capacity = container_.capacity();
+    reallocations_ += capacity > capacity_;
+    capacity_ = capacity;
+    if (container_.size() > peak_size_) {
+      peak_size_ = container_.size();
+    }
+  }
+
+public:
+  class Observation {
+  private:
+    GrowthTracker &tracker_;
+    Container &container_;
+
+  public:
+    Observation(GrowthTracker &tracker, Container &container)
+        : tracker_(tracker), container_(container) {}
+
+    Observation(const Observation &) = delete;
+    Observation &operator=(const Observation &) = delete;
+
+    ~Observation() {
+      if (__OPTIWEAVE_ENABLED(profile_growth)) {
+        tracker_.note();
+      }
+    }
+
+    Container *operator->() const { return &container_; }
+  };
+
+  GrowthTracker(const Container &container, __optiweave_site_info where)
+      : container_(container), where_(where),
+        capacity_(container.capacity()), peak_size_(container.size()) {}
+
+  GrowthTracker(const GrowthTracker &) = delete;
+  GrowthTracker &operator=(const GrowthTracker &) = delete;
+
+  ~GrowthTracker() {
+    if (__OPTIWEAVE_ENABLED(profile_growth)) {
+      note();
+      __optiweave_record_growth(peak_size_, reallocations_, &where_);
+    }
+  }
+
+  Observation observe(Container &container) { return {*this, container}; }
+};
+
+// The calling thread's counts of calls on unordered containers, per site
+inline thread_local __optiweave_hash_counts
+    *thread_hash_blocks[__OPTIWEAVE_SITE_BLOCKS] = {};
+
+/**
+ * @brief Observes one call on a std::unordered_map or std::unordered_set
+ *
+ * The tool rewrites m.find(k) to track_hash(m, site, slot, k)->find(k) and
+ * m[k] to (*track_hash(m, site, slot, k))[k]; keys with side effects are
+ * not passed twice, and those calls are counted without a sample. The
+ * probe lives until the end of the full expression and counts the table's
+ * size and bucket count after the call, and whether the call rehashed it,
+ * in the calling thread's counts for the site. Every 64th call of a site
+ * per thread also reads the size of the bucket the key hashes to before
+ * the call, which is the chain the lookup walks.
+ */
+template <typename Container> class HashProbe {
+private:
+  static constexpr std::uint64_t kSampleEvery = 64;
+
+  Container &container_;
+  __optiweave_hash_counts *counts_ = nullptr;
+  std::size_t buckets_ = 0;
+
+  void open(__optiweave_site_info where, SiteSlot &slot) {
+    if (!__OPTIWEAVE_ENABLED(profile_hashing)) {
+      return;
+    }
+    std::uint32_t id = slot.id.load(std::memory_order_relaxed);
+    if (id == SiteSlot::kUnresolved) [[unlikely]] {
+      where.type = typeid(std::remove_cv_t<Container>).name();
+      id = __optiweave_hash_site(&where);
+      slot.id.store(id, std::memory_order_relaxed);
+    }
+    if (id == __OPTIWEAVE_NO_SITE) {
+      return;
+    }
+    counts_ = thread_site_entry<__optiweave_hash_counts,
+                                __optiweave_hash_counters>(thread_hash_blocks,
+                                                           id);
+    if (counts_) {
+      buckets_ = container_.bucket_count();
+    }
+  }
+
+public:
+  HashProbe(Container &container, __optiweave_site_info where, SiteSlot &slot)
+      : container_(container) {
+    open(where, slot);
+  }
+
+  template <typename Key>
+  HashProbe(Container &container, __optiweave_site_info where, SiteSlot &slot,
+            const Key &key)
+      : container_(container) {
+    open(where, slot);
+    // Heterogeneous keys the table cannot hash directly are not sampled
+    if constexpr (requires { container.bucket(key); }) {
+      if (counts_ && buckets_ > 0 &&
+          counts_->lookups.load(std::memory_order_relaxed) % kSampleEvery ==
+              0) {
+        bump_owned(counts_->sampled_lookups);
+        bump_owned(counts_->sampled_chain,
+                   container.bucket_size(container.bucket(key)));
+      }
+    }
+  }
+
+  HashProbe(const HashProbe &) = delete;
+  HashProbe &operator=(const HashProbe &) = delete;
+
+  ~HashProbe() {
+    if (!counts_) {
+      return;
+    }
+    std::uint64_t size = container_.size();
+    std::size_t buckets = container_.bucket_count();
+    bump_owned(counts_->lookups);
+    bump_owned(counts_->rehashes, buckets != buckets_);
+    bump_owned(counts_->size_sum, size);
+    bump_owned(counts_->bucket_sum, buckets);
+    if (size > counts_->max_size.load(std::memory_order_relaxed)) {
+      counts_->max_size.store(size, std::memory_order_relaxed);
+    }
+  }
+
+  Container *operator->() const { return &container_; }
+  Container &operator*() const { return container_; }
+};
+
+template <typename Container>
+HashProbe<Container> track_hash(Container &container,
+                                __optiweave_site_info where, SiteSlot &slot) {
+  return {container, where, slot};
+}
+
+template <typename Container, typename Key>
+HashProbe<Container> track_hash(Container &container,
+                                __optiweave_site_info where, SiteSlot &slot,
+                                const Key &key) {
+  return {container, where, slot, key};
+}
+
 /**
  * @brief Performance timing utilities
  */
@@ -296,10 +1353,62 @@ public:
 
 #define OPTIWEAVE_LOG_ACCESS(ptr, index)                                       \
   do {                                                                         \
-    if (optiweave::g_config.log_array_accesses) {                              \
-      __optiweave_log_access("manual", ptr, index, __FILE__, __LINE__);        \
+    if (__OPTIWEAVE_ENABLED(log_array_accesses)) {                             \
+      auto __optiweave_where = optiweave::site_here();                         \
+      __optiweave_log_access("manual", ptr, index, 0, &__optiweave_where);     \
     }                                                                          \
   } while (0)
 
 // Alias the old names for backward compatibility
 #define __has_subscript_overload optiweave::has_subscript_overload
+
+// The tool emits wrapper names unqualified, inside whatever namespace the
+// rewritten code is in
+using optiweave::__primop_subscript;
+using optiweave::__primop_container_subscript;
+using optiweave::__primop_subscript_nd;
+using optiweave::__maybe_primop_subscript;
+using optiweave::__primop_add;
+using optiweave::__primop_sub;
+using optiweave::__primop_mul;
+using optiweave::__primop_div;
+using optiweave::__primop_mod;
+using optiweave::__primop_eq;
+using optiweave::__primop_ne;
+using optiweave::__primop_lt;
+using optiweave::__primop_gt;
+using optiweave::__primop_le;
+using optiweave::__primop_ge;
+using optiweave::__maybe_primop_add;
+using optiweave::__maybe_primop_eq;
+using optiweave::__maybe_primop_ne;
+using optiweave::__maybe_primop_lt;
+using optiweave::__maybe_primop_gt;
+using optiweave::__maybe_primop_le;
+using optiweave::__maybe_primop_ge;
+
+// Site argument appended by the tool to every generated wrapper call
+#define __optiweave_site(column) optiweave::site_here(column)
+#define __optiweave_site_write(column)                                         \
+  optiweave::site_here(column, __OPTIWEAVE_SITE_WRITE)
+
+#define __optiweave_site_last_use(column)                                      \
+  optiweave::site_here(column, __OPTIWEAVE_SITE_LAST_USE)
+
+#define __optiweave_site_loop(column, depth)                                    \
+  optiweave::site_here(column, (depth) << __OPTIWEAVE_SITE_LOOP_SHIFT)
+
+// Static per call site slot for the comparison and receiver wrappers;
+// every expansion is its own lambda, hence its own SiteSlot
+#define __optiweave_site_slot()                                                \
+  []() -> optiweave::SiteSlot & {                                              \
+    static optiweave::SiteSlot __optiweave_slot;                               \
+    return __optiweave_slot;                                                   \
+  }()
+
+// Function probe inserted by the tool as the first statement of a body
+#define __optiweave_probe(column)                                              \
+  static constexpr __optiweave_site_info __optiweave_function_site =           \
+      optiweave::site_here(column);                                            \
+  optiweave::FunctionProbe __optiweave_function_probe(                         \
+      &__optiweave_function_site)
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Check that disabled instrumentation compiles to the original code.
+
+Usage: check_codegen.py --tool=PATH --prelude=PATH --fixtures=DIR --work=DIR
+                        [--compiler=c++] [--objdump=objdump]
+                        [-- extra tool arguments]
+
+Every fixture is woven by the optiweave tool, then the original and the
+woven file are compiled at -O2 with OPTIWEAVE_NULL_POLICY and the prelude
+force-included into both. Each function's disassembly is normalized and
+compared; any function whose code differs, or that exists on one side
+only, fails the check with a diff.
+
+Normalization drops instruction addresses, objdump's comments and the
+absolute target of branches (the symbolic <function+offset> stays),
+strips the numbers of local constant labels (.LC3 becomes .LC), puts the
+registers of a compare that feeds only an equality test in a fixed order,
+and renames registers in order of first use within each function. Operand
+order and register choice follow the compiler's temporary numbering,
+which the wrappers shift without changing the code.
+"""
+
+import difflib
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+DEFAULT_TOOL_ARGS = ["--arithmetic-ops", "--comparison-ops"]
+
+FUNCTION = re.compile(r"^[0-9a-f]+ <(.+)>:$")
+INSTRUCTION = re.compile(r"^\s*[0-9a-f]+:\s+(.*)$")
+BRANCH_TARGET = re.compile(r"\b[0-9a-f]+ (<[^>]+>)")
+COMMENT = re.compile(r"\s*#.*$")
+LOCAL_LABEL = re.compile(r"\.LC[0-9]+")
+REGISTER = re.compile(r"%[a-z][a-z0-9]*")
+REGISTER_COMPARE = re.compile(
+    r"^(cmp[a-z]?|test[a-z]?) (%[a-z0-9]+),(%[a-z0-9]+)$")
+EQUALITY_USE = re.compile(r"^(je|jne|jz|jnz|sete|setne|setz|setnz) ")
+
+
+def run(command, **kwargs):
+    result = subprocess.run(command, capture_output=True, text=True, **kwargs)
+    if result.returncode != 0:
+        sys.stderr.write(" ".join(command) + "\n" + result.stdout +
+                         result.stderr)
+        raise SystemExit(2)
+    return result.stdout
+
+
+def order_equality_compares(lines):
+    ordered = list(lines)
+    for i, line in enumerate(ordered[:-1]):
+        match = REGISTER_COMPARE.match(line)
+        if match and EQUALITY_USE.match(ordered[i + 1]):
+            first, second = sorted(match.group(2, 3))
+            ordered[i] = f"{match.group(1)} {first},{second}"
+    return ordered
+
+
+def rename_registers(lines):
+    names = {}
+
+    def rename(match):
+        register = match.group(0)
+        if register not in names:
+            names[register] = f"%r{len(names)}"
+        return names[register]
+
+    return [REGISTER.sub(rename, line) for line in lines]
+
+
+def functions(objdump, obj):
+    """Normalized instruction lines per function symbol."""
+    listing = run([objdump, "-d", "-r", "--no-show-raw-insn", obj])
+    result = {}
+    name = None
+    for line in listing.splitlines():
+        match = FUNCTION.match(line)
+        if match:
+            name = match.group(1)
+            result[name] = []
+            continue
+        match = INSTRUCTION.match(line)
+        if name is None or not match:
+            continue
+        text = " ".join(COMMENT.sub("", match.group(1)).split())
+        text = LOCAL_LABEL.sub(".LC", BRANCH_TARGET.sub(r"\1", text))
+        result[name].append(text)
+    return {name: rename_registers(order_equality_compares(lines))
+            for name, lines in result.items()}
+
+
+def compile_object(compiler, prelude, source, obj, include):
+    run([compiler, "-std=c++20", "-O2", "-ffunction-sections",
+         "-DOPTIWEAVE_NULL_POLICY", "-include", prelude, "-I", include,
+         "-c", source, "-o", obj])
+
+
+def main(argv):
+    options = {"compiler": "c++", "objdump": "objdump"}
+    tool_args = DEFAULT_TOOL_ARGS
+    args = argv[1:]
+    if "--" in args:
+        at = args.index("--")
+        tool_args = args[at + 1:]
+        args = args[:at]
+    for arg in args:
+        if arg in ("-h", "--help"):
+            print(__doc__.strip())
+            return 0
+        key, _, value = arg.lstrip("-").partition("=")
+        options[key] = value
+    missing = [key for key in ("tool", "prelude", "fixtures", "work")
+               if not options.get(key)]
+    if missing:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    fixtures = options["fixtures"]
+    work = options["work"]
+    woven_dir = os.path.join(work, "woven")
+    shutil.rmtree(work, ignore_errors=True)
+    os.makedirs(woven_dir)
+
+    # The tool rewrites only the files it changes, so weave copies in place
+    sources = sorted(name for name in os.listdir(fixtures)
+                     if name.endswith(".cpp"))
+    woven = []
+    for name in sources:
+        shutil.copy(os.path.join(fixtures, name), woven_dir)
+        woven.append(os.path.join(woven_dir, name))
+    run([options["tool"], f"--prelude={options['prelude']}"] + tool_args +
+        woven + ["--", "-std=c++20", "-I", fixtures])
+
+    failures = 0
+    compared = 0
+    for name in sources:
+        stem = os.path.splitext(name)[0]
+        original_obj = os.path.join(work, stem + ".original.o")
+        woven_obj = os.path.join(work, stem + ".woven.o")
+        compile_object(options["compiler"], options["prelude"],
+                       os.path.join(fixtures, name), original_obj, fixtures)
+        compile_object(options["compiler"], options["prelude"],
+                       os.path.join(woven_dir, name), woven_obj, fixtures)
+
+        original = functions(options["objdump"], original_obj)
+        transformed = functions(options["objdump"], woven_obj)
+        for function in sorted(set(original) | set(transformed)):
+            compared += 1
+            if function not in transformed:
+                print(f"{name}: {function} is missing from the woven code")
+                failures += 1
+            elif function not in original:
+                print(f"{name}: {function} exists only in the woven code")
+                print("\n".join("  " + line for line in transformed[function]))
+                failures += 1
+            elif original[function] != transformed[function]:
+                print(f"{name}: {function} differs")
+                diff = difflib.unified_diff(original[function],
+                                            transformed[function],
+                                            "original", "woven", lineterm="")
+                print("\n".join("  " + line for line in diff))
+                failures += 1
+
+    print(f"{compared - failures} of {compared} functions identical in "
+          f"{len(sources)} fixtures")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,36 @@
+// Codegen-equivalence fixture: must compile to the same code after weaving
+// with OPTIWEAVE_NULL_POLICY (see tests/codegen/check_codegen.py)
+
+#include <cstdint>
+
+double polynomial(double x) { return 3.0 * x * x - 2.0 * x + 1.0; }
+
+int average(int a, int b) { return (a + b) / 2; }
+
+unsigned bucket(unsigned hash, unsigned buckets) { return hash % buckets; }
+
+std::int64_t dot(const std::int64_t *a, const std::int64_t *b, int n) {
+  std::int64_t total = 0;
+  for (int i = 0; i < n; ++i) {
+    total = total + a[i] * b[i];
+  }
+  return total;
+}
+
+void axpy(double alpha, const double *x, double *y, int n) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = alpha * x[i] + y[i];
+  }
+}
+
+int clamp(int value, int low, int high) {
+  if (value < low) {
+    return low;
+  }
+  if (value > high) {
+    return high;
+  }
+  return value;
+}
+
+bool sameSign(long a, long b) { return (a >= 0) == (b >= 0); }
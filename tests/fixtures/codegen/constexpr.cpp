@@ -0,0 +1,46 @@
+// Codegen-equivalence fixture: must compile to the same code after weaving
+// with OPTIWEAVE_NULL_POLICY (see tests/codegen/check_codegen.py)
+
+#include <array>
+#include <cstddef>
+
+constexpr int clampConst(int value, int low, int high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+consteval int squareAbove(int value, int floor) {
+  return value > floor ? value * value : floor;
+}
+
+static_assert(clampConst(7, 0, 5) == 5);
+
+enum Limit { kSmall = 4 > 2 ? 4 : 2, kLarge = kSmall * 2 + 1 };
+
+constexpr std::size_t kCapacity = kLarge >= 8 ? 16 : 8;
+
+template <bool Wide> int widen(int value) {
+  if constexpr (Wide == true) {
+    return value * 2;
+  } else {
+    return value;
+  }
+}
+
+int fill(std::array<int, (kCapacity > 8) ? 4 : 2> &values, int seed) {
+  int buffer[kCapacity / 2 + (kSmall < 3)] = {};
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    values[i] = seed + buffer[i];
+  }
+  return static_cast<int>(values.size());
+}
+
+int classify(int value) {
+  switch (value) {
+  case (kSmall > 3 ? 1 : 0):
+    return widen<(kLarge > 5)>(value);
+  case squareAbove(2, 1):
+    return widen<false>(value);
+  default:
+    return clampConst(value, 0, 10);
+  }
+}
@@ -0,0 +1,39 @@
+// Codegen-equivalence fixture: must compile to the same code after weaving
+// with OPTIWEAVE_NULL_POLICY (see tests/codegen/check_codegen.py)
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+double sumSpan(std::span<const double> values) {
+  double total = 0;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    total += values[i];
+  }
+  return total;
+}
+
+int histogramPeak(const std::array<int, 64> &counts) {
+  int peak = 0;
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i] > peak) {
+      peak = counts[i];
+    }
+  }
+  return peak;
+}
+
+void prefixSums(std::vector<int> &values) {
+  for (std::size_t i = 1; i < values.size(); ++i) {
+    values[i] += values[i - 1];
+  }
+}
+
+double trace(const double (&matrix)[4][4]) {
+  double total = 0;
+  for (int i = 0; i < 4; ++i) {
+    total += matrix[i][i];
+  }
+  return total;
+}
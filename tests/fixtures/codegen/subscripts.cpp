@@ -0,0 +1,29 @@
+// Codegen-equivalence fixture: must compile to the same code after weaving
+// with OPTIWEAVE_NULL_POLICY (see tests/codegen/check_codegen.py)
+
+#include <cstddef>
+#include <vector>
+
+double sumArray(const double *values, int count) {
+  double total = 0;
+  for (int i = 0; i < count; ++i) {
+    total += values[i];
+  }
+  return total;
+}
+
+void scale(double *values, std::size_t count, double factor) {
+  for (std::size_t i = 0; i < count; ++i) {
+    values[i] *= factor;
+  }
+}
+
+int lookup(const int (&table)[16], unsigned key) { return table[key & 15]; }
+
+long sumVector(const std::vector<long> &values) {
+  long total = 0;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    total += values[i];
+  }
+  return total;
+}
@@ -0,0 +1,25 @@
+// Codegen-equivalence fixture: must compile to the same code after weaving
+// with OPTIWEAVE_NULL_POLICY (see tests/codegen/check_codegen.py)
+
+#include <cstddef>
+
+template <typename T> T sum(const T *values, std::size_t count) {
+  T total = T();
+  for (std::size_t i = 0; i < count; ++i) {
+    total += values[i];
+  }
+  return total;
+}
+
+template <typename T> bool contains(const T *values, std::size_t count, T key) {
+  for (std::size_t i = 0; i < count; ++i) {
+    if (values[i] == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template int sum<int>(const int *, std::size_t);
+template double sum<double>(const double *, std::size_t);
+template bool contains<int>(const int *, std::size_t, int);
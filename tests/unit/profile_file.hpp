@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+/**
+ * @brief Temporary profile file with the given contents, removed when the
+ * test ends
+ */
+class ProfileFile {
+public:
+  explicit ProfileFile(const std::string &contents) {
+    char path[] = "/tmp/optiweave-profile-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+      close(fd);
+      path_ = path;
+      std::ofstream(path_) << contents;
+    }
+  }
+
+  ~ProfileFile() {
+    if (!path_.empty()) {
+      std::remove(path_.c_str());
+    }
+  }
+
+  ProfileFile(const ProfileFile &) = delete;
+  ProfileFile &operator=(const ProfileFile &) = delete;
+
+  const std::string &path() const { return path_; }
+
+private:
+  std::string path_;
+};
@@ -1,11 +1,16 @@
 #include "optiweave/core/ast_visitor.hpp"
+#include "unit/profile_file.hpp"
 #include <gtest/gtest.h>
 
 #include <clang/AST/ASTContext.h>
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Frontend/FrontendActions.h>
+#include <clang/Rewrite/Core/Rewriter.h>
 #include <clang/Tooling/Tooling.h>
 
+#include <memory>
+#include <string>
+
 using namespace optiweave::core;
 using namespace clang;
 using namespace clang::tooling;
@@ -27,11 +32,27 @@ TEST_F(ASTVisitorTest, DefaultConfiguration) {
   TransformationConfig default_config;
 
   EXPECT_TRUE(default_config.transform_array_subscripts);
+  EXPECT_TRUE(default_config.fuse_subscripts);
+  EXPECT_FALSE(default_config.fuse_pointer_chains);
   EXPECT_FALSE(default_config.transform_arithmetic_operators);
   EXPECT_FALSE(default_config.transform_assignment_operators);
   EXPECT_FALSE(default_config.transform_comparison_operators);
+  EXPECT_FALSE(default_config.profile_loop_trips);
+  EXPECT_FALSE(default_config.probe_functions);
+  EXPECT_FALSE(default_config.track_allocations);
+  EXPECT_FALSE(default_config.profile_container_growth);
+  EXPECT_FALSE(default_config.track_copies);
+  EXPECT_EQ(default_config.copy_threshold, 64u);
+  EXPECT_FALSE(default_config.profile_virtual_calls);
+  EXPECT_FALSE(default_config.profile_hash_lookups);
+  EXPECT_TRUE(default_config.probe_filter.empty());
   EXPECT_TRUE(default_config.preserve_templates);
   EXPECT_TRUE(default_config.skip_system_headers);
+  EXPECT_FALSE(default_config.account_memory);
+  EXPECT_EQ(default_config.branch_profile, nullptr);
+  EXPECT_EQ(default_config.reserve_advice, nullptr);
+  EXPECT_EQ(default_config.receiver_profile, nullptr);
+  EXPECT_DOUBLE_EQ(default_config.branch_threshold, 0.9);
 }
 
 // Test statistics initialization
@@ -39,6 +60,8 @@ TEST_F(ASTVisitorTest, StatisticsInitialization) {
   TransformationStats stats;
 
   EXPECT_EQ(stats.array_subscripts_transformed, 0u);
+  EXPECT_EQ(stats.container_subscripts_transformed, 0u);
+  EXPECT_EQ(stats.subscript_chains_fused, 0u);
   EXPECT_EQ(stats.arithmetic_ops_transformed, 0u);
   EXPECT_EQ(stats.template_instantiations_skipped, 0u);
   EXPECT_EQ(stats.errors_encountered, 0u);
@@ -48,12 +71,16 @@ TEST_F(ASTVisitorTest, StatisticsInitialization) {
 TEST_F(ASTVisitorTest, StatisticsReset) {
   TransformationStats stats;
   stats.array_subscripts_transformed = 5;
+  stats.container_subscripts_transformed = 4;
+  stats.subscript_chains_fused = 2;
   stats.arithmetic_ops_transformed = 3;
   stats.errors_encountered = 1;
 
   stats.reset();
 
   EXPECT_EQ(stats.array_subscripts_transformed, 0u);
+  EXPECT_EQ(stats.container_subscripts_transformed, 0u);
+  EXPECT_EQ(stats.subscript_chains_fused, 0u);
   EXPECT_EQ(stats.arithmetic_ops_transformed, 0u);
   EXPECT_EQ(stats.errors_encountered, 0u);
 }
@@ -222,4 +249,414 @@ TEST_F(MinimalASTTest, EmptyCode) {
 
 TEST_F(MinimalASTTest, InvalidCode) {
   std::string code = "invalid c++ code {{{";
-  // Should still return true for non-empty code in our
+  // Should still return true for non-empty code in our placeholder
+  EXPECT_TRUE(testVisitorWithCode(code));
+}
+
+namespace {
+/**
+ * @brief Runs TransformationConsumer over one file and keeps the rewritten
+ * main file and the statistics
+ */
+class RewriteAction : public ASTFrontendAction {
+public:
+  RewriteAction(const TransformationConfig &config, std::string &rewritten,
+                TransformationStats &stats)
+      : config_(config), rewritten_(rewritten), stats_(stats) {}
+
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &ci,
+                                                 StringRef) override {
+    rewriter_.setSourceMgr(ci.getSourceManager(), ci.getLangOpts());
+    auto consumer = std::make_unique<TransformationConsumer>(
+        rewriter_, ci.getASTContext(), config_);
+    consumer_ = consumer.get();
+    return consumer;
+  }
+
+  void EndSourceFileAction() override {
+    stats_ = consumer_->getStats();
+    const SourceManager &source_manager = rewriter_.getSourceMgr();
+    FileID main_file = source_manager.getMainFileID();
+    if (const RewriteBuffer *buffer = rewriter_.getRewriteBufferFor(main_file)) {
+      rewritten_ = std::string(buffer->begin(), buffer->end());
+    } else {
+      rewritten_ = source_manager.getBufferData(main_file).str();
+    }
+  }
+
+private:
+  TransformationConfig config_;
+  Rewriter rewriter_;
+  TransformationConsumer *consumer_ = nullptr;
+  std::string &rewritten_;
+  TransformationStats &stats_;
+};
+} // namespace
+
+// Rewrites of real source, compared line by line with the expected text
+class RewriteTest : public ::testing::Test {
+protected:
+  std::string rewrite(const std::string &code) {
+    std::string rewritten;
+    EXPECT_TRUE(runToolOnCodeWithArgs(
+        std::make_unique<RewriteAction>(config_, rewritten, stats_), code,
+        {"-std=c++17"}, "input.cc"));
+    return rewritten;
+  }
+
+  TransformationConfig config_;
+  TransformationStats stats_;
+};
+
+TEST_F(RewriteTest, ContainerSubscripts) {
+  std::string code = R"(
+namespace std {
+template <class T> struct vector {
+  T &operator[](unsigned long);
+};
+template <> struct vector<bool> {
+  bool operator[](unsigned long) const;
+};
+} // namespace std
+
+int shift(std::vector<int> &values, std::vector<bool> &flags, int i) {
+  values[i] = flags[i];
+  return values[i + 1];
+}
+)";
+
+  std::string out = rewrite(code);
+  // Stores are told apart from loads; vector<bool> keeps its proxy
+  EXPECT_NE(out.find("  __primop_container_subscript(values, i, "
+                     "__optiweave_site_write(3)) = flags[i];\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("  return __primop_container_subscript(values, i + 1, "
+                     "__optiweave_site(10));\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.container_subscripts_transformed, 2u);
+}
+
+TEST_F(RewriteTest, SubscriptChains) {
+  std::string code = R"(
+int grid[4][8];
+int at(int **rows, int i, int j) { return grid[i][j] + rows[i][j]; }
+)";
+
+  std::string out = rewrite(code);
+  // Rows of an array are only addresses; loaded row pointers are accesses
+  EXPECT_NE(out.find("{ return __primop_subscript_nd<int [4][8]>()(grid, "
+                     "__optiweave_site(43), i, j) + "
+                     "__primop_subscript<int *>()(__primop_subscript<int **>()("
+                     "rows, i, __optiweave_site(56)), j, "
+                     "__optiweave_site(56)); }"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.subscript_chains_fused, 1u);
+  EXPECT_EQ(stats_.array_subscripts_transformed, 2u);
+}
+
+TEST_F(RewriteTest, BranchAnnotations) {
+  ProfileFile profile(
+      "file\tline\tcolumn\tfunction\toperation\ttrue\tfalse\ttrue_share\n"
+      "/build/transformed/input.cc\t3\t7\tclamp\tlt\t990\t10\t0.990\n"
+      "/build/transformed/input.cc\t6\t9\tclamp\tgt\t990\t10\t0.990\n");
+  auto branches = std::make_shared<BranchProfileTable>();
+  std::string error;
+  ASSERT_TRUE(branches->load(profile.path(), error)) << error;
+  config_.branch_profile = branches;
+  config_.transform_comparison_operators = true;
+
+  std::string code = R"(
+int clamp(int x, int limit) {
+  if (x < limit) {
+    return x;
+  }
+  if (!(x > 0)) {
+    return 0;
+  }
+  return limit;
+}
+)";
+
+  std::string out = rewrite(code);
+  // A negated condition flips the hint
+  EXPECT_NE(out.find("  if (__primop_lt<int, int>()(x, limit, "
+                     "__optiweave_site(7), __optiweave_site_slot())) "
+                     "[[likely]] {\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("  if (!(__primop_gt<int, int>()(x, 0, "
+                     "__optiweave_site(9), __optiweave_site_slot()))) "
+                     "[[unlikely]] {\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.branches_annotated, 2u);
+}
+
+TEST_F(RewriteTest, LoopTripCounters) {
+  config_.transform_array_subscripts = false;
+  config_.profile_loop_trips = true;
+
+  std::string code = R"(
+int count(const int *v, int n, int x) {
+  int hits = 0;
+  for (int i = 0; i < n; ++i) {
+    if (v[i] == x) ++hits;
+  }
+  for (int i = 0; i < n; ++i)
+    hits += v[i];
+  return hits;
+}
+)";
+
+  std::string out = rewrite(code);
+  // The counter's block closes after the body, braced or not
+  const char *counter = "  { optiweave::LoopTripCounter "
+                        "__optiweave_trips(__optiweave_site(3)); ";
+  EXPECT_NE(out.find(std::string(counter) +
+                     "for (int i = 0; i < n; ++i) { "
+                     "__optiweave_trips.step(); {\n"
+                     "    if (v[i] == x) ++hits;\n"
+                     "  } } }\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find(std::string(counter) +
+                     "for (int i = 0; i < n; ++i) { "
+                     "__optiweave_trips.step();\n"
+                     "    hits += v[i]; } }\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.loops_instrumented, 2u);
+}
+
+TEST_F(RewriteTest, FunctionProbes) {
+  config_.transform_array_subscripts = false;
+  config_.probe_functions = true;
+
+  std::string code = R"(
+struct Counter {
+  int n;
+  Counter() : n(0) {}
+  int next() { return ++n; }
+};
+constexpr int twice(int x) { return 2 * x; }
+int main() {
+  auto add = [](int a) { return a + 1; };
+  return Counter().next() + add(twice(1));
+}
+)";
+
+  std::string out = rewrite(code);
+  // Probes go after member initializers; constexpr functions and lambdas
+  // are left as written
+  EXPECT_NE(out.find("  Counter() : n(0) { __optiweave_probe(3);}\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("  int next() { __optiweave_probe(7); return ++n; }\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("int main() { __optiweave_probe(5);\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("constexpr int twice(int x) { return 2 * x; }\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("  auto add = [](int a) { return a + 1; };\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.functions_probed, 3u);
+}
+
+TEST_F(RewriteTest, AllocationSites) {
+  config_.transform_array_subscripts = false;
+  config_.track_allocations = true;
+
+  std::string code = R"(
+extern "C" void *malloc(unsigned long);
+extern "C" void free(void *);
+struct Node { int value; };
+void churn(int n) {
+  for (int i = 0; i < n; ++i) {
+    Node *node = new Node{i};
+    delete node;
+  }
+  int *buffer = new int[n];
+  void *raw = malloc(64);
+  free(raw);
+  delete[] buffer;
+}
+)";
+
+  std::string out = rewrite(code);
+  // Sites inside loops carry their depth; array news wrap only the count
+  EXPECT_NE(out.find("    Node *node = optiweave::track_new(new Node{i}, "
+                     "__optiweave_site_loop(18, 1));\n"
+                     "    delete optiweave::track_delete(node, "
+                     "__optiweave_site_loop(5, 1));\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("  int *buffer = new int[optiweave::track_new_array(n, "
+                     "4, __optiweave_site(17))];\n"
+                     "  void *raw = optiweave::traced_malloc(64, "
+                     "__optiweave_site(15));\n"
+                     "  optiweave::traced_free(raw, __optiweave_site(3));\n"
+                     "  delete[] optiweave::track_delete(buffer, "
+                     "__optiweave_site(3));\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.allocations_instrumented, 6u);
+}
+
+TEST_F(RewriteTest, GrowthTrackersAndReserves) {
+  ProfileFile profile(
+      "file\tline\tcolumn\tfunction\tinstances\treallocations\tmean_size\t"
+      "min\tmedian\tp90\tmax\tstable\treserve\n"
+      "/build/transformed/input.cc\t10\t20\tfill\t1\t7\t100.0\t100\t100\t"
+      "100\t100\t1\t100\n");
+  auto advice = std::make_shared<ReserveAdviceTable>();
+  std::string error;
+  ASSERT_TRUE(advice->load(profile.path(), error)) << error;
+  config_.reserve_advice = advice;
+  config_.transform_array_subscripts = false;
+  config_.profile_container_growth = true;
+
+  std::string code = R"(
+namespace std {
+template <class T> struct vector {
+  void push_back(const T &);
+  void reserve(unsigned long);
+};
+} // namespace std
+
+void fill(int n) {
+  std::vector<int> squares;
+  for (int i = 0; i < n; ++i)
+    squares.push_back(i * i);
+}
+)";
+
+  std::string out = rewrite(code);
+  // The reserve comes before the tracker, which starts from its capacity
+  EXPECT_NE(out.find("  std::vector<int> squares; squares.reserve(100); "
+                     "optiweave::GrowthTracker __optiweave_growth_squares("
+                     "squares, __optiweave_site(20));\n"),
+            std::string::npos)
+      << out;
+  EXPECT_NE(out.find("    __optiweave_growth_squares.observe(squares)->"
+                     "push_back(i * i);\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.reserves_inserted, 1u);
+  EXPECT_EQ(stats_.growth_calls_instrumented, 1u);
+}
+
+TEST_F(RewriteTest, ExpensiveCopies) {
+  config_.transform_array_subscripts = false;
+  config_.track_copies = true;
+
+  std::string code = R"(
+struct Matrix { double cells[16]; };
+struct Point { int x, y; };
+void keep(Matrix m);
+Point use(const Matrix &source, Point p) {
+  Matrix copy = source;
+  copy = source;
+  Matrix last = copy;
+  keep(last);
+  Point q = p;
+  return q;
+}
+)";
+
+  std::string out = rewrite(code);
+  // Locals read for the last time are flagged as std::move candidates;
+  // copies below the threshold are left alone
+  EXPECT_NE(out.find("  Matrix copy = optiweave::track_copy(source, "
+                     "__optiweave_site(17));\n"
+                     "  copy = optiweave::track_copy_assignment(source, "
+                     "__optiweave_site(10));\n"
+                     "  Matrix last = optiweave::track_copy(copy, "
+                     "__optiweave_site_last_use(17));\n"
+                     "  keep(optiweave::track_copy(last, "
+                     "__optiweave_site_last_use(8)));\n"
+                     "  Point q = p;\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.copies_instrumented, 4u);
+}
+
+TEST_F(RewriteTest, ReceiverGuards) {
+  ProfileFile profile(
+      "file\tline\tcolumn\tfunction\tstatic_type\tcalls\tshape\tdominant\t"
+      "dominant_share\treceivers\n"
+      "/build/transformed/input.cc\t11\t10\ttotal\tShape\t1000\tbimorphic\t"
+      "Circle\t0.950\tCircle:950,Square:50\n");
+  auto receivers = std::make_shared<ReceiverProfileTable>();
+  std::string error;
+  ASSERT_TRUE(receivers->load(profile.path(), error)) << error;
+  config_.receiver_profile = receivers;
+  config_.transform_array_subscripts = false;
+  config_.profile_virtual_calls = true;
+
+  std::string code = R"(
+struct Shape {
+  virtual ~Shape() = default;
+  virtual double area() const = 0;
+};
+struct Circle : Shape {
+  double r = 1;
+  double area() const override { return 3 * r * r; }
+};
+double total(const Shape *shape, const Shape &other) {
+  return shape->area() + other.area();
+}
+)";
+
+  std::string out = rewrite(code);
+  // The profiled call gets a guarded direct call; the other is profiled
+  EXPECT_NE(out.find("  return (typeid((*shape)) == typeid(Circle) ? "
+                     "static_cast<const Circle &>((*shape)).Circle::area() : "
+                     "shape->area()) + optiweave::track_receiver(other, "
+                     "__optiweave_site(26), __optiweave_site_slot())"
+                     ".area();\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.virtual_calls_guarded, 1u);
+  EXPECT_EQ(stats_.virtual_calls_instrumented, 1u);
+}
+
+TEST_F(RewriteTest, HashLookups) {
+  config_.transform_array_subscripts = false;
+  config_.profile_hash_lookups = true;
+
+  std::string code = R"(
+namespace std {
+template <class K, class V> struct unordered_map {
+  V &operator[](const K &);
+  unsigned long count(const K &) const;
+};
+template <class K, class V> struct unordered_multimap {
+  unsigned long count(const K &) const;
+};
+} // namespace std
+
+unsigned long lookups(std::unordered_map<int, int> &index,
+                      std::unordered_multimap<int, int> &all, int key) {
+  index[key] = 1;
+  return index.count(key) + all.count(key);
+}
+)";
+
+  std::string out = rewrite(code);
+  // Multi containers have no single chain per key and are not probed
+  EXPECT_NE(out.find("  (*optiweave::track_hash(index, __optiweave_site(3), "
+                     "__optiweave_site_slot(), key))[key] = 1;\n"
+                     "  return optiweave::track_hash(index, "
+                     "__optiweave_site(10), __optiweave_site_slot(), key)->"
+                     "count(key) + all.count(key);\n"),
+            std::string::npos)
+      << out;
+  EXPECT_EQ(stats_.hash_lookups_instrumented, 2u);
+}
@@ -0,0 +1,35 @@
+#include "optiweave/core/branch_profile.hpp"
+#include "unit/profile_file.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+
+using optiweave::core::BranchProfile;
+using optiweave::core::BranchProfileTable;
+
+TEST(BranchProfileTest, BiasNeedsThresholdAndEnoughEvaluations) {
+  EXPECT_EQ((BranchProfile{990, 10}).bias(0.9), 1);
+  EXPECT_EQ((BranchProfile{10, 990}).bias(0.9), -1);
+  EXPECT_EQ((BranchProfile{600, 400}).bias(0.9), 0);
+  EXPECT_EQ((BranchProfile{950, 50}).bias(0.99), 0);
+  // Too few evaluations to trust, however lopsided
+  EXPECT_EQ((BranchProfile{20, 0}).bias(0.9), 0);
+}
+
+TEST(BranchProfileTableTest, SumsOutcomesOfInstantiations) {
+  ProfileFile file(
+      "file\tline\tcolumn\tfunction\toperation\ttrue\tfalse\ttrue_share\n"
+      "/build/transformed/search.cpp\t40\t9\tfind<int>\tlt\t900\t10\t0.989\n"
+      "/build/transformed/search.cpp\t40\t9\tfind<long>\tlt\t90\t0\t1.000\n");
+
+  BranchProfileTable table;
+  std::string error;
+  ASSERT_TRUE(table.load(file.path(), error)) << error;
+  EXPECT_EQ(table.size(), 1u);
+
+  const BranchProfile *profile = table.find("src/search.cpp", 40, 9);
+  ASSERT_NE(profile, nullptr);
+  EXPECT_EQ(profile->true_count, 990u);
+  EXPECT_EQ(profile->false_count, 10u);
+  EXPECT_EQ(profile->bias(0.9), 1);
+}
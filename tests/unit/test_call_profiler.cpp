@@ -0,0 +1,78 @@
+#include "optiweave/runtime/call_profiler.hpp"
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+using namespace optiweave::runtime;
+
+namespace {
+const __optiweave_site_info kMain{"app.cpp", "int main()", 1, 5, 0, nullptr};
+const __optiweave_site_info kParse{"app.cpp", "void parse()", 9, 6, 0,
+                                   nullptr};
+const __optiweave_site_info kLex{"app.cpp", "int lex()", 20, 5, 0, nullptr};
+} // namespace
+
+TEST(CallProfilerTest, FoldsInclusiveAndExclusiveTimePerPath) {
+  CallTree tree;
+  tree.enter(&kMain, 0);
+  tree.enter(&kParse, 10);
+  tree.enter(&kLex, 20);
+  tree.exit(50); // lex: 30
+  tree.enter(&kLex, 60);
+  tree.exit(70); // lex: 10
+  tree.exit(100); // parse: 90
+  tree.enter(&kLex, 110);
+  tree.exit(115); // lex directly under main: 5
+  tree.exit(200); // main: 200
+
+  // main, main;parse, main;parse;lex, main;lex
+  EXPECT_EQ(tree.size(), 5u);
+
+  std::map<std::string, CallPathTotals> paths;
+  foldCallTree(tree, paths);
+  ASSERT_EQ(paths.size(), 4u);
+
+  const CallPathTotals &top = paths["int main()"];
+  EXPECT_EQ(top.calls, 1u);
+  EXPECT_EQ(top.inclusive_cycles, 200u);
+  EXPECT_EQ(top.exclusive_cycles, 105u);
+
+  const CallPathTotals &parse = paths["int main();void parse()"];
+  EXPECT_EQ(parse.inclusive_cycles, 90u);
+  EXPECT_EQ(parse.exclusive_cycles, 50u);
+
+  const CallPathTotals &lex = paths["int main();void parse();int lex()"];
+  EXPECT_EQ(lex.calls, 2u);
+  EXPECT_EQ(lex.inclusive_cycles, 40u);
+  EXPECT_EQ(lex.exclusive_cycles, 40u);
+
+  EXPECT_EQ(paths["int main();int lex()"].inclusive_cycles, 5u);
+}
+
+TEST(CallProfilerTest, StaysBalancedPastTheDepthLimit) {
+  CallTree tree;
+  for (std::uint32_t i = 0; i < CallTree::kMaxDepth + 10; ++i) {
+    tree.enter(&kParse, i);
+  }
+  for (std::uint32_t i = 0; i < CallTree::kMaxDepth + 10; ++i) {
+    tree.exit(10000);
+  }
+  EXPECT_EQ(tree.dropped(), 10u);
+
+  // Back at the root: a new call starts a top-level path
+  tree.enter(&kMain, 20000);
+  tree.exit(20010);
+  std::map<std::string, CallPathTotals> paths;
+  foldCallTree(tree, paths);
+  EXPECT_EQ(paths["int main()"].inclusive_cycles, 10u);
+  EXPECT_EQ(paths["void parse()"].calls, 1u);
+
+  tree.enter(&kLex, 0);
+  tree.unwind();
+  tree.enter(&kMain, 30000);
+  tree.exit(30001);
+  paths.clear();
+  foldCallTree(tree, paths);
+  EXPECT_EQ(paths["int main()"].calls, 2u);
+}
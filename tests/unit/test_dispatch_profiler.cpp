@@ -0,0 +1,78 @@
+#include "optiweave/runtime/dispatch_profiler.hpp"
+#include <gtest/gtest.h>
+
+using namespace optiweave::runtime;
+
+namespace {
+struct Shape {
+  virtual ~Shape() = default;
+};
+struct Circle : Shape {};
+struct Square : Shape {};
+} // namespace
+
+TEST(DispatchProfilerTest, ClassifiesSitesByReceiverTypes) {
+  DispatchProfiler profiler(16);
+  for (int i = 0; i < 100; ++i) {
+    profiler.record(1, &typeid(Circle));
+    profiler.record(2, i % 10 ? &typeid(Circle) : &typeid(Square));
+  }
+
+  DispatchProfile mono;
+  ASSERT_TRUE(profiler.siteProfile(1, mono));
+  EXPECT_EQ(mono.calls, 100u);
+  EXPECT_EQ(mono.shape(), DispatchShape::Monomorphic);
+  ASSERT_EQ(mono.receivers.size(), 1u);
+  EXPECT_EQ(*mono.receivers[0].type, typeid(Circle));
+  EXPECT_DOUBLE_EQ(mono.dominantShare(), 1.0);
+
+  DispatchProfile bi;
+  ASSERT_TRUE(profiler.siteProfile(2, bi));
+  EXPECT_EQ(bi.shape(), DispatchShape::Bimorphic);
+  EXPECT_EQ(*bi.receivers[0].type, typeid(Circle));
+  EXPECT_EQ(bi.receivers[1].count, 10u);
+  EXPECT_DOUBLE_EQ(bi.dominantShare(), 0.9);
+
+  DispatchProfile none;
+  EXPECT_FALSE(profiler.siteProfile(3, none));
+}
+
+TEST(DispatchProfilerTest, CountsTypesBeyondTheCacheAsOverflow) {
+  struct A : Shape {};
+  struct B : Shape {};
+  struct C : Shape {};
+  DispatchProfiler profiler(4);
+  const std::type_info *types[] = {&typeid(Circle), &typeid(Square),
+                                   &typeid(A), &typeid(B), &typeid(C)};
+  for (const std::type_info *type : types) {
+    profiler.record(0, type);
+  }
+
+  DispatchProfile profile;
+  ASSERT_TRUE(profiler.siteProfile(0, profile));
+  EXPECT_EQ(profile.calls, 5u);
+  EXPECT_EQ(profile.receivers.size(), DispatchProfiler::kEntries);
+  EXPECT_EQ(profile.overflow, 1u);
+  EXPECT_EQ(profile.shape(), DispatchShape::Megamorphic);
+}
+
+TEST(DispatchProfilerTest, MergesPerThreadCaches) {
+  DispatchProfiler profiler(4);
+  // Two threads' caches: the second saw a type the first did not
+  profiler.record(0, &typeid(Circle), 70);
+  profiler.record(0, &typeid(Circle), 20);
+  profiler.record(0, &typeid(Square), 10);
+  profiler.recordOverflow(0, 5);
+  profiler.recordOverflow(1, 0);
+
+  DispatchProfile profile;
+  ASSERT_TRUE(profiler.siteProfile(0, profile));
+  EXPECT_EQ(profile.calls, 105u);
+  ASSERT_EQ(profile.receivers.size(), 2u);
+  EXPECT_EQ(profile.receivers[0].count, 90u);
+  EXPECT_EQ(profile.overflow, 5u);
+  EXPECT_EQ(profile.shape(), DispatchShape::Megamorphic);
+
+  DispatchProfile none;
+  EXPECT_FALSE(profiler.siteProfile(1, none));
+}
@@ -0,0 +1,94 @@
+#include "optiweave/runtime/false_sharing.hpp"
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace optiweave::runtime;
+
+namespace {
+constexpr std::uintptr_t kLine = 0x10000040;
+constexpr std::uint64_t kNow = 5000000;
+} // namespace
+
+TEST(FalseSharingTest, FlagsDisjointOffsetsWithAWriter) {
+  FalseSharingDetector detector;
+  // Two counters packed into one line, each bumped by its own thread
+  for (int i = 0; i < 10; ++i) {
+    detector.access(kLine, 8, true, 0, 1, kNow + i);
+    detector.access(kLine + 8, 8, true, 1, 2, kNow + i);
+  }
+
+  std::vector<FalseSharingFinding> findings = detector.findings();
+  ASSERT_EQ(findings.size(), 1u);
+  EXPECT_EQ(findings[0].line, kLine);
+  EXPECT_EQ(findings[0].conflicts, 19u);
+  EXPECT_EQ(findings[0].true_sharing, 0u);
+  EXPECT_EQ(findings[0].first.thread, 1u);
+  EXPECT_EQ(findings[0].first.site, 2u);
+  EXPECT_EQ(findings[0].first.write_mask, 0xff00u);
+  EXPECT_EQ(findings[0].second.thread, 0u);
+  EXPECT_EQ(findings[0].second.write_mask, 0xffu);
+}
+
+TEST(FalseSharingTest, IgnoresTrueSharingAndReadOnlyLines) {
+  FalseSharingDetector detector;
+  // Same bytes: real communication, not false sharing
+  detector.access(kLine, 8, true, 0, 1, kNow);
+  detector.access(kLine, 8, false, 1, 2, kNow);
+  // Disjoint reads only
+  detector.access(kLine + 64, 8, false, 0, 1, kNow);
+  detector.access(kLine + 72, 8, false, 1, 2, kNow);
+
+  EXPECT_TRUE(detector.findings().empty());
+}
+
+TEST(FalseSharingTest, OnlyAccessesInTheSameWindowConflict) {
+  FalseSharingConfig config;
+  config.window_ns = 1000;
+  FalseSharingDetector detector(config);
+  detector.access(kLine, 8, true, 0, 1, kNow);
+  detector.access(kLine + 8, 8, true, 1, 2, kNow + 5000);
+  EXPECT_TRUE(detector.findings().empty());
+
+  detector.access(kLine, 8, true, 0, 1, kNow + 5001);
+  EXPECT_EQ(detector.findings().size(), 1u);
+}
+
+TEST(FalseSharingTest, SplitsAccessesThatStraddleLines) {
+  FalseSharingDetector detector;
+  detector.access(kLine + 60, 8, true, 0, 1, kNow);
+  detector.access(kLine + 64 + 8, 8, true, 1, 2, kNow);
+  detector.access(kLine + 32, 8, true, 1, 2, kNow);
+
+  std::vector<FalseSharingFinding> findings = detector.findings();
+  ASSERT_EQ(findings.size(), 2u);
+  for (const FalseSharingFinding &finding : findings) {
+    EXPECT_EQ(finding.conflicts, 1u);
+    EXPECT_TRUE(finding.second.write_mask == 0xf000000000000000u ||
+                finding.second.write_mask == 0xfu);
+  }
+}
+
+TEST(FalseSharingTest, ConcurrentThreads) {
+  FalseSharingDetector detector;
+  std::vector<std::thread> threads;
+  for (std::uint32_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 10000; ++i) {
+        detector.access(kLine + 16 * t, 8, true, t, t, kNow);
+        detector.access(kLine + 4096 * (t + 1), 8, true, t, t, kNow);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<FalseSharingFinding> findings = detector.findings();
+  ASSERT_EQ(findings.size(), 1u);
+  EXPECT_EQ(findings[0].line, kLine);
+  EXPECT_GT(findings[0].conflicts, 0u);
+  EXPECT_EQ(detector.droppedAccesses(), 0u);
+}
@@ -0,0 +1,38 @@
+#include "optiweave/runtime/growth_profiler.hpp"
+#include <gtest/gtest.h>
+
+using namespace optiweave::runtime;
+
+TEST(GrowthProfilerTest, RecommendsPeakSizeOfStableSites) {
+  GrowthProfiler profiler(16);
+  for (int i = 0; i < 50; ++i) {
+    profiler.record(1, 1000, 11);
+    profiler.record(2, 100 + i, 8);
+    profiler.record(3, 4, 0);
+  }
+
+  GrowthProfile stable;
+  ASSERT_TRUE(profiler.siteProfile(1, stable));
+  EXPECT_EQ(stable.sizes.executions, 50u);
+  EXPECT_EQ(stable.reallocations, 550u);
+  EXPECT_TRUE(stable.stable());
+  EXPECT_EQ(stable.recommendedReserve(), 1000u);
+
+  // Sizes 100..149 fill buckets [64, 128) and [128, 256); the recommendation
+  // rounds up to the bucket bound but never past the largest size seen
+  GrowthProfile varying;
+  ASSERT_TRUE(profiler.siteProfile(2, varying));
+  EXPECT_FALSE(varying.stable());
+  EXPECT_EQ(varying.sizes.min_trips, 100u);
+  EXPECT_EQ(varying.recommendedReserve(), 149u);
+
+  // Containers that never reallocated gain nothing from reserve()
+  GrowthProfile small;
+  ASSERT_TRUE(profiler.siteProfile(3, small));
+  EXPECT_TRUE(small.stable());
+  EXPECT_EQ(small.recommendedReserve(), 0u);
+
+  GrowthProfile none;
+  EXPECT_FALSE(profiler.siteProfile(4, none));
+  EXPECT_FALSE(profiler.siteProfile(99, none));
+}
@@ -0,0 +1,69 @@
+#include "optiweave/runtime/hash_profiler.hpp"
+#include <gtest/gtest.h>
+
+using namespace optiweave::runtime;
+
+TEST(HashProfilerTest, MergesThreadCounts) {
+  HashProfiler profiler(16);
+  // Two threads' counts: 1000 elements in 1024 buckets, every 64th lookup
+  // sampled its key's bucket, which held the key alone
+  HashSiteProfile first;
+  first.lookups = 640;
+  first.size_sum = 640 * 1000;
+  first.bucket_sum = 640 * 1024;
+  first.max_size = 1000;
+  first.sampled_lookups = 10;
+  first.sampled_chain = 10;
+  HashSiteProfile second = first;
+  second.lookups = 361;
+  second.size_sum = 360 * 1000 + 1001;
+  second.bucket_sum = 360 * 1024 + 2048;
+  second.max_size = 1001;
+  second.rehashes = 1;
+  second.sampled_lookups = 6;
+  second.sampled_chain = 6;
+  profiler.record(1, first);
+  profiler.record(1, second);
+  profiler.record(1, HashSiteProfile{});
+
+  HashSiteProfile profile;
+  ASSERT_TRUE(profiler.siteProfile(1, profile));
+  EXPECT_EQ(profile.lookups, 1001u);
+  EXPECT_EQ(profile.rehashes, 1u);
+  EXPECT_EQ(profile.max_size, 1001u);
+  EXPECT_NEAR(profile.meanLoadFactor(), 0.97, 0.01);
+  EXPECT_DOUBLE_EQ(profile.chainLength(), 1.0);
+  EXPECT_EQ(adviseHashSite(profile), HashAdvice::Fine);
+
+  HashSiteProfile none;
+  EXPECT_FALSE(profiler.siteProfile(2, none));
+  EXPECT_FALSE(profiler.siteProfile(99, none));
+}
+
+TEST(HashProfilerTest, AdvisesFromChainsGrowthAndSize) {
+  HashSiteProfile clustered;
+  clustered.lookups = 100;
+  clustered.size_sum = 100 * 1000;
+  clustered.bucket_sum = 100 * 1024;
+  clustered.max_size = 1000;
+  // Every sampled lookup walked a chain of 32
+  clustered.sampled_lookups = 100;
+  clustered.sampled_chain = 32 * 100;
+  clustered.rehashes = 5;
+  EXPECT_EQ(adviseHashSite(clustered), HashAdvice::BetterHash);
+
+  HashSiteProfile growing = clustered;
+  growing.sampled_chain = growing.sampled_lookups;
+  EXPECT_EQ(adviseHashSite(growing), HashAdvice::Reserve);
+
+  HashSiteProfile small = growing;
+  small.rehashes = 0;
+  small.max_size = 12;
+  EXPECT_EQ(adviseHashSite(small), HashAdvice::FlatMap);
+
+  // Too few samples say nothing about the hash
+  HashSiteProfile unsampled = clustered;
+  unsampled.sampled_lookups = 10;
+  unsampled.sampled_chain = 32 * 10;
+  EXPECT_EQ(adviseHashSite(unsampled), HashAdvice::Reserve);
+}
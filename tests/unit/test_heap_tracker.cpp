@@ -0,0 +1,200 @@
+#include "optiweave/runtime/heap_tracker.hpp"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace optiweave::runtime;
+
+namespace {
+// The tracker never dereferences tracked memory, so synthetic addresses
+// keep these tests independent of the real heap
+constexpr std::uintptr_t kBase = 0x10000000;
+constexpr std::uintptr_t kPage = 4096;
+
+const void *at(std::uintptr_t address) {
+  return reinterpret_cast<const void *>(address);
+}
+
+const void *siteA() { return at(0x401000); }
+const void *siteB() { return at(0x402000); }
+} // namespace
+
+class HeapTrackerTest : public ::testing::Test {
+protected:
+  std::unique_ptr<HeapTracker> tracker_ = std::make_unique<HeapTracker>();
+};
+
+TEST_F(HeapTrackerTest, FindsSmallAllocationsIncludingPageSpill) {
+  // 64 bytes starting 32 bytes before a page boundary
+  std::uintptr_t base = kBase + kPage - 32;
+  ASSERT_TRUE(tracker_->onAllocate(at(base), 64, siteA()));
+  ASSERT_TRUE(tracker_->onAllocate(at(base + 64), 16, siteB()));
+
+  HeapAllocation found;
+  ASSERT_TRUE(tracker_->find(base, found));
+  EXPECT_EQ(found.base, base);
+  EXPECT_EQ(found.size, 64u);
+  EXPECT_EQ(found.site, reinterpret_cast<std::uintptr_t>(siteA()));
+
+  // Spilled onto the next page
+  ASSERT_TRUE(tracker_->find(base + 40, found));
+  EXPECT_EQ(found.base, base);
+
+  ASSERT_TRUE(tracker_->find(base + 70, found));
+  EXPECT_EQ(found.size, 16u);
+
+  EXPECT_FALSE(tracker_->find(base - 1, found));
+  EXPECT_FALSE(tracker_->find(base + 80, found));
+}
+
+TEST_F(HeapTrackerTest, LargeAllocationsSpanLeavesAndShareEdgePages) {
+  // Crosses a 16 MiB leaf boundary
+  std::uintptr_t first = kBase + (16u << 20) - 3 * kPage - 100;
+  std::size_t first_size = 8 * kPage;
+  std::uintptr_t second = first + first_size; // starts on first's last page
+  ASSERT_TRUE(tracker_->onAllocate(at(first), first_size, siteA()));
+  ASSERT_TRUE(tracker_->onAllocate(at(second), 3 * kPage, siteB()));
+
+  HeapAllocation found;
+  for (std::uintptr_t offset = 0; offset < first_size; offset += 997) {
+    ASSERT_TRUE(tracker_->find(first + offset, found)) << offset;
+    EXPECT_EQ(found.base, first);
+  }
+  ASSERT_TRUE(tracker_->find(second, found));
+  EXPECT_EQ(found.base, second);
+  ASSERT_TRUE(tracker_->find(second - 1, found));
+  EXPECT_EQ(found.base, first);
+
+  tracker_->onFree(at(first));
+  EXPECT_FALSE(tracker_->find(first + kPage, found));
+  EXPECT_FALSE(tracker_->find(second - 1, found));
+  ASSERT_TRUE(tracker_->find(second + 10, found));
+  EXPECT_EQ(found.base, second);
+  EXPECT_EQ(tracker_->liveAllocations(), 1u);
+}
+
+TEST_F(HeapTrackerTest, CountsAccessesAndFoldsThemIntoSitesOnFree) {
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase), 256, siteA()));
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase + 1024), 256, siteB()));
+
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(tracker_->recordAccess(kBase + 8 * i));
+  }
+  EXPECT_TRUE(tracker_->recordAccess(kBase + 1024));
+  EXPECT_FALSE(tracker_->recordAccess(kBase + 512));
+
+  auto hottest = tracker_->hottestAllocations(1);
+  ASSERT_EQ(hottest.size(), 1u);
+  EXPECT_EQ(hottest[0].first.base, kBase);
+  EXPECT_EQ(hottest[0].second, 10u);
+
+  tracker_->onFree(at(kBase));
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase), 128, siteA()));
+
+  std::vector<HeapSiteStats> sites = tracker_->siteStats();
+  ASSERT_EQ(sites.size(), 2u);
+  EXPECT_EQ(sites[0].site, reinterpret_cast<std::uintptr_t>(siteA()));
+  EXPECT_EQ(sites[0].allocations, 2u);
+  EXPECT_EQ(sites[0].bytes, 384u);
+  EXPECT_EQ(sites[0].live_allocations, 1u);
+  EXPECT_EQ(sites[0].accesses, 10u);
+  EXPECT_EQ(sites[1].accesses, 1u);
+}
+
+TEST_F(HeapTrackerTest, RecycledRecordsGetANewGeneration) {
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase), 64, siteA()));
+  HeapAllocation old_allocation;
+  ASSERT_TRUE(tracker_->find(kBase, old_allocation));
+  tracker_->countAccess(old_allocation);
+  tracker_->onFree(at(kBase));
+
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase + 4 * kPage), 64, siteA()));
+  HeapAllocation fresh;
+  ASSERT_TRUE(tracker_->find(kBase + 4 * kPage, fresh));
+  EXPECT_EQ(fresh.id, old_allocation.id);
+  EXPECT_NE(fresh.generation, old_allocation.generation);
+  EXPECT_EQ(tracker_->accessCount(old_allocation), 0u);
+}
+
+TEST_F(HeapTrackerTest, ChecksBoundsAgainstThePointersAllocation) {
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase), 40, siteA()));
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase + 48), 40, siteB()));
+
+  HeapAllocation cache;
+  EXPECT_EQ(tracker_->checkBounds(kBase, kBase + 32, 8, cache),
+            BoundsStatus::InBounds);
+  EXPECT_EQ(cache.base, kBase);
+
+  // Lands in the neighbouring allocation, but is still a violation of the
+  // one the pointer came from
+  EXPECT_EQ(tracker_->checkBounds(kBase, kBase + 48, 8, cache),
+            BoundsStatus::OutOfBounds);
+  EXPECT_EQ(tracker_->checkBounds(kBase, kBase + 36, 8, cache),
+            BoundsStatus::OutOfBounds);
+  EXPECT_EQ(tracker_->checkBounds(kBase + 8, kBase - 8, 8, cache),
+            BoundsStatus::OutOfBounds);
+
+  EXPECT_EQ(tracker_->checkBounds(kBase + 4 * kPage, kBase + 4 * kPage, 8,
+                                  cache),
+            BoundsStatus::Untracked);
+
+  // A stale cache entry is not trusted after the allocation goes away
+  EXPECT_EQ(tracker_->checkBounds(kBase + 56, kBase + 80, 8, cache),
+            BoundsStatus::InBounds);
+  tracker_->onFree(at(kBase + 48));
+  ASSERT_TRUE(tracker_->onAllocate(at(kBase + 48), 16, siteA()));
+  EXPECT_EQ(tracker_->checkBounds(kBase + 56, kBase + 80, 8, cache),
+            BoundsStatus::OutOfBounds);
+  EXPECT_EQ(cache.size, 16u);
+}
+
+TEST_F(HeapTrackerTest, ConcurrentAllocationAndLookup) {
+  constexpr int kThreads = 4;
+  constexpr int kRounds = 2000;
+  std::atomic<bool> failed{false};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      // Each thread churns its own region; neighbours share leaves
+      std::uintptr_t region = kBase + static_cast<std::uintptr_t>(t) * 64 * kPage;
+      for (int round = 0; round < kRounds; ++round) {
+        std::uintptr_t base = region + (round % 32) * 96;
+        std::size_t size = round % 5 == 0 ? 3 * kPage : 80;
+        if (!tracker_->onAllocate(at(base), size, siteA())) {
+          failed = true;
+        }
+        HeapAllocation found;
+        if (!tracker_->find(base + size - 1, found) || found.base != base) {
+          failed = true;
+        }
+        tracker_->onFree(at(base));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(failed);
+  EXPECT_EQ(tracker_->liveAllocations(), 0u);
+}
+
+#if defined(OPTIWEAVE_TEST_HEAP_INTERPOSE)
+TEST(HeapInterposeTest, TracksRealAllocations) {
+  HeapTracker &global = HeapTracker::global();
+  ASSERT_TRUE(global.enabled());
+
+  auto *values = new int[1000];
+  HeapAllocation found;
+  ASSERT_TRUE(global.find(reinterpret_cast<std::uintptr_t>(values + 500), found));
+  EXPECT_EQ(found.base, reinterpret_cast<std::uintptr_t>(values));
+  EXPECT_EQ(found.size, 1000 * sizeof(int));
+  delete[] values;
+  EXPECT_FALSE(global.find(reinterpret_cast<std::uintptr_t>(values + 500), found) &&
+               found.base == reinterpret_cast<std::uintptr_t>(values));
+}
+#endif
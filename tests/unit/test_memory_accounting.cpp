@@ -0,0 +1,62 @@
+#include "optiweave/core/memory_accounting.hpp"
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+#include <utility>
+
+using optiweave::core::AccountingAllocator;
+using optiweave::core::formatBytes;
+using optiweave::core::MemoryAccount;
+using optiweave::core::MemoryPeak;
+using optiweave::core::MemoryReport;
+
+TEST(MemoryAccountingTest, AllocatorChargesAndReleasesTheAccount) {
+  using Range = std::pair<unsigned, unsigned>;
+  MemoryAccount account;
+  {
+    std::set<Range, std::less<Range>, AccountingAllocator<Range>> ranges{
+        AccountingAllocator<Range>(account)};
+    for (unsigned i = 0; i < 100; ++i) {
+      ranges.insert({i, i + 1});
+    }
+    // One node per element, each at least as large as the element
+    EXPECT_EQ(account.allocations, 100u);
+    EXPECT_GE(account.bytes, 100 * sizeof(Range));
+    std::size_t full = account.bytes;
+
+    ranges.erase(ranges.begin());
+    EXPECT_EQ(account.allocations, 99u);
+    EXPECT_LT(account.bytes, full);
+    EXPECT_EQ(account.peak_bytes, full);
+  }
+  EXPECT_EQ(account.bytes, 0u);
+  EXPECT_EQ(account.allocations, 0u);
+}
+
+TEST(MemoryAccountingTest, ReportTotalsAndFormatsEntries) {
+  MemoryReport report;
+  report.add("AST", 3 * 1024 * 1024);
+  report.add("Processed ranges", 2048, 40, "ranges");
+  EXPECT_EQ(report.totalBytes(), 3u * 1024 * 1024 + 2048);
+  EXPECT_EQ(report.format(), "  AST: 3.0 MiB\n"
+                             "  Processed ranges: 2.0 KiB (40 ranges)\n"
+                             "  Total: 3.0 MiB\n");
+  EXPECT_EQ(formatBytes(512), "512 B");
+}
+
+TEST(MemoryAccountingTest, PeakKeepsTheLargestUsePerSubsystem) {
+  MemoryReport small;
+  small.add("AST", 1024);
+  small.add("Rewrite buffers", 8192, 1, "files");
+  MemoryReport large;
+  large.add("AST", 4096);
+  large.add("Rewrite buffers", 100, 1, "files");
+
+  MemoryPeak peak;
+  peak.record("a.cpp", small);
+  peak.record("b.cpp", large);
+  EXPECT_EQ(peak.format(), "  AST: 4.0 KiB (b.cpp)\n"
+                           "  Rewrite buffers: 8.0 KiB (a.cpp)\n"
+                           "  Largest translation unit: a.cpp, 9.0 KiB\n");
+}
@@ -0,0 +1,91 @@
+#include "optiweave/core/prefetch_advice.hpp"
+#include "optiweave/runtime/stride_profiler.hpp"
+#include "unit/profile_file.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+
+using namespace optiweave;
+using runtime::PrefetchAdviceConfig;
+using runtime::SiteStrideProfile;
+using runtime::StrideCursor;
+using runtime::StrideProfiler;
+
+namespace {
+constexpr std::uintptr_t kBase = 0x10000000;
+} // namespace
+
+TEST(StrideProfilerTest, FindsTheDominantStride) {
+  StrideProfiler profiler(16);
+  StrideCursor cursors[StrideProfiler::kCursors];
+
+  // Site 3 walks a column of 4160-byte rows, site 5 a row of doubles,
+  // interleaved as in a loop body
+  for (std::uint64_t i = 0; i < 5000; ++i) {
+    profiler.access(cursors, 3, kBase + i * 4160, i * 20);
+    profiler.access(cursors, 5, kBase + (1u << 30) + i * 8, i * 20 + 10);
+  }
+
+  SiteStrideProfile column;
+  ASSERT_TRUE(profiler.siteProfile(3, column));
+  EXPECT_EQ(column.accesses, 5000u);
+  EXPECT_EQ(column.stride, 4160);
+  EXPECT_GT(column.regularFraction(), 0.99);
+  EXPECT_EQ(column.new_lines, 4999u);
+  EXPECT_DOUBLE_EQ(column.nsPerAccess(), 20.0);
+
+  SiteStrideProfile row;
+  ASSERT_TRUE(profiler.siteProfile(5, row));
+  EXPECT_EQ(row.stride, 8);
+  EXPECT_LT(row.new_lines, row.accesses / 4);
+
+  SiteStrideProfile none;
+  EXPECT_FALSE(profiler.siteProfile(4, none));
+}
+
+TEST(StrideProfilerTest, RecommendsOnlyLineCrossingRegularStreams) {
+  PrefetchAdviceConfig config;
+  config.latency_ns = 300;
+
+  SiteStrideProfile column{5000, 4990, 4999, 4160, 5000 * 20, 5000};
+  std::uint32_t distance = 0;
+  ASSERT_TRUE(runtime::recommendPrefetch(column, config, -1, distance));
+  EXPECT_EQ(distance, 15u);
+
+  // Cache-friendly according to the miss-ratio curve
+  EXPECT_FALSE(runtime::recommendPrefetch(column, config, 0.01, distance));
+
+  SiteStrideProfile row{5000, 4990, 600, 8, 5000 * 20, 5000};
+  EXPECT_FALSE(runtime::recommendPrefetch(row, config, -1, distance));
+
+  SiteStrideProfile irregular{5000, 500, 4999, 4160, 5000 * 20, 5000};
+  EXPECT_FALSE(runtime::recommendPrefetch(irregular, config, -1, distance));
+}
+
+TEST(PrefetchAdviceTableTest, LoadsStrideAndDistance) {
+  ProfileFile file(
+      "file\tline\tcolumn\tfunction\tstride_bytes\tdistance\taccesses\t"
+      "regular\tns_per_access\tmiss_ratio\n"
+      "/build/transformed/kernel.cpp\t12\t14\tgather\t4160\t16\t5000\t"
+      "0.998\t20.0\t-1.000\n");
+
+  core::PrefetchAdviceTable table;
+  std::string error;
+  ASSERT_TRUE(table.load(file.path(), error)) << error;
+  EXPECT_EQ(table.size(), 1u);
+
+  const core::PrefetchAdvice *advice = table.find("src/kernel.cpp", 12, 14);
+  ASSERT_NE(advice, nullptr);
+  EXPECT_EQ(advice->stride_bytes, 4160);
+  EXPECT_EQ(advice->distance, 16u);
+  EXPECT_EQ(table.find("src/kernel.cpp", 12, 15), nullptr);
+}
+
+TEST(PrefetchAdviceTableTest, RejectsZeroStrideOrDistance) {
+  ProfileFile file("file\tline\tcolumn\tfunction\tstride_bytes\tdistance\n"
+                   "kernel.cpp\t12\t14\tgather\t0\t16\n");
+  core::PrefetchAdviceTable table;
+  std::string error;
+  EXPECT_FALSE(table.load(file.path(), error));
+  EXPECT_EQ(error, file.path() + ":2: zero stride or distance");
+}
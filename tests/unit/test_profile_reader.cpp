@@ -0,0 +1,73 @@
+#include "optiweave/core/profile_reader.hpp"
+#include "unit/profile_file.hpp"
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using optiweave::core::makeProfileSite;
+using optiweave::core::ProfileRow;
+using optiweave::core::ProfileSite;
+using optiweave::core::readProfile;
+
+TEST(ProfileReaderTest, KeysSitesByFileName) {
+  EXPECT_EQ(makeProfileSite("/build/transformed/kernel.cpp", 12, 14),
+            ProfileSite("kernel.cpp", 12, 14));
+  EXPECT_EQ(makeProfileSite("C:\\src\\kernel.cpp", 12, 14),
+            ProfileSite("kernel.cpp", 12, 14));
+  EXPECT_EQ(makeProfileSite("kernel.cpp", 12, 14),
+            makeProfileSite("src/kernel.cpp", 12, 14));
+}
+
+TEST(ProfileReaderTest, SkipsHeaderAndEmptyLines) {
+  ProfileFile file("file\tline\tcolumn\tvalue\n"
+                   "/build/transformed/kernel.cpp\t12\t14\t4160\n"
+                   "\n"
+                   "kernel.cpp\t13\t2\t8\n");
+  std::vector<ProfileRow> rows;
+  std::string error;
+  ASSERT_TRUE(readProfile(
+      file.path(), 4, [&](const ProfileRow &row) { rows.push_back(row); },
+      error))
+      << error;
+  ASSERT_EQ(rows.size(), 2u);
+  EXPECT_EQ(rows[0].site, ProfileSite("kernel.cpp", 12, 14));
+  EXPECT_EQ(rows[0].fields.size(), 4u);
+  EXPECT_EQ(rows[0].fields[3], "4160");
+  EXPECT_EQ(rows[1].site, ProfileSite("kernel.cpp", 13, 2));
+}
+
+TEST(ProfileReaderTest, ReportsTheLineOfABadRow) {
+  auto fails = [](const std::string &contents, std::size_t min_fields,
+                  const std::string &expected) {
+    ProfileFile file("file\tline\tcolumn\tvalue\n"
+                     "kernel.cpp\t12\t14\t1\n" +
+                     contents);
+    std::string error;
+    EXPECT_FALSE(readProfile(
+        file.path(), min_fields,
+        [](const ProfileRow &row) {
+          if (std::stoi(row.fields[3]) < 0) {
+            throw std::invalid_argument("negative value");
+          }
+        },
+        error));
+    // Conversion errors carry the standard library's own message
+    EXPECT_EQ(error.substr(0, file.path().size() + expected.size()),
+              file.path() + expected);
+  };
+  fails("kernel.cpp\t13\t14\n", 4, ":3: too few fields");
+  fails("kernel.cpp\tnot-a-line\t14\t1\n", 4, ":3: ");
+  fails("\nkernel.cpp\t13\t14\tmany\n", 4, ":4: ");
+  fails("kernel.cpp\t13\t14\t-1\n", 4, ":3: negative value");
+  // The site columns are required whatever the caller asks for
+  fails("kernel.cpp\t13\n", 0, ":3: too few fields");
+}
+
+TEST(ProfileReaderTest, ReportsMissingFiles) {
+  std::string error;
+  EXPECT_FALSE(readProfile(
+      "/nonexistent/profile.tsv", 3, [](const ProfileRow &) {}, error));
+  EXPECT_EQ(error, "cannot open /nonexistent/profile.tsv");
+}
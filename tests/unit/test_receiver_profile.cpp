@@ -0,0 +1,49 @@
+#include "optiweave/core/receiver_profile.hpp"
+#include "unit/profile_file.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+
+using optiweave::core::ReceiverProfile;
+using optiweave::core::ReceiverProfileTable;
+
+TEST(ReceiverProfileTest, GuardNeedsDominantTypeAndEnoughCalls) {
+  EXPECT_TRUE((ReceiverProfile{"Circle", 1000, 950}).guardable(0.9));
+  EXPECT_FALSE((ReceiverProfile{"Circle", 1000, 600}).guardable(0.9));
+  EXPECT_FALSE((ReceiverProfile{"Circle", 50, 50}).guardable(0.9));
+  EXPECT_FALSE((ReceiverProfile{"", 1000, 1000}).guardable(0.9));
+}
+
+TEST(ReceiverProfileTableTest, MergesInstantiationsThatAgree) {
+  ProfileFile file(
+      "file\tline\tcolumn\tfunction\tstatic_type\tcalls\tshape\t"
+      "dominant\tdominant_share\treceivers\n"
+      "/build/transformed/draw.cpp\t17\t14\tdraw<A>\tShape\t1000\t"
+      "bimorphic\tCircle\t0.900\tCircle:900,Square:100\n"
+      "/build/transformed/draw.cpp\t17\t14\tdraw<B>\tShape\t1000\t"
+      "bimorphic\tCircle\t0.800\tCircle:800,Square:200\n"
+      "/build/transformed/draw.cpp\t30\t9\tsum<A>\tNode\t100\t"
+      "monomorphic\tLeaf\t1.000\tLeaf:100\n"
+      "/build/transformed/draw.cpp\t30\t9\tsum<B>\tNode\t100\t"
+      "monomorphic\tBranch\t1.000\tBranch:100\n");
+
+  ReceiverProfileTable table;
+  std::string error;
+  ASSERT_TRUE(table.load(file.path(), error)) << error;
+  EXPECT_EQ(table.size(), 2u);
+
+  // Same dominant type: its calls add up, and the share sets the guard
+  const ReceiverProfile *draw = table.find("src/draw.cpp", 17, 14);
+  ASSERT_NE(draw, nullptr);
+  EXPECT_EQ(draw->dominant, "Circle");
+  EXPECT_EQ(draw->calls, 2000u);
+  EXPECT_EQ(draw->dominant_calls, 1700u);
+  EXPECT_TRUE(draw->guardable(0.85));
+  EXPECT_FALSE(draw->guardable(0.9));
+
+  // Different dominant types: no single guard fits both
+  const ReceiverProfile *sum = table.find("draw.cpp", 30, 9);
+  ASSERT_NE(sum, nullptr);
+  EXPECT_TRUE(sum->dominant.empty());
+  EXPECT_FALSE(sum->guardable(0.5));
+}
@@ -0,0 +1,47 @@
+#include "optiweave/core/reserve_advice.hpp"
+#include "unit/profile_file.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+
+using optiweave::core::ReserveAdvice;
+using optiweave::core::ReserveAdviceTable;
+
+namespace {
+const char *const kHeader = "file\tline\tcolumn\tfunction\tinstances\t"
+                            "reallocations\tmean_size\tmin\tmedian\tp90\t"
+                            "max\tstable\treserve\n";
+} // namespace
+
+TEST(ReserveAdviceTableTest, InstantiationsAtTheSameSizeStayStable) {
+  ProfileFile file(std::string(kHeader) +
+                   "/build/transformed/rows.cpp\t7\t18\trows<int>\t10\t60\t"
+                   "64.0\t64\t64\t64\t64\t1\t64\n"
+                   "/build/transformed/rows.cpp\t7\t18\trows<long>\t10\t60\t"
+                   "64.0\t64\t64\t64\t64\t1\t64\n");
+
+  ReserveAdviceTable table;
+  std::string error;
+  ASSERT_TRUE(table.load(file.path(), error)) << error;
+  const ReserveAdvice *rows = table.find("src/rows.cpp", 7, 18);
+  ASSERT_NE(rows, nullptr);
+  EXPECT_TRUE(rows->stable);
+  EXPECT_EQ(rows->reserve, 64u);
+}
+
+TEST(ReserveAdviceTableTest, InstantiationsAtDifferentSizesAreUnstable) {
+  ProfileFile file(std::string(kHeader) +
+                   "/build/transformed/rows.cpp\t7\t18\trows<int>\t10\t60\t"
+                   "64.0\t64\t64\t64\t64\t1\t64\n"
+                   "/build/transformed/rows.cpp\t7\t18\trows<long>\t10\t70\t"
+                   "128.0\t128\t128\t128\t128\t1\t128\n");
+
+  ReserveAdviceTable table;
+  std::string error;
+  ASSERT_TRUE(table.load(file.path(), error)) << error;
+  // Each instantiation is stable, but at a different size
+  const ReserveAdvice *rows = table.find("rows.cpp", 7, 18);
+  ASSERT_NE(rows, nullptr);
+  EXPECT_FALSE(rows->stable);
+  EXPECT_EQ(rows->reserve, 128u);
+}
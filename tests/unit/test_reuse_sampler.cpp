@@ -0,0 +1,86 @@
+#include "optiweave/runtime/reuse_sampler.hpp"
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+using namespace optiweave::runtime;
+
+namespace {
+constexpr std::uintptr_t kBase = 0x10000000;
+
+/**
+    @brief Sweep `lines` consecutive cache lines `passes` times
+*/
+void cyclicScan(ReuseSampler &sampler, std::uint64_t lines, int passes,
+                SiteId site) {
+  for (int pass = 0; pass < passes; ++pass) {
+    for (std::uint64_t line = 0; line < lines; ++line) {
+      sampler.access(kBase + line * 64, site);
+    }
+  }
+}
+} // namespace
+
+TEST(ReuseSamplerTest, ExactWhenEveryLineIsSampled) {
+  ReuseSamplerConfig config;
+  config.sample_one_in = 1;
+  ReuseSampler sampler(config);
+
+  // Two accesses per line: the second is a reuse at distance 0
+  for (std::uintptr_t line = 0; line < 8; ++line) {
+    sampler.access(kBase + line * 64, 1);
+    sampler.access(kBase + line * 64 + 8, 1);
+  }
+  cyclicScan(sampler, 8, 3, 2);
+
+  ReuseHistogram scan;
+  ASSERT_TRUE(sampler.siteHistogram(2, scan));
+  EXPECT_DOUBLE_EQ(scan.accesses, 24);
+  EXPECT_DOUBLE_EQ(scan.cold, 0);
+  // Each reuse sees the 7 other lines: bucket [4, 8)
+  EXPECT_DOUBLE_EQ(scan.buckets[3], 24);
+  EXPECT_DOUBLE_EQ(scan.missRatio(4), 1.0);
+  EXPECT_DOUBLE_EQ(scan.missRatio(8), 0.0);
+  EXPECT_EQ(scan.linesNeeded(0.01), 8u);
+
+  ReuseHistogram total = sampler.total();
+  EXPECT_DOUBLE_EQ(total.accesses, 40);
+  EXPECT_DOUBLE_EQ(total.cold, 8);
+  EXPECT_DOUBLE_EQ(total.buckets[0], 8);
+  EXPECT_DOUBLE_EQ(total.missRatio(8), 8.0 / 40);
+
+  EXPECT_FALSE(sampler.siteHistogram(3, scan));
+}
+
+TEST(ReuseSamplerTest, SampledEstimatesTrackTheFullStream) {
+  ReuseSamplerConfig config;
+  config.sample_one_in = 10;
+  ReuseSampler sampler(config);
+
+  constexpr std::uint64_t kLines = 20000;
+  cyclicScan(sampler, kLines, 4, 0);
+
+  ReuseHistogram total = sampler.total();
+  EXPECT_NEAR(total.accesses, 4.0 * kLines, 0.1 * 4 * kLines);
+  EXPECT_NEAR(total.cold, kLines, 0.1 * kLines);
+  // Capacity misses all around until the cache holds the whole scan
+  EXPECT_GT(total.missRatio(8192), 0.95);
+  EXPECT_LT(total.missRatio(32768), 0.3);
+  EXPECT_EQ(total.linesNeeded(0.01), 32768u);
+}
+
+TEST(ReuseSamplerTest, BoundedMemoryLowersTheRate) {
+  ReuseSamplerConfig config;
+  config.sample_one_in = 1;
+  config.max_lines = 512;
+  ReuseSampler sampler(config);
+
+  constexpr std::uint64_t kLines = 16384;
+  cyclicScan(sampler, kLines, 3, 0);
+
+  EXPECT_LT(sampler.samplingRate(), 0.05);
+  ReuseHistogram total = sampler.total();
+  EXPECT_NEAR(total.cold, kLines, 0.3 * kLines);
+  EXPECT_GT(total.missRatio(kLines / 4), 0.9);
+  EXPECT_LT(total.missRatio(4 * kLines), 0.5);
+}
@@ -0,0 +1,172 @@
+#include "optiweave/runtime/site_registry.hpp"
+#include "optiweave/runtime/telemetry.hpp"
+#include "optiweave/runtime/thread_registry.hpp"
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace optiweave::runtime;
+
+namespace {
+const char kFile[] = "kernel.cpp";
+const char kFunction[] = "void kernel()";
+const char kSubscript[] = "array_subscript";
+const char kAdd[] = "add";
+} // namespace
+
+class TelemetryTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    name_ = "/optiweave.test." + std::to_string(getpid()) + "." +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name();
+  }
+
+  std::string name_;
+};
+
+TEST(SiteRegistryTest, InternIsStable) {
+  SiteRegistry registry;
+  __optiweave_site_info site{kFile,         kFunction, 10, 5,
+                             __OPTIWEAVE_SITE_WRITE, "i"};
+
+  bool inserted = false;
+  SiteId first = registry.intern(kSubscript, site, &inserted);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(first, 0u);
+
+  SiteId again = registry.intern(kSubscript, site, &inserted);
+  EXPECT_FALSE(inserted);
+  EXPECT_EQ(again, first);
+
+  // Same location, different operation is a different site
+  SiteId other = registry.intern(kAdd, site, &inserted);
+  EXPECT_TRUE(inserted);
+  EXPECT_NE(other, first);
+
+  const SiteRecord *record = registry.get(first);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->line, 10u);
+  EXPECT_EQ(record->column, 5u);
+  EXPECT_EQ(record->flags, __OPTIWEAVE_SITE_WRITE);
+  EXPECT_STREQ(record->type, "i");
+  EXPECT_EQ(registry.size(), 2u);
+}
+
+TEST(SiteRegistryTest, ConcurrentInternAgrees) {
+  SiteRegistry registry;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<SiteId>> ids(4);
+
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (std::uint32_t line = 1; line <= 500; ++line) {
+        __optiweave_site_info site{kFile, kFunction, line, 1, 0, nullptr};
+        ids[t].push_back(registry.intern(kSubscript, site));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(registry.size(), 500u);
+  for (int t = 1; t < 4; ++t) {
+    EXPECT_EQ(ids[t], ids[0]);
+  }
+}
+
+TEST(ThreadRegistryTest, SlotsAreReused) {
+  ThreadRegistry registry;
+  ThreadRecord *first = registry.acquire();
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(first->index, 0u);
+  EXPECT_NE(first->os_tid, 0u);
+
+  registry.release(first);
+  ThreadRecord *second = registry.acquire();
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(registry.highWater(), 1u);
+}
+
+TEST_F(TelemetryTest, PublishAndSnapshot) {
+  TelemetryPublisher publisher;
+  ASSERT_TRUE(publisher.open(name_, 64, 8));
+
+  SiteRegistry registry;
+  __optiweave_site_info site{kFile, kFunction, 42, 7, 0, nullptr};
+  SiteId id = registry.intern(kSubscript, site);
+  publisher.publishSite(id, *registry.get(id));
+  publisher.publishThread(0, 1234, true);
+
+  for (int i = 0; i < 100; ++i) {
+    publisher.recordEvent(id, 0);
+  }
+
+  TelemetryReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.attach(name_, error)) << error;
+
+  TelemetrySnapshot snapshot = reader.snapshot();
+  EXPECT_EQ(snapshot.pid, getpid());
+  ASSERT_EQ(snapshot.sites.size(), 1u);
+  EXPECT_EQ(snapshot.sites[0].count, 100u);
+  EXPECT_EQ(snapshot.sites[0].line, 42u);
+  EXPECT_EQ(snapshot.sites[0].column, 7u);
+  EXPECT_EQ(snapshot.sites[0].operation, kSubscript);
+  EXPECT_EQ(snapshot.sites[0].file, kFile);
+
+  ASSERT_EQ(snapshot.threads.size(), 1u);
+  EXPECT_TRUE(snapshot.threads[0].active);
+  EXPECT_EQ(snapshot.threads[0].os_tid, 1234u);
+  EXPECT_EQ(snapshot.threads[0].events, 100u);
+}
+
+TEST_F(TelemetryTest, OutOfRangeSitesAreCountedAsDropped) {
+  TelemetryPublisher publisher;
+  ASSERT_TRUE(publisher.open(name_, 4, 1));
+  publisher.recordEvent(kInvalidSite, 0);
+
+  TelemetryReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.attach(name_, error)) << error;
+  EXPECT_EQ(reader.snapshot().dropped_events, 1u);
+}
+
+TEST_F(TelemetryTest, SegmentIsUnlinkedOnClose) {
+  {
+    TelemetryPublisher publisher;
+    ASSERT_TRUE(publisher.open(name_, 4, 1));
+  }
+
+  TelemetryReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.attach(name_, error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST_F(TelemetryTest, EventsAfterUnlinkStillLand) {
+  TelemetryPublisher publisher;
+  ASSERT_TRUE(publisher.open(name_, 4, 1));
+
+  TelemetryReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.attach(name_, error)) << error;
+
+  publisher.unlink();
+  EXPECT_TRUE(publisher.isOpen());
+  publisher.recordEvent(kInvalidSite, 0);
+  publisher.publishThread(0, 1, false);
+  EXPECT_EQ(reader.snapshot().dropped_events, 1u);
+
+  TelemetryReader late;
+  EXPECT_FALSE(late.attach(name_, error));
+}
+
+TEST_F(TelemetryTest, RejectsForeignSegments) {
+  TelemetryReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.attach("/optiweave.does-not-exist", error));
+}
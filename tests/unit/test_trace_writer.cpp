@@ -0,0 +1,287 @@
+#include "optiweave/runtime/crash_handler.hpp"
+#include "optiweave/runtime/thread_registry.hpp"
+#include "optiweave/runtime/trace_io.hpp"
+#include "optiweave/runtime/trace_event.hpp"
+#include "optiweave/runtime/trace_writer.hpp"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace optiweave::runtime;
+
+class TraceWriterTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    char pattern[] = "/tmp/optiweave-trace-XXXXXX";
+    ASSERT_NE(mkdtemp(pattern), nullptr);
+    directory_ = pattern;
+  }
+
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  TraceWriterConfig smallConfig() const {
+    TraceWriterConfig config;
+    config.directory = directory_;
+    config.block_bytes = 8192;
+    config.ring_events = 1024;
+    config.flush_interval_ms = 1;
+    return config;
+  }
+
+  std::vector<TraceEvent> readAll(const std::vector<std::string> &paths) {
+    std::vector<TraceEvent> events;
+    for (const std::string &path : paths) {
+      std::string error;
+      EXPECT_TRUE(readTraceSegment(path, events, error)) << error;
+    }
+    return events;
+  }
+
+  std::string directory_;
+};
+
+TEST(EventRingTest, PushDrainWrapsAround) {
+  EventRing *ring = EventRing::create(5);
+  ASSERT_NE(ring, nullptr);
+  EXPECT_EQ(ring->capacity(), 8u);
+
+  TraceEvent out[8];
+  for (std::uint64_t round = 0; round < 3; ++round) {
+    for (std::uint64_t i = 0; i < 6; ++i) {
+      ASSERT_TRUE(ring->tryPush({round * 10 + i, 0, i, 0, 0}));
+    }
+    ASSERT_EQ(ring->drain(out, 8), 6u);
+    for (std::uint64_t i = 0; i < 6; ++i) {
+      EXPECT_EQ(out[i].timestamp_ns, round * 10 + i);
+    }
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_TRUE(ring->tryPush({}));
+  }
+  EXPECT_FALSE(ring->tryPush({}));
+
+  const TraceEvent *first = nullptr;
+  const TraceEvent *second = nullptr;
+  std::size_t first_count = 0;
+  std::size_t second_count = 0;
+  ring->peek(first, first_count, second, second_count);
+  EXPECT_EQ(first_count + second_count, 8u);
+  EXPECT_EQ(ring->size(), 8u);
+}
+
+TEST_F(TraceWriterTest, WritesEveryEventFromEveryThread) {
+  ThreadRegistry threads;
+  TraceWriterConfig config = smallConfig();
+  config.backpressure = BackpressurePolicy::Block;
+  TraceWriter writer(threads, config);
+  ASSERT_TRUE(writer.start());
+
+  constexpr int kThreads = 4;
+  constexpr std::uint64_t kEvents = 20000;
+  std::vector<std::thread> producers;
+  for (int t = 0; t < kThreads; ++t) {
+    producers.emplace_back([&] {
+      ThreadRecord *record = threads.acquire();
+      ASSERT_NE(record, nullptr);
+      for (std::uint64_t i = 0; i < kEvents; ++i) {
+        writer.append(*record, {i, i * 8, i, 7, record->index});
+      }
+      threads.release(record);
+    });
+  }
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  writer.stop();
+
+  TraceWriterStats stats = writer.stats();
+  EXPECT_EQ(stats.events_written, kThreads * kEvents);
+  EXPECT_EQ(stats.events_dropped, 0u);
+  EXPECT_EQ(stats.write_errors, 0u);
+  EXPECT_EQ(stats.bytes_written % kTraceAlignment, 0u);
+
+  std::vector<TraceEvent> events = readAll(writer.segments());
+  ASSERT_EQ(events.size(), kThreads * kEvents);
+
+  // Each thread's events stay in order
+  std::vector<std::uint64_t> next(ThreadRegistry::kMaxThreads, 0);
+  for (const TraceEvent &event : events) {
+    EXPECT_EQ(event.timestamp_ns, next[event.thread]);
+    EXPECT_EQ(event.address, event.index * 8);
+    EXPECT_EQ(event.site, 7u);
+    ++next[event.thread];
+  }
+}
+
+TEST_F(TraceWriterTest, RotatesAndStaysWithinBudget) {
+  ThreadRegistry threads;
+  TraceWriterConfig config = smallConfig();
+  config.backpressure = BackpressurePolicy::Block;
+  config.segment_bytes = 4 * 8192;
+  config.disk_budget_bytes = 8 * 8192;
+  TraceWriter writer(threads, config);
+  ASSERT_TRUE(writer.start());
+
+  ThreadRecord *record = threads.acquire();
+  ASSERT_NE(record, nullptr);
+  for (std::uint64_t i = 0; i < 50000; ++i) {
+    writer.append(*record, {i, 0, 0, 0, record->index});
+  }
+  writer.stop();
+
+  TraceWriterStats stats = writer.stats();
+  EXPECT_GT(stats.segments_opened, 2u);
+  EXPECT_GT(stats.segments_deleted, 0u);
+
+  std::uintmax_t on_disk = 0;
+  std::size_t files = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(directory_)) {
+    on_disk += entry.file_size();
+    ++files;
+  }
+  EXPECT_EQ(files, writer.segments().size());
+  EXPECT_LE(on_disk, config.disk_budget_bytes);
+
+  // What survives is the most recent, contiguous tail of the trace
+  std::vector<TraceEvent> events = readAll(writer.segments());
+  ASSERT_FALSE(events.empty());
+  EXPECT_EQ(events.back().timestamp_ns, 49999u);
+  for (std::size_t i = 1; i < events.size(); ++i) {
+    EXPECT_EQ(events[i].timestamp_ns, events[i - 1].timestamp_ns + 1);
+  }
+  threads.release(record);
+}
+
+TEST_F(TraceWriterTest, DropPolicyCountsLostEvents) {
+  ThreadRegistry threads;
+  TraceWriterConfig config = smallConfig();
+  config.backpressure = BackpressurePolicy::Drop;
+  TraceWriter writer(threads, config);
+
+  // Not started: nothing drains, so the ring cannot even be attached
+  ThreadRecord *record = threads.acquire();
+  ASSERT_NE(record, nullptr);
+  for (int i = 0; i < 100; ++i) {
+    writer.append(*record, {});
+  }
+  EXPECT_EQ(writer.stats().events_dropped, 100u);
+  threads.release(record);
+}
+
+TEST_F(TraceWriterTest, SamplePolicyThinsUnderPressure) {
+  ThreadRegistry threads;
+  TraceWriterConfig config = smallConfig();
+  config.backpressure = BackpressurePolicy::Sample;
+  config.sample_rate = 4;
+  TraceWriter writer(threads, config);
+  ASSERT_TRUE(writer.start());
+
+  ThreadRecord *record = threads.acquire();
+  ASSERT_NE(record, nullptr);
+  for (std::uint64_t i = 0; i < 200000; ++i) {
+    writer.append(*record, {i, 0, 0, 0, record->index});
+  }
+  writer.stop();
+
+  TraceWriterStats stats = writer.stats();
+  EXPECT_EQ(stats.events_written + stats.events_dropped +
+                stats.events_sampled_out,
+            200000u);
+  threads.release(record);
+}
+
+namespace {
+void exitFromAbort(int) { _exit(42); }
+} // namespace
+
+TEST_F(TraceWriterTest, CrashFlushesBufferedEventsAndChains) {
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    // The application's own handler must still run after the flush
+    std::signal(SIGABRT, exitFromAbort);
+
+    ThreadRegistry threads;
+    TraceWriterConfig config = smallConfig();
+    config.flush_interval_ms = 60000;
+    config.backpressure = BackpressurePolicy::Block;
+    config.crash_flush = true;
+    TraceWriter writer(threads, config);
+    if (!writer.start() || !installCrashHandlers(writer)) {
+      _exit(1);
+    }
+    ThreadRecord *record = threads.acquire();
+    enableAltStack(*record);
+    for (std::uint64_t i = 0; i < 3000; ++i) {
+      writer.append(*record, {i, 0, 0, 3, record->index});
+    }
+    std::abort();
+  }
+
+  int status = 0;
+  ASSERT_EQ(waitpid(child, &status, 0), child);
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 42);
+
+  std::string crash =
+      directory_ + "/trace." + std::to_string(child) + ".crash.owt";
+  std::vector<TraceEvent> events;
+  std::string error;
+  ASSERT_TRUE(readTraceSegment(crash, events, error)) << error;
+
+  // Everything not already in the live segment is in the crash file
+  std::vector<bool> seen(3000, false);
+  for (const TraceEvent &event : events) {
+    ASSERT_LT(event.timestamp_ns, 3000u);
+    seen[event.timestamp_ns] = true;
+  }
+  std::string live = directory_ + "/trace." + std::to_string(child) + ".0.owt";
+  std::vector<TraceEvent> written;
+  ASSERT_TRUE(readTraceSegment(live, written, error)) << error;
+  for (const TraceEvent &event : written) {
+    seen[event.timestamp_ns] = true;
+  }
+  EXPECT_EQ(std::count(seen.begin(), seen.end(), false), 0);
+}
+
+TEST_F(TraceWriterTest, CleanStopRemovesCrashFile) {
+  ThreadRegistry threads;
+  TraceWriterConfig config = smallConfig();
+  config.crash_flush = true;
+  TraceWriter writer(threads, config);
+  ASSERT_TRUE(writer.start());
+  EXPECT_TRUE(std::filesystem::exists(writer.crashPath()));
+  writer.stop();
+  EXPECT_FALSE(std::filesystem::exists(writer.crashPath()));
+}
+
+TEST(TraceFormatTest, RejectsForeignFiles) {
+  std::vector<TraceEvent> events;
+  std::string error;
+  EXPECT_FALSE(readTraceSegment("/proc/self/status", events, error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(TraceFormatTest, ParsesPolicyNames) {
+  BackpressurePolicy policy = BackpressurePolicy::Drop;
+  EXPECT_TRUE(parseBackpressurePolicy("block", policy));
+  EXPECT_EQ(policy, BackpressurePolicy::Block);
+  EXPECT_TRUE(parseBackpressurePolicy("sample", policy));
+  EXPECT_STREQ(backpressurePolicyName(policy), "sample");
+  EXPECT_FALSE(parseBackpressurePolicy("fast", policy));
+}
+
+TEST(TraceIoTest, PwriteCanBeForced) {
+  std::unique_ptr<TraceIo> io = TraceIo::create(false);
+  ASSERT_NE(io, nullptr);
+  EXPECT_STREQ(io->name(), "pwrite");
+}
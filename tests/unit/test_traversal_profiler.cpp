@@ -0,0 +1,69 @@
+#include "optiweave/runtime/traversal_profiler.hpp"
+#include <gtest/gtest.h>
+
+using namespace optiweave::runtime;
+
+namespace {
+constexpr std::size_t kRows = 16;
+constexpr std::size_t kColumns = 32;
+const std::size_t kExtents[2] = {kRows, kColumns};
+} // namespace
+
+TEST(TraversalProfilerTest, TellsRowWalksFromColumnWalks) {
+  TraversalProfiler profiler(16);
+  TraversalCursor cursors[TraversalProfiler::kCursors];
+
+  for (std::size_t i = 0; i < kRows; ++i) {
+    for (std::size_t j = 0; j < kColumns; ++j) {
+      const std::size_t indices[2] = {i, j};
+      profiler.access(cursors, 1, 2, indices, kExtents, sizeof(double));
+    }
+  }
+  for (std::size_t j = 0; j < kColumns; ++j) {
+    for (std::size_t i = 0; i < kRows; ++i) {
+      const std::size_t indices[2] = {i, j};
+      profiler.access(cursors, 2, 2, indices, kExtents, sizeof(double));
+    }
+  }
+
+  SiteTraversalProfile rows;
+  ASSERT_TRUE(profiler.siteProfile(1, rows));
+  EXPECT_EQ(rows.accesses, kRows * kColumns);
+  EXPECT_EQ(rows.rank, 2u);
+  EXPECT_EQ(rows.extents[0], kRows);
+  EXPECT_EQ(rows.extents[1], kColumns);
+  EXPECT_EQ(rows.fastestDimension(), 1u);
+  EXPECT_EQ(rows.dimensionStride(1), sizeof(double));
+
+  SiteTraversalProfile columns;
+  ASSERT_TRUE(profiler.siteProfile(2, columns));
+  EXPECT_EQ(columns.fastestDimension(), 0u);
+  EXPECT_EQ(columns.dimensionStride(0), kColumns * sizeof(double));
+  // Every step but the column changes moves along dimension 0
+  EXPECT_EQ(columns.innermost_changed[0], kRows * kColumns - kColumns);
+  EXPECT_EQ(columns.innermost_changed[1], kColumns - 1);
+
+  SiteTraversalProfile none;
+  EXPECT_FALSE(profiler.siteProfile(3, none));
+}
+
+TEST(TraversalProfilerTest, UnknownExtentsAndRepeatedElements) {
+  TraversalProfiler profiler(16);
+  TraversalCursor cursors[TraversalProfiler::kCursors];
+
+  // Pointer-to-pointer chain: no extents, and the same element twice
+  const std::size_t unknown[2] = {0, 0};
+  const std::size_t first[2] = {3, 4};
+  const std::size_t next[2] = {3, 5};
+  profiler.access(cursors, 5, 2, first, unknown, sizeof(int));
+  profiler.access(cursors, 5, 2, first, unknown, sizeof(int));
+  profiler.access(cursors, 5, 2, next, unknown, sizeof(int));
+
+  SiteTraversalProfile profile;
+  ASSERT_TRUE(profiler.siteProfile(5, profile));
+  EXPECT_EQ(profile.accesses, 3u);
+  EXPECT_EQ(profile.innermost_changed[0], 0u);
+  EXPECT_EQ(profile.innermost_changed[1], 1u);
+  EXPECT_EQ(profile.dimensionStride(1), sizeof(int));
+  EXPECT_EQ(profile.dimensionStride(0), 0u);
+}
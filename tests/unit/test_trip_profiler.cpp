@@ -0,0 +1,52 @@
+#include "optiweave/runtime/trip_profiler.hpp"
+#include <gtest/gtest.h>
+
+using namespace optiweave::runtime;
+
+TEST(TripProfilerTest, HistogramsTripCountsPerLoop) {
+  TripProfiler profiler(16);
+  for (int i = 0; i < 100; ++i) {
+    profiler.record(2, 1000);
+    profiler.record(3, i % 3);
+  }
+
+  LoopTripProfile inner;
+  ASSERT_TRUE(profiler.siteProfile(2, inner));
+  EXPECT_EQ(inner.executions, 100u);
+  EXPECT_EQ(inner.trips, 100000u);
+  EXPECT_DOUBLE_EQ(inner.meanTrips(), 1000.0);
+  EXPECT_EQ(inner.min_trips, 1000u);
+  EXPECT_EQ(inner.max_trips, 1000u);
+  EXPECT_EQ(inner.buckets[LoopTripProfile::bucketOf(1000)], 100u);
+  EXPECT_EQ(inner.percentileTrips(0.5), 1000u);
+  EXPECT_EQ(classifyLoop(inner), LoopAdvice::Vectorize);
+
+  LoopTripProfile tiny;
+  ASSERT_TRUE(profiler.siteProfile(3, tiny));
+  EXPECT_EQ(tiny.min_trips, 0u);
+  EXPECT_EQ(tiny.max_trips, 2u);
+  EXPECT_EQ(tiny.buckets[0], 34u);
+  EXPECT_EQ(classifyLoop(tiny), LoopAdvice::TooShort);
+
+  LoopTripProfile none;
+  EXPECT_FALSE(profiler.siteProfile(4, none));
+}
+
+TEST(TripProfilerTest, ClassifiesByMedianTrips) {
+  LoopTripProfile constant;
+  constant.executions = 10;
+  constant.min_trips = constant.max_trips = 48;
+  constant.buckets[LoopTripProfile::bucketOf(48)] = 10;
+  EXPECT_EQ(classifyLoop(constant), LoopAdvice::Unroll);
+
+  LoopTripProfile varying = constant;
+  varying.min_trips = 40;
+  EXPECT_EQ(classifyLoop(varying), LoopAdvice::Vectorize);
+
+  LoopTripProfile huge;
+  huge.executions = 4;
+  huge.min_trips = huge.max_trips = 1u << 20;
+  huge.buckets[LoopTripProfile::bucketOf(1u << 20)] = 4;
+  EXPECT_EQ(classifyLoop(huge), LoopAdvice::Tile);
+  EXPECT_EQ(huge.percentileTrips(0.9), 1u << 20);
+}
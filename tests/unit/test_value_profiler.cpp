@@ -0,0 +1,84 @@
+#include "optiweave/runtime/value_profiler.hpp"
+#include <gtest/gtest.h>
+
+#include <thread>
+
+using namespace optiweave::runtime;
+
+namespace {
+SiteValueProfile profileOf(ValueProfiler &profiler, SiteId site) {
+  SiteValueProfile profile;
+  EXPECT_TRUE(profiler.siteProfile(site, profile));
+  return profile;
+}
+} // namespace
+
+TEST(ValueSketchTest, KeepsHeavyHittersAmongNoise) {
+  ValueProfiler profiler;
+  ValueSketch table[ValueProfiler::kSketches];
+  for (int i = 0; i < 10000; ++i) {
+    // 7 half of the time, never-repeating noise otherwise
+    profiler.record(table, 1, i % 2 ? 7 : 1000 + i);
+  }
+  profiler.collect(table);
+
+  SiteValueProfile profile = profileOf(profiler, 1);
+  EXPECT_EQ(profile.total, 10000u);
+  ASSERT_FALSE(profile.top.empty());
+  EXPECT_EQ(profile.top.front().value, 7);
+  // Guaranteed share is a lower bound on the true 50%
+  EXPECT_LE(profile.topShare(), 0.5);
+  EXPECT_GT(profile.topShare(), 0.35);
+  EXPECT_EQ(classifyDivisors(profile), DivisorPattern::Varied);
+}
+
+TEST(ValueProfilerTest, ClassifiesDivisorPatterns) {
+  ValueProfiler profiler;
+  ValueSketch table[ValueProfiler::kSketches];
+  for (int i = 0; i < 1000; ++i) {
+    profiler.record(table, 2, 10);
+    profiler.record(table, 3, std::int64_t{1} << (i % 5));
+    profiler.record(table, 4, i % 3 ? 3 : -5);
+    profiler.record(table, 5, i + 1);
+  }
+  profiler.collect(table);
+
+  EXPECT_EQ(classifyDivisors(profileOf(profiler, 2)), DivisorPattern::Constant);
+  EXPECT_EQ(classifyDivisors(profileOf(profiler, 3)),
+            DivisorPattern::PowerOfTwo);
+  EXPECT_EQ(classifyDivisors(profileOf(profiler, 4)),
+            DivisorPattern::FewValues);
+  EXPECT_EQ(classifyDivisors(profileOf(profiler, 5)), DivisorPattern::Varied);
+
+  std::vector<SiteId> expected{2, 3, 4, 5};
+  EXPECT_EQ(profiler.sites(), expected);
+}
+
+TEST(ValueProfilerTest, EvictionAndThreadsMergeIntoOneProfile) {
+  ValueProfiler profiler;
+  ValueSketch first[ValueProfiler::kSketches];
+  ValueSketch second[ValueProfiler::kSketches];
+
+  // Sites 1 and 1 + kSketches share a slot and keep evicting each other
+  std::thread worker([&] {
+    for (int i = 0; i < 500; ++i) {
+      profiler.record(second, 1, 64);
+    }
+  });
+  for (int i = 0; i < 500; ++i) {
+    profiler.record(first, 1, 64);
+    profiler.record(first, 1 + ValueProfiler::kSketches, 3);
+  }
+  worker.join();
+  profiler.collect(first);
+  profiler.collect(second);
+
+  SiteValueProfile shared = profileOf(profiler, 1);
+  EXPECT_EQ(shared.total, 1000u);
+  EXPECT_EQ(shared.top.size(), 1u);
+  EXPECT_DOUBLE_EQ(shared.topShare(), 1.0);
+  EXPECT_EQ(profileOf(profiler, 1 + ValueProfiler::kSketches).total, 500u);
+
+  SiteValueProfile none;
+  EXPECT_FALSE(profiler.siteProfile(9, none));
+}